@@ -0,0 +1,322 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  connectionBenchmarks.cpp
+* @brief Checks and measures ClientConnectionManager against a set of in process drivers
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddClientConnectionManager.h"
+#include "devDriverServer.h"
+#include "protocols/loggingClient.h"
+#include "../src/ddMessageStream.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        DD_STATIC_CONST uint32 kConnectionListenerPort = 27310;
+        DD_STATIC_CONST uint32 kClientsPerTarget = 3;
+        DD_STATIC_CONST uint32 kStreamPort = 27392;
+
+        // Fills a stream connection that nobody reads from. Sends must never wait for the socket to drain, and every
+        // message that was accepted has to arrive whole and in order once the other side starts reading.
+        static void CheckStreamSends(Result* pResult)
+        {
+            Result &result = *pResult;
+
+            Socket listenSocket;
+            Socket sendSocket;
+            Socket receiveSocket;
+            DD_BENCH_CHECK(listenSocket.Init(true, SocketType::Tcp) == Result::Success);
+            DD_BENCH_CHECK(listenSocket.Bind("127.0.0.1", kStreamPort) == Result::Success);
+            DD_BENCH_CHECK(listenSocket.Listen(1) == Result::Success);
+            DD_BENCH_CHECK(receiveSocket.Init(true, SocketType::Tcp) == Result::Success);
+            receiveSocket.SetBufferSizes(16 * 1024, 16 * 1024);
+            receiveSocket.Connect("127.0.0.1", kStreamPort);
+
+            bool canAccept = false;
+            listenSocket.Select(&canAccept, nullptr, nullptr, 1000);
+            DD_BENCH_CHECK(canAccept && (listenSocket.Accept(&sendSocket) == Result::Success));
+            if (result != Result::Success)
+            {
+                return;
+            }
+            sendSocket.SetBufferSizes(16 * 1024, 16 * 1024);
+
+            bool canWrite = false;
+            receiveSocket.Select(nullptr, &canWrite, nullptr, 1000);
+            DD_BENCH_CHECK(canWrite);
+
+            MessageStream sendStream;
+            MessageStream receiveStream;
+            MessageBuffer message = {};
+
+            // Messages of varying size keep the free space in the socket buffer from lining up with message
+            // boundaries, so some of them only partly fit. How often that happens is up to the kernel, so the
+            // exchange goes on in rounds until it has happened at least once.
+            DD_STATIC_CONST uint32 kMessagesPerRound = 4000;
+            DD_STATIC_CONST uint32 kMaxMessages = (10 * kMessagesPerRound);
+            uint32 numMessages = kMessagesPerRound;
+            uint32 numSent = 0;
+            uint32 numReceived = 0;
+            uint32 numMismatches = 0;
+            uint32 numPartialSends = 0;
+            uint64 maxSendNs = 0;
+            const uint64 deadlineInMs = (Platform::GetCurrentTimeInMs() + 10000);
+            while ((numReceived < numMessages) && (Platform::GetCurrentTimeInMs() < deadlineInMs))
+            {
+                // Keep writing until the socket pushes back.
+                Result sendResult = Result::Success;
+                while ((sendResult == Result::Success) && (numSent < numMessages))
+                {
+                    message.header.payloadSize = static_cast<Size>(8 + ((numSent * 397) % 1300));
+                    memset(&message.payload[0], static_cast<int>(numSent), message.header.payloadSize);
+                    memcpy(&message.payload[0], &numSent, sizeof(numSent));
+
+                    Stopwatch sendTimer;
+                    sendResult = sendStream.SendMessage(&sendSocket, message);
+                    maxSendNs = Platform::Max(maxSendNs, sendTimer.GetElapsedNs());
+
+                    if (sendResult == Result::Success)
+                    {
+                        numPartialSends += sendStream.HasPendingSend() ? 1 : 0;
+                        ++numSent;
+                    }
+                }
+                DD_BENCH_CHECK(sendResult != Result::Error);
+
+                // Then read a single message, which frees a little room.
+                MessageBuffer received = {};
+                if (receiveStream.ReceiveMessage(&receiveSocket, &received) == Result::Success)
+                {
+                    uint32 sequence = 0;
+                    memcpy(&sequence, &received.payload[0], sizeof(sequence));
+                    const bool isMatch =
+                        (sequence == numReceived) &&
+                        (received.header.payloadSize == (8 + ((numReceived * 397) % 1300))) &&
+                        (static_cast<uint8>(received.payload[received.header.payloadSize - 1]) ==
+                         static_cast<uint8>(numReceived));
+                    numMismatches += isMatch ? 0 : 1;
+                    ++numReceived;
+                }
+                else
+                {
+                    sendStream.FlushSend(&sendSocket);
+                    bool canRead = false;
+                    receiveSocket.Select(&canRead, nullptr, nullptr, 10);
+                }
+
+                if ((numReceived == numMessages) && (numPartialSends == 0) && (numMessages < kMaxMessages))
+                {
+                    numMessages += kMessagesPerRound;
+                }
+            }
+            DD_BENCH_CHECK((numReceived == numMessages) && (numMismatches == 0));
+            DD_BENCH_CHECK(sendStream.HasPendingSend() == false);
+            DD_BENCH_CHECK(numPartialSends > 0);
+            DD_BENCH_CHECK(maxSendNs < (100ull * 1000 * 1000));
+
+            printf("%u stream messages received intact, %u partly sent, slowest send %.2f ms\n",
+                   numReceived - numMismatches,
+                   numPartialSends,
+                   static_cast<double>(maxSendNs) / 1000000.0);
+        }
+
+        // =============================================================================================================
+        Result RunConnectionBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+            const AllocCb allocCb = GetAllocCb();
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kConnectionListenerPort, nullptr) == Result::Success);
+
+            // Drivers to connect to. Drivers only use local transports. Each one serves the logging protocol.
+            const uint32 numTargets = options.quick ? 4 : 32;
+            std::vector<DevDriverServer*> servers;
+            std::vector<ClientId> targets;
+            for (uint32 targetIndex = 0; targetIndex < numTargets; ++targetIndex)
+            {
+                ServerCreateInfo serverInfo = {};
+                serverInfo.componentType = Component::Driver;
+                serverInfo.createUpdateThread = true;
+                serverInfo.connectionInfo = GetLoopbackHostInfo(TransportType::LocalPacket, kConnectionListenerPort);
+                serverInfo.servers.logging = 1;
+                Platform::Strncpy(serverInfo.clientDescription, "ddBenchmarks driver", sizeof(serverInfo.clientDescription));
+
+                DevDriverServer* pServer = new DevDriverServer(allocCb, serverInfo);
+                if (pServer->Initialize() == Result::Success)
+                {
+                    servers.push_back(pServer);
+                    targets.push_back(pServer->GetMessageChannel()->GetClientId());
+                }
+                else
+                {
+                    delete pServer;
+                }
+            }
+            DD_BENCH_CHECK(targets.size() == numTargets);
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kConnectionListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks tool", sizeof(clientInfo.clientDescription));
+
+            DevDriverClient client(allocCb, clientInfo);
+            DD_BENCH_CHECK(client.Initialize() == Result::Success);
+
+            ClientConnectionManagerCreateInfo managerInfo = {};
+            managerInfo.maxClientsPerTarget = kClientsPerTarget;
+            ClientConnectionManager manager(allocCb, &client, managerInfo);
+
+            // Fill every target up to its quota. The thread count must not depend on the number of targets.
+            const uint32 numThreadsBefore = GetNumThreads();
+            std::vector<uint64> connectTimes;
+            for (ClientId targetClientId : targets)
+            {
+                for (uint32 clientIndex = 0; clientIndex < kClientsPerTarget; ++clientIndex)
+                {
+                    LoggingProtocol::LoggingClient* pLoggingClient = nullptr;
+                    Stopwatch connectTimer;
+                    const Result connectResult = manager.ConnectProtocolClient<Protocol::Logging>(targetClientId, &pLoggingClient);
+                    connectTimes.push_back(connectTimer.GetElapsedNs());
+                    DD_BENCH_CHECK(connectResult == Result::Success);
+                }
+
+                LoggingProtocol::LoggingClient* pOverQuota = nullptr;
+                DD_BENCH_CHECK(manager.ConnectProtocolClient<Protocol::Logging>(targetClientId, &pOverQuota) == Result::Rejected);
+                DD_BENCH_CHECK(manager.GetNumConnectedClients(targetClientId) == kClientsPerTarget);
+            }
+            const uint32 numThreadsAfter = GetNumThreads();
+            DD_BENCH_CHECK(numThreadsAfter == numThreadsBefore);
+
+            printf("%u targets, %u protocol clients: threads %u -> %u, connect p50 %.2f ms p99 %.2f ms\n",
+                   numTargets,
+                   static_cast<uint32>(connectTimes.size()),
+                   numThreadsBefore,
+                   numThreadsAfter,
+                   static_cast<double>(Percentile(&connectTimes, 50.0)) / 1000000.0,
+                   static_cast<double>(Percentile(&connectTimes, 99.0)) / 1000000.0);
+
+            // Disconnecting a target gives its whole quota back.
+            if (targets.size() > 0)
+            {
+                manager.DisconnectTarget(targets[0]);
+                DD_BENCH_CHECK(manager.GetNumConnectedClients(targets[0]) == 0);
+
+                LoggingProtocol::LoggingClient* pLoggingClient = nullptr;
+                DD_BENCH_CHECK(manager.ConnectProtocolClient<Protocol::Logging>(targets[0], &pLoggingClient) == Result::Success);
+                manager.DisconnectProtocolClient(pLoggingClient);
+            }
+
+            // Disconnect everything while other threads are in the middle of connecting. Reservations of connects in
+            // flight must survive so that every quota is whole again afterwards.
+            if (targets.size() > 0)
+            {
+                std::atomic<bool> connecting(true);
+                std::vector<std::thread> connectThreads;
+                for (uint32 threadIndex = 0; threadIndex < 2; ++threadIndex)
+                {
+                    connectThreads.emplace_back([&manager, &targets, &connecting]()
+                    {
+                        uint32 targetIndex = 0;
+                        while (connecting.load())
+                        {
+                            // The client may already have been taken by DisconnectAll, which makes this a no-op.
+                            LoggingProtocol::LoggingClient* pLoggingClient = nullptr;
+                            if (manager.ConnectProtocolClient<Protocol::Logging>(targets[targetIndex % targets.size()],
+                                                                                 &pLoggingClient) == Result::Success)
+                            {
+                                manager.DisconnectProtocolClient(pLoggingClient);
+                            }
+                            ++targetIndex;
+                        }
+                    });
+                }
+
+                const uint64 raceEndTimeInMs = Platform::GetCurrentTimeInMs() + (options.quick ? 500 : 3000);
+                uint32 numDisconnects = 0;
+                while (Platform::GetCurrentTimeInMs() < raceEndTimeInMs)
+                {
+                    manager.DisconnectAll();
+                    ++numDisconnects;
+                    Platform::Sleep(1);
+                }
+
+                connecting.store(false);
+                for (std::thread &connectThread : connectThreads)
+                {
+                    connectThread.join();
+                }
+
+                // The connect threads released their own clients. Calling DisconnectAll here would hide a broken count.
+
+                uint32 numRejected = 0;
+                for (ClientId targetClientId : targets)
+                {
+                    DD_BENCH_CHECK(manager.GetNumConnectedClients(targetClientId) == 0);
+                    for (uint32 clientIndex = 0; clientIndex < kClientsPerTarget; ++clientIndex)
+                    {
+                        LoggingProtocol::LoggingClient* pLoggingClient = nullptr;
+                        const Result connectResult =
+                            manager.ConnectProtocolClient<Protocol::Logging>(targetClientId, &pLoggingClient);
+                        numRejected += (connectResult == Result::Rejected) ? 1 : 0;
+                    }
+
+                    LoggingProtocol::LoggingClient* pOverQuota = nullptr;
+                    DD_BENCH_CHECK(manager.ConnectProtocolClient<Protocol::Logging>(targetClientId, &pOverQuota) ==
+                                   Result::Rejected);
+                }
+                DD_BENCH_CHECK(numRejected == 0);
+                printf("%u DisconnectAll calls during concurrent connects, %u connects rejected afterwards\n",
+                       numDisconnects,
+                       numRejected);
+            }
+
+            manager.DisconnectAll();
+            client.Destroy();
+
+            for (DevDriverServer* pServer : servers)
+            {
+                pServer->Destroy();
+                delete pServer;
+            }
+
+            listener.Destroy();
+
+            CheckStreamSends(&result);
+
+            return result;
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  crc32Benchmarks.cpp
+* @brief Checks CRC32 against a bitwise reference and measures its throughput
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include <cstdio>
+#include <random>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        DD_STATIC_CONST size_t kMaxCheckedLength = 1200;
+        DD_STATIC_CONST size_t kMaxCheckedAlignment = 16;
+
+        // One bit at a time, straight from the definition of the reflected polynomial.
+        static uint32 Crc32Bitwise(const uint8* pData, size_t length, uint32 lastCrc)
+        {
+            uint32 crc = ~lastCrc;
+            for (size_t byteIndex = 0; byteIndex < length; ++byteIndex)
+            {
+                crc ^= pData[byteIndex];
+                for (uint32 bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0u);
+                }
+            }
+            return ~crc;
+        }
+
+        // =============================================================================================================
+        Result RunCrc32Benchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+#if defined(__x86_64__) || defined(__i386__)
+            printf("pclmul %s\n", __builtin_cpu_supports("pclmul") ? "available, folding path checked" : "unavailable");
+#endif
+
+            // The check value of the standard CRC32.
+            DD_BENCH_CHECK(CRC32("123456789", 9) == 0xCBF43926u);
+
+            // Every length up to well past the folding threshold at every alignment of a 16 byte block, each starting
+            // from a random CRC. This covers the folded body, the tail that follows it and the slice-by-8 and
+            // byte-wise loops on their own.
+            std::mt19937 random(0x43524333u);
+            std::vector<uint8> buffer(kMaxCheckedLength + kMaxCheckedAlignment);
+            const uint32 numSeeds = options.quick ? 1 : 4;
+            uint32 numChecks = 0;
+            uint32 numMismatches = 0;
+            for (uint32 seedIndex = 0; seedIndex < numSeeds; ++seedIndex)
+            {
+                for (uint8 &byte : buffer)
+                {
+                    byte = static_cast<uint8>(random());
+                }
+
+                for (size_t alignment = 0; alignment <= kMaxCheckedAlignment; ++alignment)
+                {
+                    for (size_t length = 0; length < kMaxCheckedLength; ++length)
+                    {
+                        const uint8* pData = buffer.data() + alignment;
+                        const uint32 lastCrc = static_cast<uint32>(random());
+                        numMismatches += (CRC32(pData, length, lastCrc) != Crc32Bitwise(pData, length, lastCrc)) ? 1 : 0;
+                        ++numChecks;
+                    }
+                }
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+
+            // Transfers chain the CRC across chunks, so any split has to give the same result as a single call.
+            for (size_t split = 0; split <= kMaxCheckedLength; split += 7)
+            {
+                const uint32 firstCrc = CRC32(buffer.data(), split);
+                const uint32 chainedCrc = CRC32(buffer.data() + split, kMaxCheckedLength - split, firstCrc);
+                numMismatches += (chainedCrc != Crc32Bitwise(buffer.data(), kMaxCheckedLength, 0)) ? 1 : 0;
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+
+            printf("%u lengths and alignments match the bitwise reference, %u mismatches\n", numChecks, numMismatches);
+
+            // Throughput at the sizes the transfer protocol uses: single chunks, frames and whole blocks.
+            const size_t kSizes[] = { 64, 4096, 64 * 1024, 16 * 1024 * 1024 };
+            const uint64 targetBytes = options.quick ? (16ull * 1024 * 1024) : (1024ull * 1024 * 1024);
+            std::vector<uint8> data(kSizes[3]);
+            for (uint8 &byte : data)
+            {
+                byte = static_cast<uint8>(random());
+            }
+
+            printf("%10s %12s %14s\n", "size", "CRC32 MB/s", "bitwise MB/s");
+            for (size_t size : kSizes)
+            {
+                const uint64 numIterations = Platform::Max<uint64>(targetBytes / size, 1);
+
+                uint32 crc = 0;
+                Stopwatch crcTimer;
+                for (uint64 iteration = 0; iteration < numIterations; ++iteration)
+                {
+                    crc = CRC32(data.data(), size, crc);
+                }
+                const uint64 crcNs = Platform::Max<uint64>(crcTimer.GetElapsedNs(), 1);
+
+                // The reference is slow, so it only sees a sixty-fourth of the data.
+                const uint64 numBitwiseIterations = Platform::Max<uint64>(numIterations / 64, 1);
+                uint32 bitwiseCrc = 0;
+                Stopwatch bitwiseTimer;
+                for (uint64 iteration = 0; iteration < numBitwiseIterations; ++iteration)
+                {
+                    bitwiseCrc = Crc32Bitwise(data.data(), size, bitwiseCrc);
+                }
+                const uint64 bitwiseNs = Platform::Max<uint64>(bitwiseTimer.GetElapsedNs(), 1);
+
+                if (numBitwiseIterations == numIterations)
+                {
+                    DD_BENCH_CHECK(crc == bitwiseCrc);
+                }
+
+                printf("%10u %12.1f %14.1f\n",
+                       static_cast<uint32>(size),
+                       (static_cast<double>(size * numIterations) / (1024.0 * 1024.0)) / (crcNs / 1000000000.0),
+                       (static_cast<double>(size * numBitwiseIterations) / (1024.0 * 1024.0)) / (bitwiseNs / 1000000000.0));
+            }
+
+            return result;
+        }
+    }
+}
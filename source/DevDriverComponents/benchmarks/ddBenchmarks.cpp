@@ -0,0 +1,325 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddBenchmarks.cpp
+* @brief Entry point and shared helpers for the DevDriver component benchmarks
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        struct BenchmarkSuite
+        {
+            const char*   pName;
+            const char*   pDescription;
+            BenchmarkFunc pfnRun;
+            bool          isOptIn; // Only runs when named on the command line
+        };
+
+        static const BenchmarkSuite kSuites[] =
+        {
+            { "router",      "Transport client lookup by connection",              RunRouterBenchmarks,     false },
+            { "connections", "Client connection manager quotas and thread count",  RunConnectionBenchmarks, false },
+            { "impairment",  "Network impairment schedules and impaired pulls",    RunImpairmentBenchmarks, false },
+            { "crc32",       "CRC32 against a bitwise reference and throughput",   RunCrc32Benchmarks,      false },
+            { "fileblocks",  "File backed server blocks against heap blocks",      RunFileBlockBenchmarks,  false },
+            { "transfers",   "Push and pull throughput and latency per transport", RunTransferBenchmarks,   true  },
+            { "push",        "Pipelined push, background finalize and resume",     RunPushBenchmarks,       false },
+            { "lz4",         "LZ4 round trips, bad blocks and compressed pulls",   RunLz4Benchmarks,        false },
+            { "pull",        "Cached, parallel and resumed pulls and retention",   RunPullBenchmarks,       false },
+            { "registry",    "Server block lookups and idle block reuse",          RunRegistryBenchmarks,   false },
+            { "gro",         "Coalesced datagram receives split into messages",    RunGroBenchmarks,        false },
+        };
+
+        // =============================================================================================================
+        uint64 GetTimeInNs()
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // =============================================================================================================
+        uint64 GetCpuTimeInNs()
+        {
+            timespec time = {};
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+            return (static_cast<uint64>(time.tv_sec) * 1000000000ull) + static_cast<uint64>(time.tv_nsec);
+        }
+
+        // =============================================================================================================
+        Stopwatch::Stopwatch()
+        {
+            Restart();
+        }
+
+        // =============================================================================================================
+        void Stopwatch::Restart()
+        {
+            m_startTimeInNs = GetTimeInNs();
+            m_startCpuTimeInNs = GetCpuTimeInNs();
+        }
+
+        // =============================================================================================================
+        uint64 Stopwatch::GetElapsedNs() const
+        {
+            return (GetTimeInNs() - m_startTimeInNs);
+        }
+
+        // =============================================================================================================
+        uint64 Stopwatch::GetCpuTimeNs() const
+        {
+            return (GetCpuTimeInNs() - m_startCpuTimeInNs);
+        }
+
+        // =============================================================================================================
+        uint64 Percentile(std::vector<uint64>* pSamples, double percentile)
+        {
+            uint64 value = 0;
+            if (pSamples->size() > 0)
+            {
+                std::sort(pSamples->begin(), pSamples->end());
+                const size_t index = static_cast<size_t>((percentile / 100.0) * static_cast<double>(pSamples->size() - 1));
+                value = (*pSamples)[index];
+            }
+            return value;
+        }
+
+        // =============================================================================================================
+        static void* BenchmarkAlloc(void* pUserdata, size_t size, size_t alignment, bool zero)
+        {
+            DD_UNUSED(pUserdata);
+            return Platform::AllocateMemory(size, alignment, zero);
+        }
+
+        // =============================================================================================================
+        static void BenchmarkFree(void* pUserdata, void* pMemory)
+        {
+            DD_UNUSED(pUserdata);
+            Platform::FreeMemory(pMemory);
+        }
+
+        // =============================================================================================================
+        AllocCb GetAllocCb()
+        {
+            AllocCb allocCb = {};
+            allocCb.pUserdata = nullptr;
+            allocCb.pfnAlloc = BenchmarkAlloc;
+            allocCb.pfnFree = BenchmarkFree;
+            return allocCb;
+        }
+
+        // =============================================================================================================
+        static void* CountingAlloc(void* pUserdata, size_t size, size_t alignment, bool zero)
+        {
+            reinterpret_cast<CountingAllocator*>(pUserdata)->bytesAllocated += size;
+            return Platform::AllocateMemory(size, alignment, zero);
+        }
+
+        // =============================================================================================================
+        AllocCb GetCountingAllocCb(CountingAllocator* pCounter)
+        {
+            AllocCb allocCb = {};
+            allocCb.pUserdata = pCounter;
+            allocCb.pfnAlloc = CountingAlloc;
+            allocCb.pfnFree = BenchmarkFree;
+            return allocCb;
+        }
+
+        // =============================================================================================================
+        Result StartLoopbackListener(ListenerCore* pListener, uint32 port, NetworkImpairment* pImpairment)
+        {
+            ListenerBindAddress bindAddress = {};
+            Platform::Strncpy(bindAddress.hostAddress, kDefaultLocalHost.hostname, sizeof(bindAddress.hostAddress));
+            bindAddress.port = port;
+
+            ListenerCreateInfo createInfo = {};
+            Platform::Strncpy(createInfo.description, "ddBenchmarks", sizeof(createInfo.description));
+            createInfo.flags.enableStreamTransport = 1;
+            createInfo.flags.enableLocalPacketTransport = 1;
+            createInfo.pAddressesToBind = &bindAddress;
+            createInfo.numAddresses = 1;
+            createInfo.pNetworkImpairment = pImpairment;
+            createInfo.allocCb = GetAllocCb();
+
+            return pListener->Initialize(createInfo);
+        }
+
+        // =============================================================================================================
+        HostInfo GetLoopbackHostInfo(TransportType type, uint32 port)
+        {
+            HostInfo hostInfo = kDefaultLocalHost;
+            if (type == TransportType::Local)
+            {
+                hostInfo = kDefaultNamedPipe;
+            }
+            else if (type == TransportType::LocalPacket)
+            {
+                hostInfo = kDefaultLocalPacketSocket;
+            }
+            else
+            {
+                hostInfo.type = type;
+                hostInfo.port = port;
+            }
+            return hostInfo;
+        }
+
+        // =============================================================================================================
+        uint64 GetRouterBytesReceived(ListenerCore* pListener)
+        {
+            uint64 bytesReceived = 0;
+            for (const TransportTrafficStats &transport : pListener->GetRouterStats().transports)
+            {
+                bytesReceived += transport.traffic.bytesReceived;
+            }
+            return bytesReceived;
+        }
+
+        // =============================================================================================================
+        uint32 GetNumThreads()
+        {
+            uint32 numThreads = 0;
+
+            FILE* pStatus = fopen("/proc/self/status", "r");
+            if (pStatus != nullptr)
+            {
+                char line[256];
+                while (fgets(line, sizeof(line), pStatus) != nullptr)
+                {
+                    if (sscanf(line, "Threads: %u", &numThreads) == 1)
+                    {
+                        break;
+                    }
+                }
+                fclose(pStatus);
+            }
+
+            return numThreads;
+        }
+
+        // =============================================================================================================
+        void Check(bool condition, const char* pExpression, const char* pFile, int line, Result* pResult)
+        {
+            if (condition == false)
+            {
+                printf("CHECK FAILED %s:%d: %s\n", pFile, line, pExpression);
+                *pResult = Result::Error;
+            }
+        }
+    }
+}
+
+using namespace DevDriver;
+using namespace DevDriver::Benchmarks;
+
+static void PrintUsage()
+{
+    printf("Usage: ddBenchmarks [--quick] [suite ...]\n");
+    printf("  --quick  Use small sizes and few iterations\n");
+    printf("Runs every suite that isn't opt-in if none are named. Suites:\n");
+    for (const BenchmarkSuite &suite : kSuites)
+    {
+        printf("  %-12s %s%s\n", suite.pName, suite.pDescription, suite.isOptIn ? " (opt-in)" : "");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    setvbuf(stdout, nullptr, _IONBF, 0);
+
+    BenchmarkOptions options = {};
+    std::vector<const BenchmarkSuite*> suitesToRun;
+    bool validArguments = true;
+
+    for (int argIndex = 1; argIndex < argc; ++argIndex)
+    {
+        const char* pArg = argv[argIndex];
+        if (strcmp(pArg, "--quick") == 0)
+        {
+            options.quick = true;
+        }
+        else
+        {
+            const BenchmarkSuite* pSuite = nullptr;
+            for (const BenchmarkSuite &suite : kSuites)
+            {
+                if (strcmp(pArg, suite.pName) == 0)
+                {
+                    pSuite = &suite;
+                }
+            }
+
+            if (pSuite != nullptr)
+            {
+                suitesToRun.push_back(pSuite);
+            }
+            else
+            {
+                validArguments = false;
+            }
+        }
+    }
+
+    if (validArguments == false)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    if (suitesToRun.empty())
+    {
+        for (const BenchmarkSuite &suite : kSuites)
+        {
+            if (suite.isOptIn == false)
+            {
+                suitesToRun.push_back(&suite);
+            }
+        }
+    }
+
+    int exitCode = 0;
+    for (const BenchmarkSuite* pSuite : suitesToRun)
+    {
+        printf("== %s: %s\n", pSuite->pName, pSuite->pDescription);
+        const Result result = pSuite->pfnRun(options);
+        printf("== %s: %s\n", pSuite->pName, (result == Result::Success) ? "passed" : "FAILED");
+        if (result != Result::Success)
+        {
+            exitCode = 1;
+        }
+    }
+
+    return exitCode;
+}
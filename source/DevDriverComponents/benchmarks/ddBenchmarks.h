@@ -0,0 +1,125 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddBenchmarks.h
+* @brief Shared declarations for the DevDriver component benchmarks and checks
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "gpuopen.h"
+#include "ddPlatform.h"
+#include <atomic>
+#include <vector>
+
+namespace DevDriver
+{
+    class ListenerCore;
+    class NetworkImpairment;
+
+    namespace Benchmarks
+    {
+        // Options shared by every suite
+        struct BenchmarkOptions
+        {
+            bool quick; // Use small sizes and few iterations so the suite fits into a regular test run
+        };
+
+        // Runs the checks and measurements of a suite. Returns Result::Success if every check passed.
+        typedef Result (*BenchmarkFunc)(const BenchmarkOptions &options);
+
+        // Suites
+        Result RunRouterBenchmarks(const BenchmarkOptions &options);
+        Result RunConnectionBenchmarks(const BenchmarkOptions &options);
+        Result RunImpairmentBenchmarks(const BenchmarkOptions &options);
+        Result RunCrc32Benchmarks(const BenchmarkOptions &options);
+        Result RunFileBlockBenchmarks(const BenchmarkOptions &options);
+        Result RunTransferBenchmarks(const BenchmarkOptions &options);
+        Result RunPushBenchmarks(const BenchmarkOptions &options);
+        Result RunLz4Benchmarks(const BenchmarkOptions &options);
+        Result RunPullBenchmarks(const BenchmarkOptions &options);
+        Result RunRegistryBenchmarks(const BenchmarkOptions &options);
+        Result RunGroBenchmarks(const BenchmarkOptions &options);
+
+        // Measures wall clock and process cpu time from construction or the last call to Restart.
+        class Stopwatch
+        {
+        public:
+            Stopwatch();
+
+            void Restart();
+
+            uint64 GetElapsedNs() const;
+            uint64 GetCpuTimeNs() const;
+
+        private:
+            uint64 m_startTimeInNs;
+            uint64 m_startCpuTimeInNs;
+        };
+
+        // Returns a monotonic timestamp in nanoseconds.
+        uint64 GetTimeInNs();
+
+        // Returns the cpu time used by the whole process in nanoseconds.
+        uint64 GetCpuTimeInNs();
+
+        // Returns the given percentile (0 to 100) of the samples. Sorts the samples in place.
+        uint64 Percentile(std::vector<uint64>* pSamples, double percentile);
+
+        // Allocation callbacks backed by the platform allocator
+        AllocCb GetAllocCb();
+
+        // Counts the bytes requested through the callbacks returned by GetCountingAllocCb.
+        struct CountingAllocator
+        {
+            std::atomic<uint64> bytesAllocated;
+        };
+
+        // Allocation callbacks backed by the platform allocator that add every allocation to the counter
+        AllocCb GetCountingAllocCb(CountingAllocator* pCounter);
+
+        // Starts a listener on the loopback address with every transport enabled. Each suite uses its own port. The
+        // impairment is optional.
+        Result StartLoopbackListener(ListenerCore* pListener, uint32 port, NetworkImpairment* pImpairment);
+
+        // Connection info for clients and servers that connect to a loopback listener over the given transport
+        HostInfo GetLoopbackHostInfo(TransportType type, uint32 port);
+
+        // Returns the sum of the bytes every router transport of the listener has received so far. Router stats are
+        // merged in periodically, so recent traffic may not be counted yet.
+        uint64 GetRouterBytesReceived(ListenerCore* pListener);
+
+        // Returns the number of threads in the process
+        uint32 GetNumThreads();
+
+        // Records the outcome of a single check and prints it if it failed.
+        void Check(bool condition, const char* pExpression, const char* pFile, int line, Result* pResult);
+    }
+}
+
+// Marks the suite as failed if the condition does not hold. Expects a Result named result in scope.
+#define DD_BENCH_CHECK(condition) \
+    DevDriver::Benchmarks::Check((condition), #condition, __FILE__, __LINE__, &result)
@@ -0,0 +1,214 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  fileBlockBenchmarks.cpp
+* @brief Checks and measures file backed server blocks against heap backed ones
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include <cstdio>
+#include <cstring>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kFileBlockListenerPort = 27330;
+
+        // Pulls a whole block into pData. Returns the number of bytes received, or zero if the pull failed.
+        static size_t PullWholeBlock(TransferManager* pTransferManager, ClientId clientId, BlockId blockId, uint8* pData,
+                                     size_t size)
+        {
+            size_t totalBytesRead = 0;
+            Result readResult = Result::Error;
+            PullBlock* pPullBlock = pTransferManager->OpenPullBlock(clientId, blockId);
+            if (pPullBlock != nullptr)
+            {
+                readResult = Result::Success;
+                while (readResult == Result::Success)
+                {
+                    size_t bytesRead = 0;
+                    readResult = pPullBlock->Read(pData + totalBytesRead, size - totalBytesRead, &bytesRead);
+                    totalBytesRead += bytesRead;
+                }
+                pTransferManager->ClosePullBlock(&pPullBlock);
+            }
+            return (readResult == Result::EndOfStream) ? totalBytesRead : 0;
+        }
+
+        // =============================================================================================================
+        Result RunFileBlockBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            // The server counts what it asks its allocator for, so file storage can be shown to stay out of the heap.
+            CountingAllocator counter = {};
+            const AllocCb countingAllocCb = GetCountingAllocCb(&counter);
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kFileBlockListenerPort, nullptr) == Result::Success);
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kFileBlockListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            DevDriverClient server(countingAllocCb, clientInfo);
+            DevDriverClient puller(GetAllocCb(), clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+            DD_BENCH_CHECK(puller.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                TransferManager& serverTransferManager = server.GetMessageChannel()->GetTransferManager();
+                TransferManager& pullerTransferManager = puller.GetMessageChannel()->GetTransferManager();
+                const ClientId serverClientId = server.GetMessageChannel()->GetClientId();
+
+                // Large enough for file blocks to use several segments. The odd size leaves a partial last chunk.
+                const size_t blockSize = options.quick ? ((5 * 1024 * 1024) + 17) : ((256 * 1024 * 1024) + 17);
+                std::vector<uint8> data(blockSize);
+                for (size_t index = 0; index < blockSize; ++index)
+                {
+                    data[index] = static_cast<uint8>((index * 131) + (index >> 13));
+                }
+                const uint32 dataCrc = CRC32(data.data(), blockSize);
+
+                std::vector<uint8> readData(blockSize);
+
+                printf("%-6s %10s %14s %10s\n", "store", "write MB/s", "heap bytes", "pull MB/s");
+
+                const ServerBlockStorage kStorages[] = { ServerBlockStorage::Heap, ServerBlockStorage::File };
+                for (ServerBlockStorage storage : kStorages)
+                {
+                    const bool isFile = (storage == ServerBlockStorage::File);
+
+                    // Write in uneven pieces so writes straddle segment boundaries.
+                    const uint64 bytesAllocatedBefore = counter.bytesAllocated;
+                    Stopwatch writeTimer;
+                    SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock(storage);
+                    DD_BENCH_CHECK(pBlock.IsNull() == false);
+                    if (pBlock.IsNull())
+                    {
+                        break;
+                    }
+
+                    size_t bytesWritten = 0;
+                    size_t writeSize = 1000;
+                    while (bytesWritten < blockSize)
+                    {
+                        const size_t bytesToWrite = Platform::Min(writeSize, blockSize - bytesWritten);
+                        pBlock->Write(data.data() + bytesWritten, bytesToWrite);
+                        bytesWritten += bytesToWrite;
+                        writeSize = ((writeSize * 3) % 300007) + 1;
+                    }
+                    pBlock->Close();
+                    const uint64 writeNs = Platform::Max<uint64>(writeTimer.GetElapsedNs(), 1);
+                    const uint64 bytesAllocated = (counter.bytesAllocated - bytesAllocatedBefore);
+
+                    DD_BENCH_CHECK(pBlock->GetStorage() == storage);
+                    DD_BENCH_CHECK(pBlock->GetBlockDataSize() == blockSize);
+                    DD_BENCH_CHECK(pBlock->GetCrc32() == dataCrc);
+
+                    // File storage only takes bookkeeping from the allocator. Heap storage takes the whole block.
+                    if (isFile)
+                    {
+                        DD_BENCH_CHECK(bytesAllocated < (blockSize / 16));
+                    }
+                    else
+                    {
+                        DD_BENCH_CHECK(bytesAllocated >= blockSize);
+                    }
+
+                    // Reads gather across segments at any offset.
+                    uint32 numMismatches = 0;
+                    for (size_t offset = 0; offset < blockSize; offset += ((offset * 7) % 1048573) + 4093)
+                    {
+                        const size_t numBytes = Platform::Min<size_t>(((offset * 13) % 3000000) + 1, blockSize - offset);
+                        const size_t bytesRead = pBlock->Read(offset, readData.data(), numBytes);
+                        numMismatches += ((bytesRead != numBytes) ||
+                                          (memcmp(readData.data(), data.data() + offset, numBytes) != 0)) ? 1 : 0;
+                    }
+                    DD_BENCH_CHECK(numMismatches == 0);
+                    DD_BENCH_CHECK(pBlock->Read(blockSize, readData.data(), 1) == 0);
+                    DD_BENCH_CHECK(pBlock->CalculateCrc32(0, blockSize, 0) == dataCrc);
+
+                    // Remote clients see the same data.
+                    memset(readData.data(), 0, blockSize);
+                    Stopwatch pullTimer;
+                    const size_t bytesPulled = PullWholeBlock(&pullerTransferManager,
+                                                              serverClientId,
+                                                              pBlock->GetBlockId(),
+                                                              readData.data(),
+                                                              blockSize);
+                    const uint64 pullNs = Platform::Max<uint64>(pullTimer.GetElapsedNs(), 1);
+                    DD_BENCH_CHECK((bytesPulled == blockSize) && (memcmp(readData.data(), data.data(), blockSize) == 0));
+
+                    serverTransferManager.CloseServerBlock(pBlock);
+
+                    printf("%-6s %10.1f %14llu %10.1f\n",
+                           isFile ? "file" : "heap",
+                           (static_cast<double>(blockSize) / (1024.0 * 1024.0)) / (static_cast<double>(writeNs) / 1e9),
+                           static_cast<unsigned long long>(bytesAllocated),
+                           (static_cast<double>(blockSize) / (1024.0 * 1024.0)) / (static_cast<double>(pullNs) / 1e9));
+                }
+
+                // A reused file block starts over with new contents.
+                SharedPointer<ServerBlock> pReused = serverTransferManager.OpenServerBlock(ServerBlockStorage::File, 4096);
+                DD_BENCH_CHECK(pReused.IsNull() == false);
+                if (pReused.IsNull() == false)
+                {
+                    const size_t reusedSize = 12345;
+                    pReused->Write(data.data() + 1, reusedSize);
+                    pReused->Close();
+                    DD_BENCH_CHECK(pReused->GetStorage() == ServerBlockStorage::File);
+                    DD_BENCH_CHECK(pReused->GetBlockDataSize() == reusedSize);
+                    DD_BENCH_CHECK(pReused->GetCrc32() == CRC32(data.data() + 1, reusedSize));
+
+                    const size_t bytesPulled = PullWholeBlock(&pullerTransferManager,
+                                                              serverClientId,
+                                                              pReused->GetBlockId(),
+                                                              readData.data(),
+                                                              blockSize);
+                    DD_BENCH_CHECK((bytesPulled == reusedSize) && (memcmp(readData.data(), data.data() + 1, reusedSize) == 0));
+                    serverTransferManager.CloseServerBlock(pReused);
+                }
+            }
+
+            puller.Destroy();
+            server.Destroy();
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
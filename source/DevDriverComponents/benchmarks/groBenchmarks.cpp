@@ -0,0 +1,231 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  groBenchmarks.cpp
+* @brief Checks that coalesced datagram receives are split back into separate messages
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "../listener/routerCore.h"
+#include "../src/ddSocket.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        DD_STATIC_CONST uint32 kGroListenerPort = 27390;
+        DD_STATIC_CONST uint32 kGroSocketPort   = 27391;
+
+        // Nothing else talks to the listener, so its counters only show these messages. They are addressed to a
+        // client that doesn't exist and get dropped once counted.
+        DD_STATIC_CONST ClientId kFirstSourceClientId = 0x7F00;
+        DD_STATIC_CONST ClientId kMissingClientId     = 0x7EFF;
+
+        // Fills pBuffer with numMessages back to back messages. Every message is messageSize bytes except the last,
+        // which is lastMessageSize bytes. Returns the size of the whole buffer.
+        static size_t BuildMessages(uint8* pBuffer, uint32 numMessages, size_t messageSize, size_t lastMessageSize)
+        {
+            size_t offset = 0;
+            for (uint32 messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+            {
+                const size_t size = (messageIndex == (numMessages - 1)) ? lastMessageSize : messageSize;
+
+                MessageHeader header = {};
+                header.srcClientId = static_cast<ClientId>(kFirstSourceClientId + messageIndex);
+                header.dstClientId = kMissingClientId;
+                header.protocolId = Protocol::Logging;
+                header.payloadSize = static_cast<Size>(size - sizeof(MessageHeader));
+                memcpy(pBuffer + offset, &header, sizeof(header));
+                memset(pBuffer + offset + sizeof(header), static_cast<int>(messageIndex), size - sizeof(header));
+                offset += size;
+            }
+            return offset;
+        }
+
+#if defined(DD_LINUX) && defined(UDP_SEGMENT)
+        // Hands the whole buffer to the kernel as a single UDP_SEGMENT send, the way a sender with segmentation
+        // offload would. On loopback the receiver then gets the datagrams as one coalesced receive.
+        static bool SendSegments(uint32 port, const uint8* pData, size_t dataSize, size_t segmentSize)
+        {
+            bool sent = false;
+
+            const int osSocket = socket(AF_INET, SOCK_DGRAM, 0);
+            if (osSocket != -1)
+            {
+                sockaddr_in address = {};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(static_cast<uint16_t>(port));
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+                iovec dataVector = {};
+                dataVector.iov_base = const_cast<uint8*>(pData);
+                dataVector.iov_len = dataSize;
+
+                char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+                msghdr header = {};
+                header.msg_name = &address;
+                header.msg_namelen = sizeof(address);
+                header.msg_iov = &dataVector;
+                header.msg_iovlen = 1;
+                header.msg_control = &control[0];
+                header.msg_controllen = sizeof(control);
+
+                cmsghdr* pControlHeader = CMSG_FIRSTHDR(&header);
+                pControlHeader->cmsg_level = SOL_UDP;
+                pControlHeader->cmsg_type = UDP_SEGMENT;
+                pControlHeader->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                const uint16_t gsoSize = static_cast<uint16_t>(segmentSize);
+                memcpy(CMSG_DATA(pControlHeader), &gsoSize, sizeof(gsoSize));
+
+                sent = (sendmsg(osSocket, &header, 0) == static_cast<ssize_t>(dataSize));
+                close(osSocket);
+            }
+
+            return sent;
+        }
+#else
+        static bool SendSegments(uint32 port, const uint8* pData, size_t dataSize, size_t segmentSize)
+        {
+            DD_UNUSED(port);
+            DD_UNUSED(pData);
+            DD_UNUSED(dataSize);
+            DD_UNUSED(segmentSize);
+            return false;
+        }
+#endif
+
+        // Adds up the router's counters across all of its transports.
+        static TrafficStats GetTransportTraffic(const RouterStats& stats)
+        {
+            TrafficStats traffic = {};
+            for (const TransportTrafficStats &transport : stats.transports)
+            {
+                traffic.messagesReceived += transport.traffic.messagesReceived;
+                traffic.bytesReceived += transport.traffic.bytesReceived;
+            }
+            return traffic;
+        }
+
+        // =============================================================================================================
+        Result RunGroBenchmarks(const BenchmarkOptions &options)
+        {
+            DD_UNUSED(options);
+
+            Result result = Result::Success;
+
+            // A segmented send carries equally sized datagrams, except for a shorter last one.
+            DD_STATIC_CONST uint32 kNumMessages = 16;
+            DD_STATIC_CONST size_t kMessageSize = 1000;
+            DD_STATIC_CONST size_t kLastMessageSize = 600;
+
+            std::vector<uint8> data(kNumMessages * kMessageSize);
+            const size_t dataSize = BuildMessages(data.data(), kNumMessages, kMessageSize, kLastMessageSize);
+
+            // The kernel has to coalesce the send for the rest of the checks to mean anything, so see what a plain
+            // socket receives first.
+            Socket socket;
+            DD_BENCH_CHECK(socket.Init(false, SocketType::Udp) == Result::Success);
+            DD_BENCH_CHECK(socket.Bind("127.0.0.1", kGroSocketPort) == Result::Success);
+
+            if ((result == Result::Success) && (socket.EnableReceiveCoalescing() == Result::Success) &&
+                SendSegments(kGroSocketPort, data.data(), dataSize, kMessageSize))
+            {
+                bool canRead = false;
+                DD_BENCH_CHECK((socket.Select(&canRead, nullptr, nullptr, 1000) == Result::Success) && canRead);
+
+                std::vector<uint8> receiveBuffer(65536);
+                ConnectionInfo source = {};
+                source.size = sizeof(source.data);
+                size_t bytesReceived = 0;
+                size_t segmentSize = 0;
+                DD_BENCH_CHECK(socket.ReceiveSegmentsFrom(&source.data[0],
+                                                          &source.size,
+                                                          receiveBuffer.data(),
+                                                          receiveBuffer.size(),
+                                                          &bytesReceived,
+                                                          &segmentSize) == Result::Success);
+                DD_BENCH_CHECK((bytesReceived == dataSize) && (segmentSize == kMessageSize));
+                DD_BENCH_CHECK(memcmp(receiveBuffer.data(), data.data(), dataSize) == 0);
+                socket.Close();
+
+                // The listener's remote transport receives the same coalesced datagram and has to hand the router one
+                // message per datagram, each with its own header.
+                ListenerBindAddress bindAddress = {};
+                Platform::Strncpy(bindAddress.hostAddress, "127.0.0.1", sizeof(bindAddress.hostAddress));
+                bindAddress.port = kGroListenerPort;
+
+                ListenerCreateInfo createInfo = {};
+                Platform::Strncpy(createInfo.description, "ddBenchmarks", sizeof(createInfo.description));
+                createInfo.flags.enableReceiveCoalescing = 1;
+                createInfo.pAddressesToBind = &bindAddress;
+                createInfo.numAddresses = 1;
+                createInfo.allocCb = GetAllocCb();
+
+                ListenerCore listener;
+                DD_BENCH_CHECK(listener.Initialize(createInfo) == Result::Success);
+                DD_BENCH_CHECK(SendSegments(kGroListenerPort, data.data(), dataSize, kMessageSize));
+
+                // Router counters are flushed periodically, so wait for every message to show up. A datagram split at
+                // the wrong offset reads a bad header and throws off the byte count.
+                TrafficStats traffic = {};
+                for (uint32 attempt = 0; (attempt < 20) && (traffic.messagesReceived < kNumMessages); ++attempt)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    traffic = GetTransportTraffic(listener.GetRouterStats());
+                }
+                DD_BENCH_CHECK(traffic.messagesReceived == kNumMessages);
+                DD_BENCH_CHECK(traffic.bytesReceived == dataSize);
+
+                listener.Destroy();
+
+                printf("%u messages in one %u byte coalesced receive, %u messages and %u bytes routed\n",
+                       kNumMessages,
+                       static_cast<uint32>(bytesReceived),
+                       static_cast<uint32>(traffic.messagesReceived),
+                       static_cast<uint32>(traffic.bytesReceived));
+            }
+            else if (result == Result::Success)
+            {
+                socket.Close();
+                printf("UDP segmentation offload or receive coalescing is unavailable, skipped\n");
+            }
+
+            return result;
+        }
+    }
+}
@@ -0,0 +1,394 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  impairmentBenchmarks.cpp
+* @brief Checks NetworkImpairment and measures transfers over impaired loopback links
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddNetworkImpairment.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kImpairmentListenerPort = 27320;
+
+        // The router drops a client after it misses four pings three seconds apart. This leaves room for that.
+        DD_STATIC_CONST uint32 kClientTimeoutWaitInMs = 30000;
+
+        // Returns true if value is within tolerance of expected, relative to expected.
+        static bool IsNear(double value, double expected, double tolerance)
+        {
+            return (std::fabs(value - expected) <= (expected * tolerance));
+        }
+
+        // Checks what each setting does to a stream of messages, without any transport involved.
+        static void CheckImpairmentSchedule(Result* pResult)
+        {
+            Result& result = *pResult;
+            const uint32 numMessages = 20000;
+            uint64 deliveryTimes[NetworkImpairment::kMaxCopies] = {};
+
+            // A zero config delivers everything right away.
+            {
+                NetworkImpairment impairment;
+                DD_BENCH_CHECK(impairment.IsEnabled() == false);
+                DD_BENCH_CHECK(impairment.Schedule(100, 1234, deliveryTimes) == 1);
+                DD_BENCH_CHECK(deliveryTimes[0] == 1234);
+            }
+
+            // The same seed and traffic give the same schedule.
+            {
+                NetworkImpairmentConfig config = {};
+                config.lossRatio = 0.05f;
+                config.jitterInMs = 7;
+                config.reorderRatio = 0.05f;
+                config.reorderDelayInMs = 20;
+                config.duplicateRatio = 0.05f;
+                config.seed = 42;
+
+                NetworkImpairment first(config);
+                NetworkImpairment second(config);
+                uint32 numDifferences = 0;
+                for (uint32 messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+                {
+                    uint64 firstTimes[NetworkImpairment::kMaxCopies] = {};
+                    uint64 secondTimes[NetworkImpairment::kMaxCopies] = {};
+                    const uint32 firstCopies = first.Schedule(1000, messageIndex, firstTimes);
+                    const uint32 secondCopies = second.Schedule(1000, messageIndex, secondTimes);
+                    numDifferences += ((firstCopies != secondCopies) ||
+                                       (memcmp(firstTimes, secondTimes, sizeof(uint64) * firstCopies) != 0)) ? 1 : 0;
+                }
+                DD_BENCH_CHECK(numDifferences == 0);
+            }
+
+            // Random loss drops about lossRatio of the messages in bursts of lossBurstLength.
+            {
+                NetworkImpairmentConfig config = {};
+                config.lossRatio = 0.02f;
+                config.lossBurstLength = 4;
+                config.seed = 7;
+
+                NetworkImpairment impairment(config);
+                uint32 numDropped = 0;
+                uint32 runLength = 0;
+                uint32 numShortRuns = 0;
+                for (uint32 messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+                {
+                    if (impairment.Schedule(1000, 0, deliveryTimes) == 0)
+                    {
+                        ++numDropped;
+                        ++runLength;
+                    }
+                    else
+                    {
+                        numShortRuns += ((runLength > 0) && ((runLength % config.lossBurstLength) != 0)) ? 1 : 0;
+                        runLength = 0;
+                    }
+                }
+                const double dropRatio = static_cast<double>(numDropped) / numMessages;
+                DD_BENCH_CHECK(numShortRuns == 0);
+                DD_BENCH_CHECK((dropRatio > 0.02) && (dropRatio < 0.15));
+                DD_BENCH_CHECK(impairment.GetStats().messagesDropped == numDropped);
+            }
+
+            // dropInterval drops exactly every Nth message.
+            {
+                NetworkImpairmentConfig config = {};
+                config.dropInterval = 10;
+
+                NetworkImpairment impairment(config);
+                uint32 numWrong = 0;
+                for (uint32 messageIndex = 1; messageIndex <= 1000; ++messageIndex)
+                {
+                    const bool dropped = (impairment.Schedule(1000, 0, deliveryTimes) == 0);
+                    numWrong += (dropped != ((messageIndex % 10) == 0)) ? 1 : 0;
+                }
+                DD_BENCH_CHECK(numWrong == 0);
+            }
+
+            // Delay and jitter bound the delivery time.
+            {
+                NetworkImpairmentConfig config = {};
+                config.delayInMs = 20;
+                config.jitterInMs = 10;
+                config.seed = 3;
+
+                NetworkImpairment impairment(config);
+                uint32 numOutOfRange = 0;
+                for (uint32 messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+                {
+                    impairment.Schedule(1000, 1000, deliveryTimes);
+                    numOutOfRange += ((deliveryTimes[0] < 1020) || (deliveryTimes[0] > 1030)) ? 1 : 0;
+                }
+                DD_BENCH_CHECK(numOutOfRange == 0);
+            }
+
+            // Reordered messages are held back by reorderDelayInMs and duplicates produce a second copy.
+            {
+                NetworkImpairmentConfig config = {};
+                config.reorderRatio = 0.1f;
+                config.reorderDelayInMs = 50;
+                config.duplicateRatio = 0.1f;
+                config.seed = 11;
+
+                NetworkImpairment impairment(config);
+                uint32 numHeldBack = 0;
+                uint32 numDuplicated = 0;
+                uint32 numBadTimes = 0;
+                for (uint32 messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+                {
+                    const uint32 numCopies = impairment.Schedule(1000, 0, deliveryTimes);
+                    numDuplicated += (numCopies == 2) ? 1 : 0;
+                    for (uint32 copyIndex = 0; copyIndex < numCopies; ++copyIndex)
+                    {
+                        numBadTimes += ((deliveryTimes[copyIndex] != 0) && (deliveryTimes[copyIndex] != 50)) ? 1 : 0;
+                    }
+                    numHeldBack += (deliveryTimes[0] == 50) ? 1 : 0;
+                }
+                const NetworkImpairmentStats stats = impairment.GetStats();
+                DD_BENCH_CHECK(numBadTimes == 0);
+                DD_BENCH_CHECK(stats.messagesDuplicated == numDuplicated);
+                DD_BENCH_CHECK(IsNear(static_cast<double>(numDuplicated) / numMessages, 0.1, 0.2));
+                DD_BENCH_CHECK(IsNear(static_cast<double>(stats.messagesReordered) / numMessages, 0.1, 0.2));
+                DD_BENCH_CHECK(numHeldBack > 0);
+            }
+
+            // A bandwidth cap serializes messages one after another.
+            {
+                NetworkImpairmentConfig config = {};
+                config.bandwidthInBytesPerSecond = 1000 * 1000;
+
+                NetworkImpairment impairment(config);
+                for (uint32 messageIndex = 0; messageIndex < 1000; ++messageIndex)
+                {
+                    impairment.Schedule(1000, 0, deliveryTimes);
+                }
+                DD_BENCH_CHECK((deliveryTimes[0] >= 999) && (deliveryTimes[0] <= 1001));
+            }
+
+            // The queue hands messages out by delivery time and keeps the push order for equal times.
+            {
+                ImpairmentQueue<uint32> queue(GetAllocCb());
+                for (uint32 value = 0; value < 1000; ++value)
+                {
+                    queue.Push(value, (value * 7919u) % 50);
+                }
+
+                DD_BENCH_CHECK(queue.GetTimeUntilDue(0) == 0);
+
+                uint64 lastTime = 0;
+                uint32 lastValue = 0;
+                uint32 numPopped = 0;
+                uint32 numOutOfOrder = 0;
+                uint32 value = 0;
+                for (uint64 timeInMs = 0; timeInMs < 50; ++timeInMs)
+                {
+                    while (queue.PopDue(timeInMs, &value))
+                    {
+                        const uint64 deliveryTime = (value * 7919u) % 50;
+                        numOutOfOrder += ((deliveryTime < lastTime) ||
+                                          ((numPopped > 0) && (deliveryTime == lastTime) && (value < lastValue))) ? 1 : 0;
+                        lastTime = deliveryTime;
+                        lastValue = value;
+                        ++numPopped;
+                    }
+                }
+                DD_BENCH_CHECK(numPopped == 1000);
+                DD_BENCH_CHECK(numOutOfOrder == 0);
+                DD_BENCH_CHECK(queue.GetTimeUntilDue(0) == kInfiniteTimeout);
+            }
+        }
+
+        // A link configuration to measure transfers over
+        struct ImpairedLink
+        {
+            const char*             pName;
+            NetworkImpairmentConfig config;
+        };
+
+        // =============================================================================================================
+        Result RunImpairmentBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+            const AllocCb allocCb = GetAllocCb();
+
+            CheckImpairmentSchedule(&result);
+
+            ImpairedLink links[6] = {};
+            links[0].pName = "clean";
+            links[1].pName = "1% loss";
+            links[1].config.lossRatio = 0.01f;
+            links[2].pName = "20 ms delay";
+            links[2].config.delayInMs = 20;
+            links[3].pName = "5 ms jitter, 2% reorder";
+            links[3].config.jitterInMs = 5;
+            links[3].config.reorderRatio = 0.02f;
+            links[3].config.reorderDelayInMs = 10;
+            links[4].pName = "1% duplicates";
+            links[4].config.duplicateRatio = 0.01f;
+            links[5].pName = "10 MB/s";
+            links[5].config.bandwidthInBytesPerSecond = (10 * 1024 * 1024);
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kImpairmentListenerPort, nullptr) == Result::Success);
+
+            // Both ends of the link get their own impairment so both directions are impaired.
+            NetworkImpairment serverImpairment;
+            NetworkImpairment pullerImpairment;
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kImpairmentListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            clientInfo.pNetworkImpairment = &serverImpairment;
+            DevDriverClient server(allocCb, clientInfo);
+            clientInfo.pNetworkImpairment = &pullerImpairment;
+            DevDriverClient puller(allocCb, clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+            DD_BENCH_CHECK(puller.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                const size_t blockSize = options.quick ? (256 * 1024) : (4 * 1024 * 1024);
+                std::vector<uint8> data(blockSize);
+                for (size_t index = 0; index < blockSize; ++index)
+                {
+                    data[index] = static_cast<uint8>((index * 31) + (index >> 11));
+                }
+
+                TransferManager& serverTransferManager = server.GetMessageChannel()->GetTransferManager();
+                TransferManager& pullerTransferManager = puller.GetMessageChannel()->GetTransferManager();
+                const ClientId serverClientId = server.GetMessageChannel()->GetClientId();
+
+                SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock();
+                pBlock->Write(data.data(), data.size());
+                pBlock->Close();
+
+                printf("%-26s %10s %10s %10s\n", "link", "MB/s", "dropped", "reordered");
+
+                std::vector<uint8> pulledData(blockSize);
+                for (const ImpairedLink& link : links)
+                {
+                    serverImpairment.SetConfig(link.config);
+                    pullerImpairment.SetConfig(link.config);
+
+                    // Stats accumulate across configurations.
+                    const NetworkImpairmentStats serverStatsBefore = serverImpairment.GetStats();
+                    const NetworkImpairmentStats pullerStatsBefore = pullerImpairment.GetStats();
+
+                    Stopwatch pullTimer;
+                    size_t totalBytesRead = 0;
+                    Result readResult = Result::Error;
+                    PullBlock* pPullBlock = pullerTransferManager.OpenPullBlock(serverClientId, pBlock->GetBlockId());
+                    if (pPullBlock != nullptr)
+                    {
+                        readResult = Result::Success;
+                        while (readResult == Result::Success)
+                        {
+                            size_t bytesRead = 0;
+                            readResult = pPullBlock->Read(pulledData.data() + totalBytesRead,
+                                                          blockSize - totalBytesRead,
+                                                          &bytesRead);
+                            totalBytesRead += bytesRead;
+                        }
+                        pullerTransferManager.ClosePullBlock(&pPullBlock);
+                    }
+                    const uint64 pullNs = pullTimer.GetElapsedNs();
+
+                    DD_BENCH_CHECK(readResult == Result::EndOfStream);
+                    DD_BENCH_CHECK((totalBytesRead == blockSize) && (memcmp(pulledData.data(), data.data(), blockSize) == 0));
+
+                    const NetworkImpairmentStats serverStats = serverImpairment.GetStats();
+                    const NetworkImpairmentStats pullerStats = pullerImpairment.GetStats();
+                    const uint64 numDropped = (serverStats.messagesDropped - serverStatsBefore.messagesDropped) +
+                                              (pullerStats.messagesDropped - pullerStatsBefore.messagesDropped);
+                    const uint64 numReordered = (serverStats.messagesReordered - serverStatsBefore.messagesReordered) +
+                                                (pullerStats.messagesReordered - pullerStatsBefore.messagesReordered);
+                    printf("%-26s %10.2f %10llu %10llu\n",
+                           link.pName,
+                           (static_cast<double>(blockSize) / (1024.0 * 1024.0)) / (static_cast<double>(pullNs) / 1e9),
+                           static_cast<unsigned long long>(numDropped),
+                           static_cast<unsigned long long>(numReordered));
+                }
+
+                // Clients that stop answering pings time out of the router, and their sessions have to go with them.
+                // A pull block holds a session open while both links go silent, so neither side can reset it.
+                const NetworkImpairmentConfig cleanConfig = {};
+                serverImpairment.SetConfig(cleanConfig);
+                pullerImpairment.SetConfig(cleanConfig);
+
+                PullBlock* pPullBlock = pullerTransferManager.OpenPullBlock(serverClientId, pBlock->GetBlockId());
+                DD_BENCH_CHECK(pPullBlock != nullptr);
+                DD_BENCH_CHECK(listener.GetRouterStats().numSessions > 0);
+
+                NetworkImpairmentConfig silentConfig = {};
+                silentConfig.lossRatio = 1.0f;
+                serverImpairment.SetConfig(silentConfig);
+                pullerImpairment.SetConfig(silentConfig);
+
+                Stopwatch timeoutTimer;
+                uint64 numSessions = listener.GetRouterStats().numSessions;
+                while ((numSessions > 0) && (timeoutTimer.GetElapsedNs() < (kClientTimeoutWaitInMs * 1000000ull)))
+                {
+                    Platform::Sleep(100);
+                    numSessions = listener.GetRouterStats().numSessions;
+                }
+                DD_BENCH_CHECK(numSessions == 0);
+                printf("silent clients lost their sessions after %.1f s\n",
+                       static_cast<double>(timeoutTimer.GetElapsedNs()) / 1e9);
+
+                // Leave the link clean so the clients can disconnect quickly.
+                serverImpairment.SetConfig(cleanConfig);
+                pullerImpairment.SetConfig(cleanConfig);
+
+                if (pPullBlock != nullptr)
+                {
+                    pullerTransferManager.ClosePullBlock(&pPullBlock);
+                }
+                serverTransferManager.CloseServerBlock(pBlock);
+            }
+
+            puller.Destroy();
+            server.Destroy();
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
@@ -0,0 +1,460 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  lz4Benchmarks.cpp
+* @brief Checks LZ4 block round trips, malformed blocks and compressed pulls, and measures LZ4 throughput
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include "util/ddLz4.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kLz4ListenerPort = 27360;
+
+        // Decoded data is followed by this many guard bytes so writes past the capacity show up.
+        DD_STATIC_CONST size_t kGuardSizeInBytes = 64;
+        DD_STATIC_CONST uint8  kGuardByte = 0xCD;
+
+        enum class DataKind : uint32
+        {
+            Zeros,
+            Text,          // Short runs of a small alphabet with plenty of matches
+            Mixed,         // Random runs and repeated runs, mostly from nearby and some from past the maximum offset
+            Incompressible
+        };
+
+        // =============================================================================================================
+        static void FillData(DataKind kind, std::mt19937* pRandom, std::vector<uint8>* pData)
+        {
+            std::vector<uint8> &data = *pData;
+            size_t index = 0;
+            while (index < data.size())
+            {
+                // Mixed data is built from runs that are either random or copied from earlier in the data.
+                const size_t runLength = Platform::Min<size_t>(((*pRandom)() % 61) + 4, data.size() - index);
+                const size_t maxDistance = (((*pRandom)() % 8) != 0) ? 2048 : 70000;
+                const size_t distance = ((*pRandom)() % maxDistance) + 1;
+                const bool copyRun = ((index >= distance) && (((*pRandom)() % 4) != 0));
+
+                for (size_t runIndex = 0; runIndex < runLength; ++runIndex, ++index)
+                {
+                    switch (kind)
+                    {
+                    case DataKind::Zeros:
+                        data[index] = 0;
+                        break;
+                    case DataKind::Text:
+                        data[index] = static_cast<uint8>('a' + ((index / 37) + (index % 7)) % 11);
+                        break;
+                    case DataKind::Mixed:
+                        data[index] = copyRun ? data[index - distance] : static_cast<uint8>((*pRandom)());
+                        break;
+                    case DataKind::Incompressible:
+                        data[index] = static_cast<uint8>((*pRandom)());
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Decodes a block into a buffer of dstCapacity bytes followed by guard bytes. Returns false if anything was
+        // written past the capacity.
+        static bool DecompressGuarded(const std::vector<uint8> &block,
+                                      size_t                    dstCapacity,
+                                      std::vector<uint8>*       pDecoded,
+                                      Result*                   pResult,
+                                      size_t*                   pDecodedSize)
+        {
+            pDecoded->assign(dstCapacity + kGuardSizeInBytes, kGuardByte);
+
+            *pDecodedSize = 0;
+            *pResult = Lz4::DecompressBlock(block.data(), block.size(), pDecoded->data(), dstCapacity, pDecodedSize);
+
+            bool guardIntact = (*pDecodedSize <= dstCapacity);
+            for (size_t index = dstCapacity; index < pDecoded->size(); ++index)
+            {
+                guardIntact &= ((*pDecoded)[index] == kGuardByte);
+            }
+            return guardIntact;
+        }
+
+        // Pulls a whole block into pData, compressed or not. Returns the number of bytes read, or zero if the pull
+        // failed.
+        static size_t PullBlockData(TransferManager* pTransferManager,
+                                    ClientId         clientId,
+                                    BlockId          blockId,
+                                    bool             compressed,
+                                    uint8*           pData,
+                                    size_t           size)
+        {
+            size_t totalBytesRead = 0;
+            Result readResult = Result::Error;
+            PullBlock* pPullBlock = compressed ? pTransferManager->OpenCompressedPullBlock(clientId, blockId)
+                                               : pTransferManager->OpenPullBlock(clientId, blockId);
+            if (pPullBlock != nullptr)
+            {
+                readResult = (pPullBlock->GetBlockDataSize() == size) ? Result::Success : Result::Error;
+                while (readResult == Result::Success)
+                {
+                    // Odd read sizes so reads end in the middle of decoded frames.
+                    size_t bytesRead = 0;
+                    readResult = pPullBlock->Read(pData + totalBytesRead,
+                                                  Platform::Min<size_t>(7777, (size + 1) - totalBytesRead),
+                                                  &bytesRead);
+                    totalBytesRead += bytesRead;
+                }
+                pTransferManager->ClosePullBlock(&pPullBlock);
+            }
+            return (readResult == Result::EndOfStream) ? totalBytesRead : 0;
+        }
+
+        // =============================================================================================================
+        static void CheckRoundTrips(const BenchmarkOptions &options, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            std::mt19937 random(0x4C5A3421u);
+            const DataKind kKinds[] = { DataKind::Zeros, DataKind::Text, DataKind::Mixed, DataKind::Incompressible };
+            const size_t kLargeSizes[] = { 4095, 65536, 65537, 262147, (options.quick ? 1048583u : 16777259u) };
+
+            std::vector<size_t> sizes;
+            for (size_t size = 0; size <= 40; ++size)
+            {
+                sizes.push_back(size);
+            }
+            sizes.insert(sizes.end(), std::begin(kLargeSizes), std::end(kLargeSizes));
+
+            uint32 numMismatches = 0;
+            uint32 numOverruns = 0;
+            std::vector<uint8> data;
+            std::vector<uint8> block;
+            std::vector<uint8> decoded;
+            for (DataKind kind : kKinds)
+            {
+                for (size_t size : sizes)
+                {
+                    data.resize(size);
+                    FillData(kind, &random, &data);
+
+                    block.resize(Lz4::CompressBound(size));
+                    const size_t blockSize = Lz4::CompressBlock(data.data(), size, block.data(), block.size());
+                    block.resize(blockSize);
+
+                    Result decodeResult = Result::Error;
+                    size_t decodedSize = 0;
+                    numOverruns += DecompressGuarded(block, size, &decoded, &decodeResult, &decodedSize) ? 0 : 1;
+                    numMismatches += ((blockSize == 0) ||
+                                      (decodeResult != Result::Success) ||
+                                      (decodedSize != size) ||
+                                      (memcmp(decoded.data(), data.data(), size) != 0)) ? 1 : 0;
+
+                    // Blocks that need the whole bound don't fit into anything smaller, and decoding into less than
+                    // the decoded size fails without writing past it.
+                    if ((size > 0) && (blockSize > 1))
+                    {
+                        std::vector<uint8> smallBlock(blockSize - 1);
+                        const bool fitsSmaller =
+                            (Lz4::CompressBlock(data.data(), size, smallBlock.data(), smallBlock.size()) != 0);
+                        numMismatches += fitsSmaller ? 1 : 0;
+
+                        const bool guardIntact = DecompressGuarded(block, size - 1, &decoded, &decodeResult, &decodedSize);
+                        numOverruns += guardIntact ? 0 : 1;
+                        numMismatches += (decodeResult == Result::Success) ? 1 : 0;
+                    }
+
+                    // Only data with matches shrinks. Nothing grows past the bound.
+                    if ((kind != DataKind::Incompressible) && (size >= 4096))
+                    {
+                        DD_BENCH_CHECK(blockSize < (size / 2));
+                    }
+                    DD_BENCH_CHECK(blockSize <= Lz4::CompressBound(size));
+                }
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+            DD_BENCH_CHECK(numOverruns == 0);
+            printf("%u round trips, %u mismatches, %u overruns\n",
+                   static_cast<uint32>(sizes.size() * (sizeof(kKinds) / sizeof(kKinds[0]))),
+                   numMismatches,
+                   numOverruns);
+        }
+
+        // =============================================================================================================
+        static void CheckMalformedBlocks(const BenchmarkOptions &options, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            struct MalformedBlock
+            {
+                const char*        pName;
+                std::vector<uint8> block;
+                size_t             dstCapacity;
+            };
+
+            // Every block here is one byte or field away from being valid.
+            const MalformedBlock kMalformedBlocks[] =
+            {
+                { "empty block",                 { },                                    64 },
+                { "literals past the input",     { 0x20, 'a' },                          64 },
+                { "unterminated literal length", { 0xF0, 0xFF, 0xFF },                   64 },
+                { "truncated offset",            { 0x10, 'a', 0x01 },                    64 },
+                { "zero offset",                 { 0x10, 'a', 0x00, 0x00 },              64 },
+                { "offset before the output",    { 0x10, 'a', 0x02, 0x00 },              64 },
+                { "unterminated match length",   { 0x1F, 'a', 0x01, 0x00, 0xFF },        64 },
+                { "match past the capacity",     { 0x1F, 'a', 0x01, 0x00, 0xFF, 0x10 },  64 },
+                { "literals past the capacity",  { 0x50, 'a', 'b', 'c', 'd', 'e' },      4  },
+                { "overlong literal length",     { 0xF0, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 }, 64 },
+            };
+
+            std::vector<uint8> decoded;
+            for (const MalformedBlock &malformed : kMalformedBlocks)
+            {
+                Result decodeResult = Result::Success;
+                size_t decodedSize = 0;
+                const bool guardIntact =
+                    DecompressGuarded(malformed.block, malformed.dstCapacity, &decoded, &decodeResult, &decodedSize);
+                if ((decodeResult != Result::Error) || (guardIntact == false))
+                {
+                    printf("malformed block accepted: %s\n", malformed.pName);
+                }
+                DD_BENCH_CHECK(decodeResult == Result::Error);
+                DD_BENCH_CHECK(guardIntact);
+            }
+
+            // A match may overlap the bytes it produces.
+            const std::vector<uint8> runBlock = { 0x1F, 'a', 0x01, 0x00, 0x05 };
+            Result decodeResult = Result::Error;
+            size_t decodedSize = 0;
+            DD_BENCH_CHECK(DecompressGuarded(runBlock, 64, &decoded, &decodeResult, &decodedSize));
+            DD_BENCH_CHECK((decodeResult == Result::Success) && (decodedSize == 25));
+            DD_BENCH_CHECK(std::count(decoded.begin(), decoded.begin() + 25, 'a') == 25);
+
+            // Truncated and corrupted blocks either fail or decode to something that fits, never past the capacity.
+            // A block cut between two sequences is still a valid block, so it decodes to a prefix of the data.
+            std::mt19937 random(0x4C5A3422u);
+            std::vector<uint8> data(4099);
+            FillData(DataKind::Mixed, &random, &data);
+            std::vector<uint8> block(Lz4::CompressBound(data.size()));
+            block.resize(Lz4::CompressBlock(data.data(), data.size(), block.data(), block.size()));
+
+            uint32 numOverruns = 0;
+            uint32 numMismatches = 0;
+            for (size_t length = 0; length < block.size(); ++length)
+            {
+                const std::vector<uint8> truncated(block.begin(), block.begin() + length);
+                numOverruns += DecompressGuarded(truncated, data.size(), &decoded, &decodeResult, &decodedSize) ? 0 : 1;
+                numMismatches += ((decodeResult == Result::Success) &&
+                                  ((decodedSize >= data.size()) ||
+                                   (memcmp(decoded.data(), data.data(), decodedSize) != 0))) ? 1 : 0;
+            }
+
+            const uint32 numCorruptions = options.quick ? 20000 : 1000000;
+            for (uint32 corruption = 0; corruption < numCorruptions; ++corruption)
+            {
+                std::vector<uint8> corrupted = block;
+                const uint32 numFlips = (random() % 4) + 1;
+                for (uint32 flip = 0; flip < numFlips; ++flip)
+                {
+                    corrupted[random() % corrupted.size()] ^= static_cast<uint8>((random() % 255) + 1);
+                }
+                numOverruns += DecompressGuarded(corrupted, data.size(), &decoded, &decodeResult, &decodedSize) ? 0 : 1;
+            }
+            DD_BENCH_CHECK(numOverruns == 0);
+            DD_BENCH_CHECK(numMismatches == 0);
+            printf("%u malformed, %u truncated and %u corrupted blocks, %u overruns\n",
+                   static_cast<uint32>(sizeof(kMalformedBlocks) / sizeof(kMalformedBlocks[0])),
+                   static_cast<uint32>(block.size()),
+                   numCorruptions,
+                   numOverruns);
+        }
+
+        // =============================================================================================================
+        static void MeasureThroughput(const BenchmarkOptions &options)
+        {
+            std::mt19937 random(0x4C5A3423u);
+            const size_t size = (16 * 1024 * 1024);
+            const uint32 numIterations = options.quick ? 1 : 16;
+
+            std::vector<uint8> data(size);
+            std::vector<uint8> block(Lz4::CompressBound(size));
+            std::vector<uint8> decoded(size);
+
+            printf("%-15s %8s %14s %16s\n", "data", "ratio", "compress MB/s", "decompress MB/s");
+
+            const DataKind kKinds[] = { DataKind::Text, DataKind::Mixed, DataKind::Incompressible };
+            const char* const kKindNames[] = { "text", "mixed", "incompressible" };
+            for (uint32 kindIndex = 0; kindIndex < (sizeof(kKinds) / sizeof(kKinds[0])); ++kindIndex)
+            {
+                FillData(kKinds[kindIndex], &random, &data);
+
+                size_t blockSize = 0;
+                Stopwatch compressTimer;
+                for (uint32 iteration = 0; iteration < numIterations; ++iteration)
+                {
+                    blockSize = Lz4::CompressBlock(data.data(), size, block.data(), block.size());
+                }
+                const uint64 compressNs = Platform::Max<uint64>(compressTimer.GetElapsedNs(), 1);
+
+                size_t decodedSize = 0;
+                Stopwatch decompressTimer;
+                for (uint32 iteration = 0; iteration < numIterations; ++iteration)
+                {
+                    Lz4::DecompressBlock(block.data(), blockSize, decoded.data(), decoded.size(), &decodedSize);
+                }
+                const uint64 decompressNs = Platform::Max<uint64>(decompressTimer.GetElapsedNs(), 1);
+
+                const double totalMegabytes = (static_cast<double>(size) * numIterations) / (1024.0 * 1024.0);
+                printf("%-15s %8.3f %14.1f %16.1f\n",
+                       kKindNames[kindIndex],
+                       static_cast<double>(blockSize) / static_cast<double>(size),
+                       totalMegabytes / (static_cast<double>(compressNs) / 1e9),
+                       totalMegabytes / (static_cast<double>(decompressNs) / 1e9));
+            }
+        }
+
+        // =============================================================================================================
+        static void CheckCompressedPulls(const BenchmarkOptions &options, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kLz4ListenerPort, nullptr) == Result::Success);
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kLz4ListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            DevDriverClient server(GetAllocCb(), clientInfo);
+            DevDriverClient puller(GetAllocCb(), clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+            DD_BENCH_CHECK(puller.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                TransferManager& serverTransferManager = server.GetMessageChannel()->GetTransferManager();
+                TransferManager& pullerTransferManager = puller.GetMessageChannel()->GetTransferManager();
+                const ClientId serverClientId = server.GetMessageChannel()->GetClientId();
+
+                struct PulledBlock
+                {
+                    const char* pName;
+                    DataKind    kind;
+                    size_t      size;
+                };
+
+                // Small blocks fall back to plain pulls. The large ones span several compressed frames.
+                const size_t largeSize = options.quick ? ((3 * 1024 * 1024) + 17) : ((64 * 1024 * 1024) + 17);
+                const PulledBlock kBlocks[] =
+                {
+                    { "empty",          DataKind::Text,           0         },
+                    { "small text",     DataKind::Text,           10        },
+                    { "text",           DataKind::Text,           largeSize },
+                    { "mixed",          DataKind::Mixed,          largeSize },
+                    { "incompressible", DataKind::Incompressible, largeSize },
+                };
+
+                printf("%-15s %10s %12s %12s\n", "pull", "size", "plain bytes", "lz4 bytes");
+
+                std::mt19937 random(0x4C5A3424u);
+                std::vector<uint8> data;
+                std::vector<uint8> pulledData;
+                for (const PulledBlock &pulled : kBlocks)
+                {
+                    data.resize(pulled.size);
+                    FillData(pulled.kind, &random, &data);
+                    pulledData.assign(pulled.size + 1, 0);
+
+                    SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock();
+                    pBlock->Write(data.data(), data.size());
+                    pBlock->Close();
+
+                    // The router counts what crossed the wire for each kind of pull.
+                    uint64 wireBytes[2] = {};
+                    for (uint32 compressed = 0; compressed < 2; ++compressed)
+                    {
+                        const uint64 bytesBefore = GetRouterBytesReceived(&listener);
+                        const size_t bytesPulled = PullBlockData(&pullerTransferManager,
+                                                                 serverClientId,
+                                                                 pBlock->GetBlockId(),
+                                                                 (compressed != 0),
+                                                                 pulledData.data(),
+                                                                 pulled.size);
+                        DD_BENCH_CHECK((bytesPulled == pulled.size) &&
+                                       (memcmp(pulledData.data(), data.data(), pulled.size) == 0));
+
+                        // Router stats are merged in periodically.
+                        Platform::Sleep(300);
+                        wireBytes[compressed] = (GetRouterBytesReceived(&listener) - bytesBefore);
+                    }
+
+                    if ((pulled.kind != DataKind::Incompressible) && (pulled.size >= (1024 * 1024)))
+                    {
+                        DD_BENCH_CHECK(wireBytes[1] < (wireBytes[0] / 2));
+                    }
+
+                    printf("%-15s %10u %12llu %12llu\n",
+                           pulled.pName,
+                           static_cast<uint32>(pulled.size),
+                           static_cast<unsigned long long>(wireBytes[0]),
+                           static_cast<unsigned long long>(wireBytes[1]));
+
+                    serverTransferManager.CloseServerBlock(pBlock);
+                }
+            }
+
+            puller.Destroy();
+            server.Destroy();
+            listener.Destroy();
+        }
+
+        // =============================================================================================================
+        Result RunLz4Benchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            CheckRoundTrips(options, &result);
+            CheckMalformedBlocks(options, &result);
+            MeasureThroughput(options);
+            CheckCompressedPulls(options, &result);
+
+            return result;
+        }
+    }
+}
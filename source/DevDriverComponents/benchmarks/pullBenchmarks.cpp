@@ -0,0 +1,574 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  pullBenchmarks.cpp
+* @brief Checks cached, hashed, parallel and resumed pulls, the pull content cache and block retention
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddNetworkImpairment.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include "util/ddMetroHash.h"
+#include <cstdio>
+#include <cstring>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kPullListenerPort = 27370;
+
+        // Losing every message makes the session give up well within this time.
+        DD_STATIC_CONST uint64 kPullFailureTimeoutInMs = 20000;
+
+        // Closed blocks stay available for at least as long as the resume checks take.
+        DD_STATIC_CONST uint32 kLongRetentionTimeInMs = 120000;
+        DD_STATIC_CONST uint32 kShortRetentionTimeInMs = 500;
+
+        // The listener and the two clients every check in this suite pulls between
+        struct PullContext
+        {
+            ListenerCore*      pListener;
+            TransferManager*   pServerTransferManager;
+            TransferManager*   pPullerTransferManager;
+            ClientId           serverClientId;
+            CountingAllocator* pPullerAllocator; // Counts what the puller allocates
+            NetworkImpairment* pPullerImpairment; // Only affects the puller's traffic
+        };
+
+        // Writes a closed server block holding the given data.
+        static SharedPointer<ServerBlock> CreateServerBlock(const PullContext &context, const uint8* pData, size_t size)
+        {
+            SharedPointer<ServerBlock> pBlock = context.pServerTransferManager->OpenServerBlock();
+            if (pBlock.IsNull() == false)
+            {
+                pBlock->Write(pData, size);
+                pBlock->Close();
+            }
+            return pBlock;
+        }
+
+        // Pulls a whole block with OpenCachedPullBlock in reads of readSize bytes and checks it against the expected
+        // data, including that reads past the end fail. Returns the number of bytes the router received meanwhile.
+        static uint64 CheckCachedPull(const PullContext &context,
+                                      BlockId            blockId,
+                                      const uint8*       pExpectedData,
+                                      size_t             expectedSize,
+                                      size_t             readSize,
+                                      Result*            pResult)
+        {
+            Result &result = *pResult;
+
+            const uint64 bytesBefore = GetRouterBytesReceived(context.pListener);
+
+            TransferManager* pPullerTransferManager = context.pPullerTransferManager;
+            PullBlock* pPullBlock = pPullerTransferManager->OpenCachedPullBlock(context.serverClientId, blockId);
+            DD_BENCH_CHECK(pPullBlock != nullptr);
+            if (pPullBlock != nullptr)
+            {
+                DD_BENCH_CHECK(pPullBlock->GetBlockDataSize() == expectedSize);
+
+                std::vector<uint8> pulledData(expectedSize + readSize);
+                size_t totalBytesRead = 0;
+                Result readResult = Result::Success;
+                while ((readResult == Result::Success) && (totalBytesRead <= expectedSize))
+                {
+                    size_t bytesRead = 0;
+                    readResult = pPullBlock->Read(pulledData.data() + totalBytesRead, readSize, &bytesRead);
+                    totalBytesRead += bytesRead;
+                }
+                DD_BENCH_CHECK(readResult == Result::EndOfStream);
+                DD_BENCH_CHECK((totalBytesRead == expectedSize) &&
+                               (memcmp(pulledData.data(), pExpectedData, expectedSize) == 0));
+
+                size_t bytesRead = 0;
+                DD_BENCH_CHECK(pPullBlock->Read(pulledData.data(), readSize, &bytesRead) == Result::Error);
+
+                pPullerTransferManager->ClosePullBlock(&pPullBlock);
+            }
+
+            // Router stats are merged in periodically, so wait for the count to settle.
+            uint64 bytesAfter = GetRouterBytesReceived(context.pListener);
+            uint64 lastBytesAfter = 0;
+            uint32 attempt = 0;
+            do
+            {
+                Platform::Sleep(300);
+                lastBytesAfter = bytesAfter;
+                bytesAfter = GetRouterBytesReceived(context.pListener);
+                ++attempt;
+            } while ((bytesAfter != lastBytesAfter) && (attempt < 10));
+            return (bytesAfter - bytesBefore);
+        }
+
+        // =============================================================================================================
+        static void CheckCachedPulls(const BenchmarkOptions &options, const PullContext &context, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            const size_t blockSize = options.quick ? ((3 * 1024 * 1024) + 77) : ((64 * 1024 * 1024) + 77);
+            std::vector<uint8> data(blockSize);
+            for (size_t index = 0; index < blockSize; ++index)
+            {
+                data[index] = static_cast<uint8>((index * 13) + (index >> 9));
+            }
+
+            // Hits only ask for the hash, so they cost a small fraction of the block on the wire.
+            const uint64 maxHitBytes = (blockSize / 64);
+
+            printf("%-24s %12s\n", "cached pull", "wire bytes");
+
+            // Content hashes match MetroHash128 of the data, whether the block is written in one piece or many.
+            SharedPointer<ServerBlock> pBlock = CreateServerBlock(context, data.data(), blockSize);
+            SharedPointer<ServerBlock> pSameBlock = context.pServerTransferManager->OpenServerBlock();
+            DD_BENCH_CHECK((pBlock.IsNull() == false) && (pSameBlock.IsNull() == false));
+            if ((pBlock.IsNull() == false) && (pSameBlock.IsNull() == false))
+            {
+                for (size_t offset = 0; offset < blockSize; offset += 100000)
+                {
+                    pSameBlock->Write(data.data() + offset, Platform::Min<size_t>(100000, blockSize - offset));
+                }
+                pSameBlock->Close();
+
+                MetroHash::Hash expectedHash = {};
+                Util::MetroHash128::Hash(data.data(), blockSize, expectedHash.bytes);
+                const TransferContentHash contentHash = pBlock->GetContentHash();
+                DD_BENCH_CHECK(memcmp(contentHash.dwords, expectedHash.dwords, sizeof(expectedHash.dwords)) == 0);
+                DD_BENCH_CHECK(memcmp(pSameBlock->GetContentHash().dwords,
+                                      contentHash.dwords,
+                                      sizeof(contentHash.dwords)) == 0);
+
+                // The first pull transfers the data. Pulling it again, or another block with the same content, is a
+                // cache hit.
+                const BlockId blockId = pBlock->GetBlockId();
+                const uint64 missBytes = CheckCachedPull(context, blockId, data.data(), blockSize, 65536, &result);
+                const uint64 hitBytes = CheckCachedPull(context, blockId, data.data(), blockSize, 65536, &result);
+                const uint64 sameBytes =
+                    CheckCachedPull(context, pSameBlock->GetBlockId(), data.data(), blockSize, 100000, &result);
+                DD_BENCH_CHECK(missBytes >= blockSize);
+                DD_BENCH_CHECK(hitBytes < maxHitBytes);
+                DD_BENCH_CHECK(sameBytes < maxHitBytes);
+                printf("%-24s %12llu\n", "miss", static_cast<unsigned long long>(missBytes));
+                printf("%-24s %12llu\n", "hit", static_cast<unsigned long long>(hitBytes));
+                printf("%-24s %12llu\n", "hit on another block", static_cast<unsigned long long>(sameBytes));
+
+                // Changing a single byte changes the hash, so the new content is transferred before it's cached.
+                data[12345] ^= 1;
+                SharedPointer<ServerBlock> pChangedBlock = CreateServerBlock(context, data.data(), blockSize);
+                DD_BENCH_CHECK(pChangedBlock.IsNull() == false);
+                if (pChangedBlock.IsNull() == false)
+                {
+                    DD_BENCH_CHECK(memcmp(pChangedBlock->GetContentHash().dwords,
+                                          contentHash.dwords,
+                                          sizeof(contentHash.dwords)) != 0);
+
+                    const uint64 changedMissBytes =
+                        CheckCachedPull(context, pChangedBlock->GetBlockId(), data.data(), blockSize, 65536, &result);
+                    const uint64 changedHitBytes =
+                        CheckCachedPull(context, pChangedBlock->GetBlockId(), data.data(), blockSize, 65536, &result);
+                    DD_BENCH_CHECK(changedMissBytes >= blockSize);
+                    DD_BENCH_CHECK(changedHitBytes < maxHitBytes);
+                    printf("%-24s %12llu\n", "changed content miss", static_cast<unsigned long long>(changedMissBytes));
+                    printf("%-24s %12llu\n", "changed content hit", static_cast<unsigned long long>(changedHitBytes));
+
+                    context.pServerTransferManager->CloseServerBlock(pChangedBlock);
+                }
+                data[12345] ^= 1;
+
+                // Setting the budget to zero empties the cache, and blocks too large for the budget aren't kept.
+                context.pPullerTransferManager->SetPullContentCacheBudget(0);
+                const uint64 clearedBytes = CheckCachedPull(context, blockId, data.data(), blockSize, 65536, &result);
+                DD_BENCH_CHECK(clearedBytes >= blockSize);
+                printf("%-24s %12llu\n", "after budget 0", static_cast<unsigned long long>(clearedBytes));
+
+                context.pPullerTransferManager->SetPullContentCacheBudget(blockSize / 2);
+                CheckCachedPull(context, blockId, data.data(), blockSize, 65536, &result);
+                const uint64 tooLargeBytes = CheckCachedPull(context, blockId, data.data(), blockSize, 65536, &result);
+                DD_BENCH_CHECK(tooLargeBytes >= blockSize);
+                printf("%-24s %12llu\n", "larger than the budget", static_cast<unsigned long long>(tooLargeBytes));
+            }
+            context.pServerTransferManager->CloseServerBlock(pBlock);
+            context.pServerTransferManager->CloseServerBlock(pSameBlock);
+
+            // An empty block ends the hashed pull straight away, every time it's pulled.
+            SharedPointer<ServerBlock> pEmptyBlock = CreateServerBlock(context, data.data(), 0);
+            DD_BENCH_CHECK(pEmptyBlock.IsNull() == false);
+            if (pEmptyBlock.IsNull() == false)
+            {
+                CheckCachedPull(context, pEmptyBlock->GetBlockId(), data.data(), 0, 100, &result);
+                CheckCachedPull(context, pEmptyBlock->GetBlockId(), data.data(), 0, 100, &result);
+                context.pServerTransferManager->CloseServerBlock(pEmptyBlock);
+            }
+
+            // A pull that's closed part way through isn't cached, so the next pull transfers the whole block.
+            const size_t smallSize = 1000;
+            SharedPointer<ServerBlock> pSmallBlock = CreateServerBlock(context, data.data(), smallSize);
+            DD_BENCH_CHECK(pSmallBlock.IsNull() == false);
+            if (pSmallBlock.IsNull() == false)
+            {
+                TransferManager* pPullerTransferManager = context.pPullerTransferManager;
+                PullBlock* pPartialPull =
+                    pPullerTransferManager->OpenCachedPullBlock(context.serverClientId, pSmallBlock->GetBlockId());
+                DD_BENCH_CHECK(pPartialPull != nullptr);
+                if (pPartialPull != nullptr)
+                {
+                    uint8 partialData[10] = {};
+                    size_t bytesRead = 0;
+                    DD_BENCH_CHECK(pPartialPull->Read(partialData, sizeof(partialData), &bytesRead) == Result::Success);
+                    DD_BENCH_CHECK(memcmp(partialData, data.data(), bytesRead) == 0);
+                    pPullerTransferManager->ClosePullBlock(&pPartialPull);
+                }
+
+                const uint64 afterPartialBytes =
+                    CheckCachedPull(context, pSmallBlock->GetBlockId(), data.data(), smallSize, 64, &result);
+                const uint64 smallHitBytes =
+                    CheckCachedPull(context, pSmallBlock->GetBlockId(), data.data(), smallSize, 64, &result);
+                DD_BENCH_CHECK(afterPartialBytes >= smallSize);
+                DD_BENCH_CHECK(smallHitBytes < smallSize);
+                printf("%-24s %12llu\n", "after a partial pull", static_cast<unsigned long long>(afterPartialBytes));
+                printf("%-24s %12llu\n", "small hit", static_cast<unsigned long long>(smallHitBytes));
+
+                context.pServerTransferManager->CloseServerBlock(pSmallBlock);
+            }
+        }
+
+        // Pulls a whole block over numStreams streams in reads of readSize bytes into pData. Returns the number of
+        // bytes read, or zero if the pull failed.
+        static size_t ParallelPullBlockData(const PullContext &context,
+                                            BlockId            blockId,
+                                            uint32             numStreams,
+                                            size_t             readSize,
+                                            uint8*             pData,
+                                            size_t             size)
+        {
+            TransferManager* pPullerTransferManager = context.pPullerTransferManager;
+
+            size_t totalBytesRead = 0;
+            Result readResult = Result::Error;
+            PullBlock* pPullBlock = pPullerTransferManager->OpenPullBlock(context.serverClientId, blockId, numStreams);
+            if (pPullBlock != nullptr)
+            {
+                readResult = (pPullBlock->GetBlockDataSize() == size) ? Result::Success : Result::Error;
+                while ((readResult == Result::Success) && (totalBytesRead <= size))
+                {
+                    size_t bytesRead = 0;
+                    readResult = pPullBlock->Read(pData + totalBytesRead,
+                                                  Platform::Min(readSize, (size + 1) - totalBytesRead),
+                                                  &bytesRead);
+                    totalBytesRead += bytesRead;
+                }
+                pPullerTransferManager->ClosePullBlock(&pPullBlock);
+            }
+            return (readResult == Result::EndOfStream) ? totalBytesRead : 0;
+        }
+
+        // =============================================================================================================
+        static void CheckParallelPulls(const BenchmarkOptions &options, const PullContext &context, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            // Ranges are at most 4 MB, so the largest block has more ranges than streams and each stream pulls
+            // several of them in turn. Blocks below 1 MB are pulled over a single stream.
+            const size_t kRangeSizeInBytes = (1024 * kTransferChunkSizeInBytes);
+            const size_t largeSize = options.quick ? ((5 * kRangeSizeInBytes) + 77) : ((64 * kRangeSizeInBytes) + 77);
+            const size_t kSizes[] =
+            {
+                1000,
+                (256 * kTransferChunkSizeInBytes) - 1,
+                (256 * kTransferChunkSizeInBytes),
+                (256 * kTransferChunkSizeInBytes) + kTransferChunkSizeInBytes + 1,
+                largeSize,
+            };
+            const uint32 kNumStreams[] = { 1, 2, 3, 8, 12 };
+
+            std::vector<uint8> data(largeSize);
+            for (size_t index = 0; index < largeSize; ++index)
+            {
+                data[index] = static_cast<uint8>((index * 131) + (index >> 12));
+            }
+            std::vector<uint8> pulledData(largeSize + 1);
+
+            printf("%10s %8s %12s %14s\n", "size", "streams", "pull MB/s", "puller bytes");
+
+            for (size_t size : kSizes)
+            {
+                SharedPointer<ServerBlock> pBlock = CreateServerBlock(context, data.data(), size);
+                DD_BENCH_CHECK(pBlock.IsNull() == false);
+                if (pBlock.IsNull())
+                {
+                    break;
+                }
+
+                for (uint32 numStreams : kNumStreams)
+                {
+                    // Odd read sizes so reads end in the middle of chunks, and reads larger than a range so a single
+                    // read gathers from several streams.
+                    const size_t readSize = ((numStreams % 2) == 0) ? 7777 : ((kRangeSizeInBytes * 2) + 3);
+
+                    memset(pulledData.data(), 0, size);
+                    const uint64 bytesAllocatedBefore = context.pPullerAllocator->bytesAllocated;
+                    Stopwatch pullTimer;
+                    const size_t bytesPulled = ParallelPullBlockData(context,
+                                                                     pBlock->GetBlockId(),
+                                                                     numStreams,
+                                                                     readSize,
+                                                                     pulledData.data(),
+                                                                     size);
+                    const uint64 pullNs = Platform::Max<uint64>(pullTimer.GetElapsedNs(), 1);
+                    const uint64 bytesAllocated = (context.pPullerAllocator->bytesAllocated - bytesAllocatedBefore);
+
+                    DD_BENCH_CHECK((bytesPulled == size) && (memcmp(pulledData.data(), data.data(), size) == 0));
+
+                    // Each stream stages a single range at a time, however large the block is. The rest of what a
+                    // stream allocates is its session, which stays well below a megabyte.
+                    if (size > (kRangeSizeInBytes * numStreams))
+                    {
+                        DD_BENCH_CHECK(bytesAllocated < ((kRangeSizeInBytes + (1024 * 1024)) * numStreams));
+                    }
+
+                    printf("%10u %8u %12.1f %14llu\n",
+                           static_cast<uint32>(size),
+                           numStreams,
+                           (static_cast<double>(size) / (1024.0 * 1024.0)) / (static_cast<double>(pullNs) / 1e9),
+                           static_cast<unsigned long long>(bytesAllocated));
+                }
+
+                context.pServerTransferManager->CloseServerBlock(pBlock);
+            }
+        }
+
+        // Continues reading a block of the given size into pData until a read doesn't succeed, stopOffset bytes have
+        // been read or timeoutInMs passes. Returns the result of the last read and adds to pTotalBytesRead.
+        static Result ReadUntil(PullBlock* pPullBlock,
+                                uint8*     pData,
+                                size_t     size,
+                                size_t     stopOffset,
+                                uint64     timeoutInMs,
+                                size_t*    pTotalBytesRead)
+        {
+            Result readResult = Result::Success;
+            Stopwatch timer;
+            while ((readResult == Result::Success) &&
+                   (*pTotalBytesRead < stopOffset) &&
+                   ((timer.GetElapsedNs() / 1000000) < timeoutInMs))
+            {
+                size_t bytesRead = 0;
+                readResult = pPullBlock->Read(pData + *pTotalBytesRead,
+                                              Platform::Min<size_t>(50000, (size + 1) - *pTotalBytesRead),
+                                              &bytesRead);
+                *pTotalBytesRead += bytesRead;
+            }
+            return readResult;
+        }
+
+        // =============================================================================================================
+        static void CheckResumedPulls(const BenchmarkOptions &options, const PullContext &context, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            TransferManager* pServerTransferManager = context.pServerTransferManager;
+            TransferManager* pPullerTransferManager = context.pPullerTransferManager;
+
+            const size_t blockSize = options.quick ? ((3 * 1024 * 1024) + 777) : ((64 * 1024 * 1024) + 777);
+            std::vector<uint8> data(blockSize);
+            for (size_t index = 0; index < blockSize; ++index)
+            {
+                data[index] = static_cast<uint8>((index * 7) + (index >> 12));
+            }
+            std::vector<uint8> pulledData(blockSize + 1);
+
+            // Every pull below runs after the block was closed, so they all rely on it being retained.
+            pServerTransferManager->SetServerBlockRetentionTime(kLongRetentionTimeInMs);
+            SharedPointer<ServerBlock> pBlock = CreateServerBlock(context, data.data(), blockSize);
+            DD_BENCH_CHECK(pBlock.IsNull() == false);
+            const BlockId blockId = pBlock.IsNull() ? kInvalidBlockId : pBlock->GetBlockId();
+            pServerTransferManager->CloseServerBlock(pBlock);
+
+            // A pull that loses its session continues from the data it already has, over one stream or several.
+            // Parallel streams receive their ranges ahead of the reads, so they're cut off right away.
+            const NetworkImpairmentConfig cleanConfig = {};
+            NetworkImpairmentConfig silentConfig = {};
+            silentConfig.lossRatio = 1.0f;
+
+            const uint32 kNumStreams[] = { 1, 4 };
+            for (uint32 numStreams : kNumStreams)
+            {
+                PullBlock* pPullBlock = pPullerTransferManager->OpenPullBlock(context.serverClientId,
+                                                                              blockId,
+                                                                              numStreams);
+                DD_BENCH_CHECK(pPullBlock != nullptr);
+                if (pPullBlock == nullptr)
+                {
+                    break;
+                }
+
+                memset(pulledData.data(), 0, blockSize);
+                size_t totalBytesRead = 0;
+                const size_t failureOffset = (numStreams == 1) ? (blockSize / 3) : 0;
+                Result readResult =
+                    ReadUntil(pPullBlock, pulledData.data(), blockSize, failureOffset, UINT64_MAX, &totalBytesRead);
+                DD_BENCH_CHECK(readResult == Result::Success);
+
+                context.pPullerImpairment->SetConfig(silentConfig);
+                Stopwatch failureTimer;
+                readResult = ReadUntil(pPullBlock,
+                                       pulledData.data(),
+                                       blockSize,
+                                       blockSize,
+                                       kPullFailureTimeoutInMs,
+                                       &totalBytesRead);
+                const uint64 failureNs = failureTimer.GetElapsedNs();
+                const size_t resumeOffset = totalBytesRead;
+                DD_BENCH_CHECK((readResult != Result::Success) && (readResult != Result::EndOfStream));
+                context.pPullerImpairment->SetConfig(cleanConfig);
+
+                // Streams that hadn't noticed the loss yet fail after the first resume, so each one may need its own.
+                uint32 numResumes = 0;
+                while ((readResult != Result::EndOfStream) && (numResumes < numStreams))
+                {
+                    DD_BENCH_CHECK(pPullBlock->Resume() == Result::Success);
+                    readResult =
+                        ReadUntil(pPullBlock, pulledData.data(), blockSize, SIZE_MAX, UINT64_MAX, &totalBytesRead);
+                    ++numResumes;
+                }
+                DD_BENCH_CHECK(readResult == Result::EndOfStream);
+                DD_BENCH_CHECK((totalBytesRead == blockSize) &&
+                               (memcmp(pulledData.data(), data.data(), blockSize) == 0));
+
+                printf("%u stream pull failed after %.1f s, resumed at %u with %u resumes\n",
+                       numStreams,
+                       static_cast<double>(failureNs) / 1e9,
+                       static_cast<uint32>(resumeOffset),
+                       numResumes);
+
+                pPullerTransferManager->ClosePullBlock(&pPullBlock);
+            }
+
+            // A new pull can start from any offset up to the end of the block, such as the amount of data a client
+            // saved before its original pull was lost.
+            const size_t kOffsets[] = { 0, 1, kTransferChunkSizeInBytes, 1234567, (blockSize - 1), blockSize };
+            for (size_t offset : kOffsets)
+            {
+                PullBlock* pPullBlock = pPullerTransferManager->OpenPullBlockAtOffset(context.serverClientId,
+                                                                                      blockId,
+                                                                                      offset);
+                DD_BENCH_CHECK(pPullBlock != nullptr);
+                if (pPullBlock != nullptr)
+                {
+                    const size_t expectedSize = (blockSize - offset);
+                    DD_BENCH_CHECK(pPullBlock->GetBlockDataSize() == expectedSize);
+
+                    size_t totalBytesRead = 0;
+                    const Result readResult =
+                        ReadUntil(pPullBlock, pulledData.data(), expectedSize, SIZE_MAX, UINT64_MAX, &totalBytesRead);
+                    DD_BENCH_CHECK(readResult == Result::EndOfStream);
+                    DD_BENCH_CHECK((totalBytesRead == expectedSize) &&
+                                   (memcmp(pulledData.data(), data.data() + offset, expectedSize) == 0));
+
+                    pPullerTransferManager->ClosePullBlock(&pPullBlock);
+                }
+            }
+            DD_BENCH_CHECK(pPullerTransferManager->OpenPullBlockAtOffset(context.serverClientId,
+                                                                          blockId,
+                                                                          (blockSize + 1)) == nullptr);
+
+            // Once the retention time has passed, the block is gone.
+            pServerTransferManager->SetServerBlockRetentionTime(kShortRetentionTimeInMs);
+            SharedPointer<ServerBlock> pExpiringBlock = CreateServerBlock(context, data.data(), blockSize);
+            DD_BENCH_CHECK(pExpiringBlock.IsNull() == false);
+            const BlockId expiringBlockId = pExpiringBlock.IsNull() ? kInvalidBlockId : pExpiringBlock->GetBlockId();
+            pServerTransferManager->CloseServerBlock(pExpiringBlock);
+
+            PullBlock* pRetainedPull = pPullerTransferManager->OpenPullBlock(context.serverClientId, expiringBlockId);
+            DD_BENCH_CHECK(pRetainedPull != nullptr);
+            if (pRetainedPull != nullptr)
+            {
+                pPullerTransferManager->ClosePullBlock(&pRetainedPull);
+            }
+
+            Platform::Sleep(kShortRetentionTimeInMs + 100);
+            pServerTransferManager->Update();
+            DD_BENCH_CHECK(pServerTransferManager->GetServerBlock(expiringBlockId).IsNull());
+            DD_BENCH_CHECK(pPullerTransferManager->OpenPullBlock(context.serverClientId, expiringBlockId) == nullptr);
+
+            // The block closed with the longer retention time is still there.
+            DD_BENCH_CHECK(pServerTransferManager->GetServerBlock(blockId).IsNull() == false);
+
+            pServerTransferManager->SetServerBlockRetentionTime(0);
+        }
+
+        // =============================================================================================================
+        Result RunPullBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kPullListenerPort, nullptr) == Result::Success);
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kPullListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            DevDriverClient server(GetAllocCb(), clientInfo);
+
+            // Only the puller is impaired, so it's the puller's sessions that fail.
+            NetworkImpairment pullerImpairment;
+            CountingAllocator pullerAllocator = {};
+            clientInfo.pNetworkImpairment = &pullerImpairment;
+            DevDriverClient puller(GetCountingAllocCb(&pullerAllocator), clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+            DD_BENCH_CHECK(puller.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                PullContext context = {};
+                context.pListener = &listener;
+                context.pServerTransferManager = &server.GetMessageChannel()->GetTransferManager();
+                context.pPullerTransferManager = &puller.GetMessageChannel()->GetTransferManager();
+                context.serverClientId = server.GetMessageChannel()->GetClientId();
+                context.pPullerAllocator = &pullerAllocator;
+                context.pPullerImpairment = &pullerImpairment;
+
+                CheckCachedPulls(options, context, &result);
+                CheckParallelPulls(options, context, &result);
+                CheckResumedPulls(options, context, &result);
+            }
+
+            puller.Destroy();
+            server.Destroy();
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
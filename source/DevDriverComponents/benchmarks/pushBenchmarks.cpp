@@ -0,0 +1,270 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  pushBenchmarks.cpp
+* @brief Checks synchronous and pipelined push blocks, including finalizing in the background and resuming
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddNetworkImpairment.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include <cstdio>
+#include <cstring>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kPushListenerPort = 27350;
+        DD_STATIC_CONST size_t kPushQueueSizeInBytes = (256 * 1024);
+        DD_STATIC_CONST size_t kPushWriteSizeInBytes = 50000;
+
+        // Losing every message makes the session give up well within this time.
+        DD_STATIC_CONST uint64 kPushFailureTimeoutInMs = 20000;
+
+        // Writes pData from offset to the end of the block in uneven pieces. Returns the offset writing stopped at.
+        static size_t WriteBlockData(PushBlock* pPushBlock, const uint8* pData, size_t offset, size_t size, Result* pResult)
+        {
+            *pResult = Result::Success;
+            size_t writeSize = 1000;
+            while ((offset < size) && (*pResult == Result::Success))
+            {
+                const size_t bytesToWrite = Platform::Min(writeSize, size - offset);
+                *pResult = pPushBlock->Write(pData + offset, bytesToWrite);
+                if (*pResult == Result::Success)
+                {
+                    offset += bytesToWrite;
+                }
+                writeSize = ((writeSize * 3) % 100003) + 1;
+            }
+            return offset;
+        }
+
+        // Returns true if the server block holds exactly the given data.
+        static bool BlockMatches(const SharedPointer<ServerBlock>& pBlock, const uint8* pData, size_t size)
+        {
+            return ((pBlock->GetBlockDataSize() == size) && (pBlock->CalculateCrc32(0, size, 0) == CRC32(pData, size)));
+        }
+
+        // Waits for a finalize started with BeginFinalize and returns its result.
+        static Result WaitForFinalize(PushBlock* pPushBlock)
+        {
+            Result result = Result::NotReady;
+            while (result == Result::NotReady)
+            {
+                result = pPushBlock->WaitForFinalize(1);
+            }
+            return result;
+        }
+
+        // =============================================================================================================
+        Result RunPushBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kPushListenerPort, nullptr) == Result::Success);
+
+            // Only the pushing side is impaired, so it's the pusher's session that fails.
+            NetworkImpairment pusherImpairment;
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kPushListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            DevDriverClient server(GetAllocCb(), clientInfo);
+            clientInfo.pNetworkImpairment = &pusherImpairment;
+            DevDriverClient pusher(GetAllocCb(), clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+            DD_BENCH_CHECK(pusher.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                TransferManager& serverTransferManager = server.GetMessageChannel()->GetTransferManager();
+                TransferManager& pusherTransferManager = pusher.GetMessageChannel()->GetTransferManager();
+                const ClientId serverClientId = server.GetMessageChannel()->GetClientId();
+
+                // The odd size leaves a partial last chunk.
+                const size_t blockSize = options.quick ? ((3 * 1024 * 1024) + 777) : ((64 * 1024 * 1024) + 777);
+                std::vector<uint8> data(blockSize);
+                for (size_t index = 0; index < blockSize; ++index)
+                {
+                    data[index] = static_cast<uint8>((index * 7) + (index >> 12));
+                }
+
+                printf("%-10s %10s\n", "push", "MB/s");
+
+                // Both kinds of push block deliver the same data, and both can be finalized in the background.
+                const size_t kQueueSizes[] = { 0, kPushQueueSizeInBytes };
+                for (size_t queueSize : kQueueSizes)
+                {
+                    SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock();
+                    PushBlock* pPushBlock =
+                        pusherTransferManager.OpenPushBlock(serverClientId, pBlock->GetBlockId(), blockSize, queueSize);
+                    DD_BENCH_CHECK(pPushBlock != nullptr);
+                    if (pPushBlock != nullptr)
+                    {
+                        Stopwatch pushTimer;
+                        Result writeResult = Result::Error;
+                        WriteBlockData(pPushBlock, data.data(), 0, blockSize, &writeResult);
+                        DD_BENCH_CHECK(writeResult == Result::Success);
+
+                        DD_BENCH_CHECK(pPushBlock->BeginFinalize() == Result::Success);
+                        DD_BENCH_CHECK(pPushBlock->BeginFinalize() != Result::Success);
+                        DD_BENCH_CHECK(WaitForFinalize(pPushBlock) == Result::Success);
+                        const uint64 pushNs = Platform::Max<uint64>(pushTimer.GetElapsedNs(), 1);
+
+                        // Waiting again reports the same result, and the block can't be finalized twice.
+                        DD_BENCH_CHECK(pPushBlock->WaitForFinalize(0) == Result::Success);
+                        DD_BENCH_CHECK(pPushBlock->Finalize() != Result::Success);
+                        DD_BENCH_CHECK(BlockMatches(pBlock, data.data(), blockSize));
+
+                        printf("%-10s %10.1f\n",
+                               (queueSize > 0) ? "pipelined" : "direct",
+                               (static_cast<double>(blockSize) / (1024.0 * 1024.0)) / (static_cast<double>(pushNs) / 1e9));
+
+                        pusherTransferManager.ClosePushBlock(&pPushBlock);
+                    }
+                    serverTransferManager.CloseServerBlock(pBlock);
+                }
+
+                // Discarding drops whatever is still queued and leaves the server block empty.
+                {
+                    SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock();
+                    PushBlock* pPushBlock = pusherTransferManager.OpenPushBlock(serverClientId,
+                                                                                pBlock->GetBlockId(),
+                                                                                blockSize,
+                                                                                kPushQueueSizeInBytes);
+                    DD_BENCH_CHECK(pPushBlock != nullptr);
+                    if (pPushBlock != nullptr)
+                    {
+                        DD_BENCH_CHECK(pPushBlock->Write(data.data(), (blockSize / 2)) == Result::Success);
+                        DD_BENCH_CHECK(pPushBlock->Discard() == Result::Aborted);
+                        DD_BENCH_CHECK(pBlock->GetBlockDataSize() == 0);
+                        pusherTransferManager.ClosePushBlock(&pPushBlock);
+                    }
+                    serverTransferManager.CloseServerBlock(pBlock);
+                }
+
+                // A push that loses its session can be resumed from where the server stopped, whether it's direct or
+                // pipelined, and whether a pipelined push failed while writing or while finalizing in the background.
+                const NetworkImpairmentConfig cleanConfig = {};
+                NetworkImpairmentConfig silentConfig = {};
+                silentConfig.lossRatio = 1.0f;
+
+                struct ResumedPush
+                {
+                    size_t queueSize;
+                    bool   failWhileFinalizing;
+                };
+
+                const ResumedPush kResumedPushes[] =
+                {
+                    { 0,                     false },
+                    { kPushQueueSizeInBytes, false },
+                    { kPushQueueSizeInBytes, true  },
+                };
+                for (const ResumedPush &resumedPush : kResumedPushes)
+                {
+                    const bool failWhileFinalizing = resumedPush.failWhileFinalizing;
+                    SharedPointer<ServerBlock> pBlock = serverTransferManager.OpenServerBlock();
+                    PushBlock* pPushBlock = pusherTransferManager.OpenPushBlock(serverClientId,
+                                                                                pBlock->GetBlockId(),
+                                                                                blockSize,
+                                                                                resumedPush.queueSize);
+                    DD_BENCH_CHECK(pPushBlock != nullptr);
+                    if (pPushBlock == nullptr)
+                    {
+                        serverTransferManager.CloseServerBlock(pBlock);
+                        break;
+                    }
+
+                    Result pushResult = Result::Success;
+                    size_t offset = WriteBlockData(pPushBlock, data.data(), 0, (blockSize / 3), &pushResult);
+                    DD_BENCH_CHECK(pushResult == Result::Success);
+
+                    pusherImpairment.SetConfig(silentConfig);
+                    Stopwatch failureTimer;
+                    if (failWhileFinalizing)
+                    {
+                        // Less than fits into the queue, so the send thread is the one that runs into the failure.
+                        DD_BENCH_CHECK(pPushBlock->Write(data.data() + offset, kPushWriteSizeInBytes) == Result::Success);
+                        DD_BENCH_CHECK(pPushBlock->BeginFinalize() == Result::Success);
+                        pushResult = WaitForFinalize(pPushBlock);
+                    }
+                    else
+                    {
+                        while ((pushResult == Result::Success) &&
+                               (failureTimer.GetElapsedNs() < (kPushFailureTimeoutInMs * 1000000ull)))
+                        {
+                            const size_t bytesToWrite = Platform::Min(kPushWriteSizeInBytes, blockSize - offset);
+                            pushResult = pPushBlock->Write(data.data() + offset, bytesToWrite);
+                            offset = (pushResult == Result::Success) ? ((offset + bytesToWrite) % blockSize) : offset;
+                        }
+                    }
+                    DD_BENCH_CHECK(pushResult != Result::Success);
+                    pusherImpairment.SetConfig(cleanConfig);
+
+                    size_t resumeOffset = 0;
+                    pushResult = pPushBlock->Resume(&resumeOffset);
+                    DD_BENCH_CHECK(pushResult == Result::Success);
+                    DD_BENCH_CHECK(resumeOffset == pBlock->GetBlockDataSize());
+                    DD_BENCH_CHECK(resumeOffset <= blockSize);
+
+                    if (pushResult == Result::Success)
+                    {
+                        WriteBlockData(pPushBlock, data.data(), resumeOffset, blockSize, &pushResult);
+                        DD_BENCH_CHECK(pushResult == Result::Success);
+                        DD_BENCH_CHECK(pPushBlock->Finalize() == Result::Success);
+                        DD_BENCH_CHECK(BlockMatches(pBlock, data.data(), blockSize));
+                    }
+
+                    printf("%s %s failed after %.1f s, resumed at %u\n",
+                           (resumedPush.queueSize > 0) ? "pipelined" : "direct",
+                           failWhileFinalizing ? "finalize" : "write",
+                           static_cast<double>(failureTimer.GetElapsedNs()) / 1e9,
+                           static_cast<uint32>(resumeOffset));
+
+                    pusherTransferManager.ClosePushBlock(&pPushBlock);
+                    serverTransferManager.CloseServerBlock(pBlock);
+                }
+            }
+
+            pusher.Destroy();
+            server.Destroy();
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
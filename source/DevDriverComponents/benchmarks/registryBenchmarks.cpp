@@ -0,0 +1,270 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  registryBenchmarks.cpp
+* @brief Checks and measures server block lookups and the reuse of idle server blocks
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "msgChannel.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kRegistryListenerPort = 27380;
+
+        // Opens a heap block with the size hint, fills it with size bytes of data and closes it. Returns the number of
+        // bytes the allocator handed out meanwhile.
+        static uint64 WriteServerBlock(TransferManager*            pTransferManager,
+                                       CountingAllocator*          pAllocator,
+                                       const std::vector<uint8>&   data,
+                                       size_t                      size,
+                                       SharedPointer<ServerBlock>* ppBlock)
+        {
+            const uint64 bytesAllocatedBefore = pAllocator->bytesAllocated;
+            *ppBlock = pTransferManager->OpenServerBlock(ServerBlockStorage::Heap, size);
+            if (ppBlock->IsNull() == false)
+            {
+                (*ppBlock)->Write(data.data(), size);
+                (*ppBlock)->Close();
+            }
+            return (pAllocator->bytesAllocated - bytesAllocatedBefore);
+        }
+
+        // =============================================================================================================
+        static void CheckLookups(const BenchmarkOptions &options, TransferManager* pTransferManager, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            // Every open block can be found by its id, and closed ones can't.
+            const size_t numBlocks = options.quick ? 1024 : 16384;
+            std::vector<SharedPointer<ServerBlock>> blocks(numBlocks);
+            std::vector<BlockId> blockIds(numBlocks);
+            for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+            {
+                blocks[blockIndex] = pTransferManager->OpenServerBlock();
+                blockIds[blockIndex] = blocks[blockIndex].IsNull() ? kInvalidBlockId : blocks[blockIndex]->GetBlockId();
+            }
+
+            uint32 numMismatches = 0;
+            for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+            {
+                const SharedPointer<ServerBlock> pBlock = pTransferManager->GetServerBlock(blockIds[blockIndex]);
+                numMismatches += ((blockIds[blockIndex] == kInvalidBlockId) ||
+                                  (pBlock.Get() != blocks[blockIndex].Get())) ? 1 : 0;
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+            DD_BENCH_CHECK(pTransferManager->GetServerBlock(kInvalidBlockId).IsNull());
+
+            for (size_t blockIndex = 0; blockIndex < numBlocks; blockIndex += 2)
+            {
+                pTransferManager->CloseServerBlock(blocks[blockIndex]);
+            }
+
+            for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+            {
+                const SharedPointer<ServerBlock> pBlock = pTransferManager->GetServerBlock(blockIds[blockIndex]);
+                const bool isClosed = ((blockIndex % 2) == 0);
+                const bool isMatch = isClosed ? pBlock.IsNull() : (pBlock.Get() == blocks[blockIndex].Get());
+                numMismatches += isMatch ? 0 : 1;
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+
+            // Lookups from several threads find the right blocks while another thread keeps opening and closing
+            // blocks in the same shards.
+            const uint64 lookupsPerThread = options.quick ? 200000 : 5000000;
+            const uint32 kNumThreads[] = { 1, 2, 4, 8 };
+
+            printf("%8s %16s\n", "threads", "lookups/s");
+            for (uint32 numThreads : kNumThreads)
+            {
+                std::atomic<bool> stopChurn(false);
+                std::atomic<uint32> numLookupMismatches(0);
+
+                std::thread churnThread([pTransferManager, &stopChurn]()
+                {
+                    while (stopChurn == false)
+                    {
+                        SharedPointer<ServerBlock> pBlock = pTransferManager->OpenServerBlock();
+                        pTransferManager->CloseServerBlock(pBlock);
+                    }
+                });
+
+                Stopwatch lookupTimer;
+                std::vector<std::thread> lookupThreads;
+                for (uint32 threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+                {
+                    lookupThreads.emplace_back([&, threadIndex]()
+                    {
+                        uint32 threadMismatches = 0;
+                        size_t blockIndex = ((threadIndex * 2) + 1);
+                        for (uint64 lookup = 0; lookup < lookupsPerThread; ++lookup)
+                        {
+                            const SharedPointer<ServerBlock> pBlock =
+                                pTransferManager->GetServerBlock(blockIds[blockIndex]);
+                            threadMismatches += (pBlock.Get() != blocks[blockIndex].Get()) ? 1 : 0;
+                            blockIndex = ((blockIndex + 14) % numBlocks) | 1;
+                        }
+                        numLookupMismatches += threadMismatches;
+                    });
+                }
+
+                for (std::thread &lookupThread : lookupThreads)
+                {
+                    lookupThread.join();
+                }
+                const uint64 lookupNs = Platform::Max<uint64>(lookupTimer.GetElapsedNs(), 1);
+
+                stopChurn = true;
+                churnThread.join();
+
+                DD_BENCH_CHECK(numLookupMismatches == 0);
+
+                printf("%8u %16.0f\n",
+                       numThreads,
+                       static_cast<double>(lookupsPerThread * numThreads) / (static_cast<double>(lookupNs) / 1e9));
+            }
+
+            for (size_t blockIndex = 1; blockIndex < numBlocks; blockIndex += 2)
+            {
+                pTransferManager->CloseServerBlock(blocks[blockIndex]);
+            }
+        }
+
+        // =============================================================================================================
+        static void CheckIdleBlocks(TransferManager* pTransferManager, CountingAllocator* pAllocator, Result* pResult)
+        {
+            Result &result = *pResult;
+
+            const size_t kBlockSize = (1024 * 1024);
+            std::vector<uint8> data(4 * kBlockSize);
+            for (size_t index = 0; index < data.size(); ++index)
+            {
+                data[index] = static_cast<uint8>((index * 31) + (index >> 11));
+            }
+            std::vector<uint8> readData(data.size());
+
+            // Bookkeeping stays far below the size of a block, so any allocation larger than this is block storage.
+            const uint64 maxBookkeepingBytes = (kBlockSize / 16);
+
+            pTransferManager->SetIdleServerBlockBudget(2 * kBlockSize);
+
+            // A released block is reused for a smaller one. It comes back empty and under a new id.
+            SharedPointer<ServerBlock> pBlock;
+            DD_BENCH_CHECK(WriteServerBlock(pTransferManager, pAllocator, data, kBlockSize, &pBlock) >= kBlockSize);
+            const BlockId firstBlockId = pBlock.IsNull() ? kInvalidBlockId : pBlock->GetBlockId();
+            pTransferManager->CloseServerBlock(pBlock);
+
+            const uint64 reusedBytes = WriteServerBlock(pTransferManager, pAllocator, data, (kBlockSize / 2), &pBlock);
+            DD_BENCH_CHECK(reusedBytes < maxBookkeepingBytes);
+            if (pBlock.IsNull() == false)
+            {
+                DD_BENCH_CHECK(pBlock->GetBlockId() != firstBlockId);
+                DD_BENCH_CHECK(pBlock->GetBlockDataSize() == (kBlockSize / 2));
+                DD_BENCH_CHECK(pBlock->GetCrc32() == CRC32(data.data(), (kBlockSize / 2)));
+                DD_BENCH_CHECK((pBlock->Read(0, readData.data(), kBlockSize) == (kBlockSize / 2)) &&
+                               (memcmp(readData.data(), data.data(), (kBlockSize / 2)) == 0));
+            }
+            DD_BENCH_CHECK(pTransferManager->GetServerBlock(firstBlockId).IsNull());
+            pTransferManager->CloseServerBlock(pBlock);
+
+            // Idle blocks that are too small for the size hint, or use other storage, aren't reused.
+            const uint64 largerBytes = WriteServerBlock(pTransferManager, pAllocator, data, (2 * kBlockSize), &pBlock);
+            DD_BENCH_CHECK(largerBytes >= (2 * kBlockSize));
+            pTransferManager->CloseServerBlock(pBlock);
+
+            SharedPointer<ServerBlock> pFileBlock = pTransferManager->OpenServerBlock(ServerBlockStorage::File,
+                                                                                      kBlockSize);
+            DD_BENCH_CHECK((pFileBlock.IsNull() == false) && (pFileBlock->GetStorage() == ServerBlockStorage::File));
+            pTransferManager->CloseServerBlock(pFileBlock);
+
+            // Blocks larger than the budget are freed instead of pinning their memory.
+            DD_BENCH_CHECK(WriteServerBlock(pTransferManager, pAllocator, data, (4 * kBlockSize), &pBlock) >=
+                           (4 * kBlockSize));
+            pTransferManager->CloseServerBlock(pBlock);
+            const uint64 oversizedBytes =
+                WriteServerBlock(pTransferManager, pAllocator, data, (3 * kBlockSize), &pBlock);
+            DD_BENCH_CHECK(oversizedBytes >= (3 * kBlockSize));
+            pTransferManager->CloseServerBlock(pBlock);
+
+            // A budget of zero empties the pool and disables reuse.
+            pTransferManager->SetIdleServerBlockBudget(0);
+            const uint64 disabledBytes =
+                WriteServerBlock(pTransferManager, pAllocator, data, (kBlockSize / 2), &pBlock);
+            DD_BENCH_CHECK(disabledBytes >= (kBlockSize / 2));
+            pTransferManager->CloseServerBlock(pBlock);
+
+            printf("%-24s %12s\n", "reopened block", "bytes");
+            printf("%-24s %12llu\n", "reused", static_cast<unsigned long long>(reusedBytes));
+            printf("%-24s %12llu\n", "larger than idle blocks", static_cast<unsigned long long>(largerBytes));
+            printf("%-24s %12llu\n", "larger than the budget", static_cast<unsigned long long>(oversizedBytes));
+            printf("%-24s %12llu\n", "reuse disabled", static_cast<unsigned long long>(disabledBytes));
+        }
+
+        // =============================================================================================================
+        Result RunRegistryBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kRegistryListenerPort, nullptr) == Result::Success);
+
+            ClientCreateInfo clientInfo = {};
+            clientInfo.componentType = Component::Tool;
+            clientInfo.createUpdateThread = true;
+            clientInfo.connectionInfo = GetLoopbackHostInfo(TransportType::Remote, kRegistryListenerPort);
+            Platform::Strncpy(clientInfo.clientDescription, "ddBenchmarks", sizeof(clientInfo.clientDescription));
+
+            // The server counts what it asks its allocator for, so reused blocks can be told apart from new ones.
+            CountingAllocator counter = {};
+            DevDriverClient server(GetCountingAllocCb(&counter), clientInfo);
+            DD_BENCH_CHECK(server.Initialize() == Result::Success);
+
+            if (result == Result::Success)
+            {
+                TransferManager& transferManager = server.GetMessageChannel()->GetTransferManager();
+
+                CheckLookups(options, &transferManager, &result);
+                CheckIdleBlocks(&transferManager, &counter, &result);
+            }
+
+            server.Destroy();
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
@@ -0,0 +1,232 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  routerBenchmarks.cpp
+* @brief Checks and measures the transport client index used by RouterCore
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/routerCore.h"
+#include "../listener/transports/hostTransport.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        // Builds a connection that looks like an IPv4 socket address, which is what remote transports store.
+        static ConnectionInfo MakeConnection(TransportHandle handle, uint32 index)
+        {
+            ConnectionInfo connectionInfo = {};
+            connectionInfo.handle = handle;
+            connectionInfo.size = 16;
+
+            const uint16 family = 2;
+            const uint16 port = static_cast<uint16>(27300 + (index % 1024));
+            const uint32 address = (10u << 24) | (index / 1024);
+            memcpy(&connectionInfo.data[0], &family, sizeof(family));
+            memcpy(&connectionInfo.data[2], &port, sizeof(port));
+            memcpy(&connectionInfo.data[4], &address, sizeof(address));
+            return connectionInfo;
+        }
+
+        // The lookup RouterCore did before the index existed: compare against every client on the transport.
+        static ClientId FindClientByScan(const TransportContext &transport, const ConnectionInfo &connectionInfo)
+        {
+            for (const auto &pair : transport.clientMap)
+            {
+                if ((pair.second.size == connectionInfo.size) &&
+                    (memcmp(pair.second.data, connectionInfo.data, connectionInfo.size) == 0))
+                {
+                    return pair.first;
+                }
+            }
+            return kBroadcastClientId;
+        }
+
+        static ClientId FindClientByIndex(const TransportContext &transport, const ConnectionInfo &connectionInfo)
+        {
+            const auto find = transport.connectionIndex.find(connectionInfo);
+            return (find != transport.connectionIndex.end()) ? find->second : kBroadcastClientId;
+        }
+
+        // =============================================================================================================
+        Result RunRouterBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+
+            const uint32 kClientCounts[] = { 256, 1024, 4096, 16384 };
+            const uint32 numClientCounts = options.quick ? 3 : 4;
+            const TransportHandle handle = 1;
+
+            printf("%8s %14s %14s %16s %16s\n", "clients", "index ns/op", "scan ns/op", "reconnect ms", "reconnect scan");
+
+            for (uint32 countIndex = 0; countIndex < numClientCounts; ++countIndex)
+            {
+                const uint32 numClients = kClientCounts[countIndex];
+
+                // A fleet reconnecting: the router looks up the connection of every management message, misses for
+                // the new client and then registers it.
+                TransportContext transport;
+                Stopwatch reconnectTimer;
+                for (uint32 clientIndex = 0; clientIndex < numClients; ++clientIndex)
+                {
+                    const ConnectionInfo connectionInfo = MakeConnection(handle, clientIndex);
+                    DD_BENCH_CHECK(FindClientByIndex(transport, connectionInfo) == kBroadcastClientId);
+                    transport.AddClient(static_cast<ClientId>(clientIndex + 1), connectionInfo);
+                }
+                const uint64 reconnectNs = reconnectTimer.GetElapsedNs();
+
+                DD_BENCH_CHECK(transport.clientMap.size() == numClients);
+                DD_BENCH_CHECK(transport.connectionIndex.size() == numClients);
+
+                // Same storm with the old scan. It is quadratic, so the largest fleet is skipped.
+                uint64 reconnectScanNs = 0;
+                const bool measureReconnectScan = (numClients <= 4096);
+                if (measureReconnectScan)
+                {
+                    TransportContext scanTransport;
+                    Stopwatch scanTimer;
+                    for (uint32 clientIndex = 0; clientIndex < numClients; ++clientIndex)
+                    {
+                        const ConnectionInfo connectionInfo = MakeConnection(handle, clientIndex);
+                        DD_BENCH_CHECK(FindClientByScan(scanTransport, connectionInfo) == kBroadcastClientId);
+                        scanTransport.clientMap.emplace(static_cast<ClientId>(clientIndex + 1), connectionInfo);
+                    }
+                    reconnectScanNs = scanTimer.GetElapsedNs();
+                }
+
+                // Steady state lookups. Both methods must agree on every client.
+                const uint32 numLookups = options.quick ? 4096 : 65536;
+                uint32 numMismatches = 0;
+                Stopwatch indexTimer;
+                for (uint32 lookupIndex = 0; lookupIndex < numLookups; ++lookupIndex)
+                {
+                    const ConnectionInfo connectionInfo = MakeConnection(handle, (lookupIndex * 7919u) % numClients);
+                    numMismatches += (FindClientByIndex(transport, connectionInfo) == kBroadcastClientId) ? 1 : 0;
+                }
+                const uint64 indexNs = indexTimer.GetElapsedNs();
+
+                const uint32 numScanLookups = Platform::Min(numLookups, 1024u);
+                Stopwatch scanTimer;
+                for (uint32 lookupIndex = 0; lookupIndex < numScanLookups; ++lookupIndex)
+                {
+                    const ConnectionInfo connectionInfo = MakeConnection(handle, (lookupIndex * 7919u) % numClients);
+                    const ClientId scanClientId = FindClientByScan(transport, connectionInfo);
+                    numMismatches += (scanClientId != FindClientByIndex(transport, connectionInfo)) ? 1 : 0;
+                }
+                const uint64 scanNs = scanTimer.GetElapsedNs();
+                DD_BENCH_CHECK(numMismatches == 0);
+
+                // Half the fleet disconnects. Removed clients must disappear from the index and the rest must stay.
+                for (uint32 clientIndex = 0; clientIndex < numClients; clientIndex += 2)
+                {
+                    DD_BENCH_CHECK(transport.RemoveClient(static_cast<ClientId>(clientIndex + 1)));
+                }
+                DD_BENCH_CHECK(transport.connectionIndex.size() == transport.clientMap.size());
+                for (uint32 clientIndex = 0; clientIndex < numClients; ++clientIndex)
+                {
+                    const ClientId expected = ((clientIndex % 2) == 0) ? kBroadcastClientId
+                                                                       : static_cast<ClientId>(clientIndex + 1);
+                    numMismatches += (FindClientByIndex(transport, MakeConnection(handle, clientIndex)) != expected) ? 1 : 0;
+                }
+                DD_BENCH_CHECK(numMismatches == 0);
+
+                printf("%8u %14.1f %14.1f %16.2f",
+                       numClients,
+                       static_cast<double>(indexNs) / numLookups,
+                       static_cast<double>(scanNs) / numScanLookups,
+                       static_cast<double>(reconnectNs) / 1000000.0);
+                if (measureReconnectScan)
+                {
+                    printf(" %16.2f\n", static_cast<double>(reconnectScanNs) / 1000000.0);
+                }
+                else
+                {
+                    printf(" %16s\n", "skipped");
+                }
+            }
+
+            // Clients that share a connection, such as the ones behind a forwarding router, stay reachable until the
+            // last one is removed.
+            TransportContext sharedTransport;
+            const ConnectionInfo sharedConnection = MakeConnection(handle, 0);
+            sharedTransport.AddClient(1, sharedConnection);
+            sharedTransport.AddClient(2, sharedConnection);
+            DD_BENCH_CHECK(sharedTransport.AddClient(2, sharedConnection) == false);
+            DD_BENCH_CHECK(sharedTransport.connectionIndex.count(sharedConnection) == 2);
+            DD_BENCH_CHECK(sharedTransport.RemoveClient(1));
+            DD_BENCH_CHECK(FindClientByIndex(sharedTransport, sharedConnection) == 2);
+            DD_BENCH_CHECK(sharedTransport.RemoveClient(2));
+            DD_BENCH_CHECK(sharedTransport.RemoveClient(2) == false);
+            DD_BENCH_CHECK(sharedTransport.connectionIndex.empty());
+
+            // Broadcasts to the listener's own client wait for room in a full ring instead of being dropped, and give
+            // up if nothing makes room.
+            HostListenerTransport hostTransport(ListenerCreateInfo{});
+            MessageBuffer broadcast = {};
+            broadcast.header.payloadSize = sizeof(uint32);
+
+            uint32 numBroadcasts = 0;
+            Result pushResult = Result::Success;
+            while ((pushResult == Result::Success) && (numBroadcasts < 1024))
+            {
+                memcpy(&broadcast.payload[0], &numBroadcasts, sizeof(uint32));
+                pushResult = hostTransport.TransmitBroadcastMessage(broadcast);
+                numBroadcasts += (pushResult == Result::Success) ? 1 : 0;
+            }
+            DD_BENCH_CHECK((pushResult == Result::NotReady) && (numBroadcasts < 1024));
+
+            std::thread reader([&hostTransport]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                MessageBuffer message = {};
+                hostTransport.HostReadMessage(message, 0);
+            });
+            memcpy(&broadcast.payload[0], &numBroadcasts, sizeof(uint32));
+            DD_BENCH_CHECK(hostTransport.TransmitBroadcastMessage(broadcast) == Result::Success);
+            reader.join();
+            ++numBroadcasts;
+
+            uint32 numMismatches = 0;
+            MessageBuffer message = {};
+            for (uint32 index = 1; index < numBroadcasts; ++index)
+            {
+                uint32 value = 0;
+                const Result popResult = hostTransport.HostReadMessage(message, 0);
+                memcpy(&value, &message.payload[0], sizeof(uint32));
+                numMismatches += ((popResult != Result::Success) || (value != index)) ? 1 : 0;
+            }
+            DD_BENCH_CHECK(numMismatches == 0);
+            DD_BENCH_CHECK(hostTransport.HostReadMessage(message, 0) == Result::NotReady);
+
+            return result;
+        }
+    }
+}
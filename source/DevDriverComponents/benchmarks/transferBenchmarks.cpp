@@ -0,0 +1,305 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  transferBenchmarks.cpp
+* @brief Measures push and pull transfers between two endpoints of a loopback listener on every transport
+***********************************************************************************************************************
+*/
+
+#include "ddBenchmarks.h"
+#include "../listener/listenerCore.h"
+#include "ddTransferManager.h"
+#include "devDriverClient.h"
+#include "devDriverServer.h"
+#include "msgChannel.h"
+#include <cstdio>
+
+namespace DevDriver
+{
+    namespace Benchmarks
+    {
+        using namespace TransferProtocol;
+
+        DD_STATIC_CONST uint32 kTransferListenerPort = 27340;
+
+        // Block data repeats this pattern. The odd length keeps chunks from lining up with it.
+        DD_STATIC_CONST size_t kPatternSizeInBytes = ((1024 * 1024) + 13);
+
+        // A transport to measure, and whether the endpoint that owns the blocks is a driver
+        struct TransferLink
+        {
+            const char*   pName;
+            TransportType type;
+            bool          isDriver; // Drivers only connect over local transports
+        };
+
+        // Measurements of one direction and block size
+        struct TransferStats
+        {
+            uint64              bytesTransferred;
+            uint64              wallNs;
+            uint64              cpuNs;
+            std::vector<uint64> chunkNs;
+        };
+
+        // Calls func with the consecutive pieces of the pattern that make up a block of size bytes.
+        template <typename Func>
+        static void ForEachPatternRange(const std::vector<uint8>& pattern, size_t size, Func func)
+        {
+            size_t offset = 0;
+            while (offset < size)
+            {
+                const size_t patternOffset = (offset % kPatternSizeInBytes);
+                const size_t rangeSize = Platform::Min(kPatternSizeInBytes - patternOffset, size - offset);
+                func(pattern.data() + patternOffset, rangeSize);
+                offset += rangeSize;
+            }
+        }
+
+        // =============================================================================================================
+        static void PrintStats(const char* pLink, const char* pDirection, size_t blockSize, TransferStats* pStats)
+        {
+            const double megabytes = static_cast<double>(pStats->bytesTransferred) / (1024.0 * 1024.0);
+            printf("%-12s %-5s %10u %10.1f %12.3f %10.1f %10.1f\n",
+                   pLink,
+                   pDirection,
+                   static_cast<uint32>(blockSize),
+                   megabytes / (static_cast<double>(Platform::Max<uint64>(pStats->wallNs, 1)) / 1e9),
+                   (static_cast<double>(pStats->cpuNs) / 1e6) / megabytes,
+                   static_cast<double>(Percentile(&pStats->chunkNs, 50.0)) / 1000.0,
+                   static_cast<double>(Percentile(&pStats->chunkNs, 99.0)) / 1000.0);
+        }
+
+        // =============================================================================================================
+        Result RunTransferBenchmarks(const BenchmarkOptions &options)
+        {
+            Result result = Result::Success;
+            const AllocCb allocCb = GetAllocCb();
+
+            const TransferLink kLinks[] =
+            {
+                { "remote",      TransportType::Remote,      false },
+                { "localpacket", TransportType::LocalPacket, true  },
+                { "local",       TransportType::Local,       true  },
+            };
+
+            const size_t kQuickSizes[] = { 1024, 64 * 1024, 1024 * 1024 };
+            const size_t kFullSizes[] = { 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024, 64 * 1024 * 1024,
+                                          1024 * 1024 * 1024 };
+            const size_t* pSizes = options.quick ? kQuickSizes : kFullSizes;
+            const size_t numSizes = options.quick ? (sizeof(kQuickSizes) / sizeof(kQuickSizes[0]))
+                                                  : (sizeof(kFullSizes) / sizeof(kFullSizes[0]));
+
+            // Each size moves about this much data in total so small blocks get enough samples.
+            const uint64 targetBytes = options.quick ? (2ull * 1024 * 1024) : (256ull * 1024 * 1024);
+            const uint32 maxIterations = options.quick ? 4 : 64;
+
+            std::vector<uint8> pattern(kPatternSizeInBytes);
+            for (size_t index = 0; index < kPatternSizeInBytes; ++index)
+            {
+                pattern[index] = static_cast<uint8>((index * 131) + (index >> 13));
+            }
+
+            std::vector<uint8> chunk(kTransferChunkSizeInBytes);
+
+            ListenerCore listener;
+            DD_BENCH_CHECK(StartLoopbackListener(&listener, kTransferListenerPort, nullptr) == Result::Success);
+
+            // Cpu time covers the whole process: the listener and both endpoints.
+            printf("%-12s %-5s %10s %10s %12s %10s %10s\n",
+                   "transport", "dir", "size", "MB/s", "cpu ms/MB", "p50 us", "p99 us");
+
+            for (const TransferLink& link : kLinks)
+            {
+                const HostInfo hostInfo = GetLoopbackHostInfo(link.type, kTransferListenerPort);
+
+                // The endpoint that owns the blocks, either a driver or a tool.
+                DevDriverServer* pDriver = nullptr;
+                DevDriverClient* pOwnerClient = nullptr;
+                IMsgChannel* pOwnerChannel = nullptr;
+                if (link.isDriver)
+                {
+                    ServerCreateInfo serverInfo = {};
+                    serverInfo.componentType = Component::Driver;
+                    serverInfo.createUpdateThread = true;
+                    serverInfo.connectionInfo = hostInfo;
+                    Platform::Strncpy(serverInfo.clientDescription, "ddBenchmarks driver", sizeof(serverInfo.clientDescription));
+
+                    pDriver = new DevDriverServer(allocCb, serverInfo);
+                    DD_BENCH_CHECK(pDriver->Initialize() == Result::Success);
+                    pOwnerChannel = pDriver->GetMessageChannel();
+                }
+                else
+                {
+                    ClientCreateInfo ownerInfo = {};
+                    ownerInfo.componentType = Component::Tool;
+                    ownerInfo.createUpdateThread = true;
+                    ownerInfo.connectionInfo = hostInfo;
+                    Platform::Strncpy(ownerInfo.clientDescription, "ddBenchmarks owner", sizeof(ownerInfo.clientDescription));
+
+                    pOwnerClient = new DevDriverClient(allocCb, ownerInfo);
+                    DD_BENCH_CHECK(pOwnerClient->Initialize() == Result::Success);
+                    pOwnerChannel = pOwnerClient->GetMessageChannel();
+                }
+
+                ClientCreateInfo toolInfo = {};
+                toolInfo.componentType = Component::Tool;
+                toolInfo.createUpdateThread = true;
+                toolInfo.connectionInfo = hostInfo;
+                Platform::Strncpy(toolInfo.clientDescription, "ddBenchmarks tool", sizeof(toolInfo.clientDescription));
+
+                DevDriverClient tool(allocCb, toolInfo);
+                DD_BENCH_CHECK(tool.Initialize() == Result::Success);
+
+                if (result == Result::Success)
+                {
+                    TransferManager& ownerTransferManager = pOwnerChannel->GetTransferManager();
+                    TransferManager& toolTransferManager = tool.GetMessageChannel()->GetTransferManager();
+                    const ClientId ownerClientId = pOwnerChannel->GetClientId();
+
+                    for (size_t sizeIndex = 0; (sizeIndex < numSizes) && (result == Result::Success); ++sizeIndex)
+                    {
+                        const size_t blockSize = pSizes[sizeIndex];
+                        const uint32 numIterations =
+                            static_cast<uint32>(Platform::Min<uint64>(Platform::Max<uint64>(targetBytes / blockSize, 1),
+                                                                      maxIterations));
+
+                        uint32 expectedCrc = 0;
+                        ForEachPatternRange(pattern, blockSize, [&expectedCrc](const uint8* pData, size_t size)
+                        {
+                            expectedCrc = CRC32(pData, size, expectedCrc);
+                        });
+
+                        // Pull: the owner publishes a block and the tool reads it a chunk at a time.
+                        SharedPointer<ServerBlock> pBlock = ownerTransferManager.OpenServerBlock(ServerBlockStorage::Heap,
+                                                                                                 blockSize);
+                        ForEachPatternRange(pattern, blockSize, [&pBlock](const uint8* pData, size_t size)
+                        {
+                            pBlock->Write(pData, size);
+                        });
+                        pBlock->Close();
+
+                        TransferStats pullStats = {};
+                        for (uint32 iteration = 0; iteration < numIterations; ++iteration)
+                        {
+                            Stopwatch pullTimer;
+                            uint32 crc = 0;
+                            size_t totalBytesRead = 0;
+                            Result readResult = Result::Error;
+                            PullBlock* pPullBlock = toolTransferManager.OpenPullBlock(ownerClientId, pBlock->GetBlockId());
+                            if (pPullBlock != nullptr)
+                            {
+                                readResult = Result::Success;
+                                while (readResult == Result::Success)
+                                {
+                                    size_t bytesRead = 0;
+                                    const uint64 chunkStartNs = GetTimeInNs();
+                                    readResult = pPullBlock->Read(chunk.data(), chunk.size(), &bytesRead);
+                                    if (bytesRead > 0)
+                                    {
+                                        pullStats.chunkNs.push_back(GetTimeInNs() - chunkStartNs);
+                                    }
+                                    crc = CRC32(chunk.data(), bytesRead, crc);
+                                    totalBytesRead += bytesRead;
+                                }
+                                toolTransferManager.ClosePullBlock(&pPullBlock);
+                            }
+                            pullStats.wallNs += pullTimer.GetElapsedNs();
+                            pullStats.cpuNs += pullTimer.GetCpuTimeNs();
+                            pullStats.bytesTransferred += totalBytesRead;
+
+                            DD_BENCH_CHECK(readResult == Result::EndOfStream);
+                            DD_BENCH_CHECK((totalBytesRead == blockSize) && (crc == expectedCrc));
+                        }
+                        ownerTransferManager.CloseServerBlock(pBlock);
+                        PrintStats(link.pName, "pull", blockSize, &pullStats);
+
+                        // Push: the owner opens an empty block and the tool writes it a chunk at a time.
+                        TransferStats pushStats = {};
+                        for (uint32 iteration = 0; (iteration < numIterations) && (result == Result::Success); ++iteration)
+                        {
+                            SharedPointer<ServerBlock> pTarget = ownerTransferManager.OpenServerBlock(ServerBlockStorage::Heap,
+                                                                                                      blockSize);
+
+                            Stopwatch pushTimer;
+                            Result writeResult = Result::Error;
+                            size_t totalBytesWritten = 0;
+                            PushBlock* pPushBlock = toolTransferManager.OpenPushBlock(ownerClientId,
+                                                                                      pTarget->GetBlockId(),
+                                                                                      blockSize);
+                            if (pPushBlock != nullptr)
+                            {
+                                writeResult = Result::Success;
+                                ForEachPatternRange(pattern, blockSize, [&](const uint8* pData, size_t size)
+                                {
+                                    for (size_t offset = 0; (offset < size) && (writeResult == Result::Success);
+                                         offset += kTransferChunkSizeInBytes)
+                                    {
+                                        const size_t bytesToWrite = Platform::Min(kTransferChunkSizeInBytes, size - offset);
+                                        const uint64 chunkStartNs = GetTimeInNs();
+                                        writeResult = pPushBlock->Write(pData + offset, bytesToWrite);
+                                        pushStats.chunkNs.push_back(GetTimeInNs() - chunkStartNs);
+                                        totalBytesWritten += (writeResult == Result::Success) ? bytesToWrite : 0;
+                                    }
+                                });
+
+                                if (writeResult == Result::Success)
+                                {
+                                    writeResult = pPushBlock->Finalize();
+                                }
+                                toolTransferManager.ClosePushBlock(&pPushBlock);
+                            }
+                            pushStats.wallNs += pushTimer.GetElapsedNs();
+                            pushStats.cpuNs += pushTimer.GetCpuTimeNs();
+                            pushStats.bytesTransferred += totalBytesWritten;
+
+                            DD_BENCH_CHECK(writeResult == Result::Success);
+                            DD_BENCH_CHECK((pTarget->GetBlockDataSize() == blockSize) && (pTarget->GetCrc32() == expectedCrc));
+
+                            ownerTransferManager.CloseServerBlock(pTarget);
+                        }
+                        PrintStats(link.pName, "push", blockSize, &pushStats);
+                    }
+                }
+
+                tool.Destroy();
+                if (pDriver != nullptr)
+                {
+                    pDriver->Destroy();
+                    delete pDriver;
+                }
+                if (pOwnerClient != nullptr)
+                {
+                    pOwnerClient->Destroy();
+                    delete pOwnerClient;
+                }
+            }
+
+            listener.Destroy();
+
+            return result;
+        }
+    }
+}
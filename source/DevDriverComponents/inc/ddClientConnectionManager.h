@@ -0,0 +1,136 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddClientConnectionManager.h
+* @brief Class declaration for ClientConnectionManager
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "devDriverClient.h"
+#include "util/hashMap.h"
+#include "util/vector.h"
+
+namespace DevDriver
+{
+    // Connection manager creation info
+    struct ClientConnectionManagerCreateInfo
+    {
+        uint32 maxClientsPerTarget; // Protocol clients that may be connected to a single target at once.
+                                    // Zero means no limit. Individual targets can be changed with SetTargetQuota.
+    };
+
+    // Client Connection Manager
+    // Connects protocol clients to any number of targets through a single DevDriverClient. Every protocol client shares
+    // the client's message channel and update thread, so a tool that monitors many drivers keeps a constant thread
+    // count no matter how many targets it talks to. Protocol clients are pooled by the DevDriverClient and reused when
+    // they are disconnected. Each target can be given a quota that caps how many protocol clients connect to it.
+    class ClientConnectionManager
+    {
+    public:
+        ClientConnectionManager(const AllocCb&                           allocCb,
+                                DevDriverClient*                         pClient,
+                                const ClientConnectionManagerCreateInfo& createInfo);
+        ~ClientConnectionManager();
+
+        // Acquires a protocol client from the pool and connects it to the target
+        // Returns Rejected if the target's quota is already used up.
+        template <Protocol protocol>
+        Result ConnectProtocolClient(ClientId targetClientId, ProtocolClientType<protocol>** ppProtocolClient)
+        {
+            DD_ASSERT(ppProtocolClient != nullptr);
+
+            Result result = ReserveClient(targetClientId);
+            if (result == Result::Success)
+            {
+                ProtocolClientType<protocol>* pProtocolClient = m_pClient->AcquireProtocolClient<protocol>();
+                result = (pProtocolClient != nullptr) ? pProtocolClient->Connect(targetClientId)
+                                                      : Result::InsufficientMemory;
+
+                if (result == Result::Success)
+                {
+                    result = TrackClient(targetClientId, pProtocolClient);
+                }
+
+                if (result == Result::Success)
+                {
+                    *ppProtocolClient = pProtocolClient;
+                }
+                else
+                {
+                    m_pClient->ReleaseProtocolClient(pProtocolClient);
+                    CancelReservation(targetClientId);
+                }
+            }
+
+            return result;
+        }
+
+        // Disconnects a protocol client and returns it to the pool
+        void DisconnectProtocolClient(IProtocolClient* pProtocolClient);
+
+        // Disconnects every protocol client connected to a target, e.g. once the target has gone away
+        void DisconnectTarget(ClientId targetClientId);
+
+        // Disconnects every protocol client
+        void DisconnectAll();
+
+        // Sets how many protocol clients may be connected to a target at once. Zero means no limit.
+        // Clients that are already connected are not affected.
+        void SetTargetQuota(ClientId targetClientId, uint32 maxClients);
+
+        // Returns the number of protocol clients currently connected to a target
+        uint32 GetNumConnectedClients(ClientId targetClientId);
+
+        DevDriverClient* GetClient() const { return m_pClient; }
+
+    private:
+        // A protocol client that was handed out along with the target it was connected to
+        struct ClientLease
+        {
+            IProtocolClient* pProtocolClient;
+            ClientId         targetClientId;
+        };
+
+        // Connection accounting for a single target
+        struct TargetState
+        {
+            uint32 maxClients;
+            uint32 numClients; // Includes clients that are still connecting
+        };
+
+        Result ReserveClient(ClientId targetClientId);
+        void CancelReservation(ClientId targetClientId);
+        Result TrackClient(ClientId targetClientId, IProtocolClient* pProtocolClient);
+
+        AllocCb                                  m_allocCb;
+        DevDriverClient*                         m_pClient;
+        ClientConnectionManagerCreateInfo        m_createInfo;
+        Platform::Mutex                          m_mutex;
+        HashMap<ClientId, TargetState, 16>       m_targets;
+        Vector<ClientLease, 16>                  m_leases;
+    };
+} // DevDriver
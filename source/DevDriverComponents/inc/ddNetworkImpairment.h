@@ -0,0 +1,232 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddNetworkImpairment.h
+* @brief Class declarations for NetworkImpairment and ImpairmentQueue
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "gpuopen.h"
+#include "ddPlatform.h"
+#include "util/vector.h"
+
+namespace DevDriver
+{
+    // Describes how a simulated link impairs the messages sent over it.
+    // A zero initialized config leaves messages untouched.
+    struct NetworkImpairmentConfig
+    {
+        float  lossRatio;                 // Chance that a message starts a loss, between 0 and 1
+        uint32 lossBurstLength;           // Number of consecutive messages dropped by each loss. Zero is treated as one.
+        uint32 dropInterval;              // Additionally drops every Nth message. Zero disables it.
+        uint32 delayInMs;                 // Fixed delay added to every message
+        uint32 jitterInMs;                // Random extra delay of up to this many milliseconds per message
+        float  reorderRatio;              // Chance that a message is held back by reorderDelayInMs so later ones
+                                          // overtake it, between 0 and 1
+        uint32 reorderDelayInMs;          // Extra delay applied to reordered messages
+        float  duplicateRatio;            // Chance that a message is delivered twice, between 0 and 1
+        uint32 bandwidthInBytesPerSecond; // Link rate that messages are serialized at. Zero means unlimited.
+        uint32 seed;                      // Seed for the random number generator. The same seed and the same traffic
+                                          // produce the same impairments.
+    };
+
+    // Counters describing what an impairment did to the traffic it saw
+    struct NetworkImpairmentStats
+    {
+        uint64 messagesSubmitted;
+        uint64 messagesDropped;
+        uint64 messagesDuplicated;
+        uint64 messagesReordered;
+    };
+
+    // Network Impairment
+    // Decides the fate of every message sent over a simulated link: whether it is dropped or duplicated and when each
+    // copy is delivered. Transports use it together with an ImpairmentQueue to hold messages until their delivery
+    // time. The configuration can be changed at any time from any thread.
+    class NetworkImpairment
+    {
+    public:
+        // Upper bound on the number of copies Schedule can produce for one message
+        DD_STATIC_CONST uint32 kMaxCopies = 2;
+
+        NetworkImpairment();
+        explicit NetworkImpairment(const NetworkImpairmentConfig& config);
+        ~NetworkImpairment();
+
+        // Replaces the configuration. Also reseeds the random number generator and resets the loss pattern.
+        void SetConfig(const NetworkImpairmentConfig& config);
+        NetworkImpairmentConfig GetConfig() const;
+
+        // Returns true if the configuration changes messages in any way
+        bool IsEnabled() const;
+
+        // Schedules a message of messageSize bytes sent at currentTimeInMs. Writes the delivery time of each copy into
+        // pDeliveryTimesInMs, which must have room for kMaxCopies entries, and returns the number of copies.
+        // Zero means the message was dropped.
+        uint32 Schedule(size_t messageSize, uint64 currentTimeInMs, uint64* pDeliveryTimesInMs);
+
+        NetworkImpairmentStats GetStats() const;
+
+    private:
+        // Returns a uniformly distributed value in [0, 1)
+        float NextRandomFloat();
+        uint32 NextRandom();
+
+        mutable Platform::Mutex m_mutex;
+        NetworkImpairmentConfig m_config;
+        NetworkImpairmentStats  m_stats;
+        uint32                  m_randomState;
+        uint32                  m_burstRemaining;   // Messages left to drop in the current loss burst
+        uint64                  m_messageCount;     // Messages seen since the last configuration change
+        uint64                  m_linkFreeTimeInUs; // Time at which the simulated link finishes its last message
+    };
+
+    // Impairment Queue
+    // Holds impaired messages until their delivery time. Messages with the same delivery time come out in the order
+    // they were pushed. Not thread safe.
+    template <typename T>
+    class ImpairmentQueue
+    {
+    public:
+        explicit ImpairmentQueue(const AllocCb& allocCb)
+            : m_entries(allocCb)
+            , m_sequence(0)
+        {
+        }
+
+        bool Push(const T& value, uint64 deliveryTimeInMs)
+        {
+            Entry entry = {};
+            entry.value = value;
+            entry.deliveryTimeInMs = deliveryTimeInMs;
+            entry.sequence = m_sequence++;
+
+            const bool pushed = m_entries.PushBack(entry);
+            if (pushed)
+            {
+                // Sift the new entry up the heap
+                size_t index = (m_entries.Size() - 1);
+                while ((index > 0) && IsEarlier(m_entries[index], m_entries[(index - 1) / 2]))
+                {
+                    SwapEntries(index, (index - 1) / 2);
+                    index = (index - 1) / 2;
+                }
+            }
+
+            return pushed;
+        }
+
+        // Removes the earliest message if its delivery time has been reached
+        bool PopDue(uint64 currentTimeInMs, T* pValue)
+        {
+            DD_ASSERT(pValue != nullptr);
+
+            bool popped = false;
+            if ((m_entries.IsEmpty() == false) && (m_entries[0].deliveryTimeInMs <= currentTimeInMs))
+            {
+                *pValue = m_entries[0].value;
+
+                Entry last = {};
+                m_entries.PopBack(&last);
+                if (m_entries.IsEmpty() == false)
+                {
+                    // Move the last entry to the root and sift it down the heap
+                    m_entries[0] = last;
+
+                    const size_t size = m_entries.Size();
+                    size_t index = 0;
+                    while (true)
+                    {
+                        const size_t left = (2 * index) + 1;
+                        const size_t right = left + 1;
+                        size_t earliest = index;
+                        if ((left < size) && IsEarlier(m_entries[left], m_entries[earliest]))
+                        {
+                            earliest = left;
+                        }
+                        if ((right < size) && IsEarlier(m_entries[right], m_entries[earliest]))
+                        {
+                            earliest = right;
+                        }
+                        if (earliest == index)
+                        {
+                            break;
+                        }
+                        SwapEntries(index, earliest);
+                        index = earliest;
+                    }
+                }
+
+                popped = true;
+            }
+
+            return popped;
+        }
+
+        // Returns the number of milliseconds until the earliest message is due, or kInfiniteTimeout if empty
+        uint32 GetTimeUntilDue(uint64 currentTimeInMs) const
+        {
+            uint32 timeInMs = kInfiniteTimeout;
+            if (m_entries.IsEmpty() == false)
+            {
+                const uint64 deliveryTimeInMs = m_entries[0].deliveryTimeInMs;
+                timeInMs = (deliveryTimeInMs > currentTimeInMs)
+                    ? static_cast<uint32>(Platform::Min<uint64>(deliveryTimeInMs - currentTimeInMs, kInfiniteTimeout - 1))
+                    : 0;
+            }
+            return timeInMs;
+        }
+
+        size_t Size() const { return m_entries.Size(); }
+        bool IsEmpty() const { return m_entries.IsEmpty(); }
+        void Clear() { m_entries.Clear(); }
+
+    private:
+        struct Entry
+        {
+            T      value;
+            uint64 deliveryTimeInMs;
+            uint64 sequence;
+        };
+
+        static bool IsEarlier(const Entry& lhs, const Entry& rhs)
+        {
+            return (lhs.deliveryTimeInMs < rhs.deliveryTimeInMs) ||
+                   ((lhs.deliveryTimeInMs == rhs.deliveryTimeInMs) && (lhs.sequence < rhs.sequence));
+        }
+
+        void SwapEntries(size_t lhs, size_t rhs)
+        {
+            const Entry temp = m_entries[lhs];
+            m_entries[lhs] = m_entries[rhs];
+            m_entries[rhs] = temp;
+        }
+
+        Vector<Entry, 8> m_entries;
+        uint64           m_sequence;
+    };
+} // DevDriver
@@ -47,6 +47,11 @@ namespace DevDriver
     {
         class TransferManager;
         class TransferServer;
+        class ParallelPull;
+        class CompressedPull;
+        class PipelinedPush;
+        class CachedPull;
+        class PullContentCache;
 
         // Size of an individual "chunk" within a transfer operation.
         static const size_t kTransferChunkSizeInBytes = 4096;
@@ -57,6 +62,14 @@ namespace DevDriver
             uint8 Data[kTransferChunkSizeInBytes];
         };
 
+        // Where a server block keeps its data
+        enum class ServerBlockStorage : uint32
+        {
+            Heap = 0, // Memory from the block's allocator
+            File,     // Temporary files mapped into memory, for very large blocks. Falls back to the heap if the
+                      // files can't be created.
+        };
+
         // Base class for transfer blocks.
         // A "block" is a binary blob of data associated with a unique id. Blocks can be created locally via the
         // transfer manager's OpenServerBlock function. Once a server block is closed, it can be accessed remotely
@@ -83,19 +96,33 @@ namespace DevDriver
         // A server transfer block.
         // Only supports writes and must be closed before the data can be accessed.
         // Writes can only be performed on blocks that have not been closed.
+        // Data is stored in a list of separately allocated segments so growing a block never moves or copies the data
+        // that has already been written.
         class ServerBlock final : public TransferBlock
         {
             friend class TransferServer;
+            friend class TransferManager;
         public:
-            explicit ServerBlock(const AllocCb& allocCb, BlockId blockId)
+            explicit ServerBlock(const AllocCb&     allocCb,
+                                 BlockId            blockId,
+                                 ServerBlockStorage storage = ServerBlockStorage::Heap)
                 : TransferBlock(blockId)
+                , m_allocCb(allocCb)
+                , m_storage(storage)
                 , m_isClosed(false)
-                , m_chunks(allocCb)
+                , m_segments(allocCb)
+                , m_capacity(0)
+                , m_writeSegmentIndex(0)
                 , m_numPendingTransfers(0)
                 , m_transfersCompletedEvent(true)
                 , m_crc32(0)
+                , m_pushGeneration(0)
+                , m_hasContentHash(false)
+                , m_contentHash()
                 {}
 
+            ~ServerBlock();
+
             // Writes numBytes bytes from pSrcBuffer into the block.
             void Write(const void* pSrcBuffer, size_t numBytes);
 
@@ -108,11 +135,26 @@ namespace DevDriver
             // Returns true if this block has been closed.
             bool IsClosed() const { return m_isClosed; }
 
+            // Returns where the block keeps its data.
+            ServerBlockStorage GetStorage() const { return m_storage; }
+
+#if !DD_VERSION_SUPPORTS(GPUOPEN_SEGMENTED_SERVER_BLOCKS_VERSION)
             // Returns a const pointer to the underlying data contained within the block, or null if it contains
-            // no data.
-            const uint8* GetBlockData() const {
-                return (m_blockDataSize > 0) ? reinterpret_cast<const uint8*>(m_chunks.Data()) : nullptr;
+            // no data or if the data spans more than one storage segment. Use Read to access any block.
+            const uint8* GetBlockData() const
+            {
+                return ((m_blockDataSize > 0) && (m_blockDataSize <= m_segments[0].size)) ? m_segments[0].pData
+                                                                                           : nullptr;
             }
+#endif
+
+            // Copies up to numBytes bytes starting at offset into pDstBuffer, gathering them from as many storage
+            // segments as necessary. Returns the number of bytes copied.
+            // The data isn't guaranteed to be contiguous, so this is the only way to access all of it.
+            size_t Read(size_t offset, void* pDstBuffer, size_t numBytes) const;
+
+            // Returns the CRC32 of up to numBytes bytes starting at offset, continuing from the CRC passed in crc32.
+            uint32 CalculateCrc32(size_t offset, size_t numBytes, uint32 crc32) const;
 
             // Returns a boolean indicating whether the block has any transfers in progress.
             bool HasPendingTransfers();
@@ -124,27 +166,70 @@ namespace DevDriver
             uint32 GetCrc32() const { return m_crc32; };
 
             // Reserves at least the specified number of bytes in the internal storage.
+            // Reserving storage for an empty block makes its storage contiguous.
             void Reserve(size_t bytes);
 
+            // Returns the MetroHash128 of the block data. It's calculated by the first hashed pull, so writes don't pay
+            // for it, and kept until the block is reset. Only valid for closed blocks.
+            TransferContentHash GetContentHash();
+
         private:
+            // A separately allocated range of block storage
+            struct Segment
+            {
+                uint8* pData;        // Storage for the segment
+                size_t offset;       // Offset of the segment's first byte within the block
+                size_t size;         // Size of the segment's storage in bytes
+                bool   isFileBacked; // True if pData is a file mapping rather than a heap allocation
+            };
+
+            // Segments grow with the block until they reach this size. Larger writes get a segment of their own size.
+            DD_STATIC_CONST size_t kMaxSegmentGrowthInBytes = (256 * kTransferChunkSizeInBytes);
+
+            // File backed segments each map their own file, so they start and grow larger to keep their number low.
+            DD_STATIC_CONST size_t kMinFileSegmentSizeInBytes = (1024 * 1024);
+            DD_STATIC_CONST size_t kMaxFileSegmentGrowthInBytes = (64 * 1024 * 1024);
+
             // Notifies the block that a new transfer has begun.
             void BeginTransfer();
 
             // Notifies the block that an existing transfer has ended.
             void EndTransfer();
 
+            // Returns the index of the segment that holds the byte at offset.
+            size_t FindSegment(size_t offset) const;
+
+            // Appends a segment that can hold at least minBytes bytes.
+            bool AddSegment(size_t minBytes);
+
+            // Frees the storage of a single segment.
+            void FreeSegment(const Segment& segment);
+
+            // Frees all segments.
+            void ReleaseSegments();
+
+            AllocCb               m_allocCb;                 // Allocator used for segment storage
+            ServerBlockStorage    m_storage;                 // Where new segments are allocated
             bool                  m_isClosed;                // A bool that indicates if the block is closed
-            Vector<TransferChunk> m_chunks;                  // A list of transfer chunks used to store data
+            Vector<Segment>       m_segments;                // The segments that store the block data, in block order
+            size_t                m_capacity;                // Combined size of all segments in bytes
+            size_t                m_writeSegmentIndex;       // Index of the segment that the next write starts in
             Platform::Mutex       m_pendingTransfersMutex;   // A mutex used to control access to the pending transfers counter
             uint32                m_numPendingTransfers;     // A counter used to track the number of pending transfers
             Platform::Event       m_transfersCompletedEvent; // An event that is signaled when all pendings transfers are completed
             uint32                m_crc32;                   // CRC covering all data stored in this block
+            uint32                m_pushGeneration;          // Identifies the push transfer allowed to write the block.
+                                                             // A resumed push takes over from an interrupted one.
+            Platform::Mutex       m_contentHashMutex;        // Guards the content hash against concurrent hashed pulls
+            bool                  m_hasContentHash;          // Set once m_contentHash has been calculated
+            TransferContentHash   m_contentHash;             // MetroHash128 of the block data
         };
 
         // Backwards compatibility type alias. This will be removed with a future interface version change.
         using LocalBlock = ServerBlock;
 
         // A transfer block for reading data from a remote client.
+        // Blocks opened with more than one stream pull disjoint ranges of the block over several sessions at once.
         class PullBlock final : public TransferBlock
         {
             friend class TransferManager;
@@ -153,16 +238,36 @@ namespace DevDriver
             // Returns the number of bytes read in pBytesRead.
             Result Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead);
 
+            // Continues a pull that failed because its session was lost. Reads pick up where they stopped.
+            // Parallel pulls only restart the streams that have failed so far. Another stream can still fail once it
+            // notices the loss, so it's worth resuming again as long as reads make progress.
+            // Returns Unavailable for compressed pulls, which can't be resumed.
+            Result Resume();
+
         private:
-            explicit PullBlock(IMsgChannel* pMsgChannel, BlockId blockId)
+            explicit PullBlock(IMsgChannel* pMsgChannel, ClientId clientId, BlockId blockId)
                 : TransferBlock(blockId)
                 , m_transferClient(pMsgChannel)
+                , m_pParallelPull(nullptr)
+                , m_pCompressedPull(nullptr)
+                , m_pCachedPull(nullptr)
+                , m_clientId(clientId)
+                , m_isEmptyRange(false)
             {}
 
-            TransferClient m_transferClient;
+            TransferClient  m_transferClient;
+            ParallelPull*   m_pParallelPull;   // Set when the block is being pulled over several streams
+            CompressedPull* m_pCompressedPull; // Set when the block is being pulled in compressed form
+            CachedPull*     m_pCachedPull;     // Set when the block may be read from the pull content cache
+            ClientId        m_clientId;        // Client that exposes the block
+            bool            m_isEmptyRange;    // Set when the block was opened at the end of the remote block, until
+                                               // Read has reported the end of it
         };
 
         // A transfer block for sending data to a remote server block
+        // Blocks opened with a send queue are pipelined: Write returns once the data is queued and a background thread
+        // sends it, so errors are reported by a later Write or by the finalize. Pipelined blocks must only be used from
+        // one thread at a time.
         class PushBlock final : public TransferBlock
         {
             friend class TransferManager;
@@ -173,15 +278,35 @@ namespace DevDriver
             // Closes the block, telling the server to save the data already transfered.
             Result Finalize();
 
+            // Starts closing the block like Finalize without waiting for the server to confirm it. Pipelined blocks
+            // send any queued data first. Use WaitForFinalize to get the result.
+            Result BeginFinalize();
+
+            // Waits for a finalize started with BeginFinalize. Returns NotReady if it's still in progress when the
+            // timeout expires, or the result of the finalize otherwise.
+            Result WaitForFinalize(uint32 timeoutInMs);
+
             // Closes the block, telling the server to discard any data already transfered.
             Result Discard();
+
+            // Continues a push that failed because its session was lost. Returns the offset of the source data that
+            // writing must continue from in pOffsetInBytes. Any data still queued is dropped.
+            Result Resume(size_t* pOffsetInBytes);
         private:
-            explicit PushBlock(IMsgChannel* pMsgChannel, BlockId blockId)
+            explicit PushBlock(IMsgChannel* pMsgChannel, ClientId clientId, BlockId blockId)
                 : TransferBlock(blockId)
                 , m_transferClient(pMsgChannel)
+                , m_pPipelinedPush(nullptr)
+                , m_clientId(clientId)
+                , m_finalizeResult(Result::Error)
+                , m_isFinalizing(false)
             {}
 
             TransferClient m_transferClient;
+            PipelinedPush* m_pPipelinedPush; // Set when the block sends from a queue on its own thread
+            ClientId       m_clientId;       // Client that exposes the block
+            Result         m_finalizeResult; // Result of BeginFinalize on blocks that aren't pipelined
+            bool           m_isFinalizing;   // Set by BeginFinalize on blocks that aren't pipelined
         };
 
         // Transfer manager class.
@@ -198,20 +323,70 @@ namespace DevDriver
             // Returns a shared pointer to a server block or nullptr in the case of an error.
             // Shared pointers are always used with server blocks to make sure they aren't destroyed
             // while a remote download is in progress.
-            SharedPointer<ServerBlock> OpenServerBlock();
+            // File storage keeps very large blocks out of the heap, see ServerBlockStorage.
+            // Released blocks are reused when possible. The smallest idle block with at least sizeHintInBytes of
+            // storage is picked, and new blocks reserve that much storage up front.
+            SharedPointer<ServerBlock> OpenServerBlock(ServerBlockStorage storage         = ServerBlockStorage::Heap,
+                                                       size_t             sizeHintInBytes = 0);
 
             // Returns a shared pointer to a server block matching the requested block ID, or nullptr if it does
             // not exist.
+            // Safe to call from any thread. Lookups only lock the part of the registry that holds the block.
             SharedPointer<ServerBlock> GetServerBlock(BlockId serverBlockId);
 
-            // Releases a server block. This prevents new remote transfer requests from succeeding.
+            // Releases a server block. This prevents new remote transfer requests from succeeding, immediately unless
+            // a server block retention time has been set.
             // This will clear the server block pointer inside the shared pointer object.
             void CloseServerBlock(SharedPointer<ServerBlock>& pBlock);
 
+            // Sets how long server blocks remain available to remote clients after they're closed, so interrupted
+            // transfers can be resumed. Zero, the default, releases blocks immediately.
+            void SetServerBlockRetentionTime(uint32 retentionTimeInMs);
+
+            // Releases retained server blocks whose retention time has passed. Called periodically by the message
+            // channel so retained blocks don't outlive their retention time on an idle server.
+            void Update();
+
+            // Sets how much storage released server blocks may keep for reuse. Idle blocks are freed, largest first,
+            // until they fit in the new budget. Zero disables reuse.
+            void SetIdleServerBlockBudget(size_t budgetInBytes);
+
             // Attempts to open a block exposed by a remote client over the message bus.
             // Returns a valid PullBlock pointer on success and nullptr on failure.
             PullBlock* OpenPullBlock(ClientId clientId, BlockId blockId);
 
+            // Attempts to open a block exposed by a remote client over the message bus, pulling it over up to
+            // numStreams sessions in parallel. Each stream stages the range it's pulling in a buffer of at most 4 MB,
+            // so memory use doesn't grow with the block size.
+            // Falls back to a single stream for small blocks or servers that don't support ranged transfers.
+            // Returns a valid PullBlock pointer on success and nullptr on failure.
+            PullBlock* OpenPullBlock(ClientId clientId, BlockId blockId, uint32 numStreams);
+
+            // Attempts to open a block exposed by a remote client over the message bus, starting at offsetInBytes.
+            // Used to continue a pull from data that was saved before the original transfer was lost.
+            // GetBlockDataSize on the returned block reports the size of the data after the offset. Opening a block
+            // at its end gives an empty block, and offsets past the end return nullptr.
+            // Offsets above UINT32_MAX can't be requested and return nullptr.
+            // Returns a valid PullBlock pointer on success and nullptr on failure.
+            PullBlock* OpenPullBlockAtOffset(ClientId clientId, BlockId blockId, size_t offsetInBytes);
+
+            // Attempts to open a block exposed by a remote client over the message bus, asking the server to send it
+            // compressed. Reads return the decoded block data and GetBlockDataSize reports the decoded size.
+            // Falls back to an uncompressed pull for small blocks or servers that don't support it.
+            // Returns a valid PullBlock pointer on success and nullptr on failure.
+            PullBlock* OpenCompressedPullBlock(ClientId clientId, BlockId blockId);
+
+            // Attempts to open a block exposed by a remote client over the message bus, skipping the transfer of its
+            // data if it matches the content hash of a block pulled earlier. Blocks pulled this way are kept in a
+            // content cache, see SetPullContentCacheBudget. Falls back to a normal pull if the server doesn't report
+            // content hashes.
+            // Returns a valid PullBlock pointer on success and nullptr on failure.
+            PullBlock* OpenCachedPullBlock(ClientId clientId, BlockId blockId);
+
+            // Sets how much data blocks opened with OpenCachedPullBlock may keep in the content cache. The least
+            // recently used data is evicted first. Zero disables the cache.
+            void SetPullContentCacheBudget(size_t budgetInBytes);
+
             // Closes a pull block and deletes the underlying resources.
             // This will null out the pull block pointer that is passed in as ppBlock.
             void ClosePullBlock(PullBlock** ppBlock);
@@ -220,6 +395,12 @@ namespace DevDriver
             // Returns a valid PushBlock pointer on success and nullptr on failure.
             PushBlock* OpenPushBlock(ClientId clientId, BlockId blockId, size_t blockSize);
 
+            // Attempts to open a block exposed by a remote client over the message bus for pipelined writes.
+            // Writes are copied into a send queue of sendQueueSizeInBytes bytes and sent on a background thread, so
+            // the caller only waits when the queue is full.
+            // Returns a valid PushBlock pointer on success and nullptr on failure.
+            PushBlock* OpenPushBlock(ClientId clientId, BlockId blockId, size_t blockSize, size_t sendQueueSizeInBytes);
+
             // Closes a push block and deletes the underlying resources.
             // This will null out the push block pointer that is passed in as ppBlock.
             void ClosePushBlock(PushBlock** ppBlock);
@@ -237,18 +418,96 @@ namespace DevDriver
             }
 
         private:
+            // A closed server block that remains registered until its retention time passes
+            struct RetainedServerBlock
+            {
+                BlockId blockId;
+                uint64  expirationTimeInMs;
+            };
+
+            // A server block that's available to remote clients
+            struct RegisteredServerBlock
+            {
+                explicit RegisteredServerBlock(const SharedPointer<ServerBlock>& pServerBlock)
+                    : pBlock(pServerBlock)
+                    , expirationTimeInMs(0)
+                {}
+
+                SharedPointer<ServerBlock> pBlock;
+                uint64                     expirationTimeInMs; // When a closed block stops being available, or zero
+                                                               // while the block is open
+            };
+
+            // One part of the server block registry. Blocks are spread across the shards by id so lookups of
+            // different blocks don't wait on each other.
+            struct RegistryShard
+            {
+                explicit RegistryShard(const AllocCb& allocCb)
+                    : mutex()
+                    , blocks(allocCb)
+                {}
+
+                Platform::Mutex                              mutex;
+                HashMap<BlockId, RegisteredServerBlock, 16> blocks;
+            };
+
+            // A released server block kept for reuse
+            struct IdleServerBlock
+            {
+                // Removes the block from the pool by moving idleBlock into its place.
+                void Replace(IdleServerBlock& idleBlock)
+                {
+                    pBlock = idleBlock.pBlock;
+                    sizeClass = idleBlock.sizeClass;
+                    idleBlock.pBlock.Clear();
+                }
+
+                SharedPointer<ServerBlock> pBlock;
+                uint32                     sizeClass; // Log2 of the block's capacity, rounded down
+            };
+
+            // Returns the registry shard that holds the block with the specified id.
+            RegistryShard& GetRegistryShard(BlockId blockId) { return m_pRegistryShards[blockId % kNumRegistryShards]; }
+
+            // Removes a block from the registry and returns it, or an empty pointer if it isn't registered.
+            SharedPointer<ServerBlock> UnregisterServerBlock(BlockId blockId);
+
+            // Unregisters retained server blocks whose retention time has passed. Must be called with m_mutex held.
+            void ReleaseExpiredServerBlocks();
+
+            // Keeps an unregistered block for reuse if nothing else references it and it fits in the idle block
+            // budget. Clears pBlock either way. Must be called with m_mutex held.
+            void RecycleServerBlock(SharedPointer<ServerBlock>& pBlock);
+
+            // Frees idle blocks, largest first, until the idle blocks use at most budgetInBytes bytes and there is
+            // room for numFreeSlots more of them. Must be called with m_mutex held.
+            void TrimIdleServerBlocks(size_t budgetInBytes, size_t numFreeSlots);
+
             IMsgChannel*     m_pMessageChannel;
             SessionManager*  m_pSessionManager;
             TransferServer*  m_pTransferServer;
             AllocCb          m_allocCb;
             Platform::Random m_rng;
-            Platform::Mutex  m_mutex;
+            Platform::Mutex  m_mutex;          // Guards everything below except the registry shards
 
-            // A list of all the server blocks that are currently available to the TransferManager.
-            HashMap<BlockId, SharedPointer<ServerBlock>, 16> m_registeredServerBlocks;
-            Queue<SharedPointer<ServerBlock>>                m_idleBlocks;
+            // All the server blocks that are currently available to the TransferManager, split into
+            // kNumRegistryShards shards that each have their own lock.
+            RegistryShard*             m_pRegistryShards;
+            PullContentCache*          m_pPullContentCache; // Data of blocks opened with OpenCachedPullBlock
+
+            DD_STATIC_CONST size_t kNumRegistryShards = 16;
 
             DD_STATIC_CONST size_t kMaxCachedIdleBlocks = 16;
+            DD_STATIC_CONST size_t kDefaultIdleBlockBudgetInBytes = (32 * 1024 * 1024);
+
+            IdleServerBlock            m_idleBlocks[kMaxCachedIdleBlocks];
+            size_t                     m_numIdleBlocks;
+            size_t                     m_idleBlockSizeInBytes;   // Total capacity of the idle blocks
+            size_t                     m_idleBlockBudgetInBytes;
+            Queue<RetainedServerBlock> m_retainedServerBlocks;
+            uint32                     m_serverBlockRetentionTimeInMs;
+
+            DD_STATIC_CONST uint32 kDefaultServerBlockRetentionTimeInMs = 0;
         };
     } // TransferProtocol
 } // DevDriver
@@ -43,6 +43,7 @@ namespace DevDriver
 {
     class IMsgChannel;
     class IProtocolClient;
+    class NetworkImpairment;
 
     // Client Creation Info
     // This struct extends the MessageChannelCreateInfo struct and adds information about the destination host
@@ -51,6 +52,9 @@ namespace DevDriver
     {
         HostInfo                 connectionInfo;    // Connection information describing how the Server should connect
                                                     // to the message bus.
+        NetworkImpairment*       pNetworkImpairment; // Optional impairment applied to every message the client sends.
+                                                     // Used to test behavior on lossy or slow links. Must outlive the
+                                                     // client.
     };
 
 #if !DD_VERSION_SUPPORTS(GPUOPEN_CREATE_INFO_CLEANUP_VERSION)
@@ -24,7 +24,7 @@
 
 #pragma once
 
-#define GPUOPEN_INTERFACE_MAJOR_VERSION 36
+#define GPUOPEN_INTERFACE_MAJOR_VERSION 37
 
 #define GPUOPEN_INTERFACE_MINOR_VERSION 0
 
@@ -44,6 +44,8 @@ static_assert((GPUOPEN_CLIENT_INTERFACE_MAJOR_VERSION >= GPUOPEN_MINIMUM_INTERFA
 ***********************************************************************************************************************
 *| Version | Change Description                                                                                       |
 *| ------- | ---------------------------------------------------------------------------------------------------------|
+*| 37.0    | Removed ServerBlock::GetBlockData. Server blocks keep their data in segments, so it's read with          |
+*|         | ServerBlock::Read instead.                                                                               |
 *| 36.0    | Added support for capturing the RGP trace on specific frame or dispatch.                                 |
 *|         | Added bitfield to control whether driver internal code objects are included in the code object database. |
 *| 35.0    | Updated Settings URI enum SettingType to avoid X11 macro name collision.                                 |
@@ -142,6 +144,7 @@ static_assert((GPUOPEN_CLIENT_INTERFACE_MAJOR_VERSION >= GPUOPEN_MINIMUM_INTERFA
 ***********************************************************************************************************************
 */
 
+#define GPUOPEN_SEGMENTED_SERVER_BLOCKS_VERSION 37
 #define GPUOPEN_SETTINGS_URI_LINUX_BUILD 35
 #define GPUOPEN_VERSIONED_URI_SERVICES_VERSION 34
 #define GPUOPEN_URIINTERFACE_CLEANUP_VERSION 33
@@ -475,6 +478,8 @@ namespace DevDriver
     {
         Local = 0,
         Remote,
+        RemoteStream,   // Remote connection over a reliable stream (TCP) instead of datagrams
+        LocalPacket,    // Local connection over a connection oriented packet socket instead of datagrams (Linux only)
     };
 
     // Struct used to designate a transport type, port number, and hostname
@@ -506,6 +511,15 @@ namespace DevDriver
 
     };
 
+    // Default local packet socket information
+    // Each client gets its own connection so disconnects are seen immediately instead of through ping timeouts.
+    DD_STATIC_CONST HostInfo kDefaultLocalPacketSocket =
+    {
+        TransportType::LocalPacket,
+        0,
+        "\\\\.\\pipe\\AMD-Developer-Service-Packet"
+    };
+
     ////////////////////////////
     // Common definition of a message header
     //
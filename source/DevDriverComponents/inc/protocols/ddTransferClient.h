@@ -50,12 +50,54 @@ namespace DevDriver
             // pTransferSizeInBytes.
             Result RequestPullTransfer(BlockId blockId, size_t* pTransferSizeInBytes);
 
+            // Requests a pull transfer of the byte range [offsetInBytes, offsetInBytes + sizeInBytes) of a block.
+            // The range is clamped to the end of the block, the clamped size is returned in pTransferSizeInBytes and
+            // the size of the whole block in pBlockSizeInBytes. A zero sized range only queries the block size and
+            // leaves no transfer in progress. Returns Unavailable if the server does not support ranged transfers.
+            // Returns Error if the offset or size doesn't fit into 32 bits.
+            Result RequestRangedPullTransfer(BlockId blockId,
+                                             size_t  offsetInBytes,
+                                             size_t  sizeInBytes,
+                                             size_t* pTransferSizeInBytes,
+                                             size_t* pBlockSizeInBytes);
+
+            // Requests a pull transfer of a whole block encoded with the requested compression. Returns the size of
+            // the decoded block in pBlockSizeInBytes and the compression the server applied in pCompression. Encoded
+            // data is streamed, so pTransferSizeInBytes is zero and reads return EndOfStream once the sentinel
+            // arrives. An empty read checks for it after the last frame. The server sends the raw block data and
+            // reports TransferCompression::None, with its size in pTransferSizeInBytes, for blocks too small to
+            // compress. Returns Unavailable if the server does not support compressed transfers.
+            Result RequestCompressedPullTransfer(BlockId              blockId,
+                                                 TransferCompression  compression,
+                                                 size_t*              pTransferSizeInBytes,
+                                                 size_t*              pBlockSizeInBytes,
+                                                 TransferCompression* pCompression);
+
+            // Requests a pull transfer of a whole block that first reports the block's content hash in pContentHash,
+            // so a caller that already has the data can skip it. The transfer waits for ContinueHashedPullTransfer
+            // before any data is sent. Returns the size of the block in pTransferSizeInBytes. Returns Unavailable if
+            // the server does not support hashed transfers.
+            Result RequestHashedPullTransfer(BlockId              blockId,
+                                             size_t*              pTransferSizeInBytes,
+                                             TransferContentHash* pContentHash);
+
+            // Continues a transfer started by RequestHashedPullTransfer. The block data can then be read as for any
+            // other pull, or the transfer ends right away without sending it if skipData is true or the block is
+            // empty.
+            Result ContinueHashedPullTransfer(bool skipData);
+
             // Reads transfer data from a previous transfer that completed successfully.
             Result ReadPullTransferData(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead);
 
             // Aborts a pull transfer in progress.
             Result AbortPullTransfer();
 
+            // Resumes a pull transfer that was interrupted, usually by the loss of its session. Reconnects to
+            // clientId and requests the rest of the transfer from the last byte received. Data that was received but
+            // not read yet is kept, and the final CRC check still covers the whole transfer. Returns Unavailable if
+            // the server does not support resuming transfers or the transfer is receiving compressed data.
+            Result ResumePullTransfer(ClientId clientId);
+
             // Requests a transfer on the remote client. Returns Success if the request was successful and data
             // can be written to the server.
             Result RequestPushTransfer(BlockId blockId, size_t transferSizeInBytes);
@@ -66,6 +108,30 @@ namespace DevDriver
             // Closes the push transfer session, optionally discarding any data already transmitted
             Result ClosePushTransfer(bool discard = false);
 
+            // Resumes a push transfer that was interrupted, usually by the loss of its session. Reconnects to
+            // clientId and returns the number of bytes the server already holds in pOffsetInBytes. Writing must
+            // continue from that offset of the source data. Returns Unavailable if the server does not support
+            // resuming transfers.
+            Result ResumePushTransfer(ClientId clientId, size_t* pOffsetInBytes);
+
+            // Returns true if the connected server supports ranged pull transfers.
+            bool SupportsRangedPull() const
+            {
+                return IsConnected() && (m_pSession->GetVersion() >= TRANSFER_RANGED_PULL_VERSION);
+            }
+
+            // Returns true if the connected server supports compressed pull transfers.
+            bool SupportsCompressedPull() const
+            {
+                return IsConnected() && (m_pSession->GetVersion() >= TRANSFER_COMPRESSION_VERSION);
+            }
+
+            // Returns true if the connected server supports hashed pull transfers.
+            bool SupportsHashedPull() const
+            {
+                return IsConnected() && (m_pSession->GetVersion() >= TRANSFER_CONTENT_HASH_VERSION);
+            }
+
             // Returns true if there's currently a transfer in progress.
             bool IsTransferInProgress() const
             {
@@ -86,6 +152,27 @@ namespace DevDriver
         private:
             void ResetState() override;
 
+            // Sets up the transfer context for a pull transfer of totalBytes bytes starting at offset in the block.
+            void BeginPullTransfer(BlockId blockId, uint32 offset, uint32 totalBytes);
+
+            // Receives the sentinel at the end of a pull transfer and verifies the transfer CRC.
+            Result ReceivePullSentinel();
+
+            // Verifies a sentinel received at the end of a pull transfer. Fails the transfer if it reports an error
+            // or its CRC doesn't match.
+            void CheckPullSentinel(const TransferDataSentinel& sentinel);
+
+            // Receives the next chunk of a pull transfer into the scratch payload. Streamed transfers end with the
+            // sentinel instead, which returns EndOfStream.
+            Result ReceivePullChunk();
+
+            // Requests the pull of a block range and waits for the header that accepts it.
+            Result SendRangedPullRequest(BlockId                   blockId,
+                                         uint32                    offset,
+                                         uint32                    size,
+                                         uint32                    crcOffset,
+                                         TransferRangedDataHeader* pHeader);
+
             // Helper method to send a payload, handling backwards compatibility and retrying.
             Result SendTransferPayload(const SizedPayloadContainer& container,
                                        uint32                       timeoutInMs = kDefaultCommunicationTimeoutInMs,
@@ -103,6 +190,7 @@ namespace DevDriver
             {
                 Idle = 0,
                 TransferInProgress,
+                WaitingForContinue, // A hashed pull transfer reported its hash and waits to continue
                 Error
             };
 
@@ -111,6 +199,9 @@ namespace DevDriver
             {
                 TransferState state;
                 TransferType  type;
+                BlockId blockId;
+                uint32 crcOffset;  // Offset of the first byte covered by the transfer CRC
+                uint32 endOffset;  // Offset one past the last byte of the transfer
                 uint32 totalBytes;
                 uint32 crc32;
                 size_t dataChunkSizeInBytes;
@@ -40,7 +40,7 @@
 ***********************************************************************************************************************
 */
 
-#define TRANSFER_PROTOCOL_MAJOR_VERSION 2
+#define TRANSFER_PROTOCOL_MAJOR_VERSION 6
 #define TRANSFER_PROTOCOL_MINOR_VERSION 0
 
 #define TRANSFER_INTERFACE_VERSION ((TRANSFER_INTERFACE_MAJOR_VERSION << 16) | TRANSFER_INTERFACE_MINOR_VERSION)
@@ -51,11 +51,19 @@
 ***********************************************************************************************************************
 *| Version | Change Description                                                                                       |
 *| ------- | ---------------------------------------------------------------------------------------------------------|
+*|  6.0    | Add hashed pull transfers that report the block's content hash before sending its data                   |
+*|  5.0    | Add compressed pull transfers                                                                            |
+*|  4.0    | Add resumable pull and push transfers                                                                    |
+*|  3.0    | Add ranged pull transfers so a block can be pulled over several sessions in parallel                     |
 *|  2.0    | Refactor for variably sized messages + push transfers                                                    |
 *|  1.0    | Initial version                                                                                          |
 ***********************************************************************************************************************
 */
 
+#define TRANSFER_CONTENT_HASH_VERSION 6
+#define TRANSFER_COMPRESSION_VERSION 5
+#define TRANSFER_RESUME_VERSION 4
+#define TRANSFER_RANGED_PULL_VERSION 3
 #define TRANSFER_REFACTOR_VERSION 2
 #define TRANSFER_INITIAL_VERSION 1
 
@@ -80,6 +88,17 @@ namespace DevDriver
         {
             Pull = 0,
             Push,
+            RangedPull,
+            ResumePush,
+            CompressedPull,
+            HashedPull,
+            Count,
+        };
+
+        enum struct TransferCompression : uint32
+        {
+            None = 0,
+            Lz4,
             Count,
         };
 
@@ -124,6 +143,63 @@ namespace DevDriver
 
         DD_CHECK_SIZE(TransferRequest, 16);
 
+        // Pull request for the byte range [offsetInBytes, offsetInBytes + sizeInBytes) of a block.
+        // The server clamps the range to the end of the block. A size of zero only queries the block size.
+        // The sentinel CRC covers [crcOffsetInBytes, offsetInBytes + sizeInBytes) so a resumed range is verified
+        // together with the data received before the interruption. Servers older than TRANSFER_RESUME_VERSION
+        // ignore crcOffsetInBytes and treat it as equal to offsetInBytes.
+        DD_NETWORK_STRUCT(TransferRangedRequest, 4)
+        {
+            TransferMessage command;
+            BlockId         blockId;
+            TransferType    type;
+            uint32          sizeInBytes;
+            uint32          offsetInBytes;
+            uint32          crcOffsetInBytes;
+
+            constexpr TransferRangedRequest(BlockId blockId, uint32 offset, uint32 size, uint32 crcOffset)
+                : command(TransferMessage::TransferRequest)
+                , blockId(blockId)
+                , type(TransferType::RangedPull)
+                , sizeInBytes(size)
+                , offsetInBytes(offset)
+                , crcOffsetInBytes(crcOffset)
+            {
+            }
+        };
+
+        DD_CHECK_SIZE(TransferRangedRequest, 24);
+
+        // Size of a TransferRangedRequest sent by TRANSFER_RANGED_PULL_VERSION clients, which lacks crcOffsetInBytes.
+        DD_STATIC_CONST size_t kRangedRequestV3Size = offsetof(TransferRangedRequest, crcOffsetInBytes);
+
+        // Ranged requests carry 32 bit offsets and sizes. Returns true if value can be sent in one unchanged.
+        constexpr bool FitsInRangedRequest(size_t value)
+        {
+            return ((static_cast<uint64>(value) >> 32) == 0);
+        }
+
+        // Pull request for a whole block encoded with the requested compression.
+        // The server may answer with TransferCompression::None if the block does not compress, in which case the
+        // raw block data follows exactly as for a normal pull.
+        DD_NETWORK_STRUCT(TransferCompressedRequest, 4)
+        {
+            TransferMessage     command;
+            BlockId             blockId;
+            TransferType        type;
+            TransferCompression compression;
+
+            constexpr TransferCompressedRequest(BlockId blockId, TransferCompression compression)
+                : command(TransferMessage::TransferRequest)
+                , blockId(blockId)
+                , type(TransferType::CompressedPull)
+                , compression(compression)
+            {
+            }
+        };
+
+        DD_CHECK_SIZE(TransferCompressedRequest, 16);
+
         DD_NETWORK_STRUCT(TransferDataHeader, 4)
         {
             TransferMessage command;
@@ -153,6 +229,82 @@ namespace DevDriver
 
         DD_CHECK_SIZE(TransferDataHeaderV2, 8);
 
+        // Response to a TransferRangedRequest. The sentinel that follows the range carries the CRC of the range only.
+        DD_NETWORK_STRUCT(TransferRangedDataHeader, 4)
+        {
+            TransferMessage command;
+            uint32 sizeInBytes;
+            uint32 blockSizeInBytes;
+
+            constexpr TransferRangedDataHeader(uint32 size, uint32 blockSize)
+                : command(TransferMessage::TransferDataHeader)
+                , sizeInBytes(size)
+                , blockSizeInBytes(blockSize)
+            {}
+        };
+
+        DD_CHECK_SIZE(TransferRangedDataHeader, 12);
+
+        // Response to a TransferCompressedRequest. blockSizeInBytes is the size of the block once decoded.
+        // The server encodes the frames while it sends them, so for compressed data the size on the wire isn't known
+        // up front: sizeInBytes is zero and the data ends with the sentinel. If the server sends the raw block
+        // instead, compression is TransferCompression::None and sizeInBytes is the block size. Either way the
+        // sentinel CRC covers the bytes on the wire.
+        DD_NETWORK_STRUCT(TransferCompressedDataHeader, 4)
+        {
+            TransferMessage     command;
+            uint32              sizeInBytes;
+            uint32              blockSizeInBytes;
+            TransferCompression compression;
+
+            constexpr TransferCompressedDataHeader(uint32 size, uint32 blockSize, TransferCompression compression)
+                : command(TransferMessage::TransferDataHeader)
+                , sizeInBytes(size)
+                , blockSizeInBytes(blockSize)
+                , compression(compression)
+            {}
+        };
+
+        DD_CHECK_SIZE(TransferCompressedDataHeader, 16);
+
+        // MetroHash128 of a block's data, see util/ddMetroHash.h
+        DD_NETWORK_STRUCT(TransferContentHash, 4)
+        {
+            uint32 dwords[4];
+        };
+
+        DD_CHECK_SIZE(TransferContentHash, 16);
+
+        // Response to a HashedPull TransferRequest. The server then waits for the client to answer with a
+        // TransferStatus: Success to receive the block data, which follows exactly as for a normal pull, or
+        // EndOfStream if it already has data with the same hash, which ends the transfer without another message.
+        DD_NETWORK_STRUCT(TransferHashedDataHeader, 4)
+        {
+            TransferMessage     command;
+            uint32              sizeInBytes;
+            TransferContentHash contentHash;
+
+            constexpr TransferHashedDataHeader(uint32 size, const TransferContentHash& hash)
+                : command(TransferMessage::TransferDataHeader)
+                , sizeInBytes(size)
+                , contentHash(hash)
+            {}
+        };
+
+        DD_CHECK_SIZE(TransferHashedDataHeader, 24);
+
+        // Compressed block data is a sequence of independently encoded frames, each preceded by this header.
+        // A frame whose compressed size equals its decompressed size is stored uncompressed.
+        DD_STATIC_CONST uint32 kCompressedFrameSizeInBytes = (64 * 1024);
+
+        DD_NETWORK_STRUCT(TransferCompressedFrameHeader, 4)
+        {
+            uint32 compressedSizeInBytes;
+            uint32 decompressedSizeInBytes;
+        };
+
+        DD_CHECK_SIZE(TransferCompressedFrameHeader, 8);
+
         DD_NETWORK_STRUCT(TransferDataChunk, 4)
         {
             TransferMessage command;
@@ -162,12 +314,20 @@ namespace DevDriver
                 const void *pData,
                 size_t bytesToSend,
                 SizedPayloadContainer* pContainer)
+            {
+                memcpy(PreparePayload(bytesToSend, pContainer), pData, bytesToSend);
+            }
+
+            // Sets up a chunk payload for bytesToSend bytes and returns a pointer to its data for the caller to fill.
+            static uint8* PreparePayload(
+                size_t bytesToSend,
+                SizedPayloadContainer* pContainer)
             {
                 pContainer->payloadSize = static_cast<uint32>(bytesToSend + offsetof(TransferDataChunk, data));
                 DD_ASSERT(pContainer->payloadSize <= kMaxPayloadSizeInBytes);
                 TransferDataChunk& payload = pContainer->GetPayload<TransferDataChunk>();
                 payload.command = TransferMessage::TransferDataChunk;
-                memcpy(&payload.data[0], pData, bytesToSend);
+                return &payload.data[0];
             }
         };
 
@@ -201,5 +361,24 @@ namespace DevDriver
         };
 
         DD_CHECK_SIZE(TransferStatus, 8);
+
+        // Response to a ResumePush request. Reports how much of the block the server already holds and the CRC of
+        // that data so the client can continue writing from there.
+        DD_NETWORK_STRUCT(TransferResumeStatus, 4)
+        {
+            TransferMessage command;
+            Result result;
+            uint32 sizeInBytes;
+            uint32 crc32;
+
+            constexpr TransferResumeStatus(Result result, uint32 size, uint32 crc32)
+                : command(TransferMessage::TransferStatus)
+                , result(result)
+                , sizeInBytes(size)
+                , crc32(crc32)
+            {}
+        };
+
+        DD_CHECK_SIZE(TransferResumeStatus, 16);
     }
 }
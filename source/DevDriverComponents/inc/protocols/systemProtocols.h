@@ -141,6 +141,7 @@ namespace DevDriver
             QueryStatus,
             QueryStatusResponse,
             KeepAlive,
+            RouterAnnounce,
             Count
         };
 
@@ -218,5 +219,28 @@ namespace DevDriver
         };
 
         DD_CHECK_SIZE(QueryStatusResponsePayload, 8);
+
+        // Maximum number of routes carried by a router announcement, one for every possible router prefix
+        DD_STATIC_CONST uint32 kMaxRouterRoutes = (1 << kRouterPrefixWidth);
+
+        DD_NETWORK_STRUCT(RouterRoute, 2)
+        {
+            ClientId    routerPrefix;   // Prefix of the client ids owned by the router this route leads to
+            uint8       hopCount;       // Number of routers between the announcing router and the owning router
+            uint8       reserved;
+        };
+
+        DD_CHECK_SIZE(RouterRoute, 4);
+
+        // Out of band message exchanged between federated routers. Each router periodically announces its own
+        // prefix with a hop count of zero along with every prefix it can reach through its other peers.
+        DD_NETWORK_STRUCT(RouterAnnouncePayload, 4)
+        {
+            uint8       numRoutes;
+            uint8       reserved[3];
+            RouterRoute routes[kMaxRouterRoutes];
+        };
+
+        DD_CHECK_SIZE(RouterAnnouncePayload, 36);
     }
 }
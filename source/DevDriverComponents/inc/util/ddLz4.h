@@ -0,0 +1,53 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddLz4.h
+* @brief Minimal LZ4 block format encoder and decoder used for compressed block transfers.
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "ddPlatform.h"
+
+namespace DevDriver
+{
+    namespace Lz4
+    {
+        // Returns the worst case size of the compressed form of srcSize bytes.
+        inline size_t CompressBound(size_t srcSize)
+        {
+            return (srcSize + (srcSize / 255) + 16);
+        }
+
+        // Compresses srcSize bytes from pSrc into a single LZ4 block stored at pDst.
+        // Returns the size of the compressed block in bytes, or 0 if it did not fit into dstCapacity bytes.
+        size_t CompressBlock(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity);
+
+        // Decompresses the LZ4 block of srcSize bytes at pSrc into pDst.
+        // Returns Result::Error if the block is malformed or does not fit into dstCapacity bytes.
+        Result DecompressBlock(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity, size_t* pDstSize);
+    } // Lz4
+} // DevDriver
@@ -61,6 +61,9 @@ namespace DevDriver
         // check to see if the class has been set
         bool IsNull() const { return m_pObject == nullptr; }
 
+        // returns the number of shared pointers that reference the object, or zero if the pointer is null
+        int32 GetRefCount() const { return (m_pContainer != nullptr) ? m_pContainer->GetRefCount() : 0; }
+
         // clear the pointer and, if required, delete the underlying allocation
         void Clear()
         {
@@ -119,6 +122,9 @@ namespace DevDriver
                 return result;
             }
 
+            // Retrieve the current reference count
+            int32 GetRefCount() const { return m_refCount; }
+
             // Retrieve the allocator callbacks so it can be destroyed
             const AllocCb& GetAllocCb() const { return m_allocCb; }
         private:
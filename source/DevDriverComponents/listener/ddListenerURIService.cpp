@@ -43,6 +43,153 @@ namespace DevDriver
 
     // =====================================================================================================================
 #if DD_VERSION_SUPPORTS(GPUOPEN_URIINTERFACE_CLEANUP_VERSION)
+    // Writes the members of a TrafficStats structure into the currently open map
+    static void WriteTrafficStats(IStructuredWriter* pWriter, const TrafficStats& stats)
+    {
+        pWriter->KeyAndValue("messagesReceived", stats.messagesReceived);
+        pWriter->KeyAndValue("bytesReceived", stats.bytesReceived);
+        pWriter->KeyAndValue("messagesSent", stats.messagesSent);
+        pWriter->KeyAndValue("bytesSent", stats.bytesSent);
+        pWriter->KeyAndValue("messagesRetried", stats.messagesRetried);
+        pWriter->KeyAndValue("messagesDropped", stats.messagesDropped);
+        pWriter->KeyAndValue("messagesThrottled", stats.messagesThrottled);
+        pWriter->KeyAndValue("queuedMessages", stats.queuedMessages);
+    }
+
+    // =====================================================================================================================
+    // Writes the members of a ClientInfo structure into the currently open map
+    static void WriteClientInfo(IStructuredWriter* pWriter, const ClientInfo& clientInfo)
+    {
+        pWriter->KeyAndValue("clientId", static_cast<uint32>(clientInfo.clientId));
+        pWriter->KeyAndValue("name", clientInfo.clientName);
+        pWriter->KeyAndValue("description", clientInfo.clientDescription);
+        pWriter->KeyAndValue("processId", static_cast<uint32>(clientInfo.clientPid));
+        pWriter->KeyAndValue("identified", clientInfo.hasBeenIdentified);
+    }
+
+    // =====================================================================================================================
+    // Handles the "bind <address> <port>" and "unbind <address> <port>" commands
+    Result ListenerURIService::HandleBindRequest(IURIRequestContext* pContext)
+    {
+        Result result = Result::Error;
+
+        char arguments[kMaxStringLength * 2] = {};
+        Platform::Strncpy(arguments, pContext->GetRequestArguments(), sizeof(arguments));
+
+        char* pStrtokContext = nullptr;
+        const char* pCommand = Platform::Strtok(arguments, " ", &pStrtokContext);
+        const char* pHostAddress = Platform::Strtok(nullptr, " ", &pStrtokContext);
+        const char* pPort = Platform::Strtok(nullptr, " ", &pStrtokContext);
+
+        if ((pCommand != nullptr) && (pHostAddress != nullptr) && (pPort != nullptr))
+        {
+            char* pPortEnd = nullptr;
+            const unsigned long port = strtoul(pPort, &pPortEnd, 10);
+
+            if ((*pPortEnd == '\0') && (port <= 0xFFFF))
+            {
+                ListenerBindAddress address = {};
+                Platform::Strncpy(address.hostAddress, pHostAddress, sizeof(address.hostAddress));
+                address.port = static_cast<uint32>(port);
+
+                const bool bind = (strcmp(pCommand, "bind") == 0);
+                if (bind)
+                {
+                    result = m_pListenerCore->AddBindAddress(address);
+                }
+                else
+                {
+                    result = m_pListenerCore->RemoveBindAddress(address);
+                }
+
+                if (result == Result::Success)
+                {
+                    ITextWriter* pWriter = nullptr;
+                    result = pContext->BeginTextResponse(&pWriter);
+
+                    if (result == Result::Success)
+                    {
+                        pWriter->Write("%s %s:%u", bind ? "Bound" : "Unbound", address.hostAddress, address.port);
+                        result = pWriter->End();
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // =====================================================================================================================
+    // Handles the "clientchanges [version]" command
+    // Returns the client list changes made after the given version so that tools can poll for differences instead of
+    // reading the full list. A full list is returned instead when no version is given or the changes are gone.
+    Result ListenerURIService::HandleClientChangesRequest(IURIRequestContext* pContext)
+    {
+        const char* pVersion = pContext->GetRequestArguments() + 13;
+        while (*pVersion == ' ')
+        {
+            ++pVersion;
+        }
+
+        std::vector<ClientListChange> changes;
+        uint64 version = 0;
+        Result changesResult = Result::Unavailable;
+        if (*pVersion != '\0')
+        {
+            const uint64 sinceVersion = strtoull(pVersion, nullptr, 10);
+            changesResult = m_pListenerCore->GetClientListChanges(sinceVersion, &changes, &version);
+        }
+
+        IStructuredWriter* pWriter = nullptr;
+        Result result = pContext->BeginJsonResponse(&pWriter);
+
+        if (result == Result::Success)
+        {
+            pWriter->BeginMap();
+
+            if (changesResult == Result::Success)
+            {
+                pWriter->KeyAndValue("version", version);
+                pWriter->KeyAndValue("full", false);
+
+                pWriter->KeyAndBeginList("changes");
+                for (const ClientListChange& change : changes)
+                {
+                    static const char* const kChangeNames[] = { "connected", "updated", "disconnected" };
+
+                    pWriter->BeginMap();
+                    pWriter->KeyAndValue("version", change.version);
+                    pWriter->KeyAndValue("change", kChangeNames[static_cast<uint32>(change.type)]);
+                    WriteClientInfo(pWriter, change.clientInfo);
+                    pWriter->EndMap();
+                }
+                pWriter->EndList();
+            }
+            else
+            {
+                const std::shared_ptr<const ClientListSnapshot> pSnapshot = m_pListenerCore->GetClientListSnapshot();
+
+                pWriter->KeyAndValue("version", pSnapshot->version);
+                pWriter->KeyAndValue("full", true);
+
+                pWriter->KeyAndBeginList("clients");
+                for (const ClientInfo& clientInfo : pSnapshot->clients)
+                {
+                    pWriter->BeginMap();
+                    WriteClientInfo(pWriter, clientInfo);
+                    pWriter->EndMap();
+                }
+                pWriter->EndList();
+            }
+
+            pWriter->EndMap();
+            result = pWriter->End();
+        }
+
+        return result;
+    }
+
+    // =====================================================================================================================
     Result ListenerURIService::HandleRequest(IURIRequestContext* pContext)
     {
         DD_ASSERT(pContext != nullptr);
@@ -52,9 +199,18 @@ namespace DevDriver
         // We can only handle requests if a valid listener core has been bound.
         if (m_pListenerCore != nullptr)
         {
-            // We currently only handle the "info" command.
-            // All other commands will result in an error.
-            if (strcmp(pContext->GetRequestArguments(), "clients") == 0)
+            // We currently handle the "clients", "clientchanges", "transports", "stats", "info", "bind" and "unbind"
+            // commands. All other commands will result in an error.
+            if ((strncmp(pContext->GetRequestArguments(), "bind ", 5) == 0) ||
+                (strncmp(pContext->GetRequestArguments(), "unbind ", 7) == 0))
+            {
+                result = HandleBindRequest(pContext);
+            }
+            else if (strncmp(pContext->GetRequestArguments(), "clientchanges", 13) == 0)
+            {
+                result = HandleClientChangesRequest(pContext);
+            }
+            else if (strcmp(pContext->GetRequestArguments(), "clients") == 0)
             {
                 // Get a list of all currently connected clients.
                 const std::vector<DevDriver::ClientInfo> connectedClients = m_pListenerCore->GetConnectedClientList();
@@ -84,7 +240,7 @@ namespace DevDriver
             else if (strcmp(pContext->GetRequestArguments(), "transports") == 0)
             {
                 // Get a list of all currently managed transports.
-                const std::vector<std::shared_ptr<IListenerTransport>>& managedTransports = m_pListenerCore->GetManagedTransports();
+                const std::vector<std::shared_ptr<IListenerTransport>> managedTransports = m_pListenerCore->GetManagedTransports();
 
                 ITextWriter* pWriter = nullptr;
                 result = pContext->BeginTextResponse(&pWriter);
@@ -106,6 +262,50 @@ namespace DevDriver
                     result = pWriter->End();
                 }
             }
+            else if (strcmp(pContext->GetRequestArguments(), "stats") == 0)
+            {
+                const RouterStats routerStats = m_pListenerCore->GetRouterStats();
+
+                IStructuredWriter* pWriter = nullptr;
+                result = pContext->BeginJsonResponse(&pWriter);
+
+                if (result == Result::Success)
+                {
+                    pWriter->BeginMap();
+
+                    pWriter->KeyAndBeginList("transports");
+                    for (const TransportTrafficStats& transportStats : routerStats.transports)
+                    {
+                        pWriter->BeginMap();
+                        pWriter->KeyAndValue("name", transportStats.name.c_str());
+                        pWriter->KeyAndValue("handle", transportStats.handle);
+                        WriteTrafficStats(pWriter, transportStats.traffic);
+                        pWriter->EndMap();
+                    }
+                    pWriter->EndList();
+
+                    pWriter->KeyAndBeginList("clients");
+                    for (const ClientTrafficStats& clientStats : routerStats.clients)
+                    {
+                        pWriter->BeginMap();
+                        pWriter->KeyAndValue("clientId", static_cast<uint32>(clientStats.clientId));
+                        WriteTrafficStats(pWriter, clientStats.traffic);
+                        pWriter->EndMap();
+                    }
+                    pWriter->EndList();
+
+                    // Bucket N counts messages that were routed in less than 2^N microseconds.
+                    pWriter->KeyAndBeginList("routingLatencyHistogramUs");
+                    for (uint32 bucket = 0; bucket < kNumRoutingLatencyBuckets; ++bucket)
+                    {
+                        pWriter->Value(routerStats.routingLatencyHistogram[bucket]);
+                    }
+                    pWriter->EndList();
+
+                    pWriter->EndMap();
+                    result = pWriter->End();
+                }
+            }
             else if (strcmp(pContext->GetRequestArguments(), "info") == 0)
             {
                 const IClientManager* pClientManager = m_pListenerCore->GetClientManager();
@@ -119,6 +319,12 @@ namespace DevDriver
                     pWriter->Write("Listener Description: %s", createInfo.description);
                     pWriter->Write("\nListener UWP Support: %u", static_cast<uint32>(createInfo.flags.enableUWP));
                     pWriter->Write("\nListener Server Support: %u", static_cast<uint32>(createInfo.flags.enableServer));
+                    pWriter->Write("\nListener Federation Support: %u", static_cast<uint32>(createInfo.flags.enableFederation));
+                    pWriter->Write("\nListener Stream Transport Support: %u", static_cast<uint32>(createInfo.flags.enableStreamTransport));
+                    pWriter->Write("\nListener Local Packet Transport Support: %u", static_cast<uint32>(createInfo.flags.enableLocalPacketTransport));
+                    pWriter->Write("\nListener Receive Coalescing Support: %u", static_cast<uint32>(createInfo.flags.enableReceiveCoalescing));
+                    pWriter->Write("\nListener Socket Buffer Sizes: %u send, %u receive", createInfo.socketSendBufferSize, createInfo.socketReceiveBufferSize);
+                    pWriter->Write("\nListener Client Rate Limit: %u messages per second", createInfo.clientRateLimit.messagesPerSecond);
                     pWriter->Write("\nClient Manager Name: %s", pClientManager->GetClientManagerName());
                     pWriter->Write("\nClient Manager Host Client Id: %u", static_cast<uint32>(pClientManager->GetHostClientId()));
 
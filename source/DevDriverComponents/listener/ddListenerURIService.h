@@ -38,7 +38,7 @@ namespace DevDriver
 
     // String used to identify the listener URI service
     DD_STATIC_CONST char kListenerURIServiceName[] = "listener";
-    DD_STATIC_CONST Version kListenerURIServiceVersion = 1;
+    DD_STATIC_CONST Version kListenerURIServiceVersion = 4;
 
     class ListenerURIService : public IService
     {
@@ -68,6 +68,14 @@ namespace DevDriver
 #endif
 
     private:
+#if DD_VERSION_SUPPORTS(GPUOPEN_URIINTERFACE_CLEANUP_VERSION)
+        // Adds or removes a listener bind address at runtime
+        Result HandleBindRequest(IURIRequestContext* pContext);
+
+        // Returns the client list changes since a version, or the full client list
+        Result HandleClientChangesRequest(IURIRequestContext* pContext);
+#endif
+
         // Currently bound listener core
         ListenerCore* m_pListenerCore;
     };
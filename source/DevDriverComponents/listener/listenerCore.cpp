@@ -37,6 +37,8 @@
 #endif
 #include "transports/socketTransport.h"
 #include "transports/hostTransport.h"
+#include "transports/connectionTransport.h"
+#include "transports/impairedTransport.h"
 #include "clientmanagers/listenerClientManager.h"
 #include "../src/messageChannel.h"
 #include "hostMsgTransport.h"
@@ -59,6 +61,13 @@ namespace DevDriver
     // Client manager routing prefix
     DD_STATIC_CONST ClientId kListenerClientManagerPrefix = (0x0000) & kRouterPrefixMask;
 
+    // =====================================================================================================================
+    // Returns true if both bind addresses refer to the same host address and port
+    static bool IsSameBindAddress(const ListenerBindAddress& lhs, const ListenerBindAddress& rhs)
+    {
+        return ((lhs.port == rhs.port) && (strcmp(lhs.hostAddress, rhs.hostAddress) == 0));
+    }
+
     // =====================================================================================================================
     // Logs a message to the console or the logging server if it's available
     void LogMessage(LogLevel logLevel, const char *format, ...)
@@ -92,6 +101,13 @@ namespace DevDriver
         return m_routerCore.GetConnectedClientList();
     }
 
+    // =====================================================================================================================
+    // Returns a snapshot of the router's traffic counters
+    RouterStats ListenerCore::GetRouterStats()
+    {
+        return m_routerCore.GetRouterStats();
+    }
+
     // =====================================================================================================================
     // Constructor
     ListenerCore::ListenerCore() :
@@ -121,6 +137,7 @@ namespace DevDriver
         Result result = Result::Unavailable;
 
         std::lock_guard<std::mutex> lock(m_routerMutex);
+        std::lock_guard<std::mutex> transportLock(m_transportMutex);
 
         if (m_pClientManager == nullptr)
         {
@@ -128,6 +145,15 @@ namespace DevDriver
             infoStruct.routerPrefix = kListenerClientManagerPrefix;
             infoStruct.routerPrefixMask = 0;
 
+            // Federated listeners hand out client ids from their own prefix so other routers can tell which
+            // listener owns a client.
+            if (createInfo.flags.enableFederation)
+            {
+                DD_ASSERT(createInfo.routerPrefix < (1u << kRouterPrefixWidth));
+                infoStruct.routerPrefix = static_cast<ClientId>(createInfo.routerPrefix << kRouterPrefixShift) & kRouterPrefixMask;
+                infoStruct.routerPrefixMask = kRouterPrefixMask;
+            }
+
             IClientManager *pClientManager = new ListenerClientManager(createInfo.allocCb, infoStruct);
             if (m_routerCore.SetClientManager(pClientManager) == Result::Success)
             {
@@ -147,23 +173,66 @@ namespace DevDriver
             auto pPipeTransport = std::make_shared<SocketListenerTransport>(kDefaultNamedPipe.type,
                                                                             kDefaultNamedPipe.hostname,
                                                                             kDefaultNamedPipe.port);
+            pPipeTransport->SetSocketBufferSizes(createInfo.socketSendBufferSize, createInfo.socketReceiveBufferSize);
 #endif
             if (m_routerCore.RegisterTransport(pPipeTransport) == Result::Success)
             {
                 m_managedTransports.emplace_back(pPipeTransport);
             }
 
+#if defined(DD_LINUX)
+            if (createInfo.flags.enableLocalPacketTransport)
+            {
+                auto pPacketTransport = std::make_shared<ConnectionListenerTransport>(SocketType::LocalSeqPacket,
+                                                                                      kDefaultLocalPacketSocket.hostname,
+                                                                                      kDefaultLocalPacketSocket.port);
+                if (m_routerCore.RegisterTransport(pPacketTransport) == Result::Success)
+                {
+                    m_managedTransports.emplace_back(pPacketTransport);
+                }
+            }
+#endif
+
+            std::shared_ptr<SocketListenerTransport> pFederationTransport;
+
             for (uint32 i = 0; i < createInfo.numAddresses; i++)
             {
                 // todo: validate this.
-                ListenerBindAddress &address = createInfo.pAddressesToBind[i];
+                const ListenerBindAddress &address = createInfo.pAddressesToBind[i];
+
+                BoundAddress boundAddress = {};
+                if (BindAddress(address, createInfo, &boundAddress) == Result::Success)
+                {
+                    m_boundAddresses.push_back(boundAddress);
+
+                    // Peer routers are reached through the first remote transport.
+                    if (createInfo.flags.enableFederation &&
+                        (pFederationTransport == nullptr) &&
+                        (boundAddress.pRemoteTransport != nullptr))
+                    {
+                        pFederationTransport = boundAddress.pSocketTransport;
+                    }
+                }
+            }
 
-                auto pRemoteTransport = std::make_shared<SocketListenerTransport>(TransportType::Remote,
-                                                                                  address.hostAddress,
-                                                                                  address.port);
-                if (m_routerCore.RegisterTransport(pRemoteTransport) == Result::Success)
+            for (uint32 i = 0; i < createInfo.numRoutersToFederate; i++)
+            {
+                const ListenerBindAddress &address = createInfo.pRoutersToFederate[i];
+
+                ConnectionInfo connectionInfo = {};
+                Result peerResult = Result::Unavailable;
+                if (pFederationTransport != nullptr)
+                {
+                    peerResult = pFederationTransport->LookupConnectionInfo(address.hostAddress, address.port, &connectionInfo);
+                    if (peerResult == Result::Success)
+                    {
+                        peerResult = m_routerCore.AddRouterPeer(connectionInfo);
+                    }
+                }
+
+                if (peerResult != Result::Success)
                 {
-                    m_managedTransports.emplace_back(pRemoteTransport);
+                    DD_PRINT(LogLevel::Alert, "[ListenerCore] Unable to federate with %s:%u", address.hostAddress, address.port);
                 }
             }
         }
@@ -206,6 +275,13 @@ namespace DevDriver
 
             RouterStartInfo startInfo = {};
             Platform::Strncpy(startInfo.description, createInfo.description, sizeof(startInfo.description));
+            startInfo.enableFederation = (createInfo.flags.enableFederation != 0);
+            startInfo.rateLimits.clientLimit = createInfo.clientRateLimit;
+            for (uint32 i = 0; i < createInfo.numProtocolRateLimits; i++)
+            {
+                const ListenerProtocolRateLimit &protocolRateLimit = createInfo.pProtocolRateLimits[i];
+                startInfo.rateLimits.protocolLimits[static_cast<uint32>(protocolRateLimit.protocol)] = protocolRateLimit.limit;
+            }
 
             if (m_routerCore.Start(startInfo) == Result::Success)
             {
@@ -260,6 +336,7 @@ namespace DevDriver
                 m_routerCore.RemoveTransport(pTransport);
             }
             m_managedTransports.clear();
+            m_boundAddresses.clear();
             m_routerCore.Stop();
 
             if (m_pClientManager != nullptr)
@@ -294,13 +371,19 @@ namespace DevDriver
                 m_pMsgChannel = nullptr;
             }
 
-            for (const auto &pTransport : m_managedTransports)
             {
-                m_routerCore.RemoveTransport(pTransport);
+                // The URI service is gone now so nothing else can be changing the bound addresses.
+                std::lock_guard<std::mutex> transportLock(m_transportMutex);
+
+                for (const auto &pTransport : m_managedTransports)
+                {
+                    m_routerCore.RemoveTransport(pTransport);
+                }
+                m_managedTransports.clear();
+                m_boundAddresses.clear();
+                m_started = false;
             }
-            m_managedTransports.clear();
             m_routerCore.Stop();
-            m_started = false;
 
             if (m_pClientManager != nullptr)
             {
@@ -310,6 +393,175 @@ namespace DevDriver
         }
     }
 
+    // =====================================================================================================================
+    // Starts listening for connections on an additional address while the listener is running
+    Result ListenerCore::AddBindAddress(const ListenerBindAddress& address)
+    {
+        Result result = Result::Unavailable;
+
+        std::lock_guard<std::mutex> lock(m_transportMutex);
+
+        if (m_started)
+        {
+            result = Result::Success;
+
+            for (const BoundAddress &boundAddress : m_boundAddresses)
+            {
+                if (IsSameBindAddress(boundAddress.address, address))
+                {
+                    result = Result::Error;
+                    break;
+                }
+            }
+
+            if (result == Result::Success)
+            {
+                BoundAddress boundAddress = {};
+                result = BindAddress(address, m_createInfo, &boundAddress);
+                if (result == Result::Success)
+                {
+                    m_boundAddresses.push_back(boundAddress);
+                }
+            }
+        }
+
+        if (result != Result::Success)
+        {
+            DD_PRINT(LogLevel::Alert, "[ListenerCore] Unable to bind to %s:%u", address.hostAddress, address.port);
+        }
+
+        return result;
+    }
+
+    // =====================================================================================================================
+    // Stops listening for connections on a bound address and disconnects the clients that were using it
+    Result ListenerCore::RemoveBindAddress(const ListenerBindAddress& address)
+    {
+        Result result = Result::Unavailable;
+
+        std::lock_guard<std::mutex> lock(m_transportMutex);
+
+        if (m_started)
+        {
+            result = Result::Error;
+
+            for (auto iter = m_boundAddresses.begin(); iter != m_boundAddresses.end(); ++iter)
+            {
+                if (IsSameBindAddress(iter->address, address))
+                {
+                    if (iter->pRemoteTransport != nullptr)
+                    {
+                        RemoveManagedTransport(iter->pRemoteTransport);
+                    }
+
+                    if (iter->pStreamTransport != nullptr)
+                    {
+                        RemoveManagedTransport(iter->pStreamTransport);
+                    }
+
+                    m_boundAddresses.erase(iter);
+
+                    DD_PRINT(LogLevel::Info, "[ListenerCore] Stopped listening for connections on %s:%u", address.hostAddress, address.port);
+                    result = Result::Success;
+                    break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // =====================================================================================================================
+    // Returns a snapshot of the transports that are currently managed by the listener
+    std::vector<std::shared_ptr<IListenerTransport>> ListenerCore::GetManagedTransports() const
+    {
+        std::lock_guard<std::mutex> lock(m_transportMutex);
+        return m_managedTransports;
+    }
+
+    // =====================================================================================================================
+    // Creates the transports for a bind address and registers them with the router
+    Result ListenerCore::BindAddress(const ListenerBindAddress& address,
+                                     const ListenerCreateInfo&  createInfo,
+                                     BoundAddress*              pBoundAddress)
+    {
+        DD_ASSERT(pBoundAddress != nullptr);
+
+        pBoundAddress->address = address;
+
+        auto pSocketTransport = std::make_shared<SocketListenerTransport>(TransportType::Remote,
+                                                                          address.hostAddress,
+                                                                          address.port);
+        pSocketTransport->SetSocketBufferSizes(createInfo.socketSendBufferSize, createInfo.socketReceiveBufferSize);
+        pSocketTransport->SetReceiveCoalescing(createInfo.flags.enableReceiveCoalescing != 0);
+
+        std::shared_ptr<IListenerTransport> pRemoteTransport = pSocketTransport;
+        if (createInfo.pNetworkImpairment != nullptr)
+        {
+            pRemoteTransport = std::make_shared<ImpairedListenerTransport>(createInfo.allocCb,
+                                                                           pSocketTransport,
+                                                                           createInfo.pNetworkImpairment);
+        }
+
+        if (m_routerCore.RegisterTransport(pRemoteTransport) == Result::Success)
+        {
+            m_managedTransports.emplace_back(pRemoteTransport);
+            pBoundAddress->pRemoteTransport = pRemoteTransport;
+            pBoundAddress->pSocketTransport = pSocketTransport;
+        }
+
+        if (createInfo.flags.enableStreamTransport)
+        {
+            std::shared_ptr<IListenerTransport> pStreamTransport =
+                std::make_shared<ConnectionListenerTransport>(SocketType::Tcp, address.hostAddress, address.port);
+            if (createInfo.pNetworkImpairment != nullptr)
+            {
+                pStreamTransport = std::make_shared<ImpairedListenerTransport>(createInfo.allocCb,
+                                                                               pStreamTransport,
+                                                                               createInfo.pNetworkImpairment);
+            }
+
+            if (m_routerCore.RegisterTransport(pStreamTransport) == Result::Success)
+            {
+                m_managedTransports.emplace_back(pStreamTransport);
+                pBoundAddress->pStreamTransport = pStreamTransport;
+            }
+        }
+
+        // Transports registered after initialization are logged here since the startup log has already been written.
+        if (m_started)
+        {
+            if (pBoundAddress->pRemoteTransport != nullptr)
+            {
+                DD_PRINT(LogLevel::Info, "[ListenerCore] Listening for connections on %s", pBoundAddress->pRemoteTransport->GetTransportName());
+            }
+
+            if (pBoundAddress->pStreamTransport != nullptr)
+            {
+                DD_PRINT(LogLevel::Info, "[ListenerCore] Listening for connections on %s", pBoundAddress->pStreamTransport->GetTransportName());
+            }
+        }
+
+        const bool bound = ((pBoundAddress->pRemoteTransport != nullptr) || (pBoundAddress->pStreamTransport != nullptr));
+        return bound ? Result::Success : Result::Error;
+    }
+
+    // =====================================================================================================================
+    // Removes a transport from the router, which disconnects its clients, and stops managing it
+    void ListenerCore::RemoveManagedTransport(const std::shared_ptr<IListenerTransport>& pTransport)
+    {
+        m_routerCore.RemoveTransport(pTransport);
+
+        for (auto iter = m_managedTransports.begin(); iter != m_managedTransports.end(); ++iter)
+        {
+            if (*iter == pTransport)
+            {
+                m_managedTransports.erase(iter);
+                break;
+            }
+        }
+    }
+
 #if !DD_VERSION_SUPPORTS(GPUOPEN_DISTRIBUTED_STATUS_FLAGS_VERSION)
     // =====================================================================================================================
     // Sets the developer mode enabled client flag to the specified value
@@ -41,6 +41,9 @@
 
 namespace DevDriver
 {
+    class NetworkImpairment;
+    class SocketListenerTransport;
+
     // Flags for configuring the listener core's behavior
     union ListenerConfigFlags
     {
@@ -52,7 +55,14 @@ namespace DevDriver
             uint32 enableServer : 1;  // Enables the built-in listener server which allows the listener to
                                       // communicate at an application protocol level with other clients on
                                       // the bus
-            uint32 reserved     : 30; // Reserved for future usage
+            uint32 enableFederation : 1; // Exchanges routes with other listeners so that clients connected to
+                                         // any of them can reach each other through this listener
+            uint32 enableStreamTransport : 1; // Also accepts reliable stream (TCP) connections on every bind address
+            uint32 enableLocalPacketTransport : 1; // Also accepts local clients over a connection per client packet
+                                                   // socket (Linux only)
+            uint32 enableReceiveCoalescing : 1; // Lets the kernel coalesce datagrams from the same client into a
+                                                // single receive on remote transports (Linux only)
+            uint32 reserved     : 26; // Reserved for future usage
         };
         uint32     value;
     };
@@ -64,6 +74,13 @@ namespace DevDriver
         uint32 port;                          // Network port
     };
 
+    // A rate limit applied to the traffic that each client sends with a specific protocol
+    struct ListenerProtocolRateLimit
+    {
+        Protocol  protocol; // Protocol to limit. Session traffic is limited by the protocol that opened the session.
+        RateLimit limit;    // Messages per second and burst size allowed per client
+    };
+
     // Creation information for the listener core object
     struct ListenerCreateInfo
     {
@@ -72,6 +89,21 @@ namespace DevDriver
         ListenerServerCreateInfo serverCreateInfo;              // Creation information for the built in listener server
         ListenerBindAddress*     pAddressesToBind;              // A list of addresses to lister for connections on
         uint32                   numAddresses;                  // The number of entries in pAddressesToBind
+        uint32                   routerPrefix;                  // Router prefix owned by this listener when federation is enabled.
+                                                                // Must be unique among federated listeners and less than
+                                                                // (1 << kRouterPrefixWidth)
+        ListenerBindAddress*     pRoutersToFederate;            // Addresses of other listeners to exchange routes with
+        uint32                   numRoutersToFederate;          // The number of entries in pRoutersToFederate
+        RateLimit                clientRateLimit;               // Rate limit for everything each client sends. A messagesPerSecond
+                                                                // of zero disables it.
+        ListenerProtocolRateLimit* pProtocolRateLimits;         // Per protocol rate limits for the traffic each client sends
+        uint32                   numProtocolRateLimits;         // The number of entries in pProtocolRateLimits
+        uint32                   socketSendBufferSize;          // Kernel send buffer size for datagram transports. Zero keeps
+                                                                // the default of two session windows.
+        uint32                   socketReceiveBufferSize;       // Kernel receive buffer size for datagram transports. Zero keeps
+                                                                // the default of two session windows.
+        NetworkImpairment*       pNetworkImpairment;            // Optional impairment applied to every message sent to remote
+                                                                // clients. Used to test behavior on lossy or slow links.
         AllocCb                  allocCb;                       // An allocation callback that is used to manage memory allocations
     };
 
@@ -122,8 +154,32 @@ namespace DevDriver
         // This function has to acquire an internal lock so it should not be considered a "cheap" function
         std::vector<ClientInfo> GetConnectedClientList();
 
-        // Returns a list of the currently managed transports.
-        const std::vector<std::shared_ptr<IListenerTransport>>& GetManagedTransports() const { return m_managedTransports; }
+        // Returns the current versioned snapshot of the client list without taking any of the router's locks
+        // Pollers should keep the snapshot and only ask for changes after its version.
+        std::shared_ptr<const ClientListSnapshot> GetClientListSnapshot() const { return m_routerCore.GetClientListSnapshot(); }
+
+        // Returns the client list changes made after sinceVersion and the current version
+        // Returns Unavailable if the changes are no longer retained, in which case a new snapshot must be read.
+        Result GetClientListChanges(uint64 sinceVersion, std::vector<ClientListChange>* pChanges, uint64* pVersion) const
+        {
+            return m_routerCore.GetClientListChanges(sinceVersion, pChanges, pVersion);
+        }
+
+        // Returns a snapshot of the router's per-transport and per-client traffic counters
+        // This function has to acquire internal locks so it should not be considered a "cheap" function
+        RouterStats GetRouterStats();
+
+        // Starts listening for connections on an additional address while the listener is running
+        // A stream transport is created for the address as well when stream transports are enabled.
+        Result AddBindAddress(const ListenerBindAddress& address);
+
+        // Stops listening for connections on an address that was bound during initialization or by AddBindAddress
+        // Clients connected through the address are disconnected. All other clients are unaffected.
+        Result RemoveBindAddress(const ListenerBindAddress& address);
+
+        // Returns a copy of the list of the currently managed transports.
+        // Transports can be added and removed at runtime so a snapshot is returned rather than a reference.
+        std::vector<std::shared_ptr<IListenerTransport>> GetManagedTransports() const;
 
         // Returns the client manager pointer.
         const IClientManager* GetClientManager() const { return m_pClientManager; }
@@ -137,10 +193,30 @@ namespace DevDriver
         const ListenerCreateInfo& GetCreateInfo() const { return m_createInfo; }
 
     private:
+        // The transports that were created to listen on a bind address
+        struct BoundAddress
+        {
+            ListenerBindAddress                 address;          // The address the transports are bound to
+            std::shared_ptr<IListenerTransport> pRemoteTransport; // Datagram transport for the address
+            std::shared_ptr<IListenerTransport> pStreamTransport; // Stream transport for the address, if enabled
+            std::shared_ptr<SocketListenerTransport> pSocketTransport; // The datagram socket behind pRemoteTransport
+        };
+
+        // Creates and registers the transports for a bind address. Expects m_transportMutex to be held.
+        Result BindAddress(const ListenerBindAddress& address,
+                           const ListenerCreateInfo&  createInfo,
+                           BoundAddress*              pBoundAddress);
+
+        // Removes a transport from the router and the list of managed transports. Expects m_transportMutex to be held.
+        void RemoveManagedTransport(const std::shared_ptr<IListenerTransport>& pTransport);
+
         ListenerCreateInfo                                      m_createInfo;         // Creation information provided during initialization
         RouterCore                                              m_routerCore;         // The underlying router core object
         std::vector<std::shared_ptr<IListenerTransport>>        m_managedTransports;  // A vector of all transports that are managed by the listener
+        std::vector<BoundAddress>                               m_boundAddresses;     // The addresses the listener is currently bound to
         std::mutex                                              m_routerMutex;        // A mutex used to make access to the router thread safe
+        mutable std::mutex                                      m_transportMutex;     // Guards m_managedTransports and m_boundAddresses.
+                                                                                      // Acquired after m_routerMutex.
         IClientManager*                                         m_pClientManager;     // Pointer to the current client manager object
         bool                                                    m_started;            // True if the listener has been started, false otherwise
                                                                                       // (Used for internal resource cleanup logic)
@@ -31,6 +31,8 @@
 #include "routerCore.h"
 #include "../inc/ddPlatform.h"
 #include <cstring>
+#include <chrono>
+#include <algorithm>
 #include "protocols/systemProtocols.h"
 
 namespace DevDriver
@@ -48,10 +50,144 @@ namespace DevDriver
         kUnknownClient,
         {},
         0,
-        false,
+        0,
         false
     };
 
+    // Returns the number of bytes the message occupies on the wire.
+    inline uint64 MessageSizeInBytes(const MessageBuffer &message)
+    {
+        return sizeof(MessageHeader) + message.header.payloadSize;
+    }
+
+    // Returns the routing latency histogram bucket for the provided routing time.
+    inline uint32 LatencyBucketForTime(uint64 timeInUs)
+    {
+        uint32 bucket = 0;
+        while ((timeInUs > 0) & (bucket < (kNumRoutingLatencyBuckets - 1)))
+        {
+            timeInUs >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    inline void AccumulateTrafficStats(TrafficStats *pTotal, const TrafficStats &stats)
+    {
+        pTotal->messagesReceived += stats.messagesReceived;
+        pTotal->bytesReceived += stats.bytesReceived;
+        pTotal->messagesSent += stats.messagesSent;
+        pTotal->bytesSent += stats.bytesSent;
+        pTotal->messagesRetried += stats.messagesRetried;
+        pTotal->messagesDropped += stats.messagesDropped;
+        pTotal->messagesThrottled += stats.messagesThrottled;
+        pTotal->queuedMessages += stats.queuedMessages;
+    }
+
+    // Builds the key used to look up the protocol of a session between two clients.
+    inline uint64 SessionKey(ClientId clientA, ClientId clientB, SessionId sessionId)
+    {
+        const uint64 lowClientId = Platform::Min(clientA, clientB);
+        const uint64 highClientId = Platform::Max(clientA, clientB);
+        return ((lowClientId << 48) | (highClientId << 32) | sessionId);
+    }
+
+    // Adds a session key to the tracking order of a client. Returns true along with the oldest key if that one had
+    // to be given up to stay within the limit.
+    inline bool PushTrackedSession(std::deque<uint64>* pOrder, uint64 key, size_t maxSessions, uint64* pEvictedKey)
+    {
+        const bool evicted = (pOrder->size() >= maxSessions);
+        if (evicted)
+        {
+            *pEvictedKey = pOrder->front();
+            pOrder->pop_front();
+        }
+        pOrder->push_back(key);
+        return evicted;
+    }
+
+    // Removes a session key from the tracking order of a client.
+    inline void RemoveTrackedSession(std::deque<uint64>* pOrder, uint64 key)
+    {
+        const auto find = std::find(pOrder->begin(), pOrder->end(), key);
+        if (find != pOrder->end())
+        {
+            pOrder->erase(find);
+        }
+    }
+
+    // Returns true if the rate limit restricts anything.
+    inline bool IsRateLimitEnabled(const RateLimit &limit)
+    {
+        return (limit.messagesPerSecond > 0);
+    }
+
+    // Returns true if the message may be rate limited and fairly scheduled. Client management traffic is always
+    // routed right away since it is needed to connect and to stay connected.
+    inline bool IsSchedulableMessage(const MessageBuffer &message)
+    {
+        return ((message.header.srcClientId != kBroadcastClientId) &&
+                (message.header.protocolId != Protocol::ClientManagement) &&
+                !ClientManagementProtocol::IsOutOfBandMessage(message));
+    }
+
+    // Returns true if both connection infos refer to the same endpoint on the same transport.
+    inline bool IsSameConnection(const ConnectionInfo &lhs, const ConnectionInfo &rhs)
+    {
+        return ((lhs.handle == rhs.handle) &&
+                (lhs.size == rhs.size) &&
+                (memcmp(lhs.data, rhs.data, lhs.size) == 0));
+    }
+
+    size_t ConnectionInfoHash::operator()(const ConnectionInfo &connectionInfo) const
+    {
+        // 64-bit FNV-1a over the address bytes
+        uint64 hash = 14695981039346656037ull;
+        for (size_t byteIndex = 0; byteIndex < connectionInfo.size; ++byteIndex)
+        {
+            hash ^= static_cast<uint8>(connectionInfo.data[byteIndex]);
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    bool ConnectionInfoEqual::operator()(const ConnectionInfo &lhs, const ConnectionInfo &rhs) const
+    {
+        return ((lhs.size == rhs.size) && (memcmp(lhs.data, rhs.data, lhs.size) == 0));
+    }
+
+    bool TransportContext::AddClient(ClientId clientId, const ConnectionInfo &connectionInfo)
+    {
+        const bool inserted = clientMap.emplace(clientId, connectionInfo).second;
+        if (inserted)
+        {
+            connectionIndex.emplace(connectionInfo, clientId);
+        }
+        return inserted;
+    }
+
+    bool TransportContext::RemoveClient(ClientId clientId)
+    {
+        const auto find = clientMap.find(clientId);
+        if (find == clientMap.end())
+        {
+            return false;
+        }
+
+        const auto range = connectionIndex.equal_range(find->second);
+        for (auto iter = range.first; iter != range.second; ++iter)
+        {
+            if (iter->second == clientId)
+            {
+                connectionIndex.erase(iter);
+                break;
+            }
+        }
+
+        clientMap.erase(find);
+        return true;
+    }
+
     //@note: The clients mutex must always be owned during this function.
     ClientContext* RouterCore::FindClientById(ClientId clientId)
     {
@@ -72,17 +208,13 @@ namespace DevDriver
         {
             if (find->second.pTransport != nullptr && !find->second.pTransport->ForwardingConnection())
             {
-                for (auto& pair : find->second.clientMap)
+                const auto findConnection = find->second.connectionIndex.find(connectionInfo);
+                if (findConnection != find->second.connectionIndex.end())
                 {
-                    if (pair.second.size == connectionInfo.size &&
-                        (memcmp(pair.second.data, connectionInfo.data, connectionInfo.size) == 0))
+                    auto findClient = m_clientMap.find(findConnection->second);
+                    if (findClient != m_clientMap.end())
                     {
-                        auto findClient = m_clientMap.find(pair.first);
-                        if (findClient != m_clientMap.end())
-                        {
-                            return &findClient->second;
-                        }
-                        return nullptr;
+                        return &findClient->second;
                     }
                 }
             }
@@ -104,15 +236,25 @@ namespace DevDriver
                 ClientContext clientData(kNewClientContext);
                 clientData.clientInfo.clientId = clientId;
                 clientData.pingRetryCount = 0;
-                clientData.receivedPong = true;
+                clientData.lastActivityTimeInMs = Platform::GetCurrentTimeInMs();
                 clientData.connectionInfo = connectionInfo;
                 clientData.registeredClient = registeredClient;
 
                 m_clientMap.emplace(clientId, clientData);
+                PublishClientListChange(ClientListChangeType::Connected, clientData.clientInfo);
 
-                transport.clientMap.emplace(clientId, connectionInfo);
+                // Clients owned by another router are reached through that router's prefix route, so they must
+                // not receive broadcasts directly from us as well.
+                if (IsRemoteClient(clientId))
+                {
+                    DD_PRINT(LogLevel::Info, "[RouterCore] Remote client %u discovered via %s", clientId, transport.pTransport->GetTransportName());
+                }
+                else
+                {
+                    transport.AddClient(clientId, connectionInfo);
 
-                DD_PRINT(LogLevel::Info, "[RouterCore] Client %u connected via %s", clientId, transport.pTransport->GetTransportName());
+                    DD_PRINT(LogLevel::Info, "[RouterCore] Client %u connected via %s", clientId, transport.pTransport->GetTransportName());
+                }
 
             }
         }
@@ -121,42 +263,72 @@ namespace DevDriver
     //@note: The client and transport mutex must always be owned during this function.
     void RouterCore::RemoveClient(ClientId clientId)
     {
-        const auto &find = m_clientMap.find(clientId);
-        if (find != m_clientMap.end())
+        // Announcing a disconnect can uncover further clients that can no longer be reached. Those are handled
+        // from this work list instead of recursing back through the broadcast path.
+        std::vector<ClientId> pendingClients(1, clientId);
+
+        while (!pendingClients.empty())
         {
-            TransportHandle tHandle = find->second.connectionInfo.handle;
-            const auto &findTransport = m_transportMap.find(tHandle);
-            if (findTransport != m_transportMap.end() && findTransport->second.pTransport != nullptr)
+            const ClientId removedClientId = pendingClients.back();
+            pendingClients.pop_back();
+
+            const auto &find = m_clientMap.find(removedClientId);
+            if (find != m_clientMap.end())
             {
-                auto &transport = findTransport->second;
-                if (transport.pTransport != nullptr)
+                TransportHandle tHandle = find->second.connectionInfo.handle;
+                const auto &findTransport = m_transportMap.find(tHandle);
+                if (findTransport != m_transportMap.end() && findTransport->second.pTransport != nullptr)
                 {
-                    transport.clientMap.erase(clientId);
-                    DD_PRINT(LogLevel::Info, "[RouterCore] Client %u disconnected from %s", clientId, transport.pTransport->GetTransportName());
+                    auto &transport = findTransport->second;
+                    if (transport.pTransport != nullptr)
+                    {
+                        transport.RemoveClient(removedClientId);
+                        DD_PRINT(LogLevel::Info, "[RouterCore] Client %u disconnected from %s", removedClientId, transport.pTransport->GetTransportName());
+                    }
                 }
-            }
 
-            if (find->second.registeredClient)
-            {
-                m_pClientManager->UnregisterClient(find->first);
+                const bool registeredClient = find->second.registeredClient;
+                PublishClientListChange(ClientListChangeType::Disconnected, find->second.clientInfo);
+                m_clientMap.erase(find);
+                RemoveClientSessions(removedClientId);
 
-                MessageBuffer messageBuffer = {};
-                messageBuffer.header.dstClientId = kBroadcastClientId;
-                messageBuffer.header.srcClientId = clientId;
-                messageBuffer.header.protocolId = Protocol::System;
-                messageBuffer.header.messageId = static_cast<MessageCode>(SystemProtocol::SystemMessage::ClientDisconnected);
-                messageBuffer.header.payloadSize = 0;
-                SendBroadcastMessage(messageBuffer, nullptr);
+                if (registeredClient)
+                {
+                    m_pClientManager->UnregisterClient(removedClientId);
+
+                    MessageBuffer messageBuffer = {};
+                    messageBuffer.header.dstClientId = kBroadcastClientId;
+                    messageBuffer.header.srcClientId = removedClientId;
+                    messageBuffer.header.protocolId = Protocol::System;
+                    messageBuffer.header.messageId = static_cast<MessageCode>(SystemProtocol::SystemMessage::ClientDisconnected);
+                    messageBuffer.header.payloadSize = 0;
+                    TransmitBroadcastMessage(messageBuffer, nullptr, nullptr, &pendingClients);
+                }
             }
-            m_clientMap.erase(find);
         }
     }
 
-    void RouterCore::SendBroadcastMessage(const MessageBuffer &message, const std::shared_ptr<IListenerTransport> &pSourceTransport)
+    //@note: The client and transport mutex must always be owned during this function.
+    void RouterCore::SendBroadcastMessage(const MessageBuffer &message,
+                                          const std::shared_ptr<IListenerTransport> &pSourceTransport,
+                                          const ConnectionInfo *pSourceConnection)
     {
-        const ClientId &srcClientId = message.header.srcClientId;
+        std::vector<ClientId> failedClients;
+        TransmitBroadcastMessage(message, pSourceTransport, pSourceConnection, &failedClients);
+
+        for (const ClientId failedClientId : failedClients)
+        {
+            RemoveClient(failedClientId);
+        }
+    }
 
-        ClientId lastFailedClient = kBroadcastClientId;
+    //@note: The client and transport mutex must always be owned during this function.
+    void RouterCore::TransmitBroadcastMessage(const MessageBuffer &message,
+                                              const std::shared_ptr<IListenerTransport> &pSourceTransport,
+                                              const ConnectionInfo *pSourceConnection,
+                                              std::vector<ClientId>* pFailedClients)
+    {
+        const ClientId &srcClientId = message.header.srcClientId;
 
         for (auto& pair : m_transportMap)
         {
@@ -166,32 +338,239 @@ namespace DevDriver
                 std::shared_ptr<IListenerTransport> &pTransport = context.pTransport;
                 if (pTransport->ForwardingConnection())
                 {
+                    // Forwarding transports fan the message out themselves, so they only ever see it once.
                     if (pTransport != pSourceTransport)
                     {
-                        pTransport->TransmitBroadcastMessage(message);
+                        const Result result = pTransport->TransmitBroadcastMessage(message);
+
+                        std::lock_guard<std::mutex> statsLock(m_statsMutex);
+                        TrafficStats &transportStats = m_transportStats[pair.first];
+                        if (result == Result::Success)
+                        {
+                            transportStats.messagesSent += 1;
+                            transportStats.bytesSent += MessageSizeInBytes(message);
+                        }
+                        else
+                        {
+                            transportStats.messagesDropped += 1;
+                        }
                     }
                 }
                 else if (context.clientMap.size() > 0)
                 {
+                    // Gather every destination on this transport so it can fan the message out in one batch.
+                    m_broadcastClientIds.clear();
+                    m_broadcastConnections.clear();
                     for (const auto &clientPair : context.clientMap)
                     {
-                        if (clientPair.first != srcClientId &&
-                            pTransport->TransmitMessage(clientPair.second, message) == Result::Error)
+                        if (clientPair.first != srcClientId)
+                        {
+                            m_broadcastClientIds.push_back(clientPair.first);
+                            m_broadcastConnections.push_back(&clientPair.second);
+                        }
+                    }
+
+                    const size_t numConnections = m_broadcastConnections.size();
+                    if (numConnections > 0)
+                    {
+                        m_broadcastResults.resize(numConnections);
+                        pTransport->TransmitMessageToConnections(m_broadcastConnections.data(),
+                                                                 numConnections,
+                                                                 message,
+                                                                 m_broadcastResults.data());
+
+                        const uint64 messageSize = MessageSizeInBytes(message);
+
+                        std::lock_guard<std::mutex> statsLock(m_statsMutex);
+                        TrafficStats &transportStats = m_transportStats[pair.first];
+                        for (size_t connectionIndex = 0; connectionIndex < numConnections; ++connectionIndex)
+                        {
+                            const ClientId clientId = m_broadcastClientIds[connectionIndex];
+                            TrafficStats &clientStats = m_clientStats[clientId];
+
+                            // Broadcasts are never retried, so anything that was not sent right away is lost.
+                            if (m_broadcastResults[connectionIndex] == Result::Success)
+                            {
+                                transportStats.messagesSent += 1;
+                                transportStats.bytesSent += messageSize;
+                                clientStats.messagesSent += 1;
+                                clientStats.bytesSent += messageSize;
+                            }
+                            else
+                            {
+                                transportStats.messagesDropped += 1;
+                                clientStats.messagesDropped += 1;
+
+                                if (m_broadcastResults[connectionIndex] == Result::Error)
+                                {
+                                    pFailedClients->push_back(clientId);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Federated routers receive the broadcast once and fan it out to their own clients. The router the message
+        // came from already did that for its side of the federation.
+        for (const RouterPeer &peer : m_routerPeers)
+        {
+            if ((pSourceConnection == nullptr) || !IsSameConnection(peer.connectionInfo, *pSourceConnection))
+            {
+                const auto &find = m_transportMap.find(peer.connectionInfo.handle);
+                if ((find != m_transportMap.end()) && (find->second.pTransport != nullptr))
+                {
+                    const Result result = find->second.pTransport->TransmitMessage(peer.connectionInfo, message);
+
+                    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+                    TrafficStats &transportStats = m_transportStats[peer.connectionInfo.handle];
+                    if (result == Result::Success)
+                    {
+                        transportStats.messagesSent += 1;
+                        transportStats.bytesSent += MessageSizeInBytes(message);
+                    }
+                    else
+                    {
+                        transportStats.messagesDropped += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    //@note: The clients mutex must always be owned during this function.
+    const RouterCore::PrefixRoute* RouterCore::FindPrefixRoute(ClientId clientId) const
+    {
+        const PrefixRoute* pRoute = nullptr;
+        if (IsRemoteClient(clientId))
+        {
+            const PrefixRoute &route = m_prefixRoutes[(clientId & kRouterPrefixMask) >> kRouterPrefixShift];
+            if (route.valid)
+            {
+                pRoute = &route;
+            }
+        }
+        return pRoute;
+    }
+
+    //@note: The client and transport mutex must always be owned during this function.
+    void RouterCore::ProcessRouterAnnounce(const MessageContext &messageContext)
+    {
+        using namespace DevDriver::ClientManagementProtocol;
+
+        const MessageBuffer &message = messageContext.message;
+        const ConnectionInfo &connectionInfo = messageContext.connectionInfo;
+
+        // Only routers we were configured to federate with may install routes. Anything else connected to a remote
+        // transport could otherwise take over another router's prefix.
+        bool knownPeer = false;
+        for (const RouterPeer &peer : m_routerPeers)
+        {
+            if (IsSameConnection(peer.connectionInfo, connectionInfo))
+            {
+                knownPeer = true;
+                break;
+            }
+        }
+
+        if (m_federationEnabled && (knownPeer == false))
+        {
+            DD_PRINT(LogLevel::Verbose, "[RouterCore] Dropped router announcement from an unknown peer");
+        }
+
+        if (m_federationEnabled && knownPeer && (message.header.payloadSize == sizeof(RouterAnnouncePayload)))
+        {
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+
+            const RouterAnnouncePayload* DD_RESTRICT pPayload = reinterpret_cast<const RouterAnnouncePayload*>(&message.payload[0]);
+            const uint32 numRoutes = Platform::Min(static_cast<uint32>(pPayload->numRoutes), kMaxRouterRoutes);
+            for (uint32 routeIndex = 0; routeIndex < numRoutes; ++routeIndex)
+            {
+                const ClientId routerPrefix = (pPayload->routes[routeIndex].routerPrefix & kRouterPrefixMask);
+                const uint32 hopCount = pPayload->routes[routeIndex].hopCount + 1u;
+
+                // Routes that are too long are treated as unreachable. This bounds how long a stale route can bounce
+                // between routers after the owner disappears.
+                if ((routerPrefix != m_routerPrefix) & (hopCount <= kMaxRouterHopCount))
+                {
+                    PrefixRoute &route = m_prefixRoutes[routerPrefix >> kRouterPrefixShift];
+                    const bool sameNextHop = (route.valid && IsSameConnection(route.nextHop, connectionInfo));
+
+                    // Always take updates from the current next hop, even if the route got longer, and otherwise only
+                    // switch over to strictly shorter routes.
+                    if ((route.valid == false) || sameNextHop || (hopCount < route.hopCount))
+                    {
+                        if ((sameNextHop == false) || (hopCount != route.hopCount))
                         {
-                            lastFailedClient = clientPair.first;
+                            DD_PRINT(LogLevel::Info,
+                                     "[RouterCore] Routing prefix 0x%x via %s (%u hops)",
+                                     routerPrefix,
+                                     m_transportMap.at(connectionInfo.handle).pTransport->GetTransportName(),
+                                     hopCount);
+                            m_routeGeneration.fetch_add(1, std::memory_order_acq_rel);
                         }
+
+                        route.nextHop = connectionInfo;
+                        route.hopCount = hopCount;
+                        route.lastUpdateTimeInMs = currentTimeInMs;
+                        route.valid = true;
                     }
                 }
             }
         }
+    }
+
+    //@note: The client and transport mutex must always be owned during this function.
+    void RouterCore::AnnounceRoutes(uint64 currentTimeInMs)
+    {
+        using namespace DevDriver::ClientManagementProtocol;
+
+        const uint64 routeTimeoutInMs = (kClientDiscoveryIntervalInMs * kRouterTimeoutCount);
 
-        // this is technically recursive - every time a write fails, it will call SendBroadcastMessage to announce the client disconnect
-        // which will then traverse the list of clients and trigger additional failures.
-        if (lastFailedClient != kBroadcastClientId)
+        for (uint32 prefixIndex = 0; prefixIndex < kMaxRouterPrefixes; ++prefixIndex)
         {
-            RemoveClient(lastFailedClient);
+            PrefixRoute &route = m_prefixRoutes[prefixIndex];
+            if (route.valid && ((currentTimeInMs - route.lastUpdateTimeInMs) > routeTimeoutInMs))
+            {
+                DD_PRINT(LogLevel::Info, "[RouterCore] Route to prefix 0x%x timed out", (prefixIndex << kRouterPrefixShift));
+                route.valid = false;
+                m_routeGeneration.fetch_add(1, std::memory_order_acq_rel);
+            }
         }
 
+        for (const RouterPeer &peer : m_routerPeers)
+        {
+            const auto &find = m_transportMap.find(peer.connectionInfo.handle);
+            if ((find != m_transportMap.end()) && (find->second.pTransport != nullptr))
+            {
+                MessageBuffer messageBuffer = kOutOfBandMessage;
+                messageBuffer.header.messageId = static_cast<MessageCode>(ManagementMessage::RouterAnnounce);
+                messageBuffer.header.payloadSize = sizeof(RouterAnnouncePayload);
+
+                RouterAnnouncePayload* DD_RESTRICT pPayload = reinterpret_cast<RouterAnnouncePayload*>(&messageBuffer.payload[0]);
+                memset(pPayload, 0, sizeof(RouterAnnouncePayload));
+
+                pPayload->routes[0].routerPrefix = m_routerPrefix;
+                pPayload->routes[0].hopCount = 0;
+                uint32 numRoutes = 1;
+
+                // Never announce a route back to the peer it was learned from.
+                for (uint32 prefixIndex = 0; prefixIndex < kMaxRouterPrefixes; ++prefixIndex)
+                {
+                    const PrefixRoute &route = m_prefixRoutes[prefixIndex];
+                    if (route.valid && !IsSameConnection(route.nextHop, peer.connectionInfo))
+                    {
+                        pPayload->routes[numRoutes].routerPrefix = static_cast<ClientId>(prefixIndex << kRouterPrefixShift);
+                        pPayload->routes[numRoutes].hopCount = static_cast<uint8>(route.hopCount);
+                        ++numRoutes;
+                    }
+                }
+                pPayload->numRoutes = static_cast<uint8>(numRoutes);
+
+                find->second.pTransport->TransmitMessage(peer.connectionInfo, messageBuffer);
+            }
+        }
     }
 
     void RouterCore::ProcessRouterMessage(const MessageContext &messageContext)
@@ -218,6 +597,13 @@ namespace DevDriver
 
                 ClientContext* pSrcClientInfo = FindClientById(srcClientId);
 
+                // Any system message shows that the client is still there, not just a pong.
+                if (pSrcClientInfo != nullptr)
+                {
+                    pSrcClientInfo->pingRetryCount = 0;
+                    pSrcClientInfo->lastActivityTimeInMs = Platform::GetCurrentTimeInMs();
+                }
+
                 if ((pSrcClientInfo == nullptr) &
                     (static_cast<SystemMessage>(messageHeader.messageId) != SystemMessage::ClientDisconnected))
                 {
@@ -248,8 +634,6 @@ namespace DevDriver
                 {
                     if (pSrcClientInfo != nullptr)
                     {
-                        // Update the last response time if we already know about this client.
-                        pSrcClientInfo->receivedPong = true;
                         if (!pSrcClientInfo->clientInfo.hasBeenIdentified)
                         {
                             queryClientInfo = true;
@@ -270,10 +654,8 @@ namespace DevDriver
                         pSrcClientInfo->clientInfo.clientPid = pPayload->processId;
                     }
 
-                    pSrcClientInfo->pingRetryCount = 0;
-                    pSrcClientInfo->receivedPong = true;
-
                     pSrcClientInfo->clientInfo.hasBeenIdentified = true;
+                    PublishClientListChange(ClientListChangeType::Updated, pSrcClientInfo->clientInfo);
                     queryClientInfo = false;
                     break;
                 }
@@ -302,7 +684,9 @@ namespace DevDriver
     }
 
     /////////////////////////////
-    // Periodically sends client discovery packets into the network to keep the local client list up to date.
+    // Periodically checks that clients are still alive. Clients that have sent anything recently are left alone, only
+    // silent ones are pinged directly. Transports that see a connection close remove its clients through
+    // RemoveConnection, so most disconnects never get this far.
     void RouterCore::UpdateClients()
     {
         // Check if the update interval has been reached.
@@ -311,14 +695,34 @@ namespace DevDriver
         {
             std::lock_guard<std::mutex> clientLock(m_clientMutex);
 
+            // Pick up the clients whose traffic was routed by the transport threads since the last check.
+            std::vector<ClientId> activeClients;
+            {
+                std::lock_guard<std::mutex> statsLock(m_statsMutex);
+                activeClients.swap(m_activeClients);
+            }
+
+            for (const ClientId activeClientId : activeClients)
+            {
+                ClientContext* pClientInfo = FindClientById(activeClientId);
+                if (pClientInfo != nullptr)
+                {
+                    pClientInfo->pingRetryCount = 0;
+                    pClientInfo->lastActivityTimeInMs = currentTimeInMs;
+                }
+            }
+
+            // Clients that fail to receive a disconnect announcement are removed once we're done walking the map.
+            std::vector<ClientId> failedClients;
+            std::vector<ClientId> silentClients;
+
             for (auto it = m_clientMap.begin(); it != m_clientMap.end(); )
             {
                 const ClientId &clientId = it->first;
                 const TransportHandle &tHandle = it->second.connectionInfo.handle;
-                if (it->second.receivedPong)
+                if ((currentTimeInMs - it->second.lastActivityTimeInMs) < kClientDiscoveryIntervalInMs)
                 {
                     it->second.pingRetryCount = 0;
-                    it->second.receivedPong = false;
                 }
                 else
                 {
@@ -335,7 +739,7 @@ namespace DevDriver
                         auto &transport = find->second;
                         if (transport.pTransport != nullptr)
                         {
-                            if (transport.clientMap.erase(clientId) > 0)
+                            if (transport.RemoveClient(clientId))
                             {
                                 DD_PRINT(LogLevel::Info,
                                          "[RouterCore] Client %u timed out from %s",
@@ -353,23 +757,27 @@ namespace DevDriver
                         messageBuffer.header.protocolId = Protocol::System;
                         messageBuffer.header.messageId = static_cast<MessageCode>(SystemProtocol::SystemMessage::ClientDisconnected);
                         messageBuffer.header.payloadSize = 0;
-                        SendBroadcastMessage(messageBuffer, nullptr);
+                        TransmitBroadcastMessage(messageBuffer, nullptr, nullptr, &failedClients);
                     }
+                    PublishClientListChange(ClientListChangeType::Disconnected, it->second.clientInfo);
+                    RemoveClientSessions(clientId);
                     it = m_clientMap.erase(it);
                 }
                 else
                 {
+                    if (it->second.pingRetryCount > 0)
+                    {
+                        silentClients.push_back(clientId);
+                    }
                     ++it;
                 }
             }
 
             m_lastClientPingTimeInMs = currentTimeInMs;
 
-            // Broadcast a client discovery request into the local network.
             MessageBuffer messageBuffer = {};
 
             messageBuffer.header.srcClientId = m_clientId;
-            messageBuffer.header.dstClientId = kBroadcastClientId;
             messageBuffer.header.protocolId = Protocol::System;
             messageBuffer.header.messageId = static_cast<MessageCode>(SystemProtocol::SystemMessage::Ping);
             messageBuffer.header.sessionId = kInvalidSessionId;
@@ -377,8 +785,36 @@ namespace DevDriver
             messageBuffer.header.payloadSize = 0;
 
             std::lock_guard<std::mutex> transportLock(m_transportMutex);
-            SendBroadcastMessage(messageBuffer, nullptr);
-            // Update the last client discovery time.
+
+            // Ping each silent client directly. Remote clients are pinged through the router that owns them.
+            for (const ClientId silentClientId : silentClients)
+            {
+                const ClientContext* pClientInfo = FindClientById(silentClientId);
+                const auto &find = m_transportMap.find(pClientInfo->connectionInfo.handle);
+                if ((find != m_transportMap.end()) && (find->second.pTransport != nullptr))
+                {
+                    messageBuffer.header.dstClientId = silentClientId;
+                    if (find->second.pTransport->TransmitMessage(pClientInfo->connectionInfo, messageBuffer) == Result::Error)
+                    {
+                        failedClients.push_back(silentClientId);
+                    }
+                }
+            }
+
+            for (const ClientId failedClientId : failedClients)
+            {
+                RemoveClient(failedClientId);
+            }
+            AnnounceRoutes(currentTimeInMs);
+
+            // Broadcast a client discovery request into the local network to find clients that never announced
+            // themselves to us.
+            if ((currentTimeInMs - kClientDiscoveryBroadcastIntervalInMs) >= m_lastDiscoveryBroadcastTimeInMs)
+            {
+                messageBuffer.header.dstClientId = kBroadcastClientId;
+                SendBroadcastMessage(messageBuffer, nullptr, nullptr);
+                m_lastDiscoveryBroadcastTimeInMs = currentTimeInMs;
+            }
         }
     }
 
@@ -422,6 +858,15 @@ namespace DevDriver
             {
                 // keepalive packet, discard
                 DD_PRINT(LogLevel::Debug, "Received keep alive packet seq %u", messageHeader.sessionId);
+
+                // Keep alives double as liveness for the client on the connection so it never needs to be pinged.
+                ClientContext* pExternalClientInfo = FindExternalClientByConnection(messageContext.connectionInfo);
+                if (pExternalClientInfo != nullptr)
+                {
+                    pExternalClientInfo->pingRetryCount = 0;
+                    pExternalClientInfo->lastActivityTimeInMs = Platform::GetCurrentTimeInMs();
+                }
+
                 MessageBuffer messageBuffer = kOutOfBandMessage;
                 // this assumes that these are valid for the protocol
                 messageBuffer.header.messageId = static_cast<MessageCode>(ManagementMessage::KeepAlive);
@@ -429,6 +874,11 @@ namespace DevDriver
                 messageBuffer.header.sessionId = messageHeader.sessionId;
                 do {} while (pTransport->TransmitMessage(messageContext.connectionInfo, messageBuffer) == Result::NotReady);
                 return;
+            } else if (IsOutOfBandMessage(message) & IsValidOutOfBandMessage(message) &
+                (static_cast<ManagementMessage>(messageHeader.messageId) == ManagementMessage::RouterAnnounce))
+            {
+                ProcessRouterAnnounce(messageContext);
+                return;
             }
 
             const auto &srcClientId = messageHeader.srcClientId;
@@ -466,7 +916,7 @@ namespace DevDriver
                             messageBuffer.header.protocolId = Protocol::System;
                             messageBuffer.header.messageId = static_cast<MessageCode>(SystemProtocol::SystemMessage::ClientConnected);
                             messageBuffer.header.payloadSize = 0;
-                            SendBroadcastMessage(messageBuffer, nullptr);
+                            SendBroadcastMessage(messageBuffer, nullptr, nullptr);
                         }
                     }
                     else
@@ -629,11 +1079,25 @@ namespace DevDriver
         return false;
     }
 
-    bool RouterCore::ConnectionInfoForClientId(ClientId clientId, ConnectionInfo *pConnectionInfo)
+    bool RouterCore::ConnectionInfoForClientId(ClientId clientId, ConnectionInfo *pConnectionInfo, bool *pRemoteClient)
     {
         if (clientId == kBroadcastClientId)
             return false;
         std::lock_guard<std::mutex> clientLock(m_clientMutex);
+
+        // Clients owned by another router are always reached through the next hop towards that router.
+        *pRemoteClient = IsRemoteClient(clientId);
+        if (*pRemoteClient)
+        {
+            const PrefixRoute* pRoute = FindPrefixRoute(clientId);
+            if (pRoute != nullptr)
+            {
+                *pConnectionInfo = pRoute->nextHop;
+                return true;
+            }
+            return false;
+        }
+
         ClientContext* pClientInfo = FindClientById(clientId);
         if (pClientInfo != nullptr)
         {
@@ -662,13 +1126,25 @@ namespace DevDriver
         std::lock_guard<std::mutex> clientLock(m_clientMutex);
         std::lock_guard<std::mutex> transportLock(m_transportMutex);
 
+        // Only accept broadcasts from remote clients when they arrive from the next hop towards their router. Any
+        // other copy took a longer path through the federation, and forwarding it would let broadcasts circle
+        // forever when the routers are connected in a loop.
+        if (IsRemoteClient(msgContext.message.header.srcClientId))
+        {
+            const PrefixRoute* pRoute = FindPrefixRoute(msgContext.message.header.srcClientId);
+            if ((pRoute == nullptr) || !IsSameConnection(pRoute->nextHop, msgContext.connectionInfo))
+            {
+                return;
+            }
+        }
+
         std::shared_ptr<IListenerTransport> pSourceTransport;
         const auto &find = m_transportMap.find(msgContext.connectionInfo.handle);
         if (find != m_transportMap.end())
         {
             pSourceTransport = find->second.pTransport;
         }
-        SendBroadcastMessage(msgContext.message, pSourceTransport);
+        SendBroadcastMessage(msgContext.message, pSourceTransport, &msgContext.connectionInfo);
     }
 
     void RouterCore::RouteInternalMessage(const MessageContext & recvMsgContext)
@@ -716,33 +1192,437 @@ namespace DevDriver
                 messageBuffer.clear();
             }
             UpdateClients();
+            LogRouterStats();
         }
     }
 
     std::vector<ClientInfo> RouterCore::GetConnectedClientList()
     {
-        std::vector<ClientInfo> result = std::vector<ClientInfo>();
-        std::lock_guard<std::mutex> lock(m_clientMutex);
+        return GetClientListSnapshot()->clients;
+    }
+
+    std::shared_ptr<const ClientListSnapshot> RouterCore::GetClientListSnapshot() const
+    {
+        return std::atomic_load(&m_pClientListSnapshot);
+    }
+
+    Result RouterCore::GetClientListChanges(uint64 sinceVersion, std::vector<ClientListChange>* pChanges, uint64* pVersion) const
+    {
+        DD_ASSERT(pChanges != nullptr);
+        DD_ASSERT(pVersion != nullptr);
+
+        Result result = Result::Success;
 
-        result.reserve(m_clientMap.size());
-        for (const auto& pair : m_clientMap)
+        const std::shared_ptr<const ClientListSnapshot> pSnapshot = GetClientListSnapshot();
+        *pVersion = pSnapshot->version;
+        pChanges->clear();
+
+        if (sinceVersion < pSnapshot->version)
         {
-            if (pair.first != m_clientId)
+            // The history has to reach back to the change right after sinceVersion, otherwise some were dropped.
+            const std::vector<ClientListChange> &recentChanges = pSnapshot->recentChanges;
+            if (recentChanges.empty() || (recentChanges.front().version > (sinceVersion + 1)))
+            {
+                result = Result::Unavailable;
+            }
+            else
             {
-                result.emplace_back(pair.second.clientInfo);
+                for (const ClientListChange &change : recentChanges)
+                {
+                    if (change.version > sinceVersion)
+                    {
+                        pChanges->push_back(change);
+                    }
+                }
             }
         }
+        else if (sinceVersion > pSnapshot->version)
+        {
+            // The caller has a version from a previous run of the router.
+            result = Result::Unavailable;
+        }
 
-        //clientLock.unlock();
         return result;
     }
 
-    RouterCore::RouterCore() :
-        m_pClientManager(nullptr),
-        m_lastTransportId(0),
-        m_lastClientPingTimeInMs(0),
-        m_clientThread(),
-        m_clientInfoResponse()
+    //@note: The clients mutex must always be owned during this function.
+    // Publishes a new client list snapshot with a single change applied to the current one.
+    void RouterCore::PublishClientListChange(ClientListChangeType type, const ClientInfo &clientInfo)
+    {
+        if (clientInfo.clientId != m_clientId)
+        {
+            const std::shared_ptr<const ClientListSnapshot> pCurrent = std::atomic_load(&m_pClientListSnapshot);
+            std::shared_ptr<ClientListSnapshot> pNext = std::make_shared<ClientListSnapshot>();
+            pNext->version = pCurrent->version + 1;
+
+            // Clients keep their position in the list when they are updated.
+            bool found = false;
+            pNext->clients.reserve(pCurrent->clients.size() + 1);
+            for (const ClientInfo &currentClientInfo : pCurrent->clients)
+            {
+                if (currentClientInfo.clientId != clientInfo.clientId)
+                {
+                    pNext->clients.push_back(currentClientInfo);
+                }
+                else if (type != ClientListChangeType::Disconnected)
+                {
+                    pNext->clients.push_back(clientInfo);
+                    found = true;
+                }
+            }
+
+            if (!found && (type != ClientListChangeType::Disconnected))
+            {
+                pNext->clients.push_back(clientInfo);
+            }
+
+            const size_t firstRetainedChange = (pCurrent->recentChanges.size() >= kMaxClientListChanges) ? 1 : 0;
+            pNext->recentChanges.assign(pCurrent->recentChanges.begin() + firstRetainedChange, pCurrent->recentChanges.end());
+
+            ClientListChange change = {};
+            change.version = pNext->version;
+            change.type = type;
+            change.clientInfo = clientInfo;
+            pNext->recentChanges.push_back(change);
+
+            std::atomic_store(&m_pClientListSnapshot, std::shared_ptr<const ClientListSnapshot>(std::move(pNext)));
+        }
+    }
+
+    RouterStats RouterCore::GetRouterStats()
+    {
+        RouterStats stats = {};
+
+        std::lock_guard<std::mutex> clientLock(m_clientMutex);
+        std::lock_guard<std::mutex> transportLock(m_transportMutex);
+        std::lock_guard<std::mutex> statsLock(m_statsMutex);
+
+        // Counters can still be merged in for transports and clients that have gone away. They are dropped here
+        // so that the maps only ever track what is currently connected.
+        for (auto it = m_transportStats.begin(); it != m_transportStats.end(); )
+        {
+            const auto &find = m_transportMap.find(it->first);
+            if ((find != m_transportMap.end()) && (find->second.pTransport != nullptr))
+            {
+                TransportTrafficStats transportStats = {};
+                transportStats.handle = it->first;
+                transportStats.name = find->second.pTransport->GetTransportName();
+                transportStats.traffic = it->second;
+                stats.transports.emplace_back(transportStats);
+                ++it;
+            }
+            else
+            {
+                it = m_transportStats.erase(it);
+            }
+        }
+
+        for (auto it = m_clientStats.begin(); it != m_clientStats.end(); )
+        {
+            if ((it->first != m_clientId) && (m_clientMap.find(it->first) != m_clientMap.end()))
+            {
+                ClientTrafficStats clientStats = {};
+                clientStats.clientId = it->first;
+                clientStats.traffic = it->second;
+                stats.clients.emplace_back(clientStats);
+                ++it;
+            }
+            else
+            {
+                it = m_clientStats.erase(it);
+            }
+        }
+
+        memcpy(stats.routingLatencyHistogram, m_routingLatencyHistogram, sizeof(m_routingLatencyHistogram));
+
+        std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+        stats.numSessions = m_sessionProtocols.size();
+
+        return stats;
+    }
+
+    Result RouterCore::AddRouterPeer(const ConnectionInfo &connectionInfo)
+    {
+        Result result = Result::Error;
+
+        std::lock_guard<std::mutex> clientLock(m_clientMutex);
+        std::lock_guard<std::mutex> transportLock(m_transportMutex);
+
+        const auto &find = m_transportMap.find(connectionInfo.handle);
+        if ((find != m_transportMap.end()) && (find->second.pTransport != nullptr))
+        {
+            const RouterPeer peer = { connectionInfo };
+            m_routerPeers.push_back(peer);
+
+            DD_PRINT(LogLevel::Verbose, "[RouterCore] Added router peer via %s", find->second.pTransport->GetTransportName());
+            result = Result::Success;
+        }
+
+        return result;
+    }
+
+    RouterRateLimits RouterCore::GetRateLimits()
+    {
+        std::lock_guard<std::mutex> rateLimitLock(m_rateLimitMutex);
+        return m_rateLimits;
+    }
+
+    std::shared_ptr<const SessionProtocolMap> RouterCore::GetSessionProtocols()
+    {
+        // Every transport thread reads the same snapshot, so the map is only copied once per change.
+        std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+        if (m_pSessionProtocolSnapshot == nullptr)
+        {
+            m_pSessionProtocolSnapshot = std::make_shared<const SessionProtocolMap>(m_sessionProtocols);
+        }
+        return m_pSessionProtocolSnapshot;
+    }
+
+    void RouterCore::TrackSessionMessage(const MessageBuffer &message)
+    {
+        using namespace SessionProtocol;
+
+        // Bounds the number of sessions that each client can have tracked. Sessions are normally forgotten when one
+        // of their clients disconnects, so this is only reached if a client leaks sessions. The oldest sessions of
+        // that client are forgotten first.
+        DD_STATIC_CONST size_t kMaxTrackedSessionsPerClient = 256;
+
+        const SessionMessage command = static_cast<SessionMessage>(message.header.messageId);
+        const ClientId srcClientId = message.header.srcClientId;
+        const ClientId dstClientId = message.header.dstClientId;
+
+        if ((command == SessionMessage::Syn) && (message.header.payloadSize >= sizeof(SynPayload)))
+        {
+            // The Syn carries the protocol along with the session id picked by the client.
+            const SynPayload* pPayload = reinterpret_cast<const SynPayload*>(&message.payload[0]);
+            const uint64 key = SessionKey(srcClientId, dstClientId, message.header.sessionId);
+
+            std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+            const auto insert = m_pendingSessionProtocols.emplace(key, static_cast<uint32>(pPayload->protocol));
+            if (insert.second)
+            {
+                uint64 evictedKey = 0;
+                if (PushTrackedSession(&m_trackedSessions[srcClientId].pending,
+                                       key,
+                                       kMaxTrackedSessionsPerClient,
+                                       &evictedKey))
+                {
+                    m_pendingSessionProtocols.erase(evictedKey);
+                }
+            }
+            else
+            {
+                insert.first->second = static_cast<uint32>(pPayload->protocol);
+            }
+        }
+        else if ((command == SessionMessage::SynAck) && (message.header.payloadSize >= sizeof(SynAckPayload)))
+        {
+            // The SynAck carries the session id that both sides use from now on along with the client's original one.
+            // It travels back to the client that sent the Syn.
+            const SynAckPayload* pPayload = reinterpret_cast<const SynAckPayload*>(&message.payload[0]);
+            const uint64 pendingKey = SessionKey(srcClientId, dstClientId, pPayload->initialSessionId);
+            const uint64 key = SessionKey(srcClientId, dstClientId, message.header.sessionId);
+
+            std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+            const auto find = m_pendingSessionProtocols.find(pendingKey);
+            if (find != m_pendingSessionProtocols.end())
+            {
+                TrackedSessions &tracked = m_trackedSessions[dstClientId];
+                RemoveTrackedSession(&tracked.pending, pendingKey);
+
+                const auto insert = m_sessionProtocols.emplace(key, find->second);
+                if (insert.second)
+                {
+                    uint64 evictedKey = 0;
+                    if (PushTrackedSession(&tracked.established, key, kMaxTrackedSessionsPerClient, &evictedKey))
+                    {
+                        m_sessionProtocols.erase(evictedKey);
+                    }
+                }
+                else
+                {
+                    insert.first->second = find->second;
+                }
+
+                m_pendingSessionProtocols.erase(find);
+                m_pSessionProtocolSnapshot.reset();
+                m_sessionGeneration.fetch_add(1, std::memory_order_release);
+            }
+        }
+        else if (command == SessionMessage::Rst)
+        {
+            const uint64 key = SessionKey(srcClientId, dstClientId, message.header.sessionId);
+
+            std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+            if (m_sessionProtocols.erase(key) > 0)
+            {
+                // Either side may reset the session, so look at both clients.
+                for (const ClientId clientId : { srcClientId, dstClientId })
+                {
+                    const auto find = m_trackedSessions.find(clientId);
+                    if (find != m_trackedSessions.end())
+                    {
+                        RemoveTrackedSession(&find->second.established, key);
+                    }
+                }
+                m_pSessionProtocolSnapshot.reset();
+                m_sessionGeneration.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    void RouterCore::RemoveClientSessions(ClientId clientId)
+    {
+        // Both client ids are stored in the upper 32 bits of the session key.
+        const auto hasClient = [clientId](uint64 key) -> bool
+        {
+            return ((static_cast<ClientId>(key >> 48) == clientId) || (static_cast<ClientId>(key >> 32) == clientId));
+        };
+
+        std::lock_guard<std::mutex> sessionLock(m_sessionMutex);
+
+        for (auto iter = m_pendingSessionProtocols.begin(); iter != m_pendingSessionProtocols.end(); )
+        {
+            iter = hasClient(iter->first) ? m_pendingSessionProtocols.erase(iter) : std::next(iter);
+        }
+
+        m_trackedSessions.erase(clientId);
+        for (auto &tracked : m_trackedSessions)
+        {
+            std::deque<uint64> &pending = tracked.second.pending;
+            std::deque<uint64> &established = tracked.second.established;
+            pending.erase(std::remove_if(pending.begin(), pending.end(), hasClient), pending.end());
+            established.erase(std::remove_if(established.begin(), established.end(), hasClient), established.end());
+        }
+
+        bool removedSession = false;
+        for (auto iter = m_sessionProtocols.begin(); iter != m_sessionProtocols.end(); )
+        {
+            if (hasClient(iter->first))
+            {
+                iter = m_sessionProtocols.erase(iter);
+                removedSession = true;
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        if (removedSession)
+        {
+            m_pSessionProtocolSnapshot.reset();
+            m_sessionGeneration.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void RouterCore::MergeTrafficStats(const PendingTrafficStats &stats)
+    {
+        std::lock_guard<std::mutex> statsLock(m_statsMutex);
+
+        for (const auto &pair : stats.transports)
+        {
+            AccumulateTrafficStats(&m_transportStats[pair.first], pair.second);
+        }
+
+        for (const auto &pair : stats.clients)
+        {
+            AccumulateTrafficStats(&m_clientStats[pair.first], pair.second);
+
+            // Routed traffic proves the sender is alive without the router having to ask.
+            if (pair.second.messagesReceived > 0)
+            {
+                m_activeClients.push_back(pair.first);
+            }
+        }
+
+        for (uint32 bucket = 0; bucket < kNumRoutingLatencyBuckets; ++bucket)
+        {
+            m_routingLatencyHistogram[bucket] += stats.routingLatencyHistogram[bucket];
+        }
+    }
+
+    /////////////////////////////
+    // Periodically logs a summary of the router's traffic counters while there is traffic to report.
+    void RouterCore::LogRouterStats()
+    {
+        const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+        if ((currentTimeInMs - m_lastStatsLogTimeInMs) >= kStatsLogIntervalInMs)
+        {
+            m_lastStatsLogTimeInMs = currentTimeInMs;
+
+            const RouterStats stats = GetRouterStats();
+
+            uint64 routedMessages = 0;
+            for (uint32 bucket = 0; bucket < kNumRoutingLatencyBuckets; ++bucket)
+            {
+                routedMessages += stats.routingLatencyHistogram[bucket];
+            }
+
+            if (routedMessages != m_lastLoggedMessageCount)
+            {
+                m_lastLoggedMessageCount = routedMessages;
+
+                TrafficStats totals = {};
+                for (const TransportTrafficStats &transportStats : stats.transports)
+                {
+                    AccumulateTrafficStats(&totals, transportStats.traffic);
+                }
+
+                // Find the histogram buckets containing the median and 99th percentile routing times.
+                uint32 medianBucket = 0;
+                uint32 tailBucket = 0;
+                uint64 countedMessages = 0;
+                for (uint32 bucket = 0; bucket < kNumRoutingLatencyBuckets; ++bucket)
+                {
+                    if (countedMessages < ((routedMessages + 1) / 2))
+                    {
+                        medianBucket = bucket;
+                    }
+                    if (countedMessages < (routedMessages - (routedMessages / 100)))
+                    {
+                        tailBucket = bucket;
+                    }
+                    countedMessages += stats.routingLatencyHistogram[bucket];
+                }
+
+                DD_PRINT(LogLevel::Info,
+                         "[RouterCore] %zu transports, %zu clients: %llu msgs (%llu bytes) in, %llu msgs (%llu bytes) out, "
+                         "%llu retried, %llu dropped, %llu throttled, %lld queued, p50 < %lluus, p99 < %lluus",
+                         stats.transports.size(),
+                         stats.clients.size(),
+                         totals.messagesReceived,
+                         totals.bytesReceived,
+                         totals.messagesSent,
+                         totals.bytesSent,
+                         totals.messagesRetried,
+                         totals.messagesDropped,
+                         totals.messagesThrottled,
+                         totals.queuedMessages,
+                         (1ull << medianBucket),
+                         (1ull << tailBucket));
+            }
+        }
+    }
+
+    RouterCore::RouterCore() :
+        m_pClientListSnapshot(std::make_shared<ClientListSnapshot>()),
+        m_pClientManager(nullptr),
+        m_lastTransportId(0),
+        m_lastClientPingTimeInMs(0),
+        m_lastDiscoveryBroadcastTimeInMs(0),
+        m_clientThread(),
+        m_clientInfoResponse(),
+        m_routingLatencyHistogram(),
+        m_lastStatsLogTimeInMs(0),
+        m_lastLoggedMessageCount(0),
+        m_federationEnabled(false),
+        m_routerPrefix(0),
+        m_prefixRoutes(),
+        m_routeGeneration(0),
+        m_rateLimits(),
+        m_rateLimitGeneration(0),
+        m_sessionGeneration(0)
     {
 
     }
@@ -763,6 +1643,31 @@ namespace DevDriver
         {
             // Initialize the last discovery time to the current time - some offset.
             m_lastClientPingTimeInMs = 0;
+            m_lastDiscoveryBroadcastTimeInMs = 0;
+
+            {
+                std::lock_guard<std::mutex> clientLock(m_clientMutex);
+                m_federationEnabled = startInfo.enableFederation;
+                m_routerPrefix = (m_clientId & kRouterPrefixMask);
+            }
+
+            if (m_federationEnabled)
+            {
+                DD_PRINT(LogLevel::Info, "[RouterCore] Federation enabled with router prefix 0x%x", m_routerPrefix);
+            }
+
+            {
+                std::lock_guard<std::mutex> rateLimitLock(m_rateLimitMutex);
+                m_rateLimits = startInfo.rateLimits;
+                m_rateLimitGeneration.fetch_add(1, std::memory_order_release);
+            }
+
+            if (IsRateLimitEnabled(startInfo.rateLimits.clientLimit))
+            {
+                DD_PRINT(LogLevel::Info,
+                         "[RouterCore] Limiting each client to %u messages per second",
+                         startInfo.rateLimits.clientLimit.messagesPerSecond);
+            }
 
             m_clientThread.active = true;
             m_clientThread.thread = std::thread(&DevDriver::RouterCore::RouterThreadFunc, this, std::ref(m_clientThread));
@@ -832,6 +1737,7 @@ namespace DevDriver
         Result result = Result::Error;
 
         TransportHandle tHandle = pTransport->GetHandle();
+        std::unique_lock<std::mutex> clientLock(m_clientMutex);
         std::unique_lock<std::mutex> transportLock(m_transportMutex);
 
         const auto &find = m_transportMap.find(tHandle);
@@ -842,12 +1748,28 @@ namespace DevDriver
             {
                 RemoveClient(pair.first);
             }
+
+            // Forget every peer and route that went through the transport.
+            for (auto it = m_routerPeers.begin(); it != m_routerPeers.end(); )
+            {
+                it = (it->connectionInfo.handle == tHandle) ? m_routerPeers.erase(it) : (it + 1);
+            }
+            for (PrefixRoute &route : m_prefixRoutes)
+            {
+                if (route.valid && (route.nextHop.handle == tHandle))
+                {
+                    route.valid = false;
+                    m_routeGeneration.fetch_add(1, std::memory_order_acq_rel);
+                }
+            }
+
             m_transportMap.erase(tHandle);
             DD_PRINT(LogLevel::Verbose, "[RouterCore] Removing transport: %s", pTransport->GetTransportName());
             result = Result::Success;
         }
 
         transportLock.unlock();
+        clientLock.unlock();
 
         if (result == Result::Success)
         {
@@ -856,6 +1778,36 @@ namespace DevDriver
         return result;
     }
 
+    // Removes the clients that were using a connection the transport has seen close. Transports that own a
+    // connection per client call this so that disconnects are handled immediately instead of by ping timeouts.
+    // Must not be called while the router is calling into the transport.
+    Result RouterCore::RemoveConnection(const ConnectionInfo &connectionInfo)
+    {
+        Result result = Result::Error;
+
+        std::lock_guard<std::mutex> clientLock(m_clientMutex);
+        std::lock_guard<std::mutex> transportLock(m_transportMutex);
+
+        const auto &find = m_transportMap.find(connectionInfo.handle);
+        if (find != m_transportMap.end())
+        {
+            std::vector<ClientId> connectionClients;
+            const auto range = find->second.connectionIndex.equal_range(connectionInfo);
+            for (auto iter = range.first; iter != range.second; ++iter)
+            {
+                connectionClients.push_back(iter->second);
+            }
+
+            for (const ClientId clientId : connectionClients)
+            {
+                RemoveClient(clientId);
+            }
+            result = Result::Success;
+        }
+
+        return result;
+    }
+
     void RouterCore::Stop()
     {
         DD_ASSERT(m_pClientManager != nullptr);
@@ -898,12 +1850,52 @@ namespace DevDriver
         }
     }
 
+    RoutingCache::RoutingCache(RouterCore *pRouter) :
+        m_pRouter(pRouter),
+        m_pendingStats()
+    {
+        m_lastStatsFlushTimeInMs = Platform::GetCurrentTimeInMs();
+    }
+
+    RoutingCache::~RoutingCache()
+    {
+        FlushStats(true);
+    }
+
+    bool RoutingCache::ReceiveMessage(const MessageContext & messageContext)
+    {
+        const ClientId &srcClientId = messageContext.message.header.srcClientId;
+        DD_ASSERT(messageContext.connectionInfo.handle != 0);
+
+        const uint64 messageSize = MessageSizeInBytes(messageContext.message);
+        TrafficStats &transportStats = m_pendingStats.transports[messageContext.connectionInfo.handle];
+        transportStats.messagesReceived += 1;
+        transportStats.bytesReceived += messageSize;
+        if (srcClientId != kBroadcastClientId)
+        {
+            TrafficStats &clientStats = m_pendingStats.clients[srcClientId];
+            clientStats.messagesReceived += 1;
+            clientStats.bytesReceived += messageSize;
+        }
+        m_hasPendingStats = true;
+
+        // Remember which protocol opened each session so session traffic can be rate limited by protocol.
+        if (messageContext.message.header.protocolId == Protocol::Session)
+        {
+            m_pRouter->TrackSessionMessage(messageContext.message);
+        }
+
+        return m_pRouter->IsRoutableMessage(messageContext);
+    }
+
     Result RoutingCache::RouteMessage(const MessageContext & messageContext)
     {
+        const auto startTime = std::chrono::steady_clock::now();
+
         Result result = Result::Unavailable;
         const ClientId &dstClientId = messageContext.message.header.dstClientId;
-        DD_ASSERT(messageContext.connectionInfo.handle != 0);
-        if (m_pRouter->IsRoutableMessage(messageContext))
+
+        if (ReceiveMessage(messageContext))
         {
             // If it's a broadcast message, we punt this over to the RouterCore since it has the current list of
             // all transports. This needs to be updated sometime to improve performance and minimize locking, but
@@ -915,70 +1907,596 @@ namespace DevDriver
             }
             else
             {
-                // If it is a directed message, we check to see if it's the same as the last client we talked to. That
-                // lets us skip the overhead of looking up the connection info for every packet during burst traffic
-                // situations
-                if (m_currentClientId != dstClientId)
+                result = TransmitDirectedMessage(messageContext);
+            }
+        }
+
+        const auto routingTime = std::chrono::steady_clock::now() - startTime;
+        const uint64 routingTimeInUs = std::chrono::duration_cast<std::chrono::microseconds>(routingTime).count();
+        m_pendingStats.routingLatencyHistogram[LatencyBucketForTime(routingTimeInUs)] += 1;
+
+        return result;
+    }
+
+    Result RoutingCache::RetryMessage(const MessageContext & messageContext)
+    {
+        DD_ASSERT(messageContext.message.header.dstClientId != kBroadcastClientId);
+        return TransmitDirectedMessage(messageContext);
+    }
+
+    Result RoutingCache::TransmitDirectedMessage(const MessageContext & messageContext)
+    {
+        Result result = Result::Unavailable;
+        const ClientId &dstClientId = messageContext.message.header.dstClientId;
+
+        // Discard everything we have cached if the router's prefix routes changed since the last message.
+        const uint32 routeGeneration = m_pRouter->GetRouteGeneration();
+        if (routeGeneration != m_routeGeneration)
+        {
+            m_routingCache.clear();
+            m_pCurrentClientContext = nullptr;
+            m_currentClientId = kBroadcastClientId;
+            m_routeGeneration = routeGeneration;
+        }
+
+        // If it is a directed message, we check to see if it's the same as the last client we talked to. That
+        // lets us skip the overhead of looking up the connection info for every packet during burst traffic
+        // situations
+        if (m_currentClientId != dstClientId)
+        {
+            // If it isn't, we first invalidate previous state
+            m_pCurrentClientContext = nullptr;
+            m_currentClientId = dstClientId;
+
+            // First things first, we perform a lookup in the cache.
+            const auto find = m_routingCache.find(dstClientId);
+            if (find != m_routingCache.end())
+            {
+                // If it existed in the cache then we can guarantee that there was - at one point - a valid
+                // transport associated with it.
+                m_pCurrentClientContext = &find->second;
+            }
+            else
+            {
+                // If it doesn't exist in the cache we need to look up both the connection info and the
+                // transport information from the main router.
+                CacheClientContext newClientContext = {};
+                ConnectionInfo& connectionInfo = newClientContext.connectionInfo;
+                std::shared_ptr<IListenerTransport>& pTransport = newClientContext.pTransport;
+
+                // First lookup the client ID to see if the router knows about it
+                if (m_pRouter->ConnectionInfoForClientId(dstClientId, &connectionInfo, &newClientContext.remoteClient))
                 {
-                    // If it isn't, we first invalidate previous state
-                    m_pCurrentClientContext = nullptr;
-                    m_currentClientId = dstClientId;
+                    DD_ASSERT(connectionInfo.handle != 0);
+                    // Then look up the transport associated with its transport handle. This lookup should
+                    // never fail. If it fails, very bad things have happened and we are in an undefined state.
+                    pTransport = m_pRouter->TransportForTransportHandle(connectionInfo.handle);
+                    DD_ASSERT(pTransport != nullptr);
+
+                    // Place the client context inside the routing cache and set the pointer to it.
+                    const auto res = m_routingCache.emplace(dstClientId, newClientContext);
+                    m_pCurrentClientContext = &res.first->second;
+                }
+            }
+        }
+
+        // A message for a remote client must never be sent back to the router it came from, otherwise two routers
+        // with inconsistent routes would pass it back and forth.
+        if ((m_pCurrentClientContext != nullptr) &&
+            m_pCurrentClientContext->remoteClient &&
+            IsSameConnection(m_pCurrentClientContext->connectionInfo, messageContext.connectionInfo))
+        {
+            RecordDroppedMessage(messageContext);
+        }
+        // If we have a valid client context then we send the message
+        else if (m_pCurrentClientContext != nullptr)
+        {
+            const ConnectionInfo& connectionInfo = m_pCurrentClientContext->connectionInfo;
+            const std::shared_ptr<IListenerTransport>& pTransport = m_pCurrentClientContext->pTransport;
+
+            result = pTransport->TransmitMessage(connectionInfo, messageContext.message);
+
+            if (result == Result::Success)
+            {
+                const uint64 messageSize = MessageSizeInBytes(messageContext.message);
+
+                TrafficStats &transportStats = m_pendingStats.transports[connectionInfo.handle];
+                transportStats.messagesSent += 1;
+                transportStats.bytesSent += messageSize;
+
+                TrafficStats &clientStats = m_pendingStats.clients[dstClientId];
+                clientStats.messagesSent += 1;
+                clientStats.bytesSent += messageSize;
+
+                m_hasPendingStats = true;
+            }
+            // If the transport failed (not timed out), erase the client from the routing cache, null out
+            // the current state, and remove the client from the Router.
+            else if (result == Result::Error)
+            {
+                RecordDroppedMessage(messageContext);
+
+                m_routingCache.erase(dstClientId);
+                m_pCurrentClientContext = nullptr;
+                m_currentClientId = kBroadcastClientId;
+
+                std::lock_guard<std::mutex> clientLock(m_pRouter->m_clientMutex);
+                std::lock_guard<std::mutex> transportLock(m_pRouter->m_transportMutex);
+                m_pRouter->RemoveClient(dstClientId);
+            }
+        }
+        else
+        {
+            // There is nowhere to deliver a message addressed to an unknown client.
+            RecordDroppedMessage(messageContext);
+        }
+        return result;
+    }
+
+    void RoutingCache::RecordQueuedMessage(const MessageContext &messageContext, int64 delta)
+    {
+        m_pendingStats.transports[messageContext.connectionInfo.handle].queuedMessages += delta;
+        m_pendingStats.clients[messageContext.message.header.dstClientId].queuedMessages += delta;
+        m_hasPendingStats = true;
+    }
+
+    void RoutingCache::RecordRetriedMessage(const MessageContext &messageContext)
+    {
+        m_pendingStats.transports[messageContext.connectionInfo.handle].messagesRetried += 1;
+        m_pendingStats.clients[messageContext.message.header.dstClientId].messagesRetried += 1;
+        m_hasPendingStats = true;
+    }
+
+    void RoutingCache::RecordDroppedMessage(const MessageContext &messageContext)
+    {
+        m_pendingStats.transports[messageContext.connectionInfo.handle].messagesDropped += 1;
+        m_pendingStats.clients[messageContext.message.header.dstClientId].messagesDropped += 1;
+        m_hasPendingStats = true;
+    }
+
+    void RoutingCache::RecordThrottledMessage(const MessageContext &messageContext)
+    {
+        m_pendingStats.transports[messageContext.connectionInfo.handle].messagesThrottled += 1;
+        m_pendingStats.clients[messageContext.message.header.srcClientId].messagesThrottled += 1;
+        m_hasPendingStats = true;
+    }
+
+    void RoutingCache::FlushStats(bool force)
+    {
+        if (m_hasPendingStats)
+        {
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+            if (force || ((currentTimeInMs - m_lastStatsFlushTimeInMs) >= kStatsFlushIntervalInMs))
+            {
+                m_pRouter->MergeTrafficStats(m_pendingStats);
+
+                m_pendingStats.transports.clear();
+                m_pendingStats.clients.clear();
+                memset(m_pendingStats.routingLatencyHistogram, 0, sizeof(m_pendingStats.routingLatencyHistogram));
+
+                m_hasPendingStats = false;
+                m_lastStatsFlushTimeInMs = currentTimeInMs;
+            }
+        }
+    }
+
+    void RoutingRetryQueue::RouteMessage(RoutingCache &cache, const MessageContext &messageContext)
+    {
+        const auto find = m_destinationQueues.find(messageContext.message.header.dstClientId);
+        if ((find != m_destinationQueues.end()) && (find->second.empty() == false))
+        {
+            // The destination is still working through its backlog. Sending this message now would deliver it ahead
+            // of the ones that arrived before it.
+            if (cache.ReceiveMessage(messageContext))
+            {
+                EnqueueMessage(cache, messageContext);
+            }
+        }
+        else if (cache.RouteMessage(messageContext) == Result::NotReady)
+        {
+            EnqueueMessage(cache, messageContext);
+        }
+    }
+
+    void RoutingRetryQueue::EnqueueMessage(RoutingCache &cache, const MessageContext &messageContext)
+    {
+        std::deque<QueuedMessage> &queue = m_destinationQueues[messageContext.message.header.dstClientId];
+
+        // Drop the oldest message for this destination if its queue is full. Only this destination loses data,
+        // every other destination on the transport keeps its own queue space.
+        if (queue.size() >= kMaxMessagesPerDestination)
+        {
+            cache.RecordDroppedMessage(queue.front().context);
+            cache.RecordQueuedMessage(queue.front().context, -1);
+            queue.pop_front();
+            --m_queuedMessages;
+            ++m_stats.messagesDropped;
+        }
 
-                    // First things first, we perform a lookup in the cache.
-                    const auto find = m_routingCache.find(dstClientId);
-                    if (find != m_routingCache.end())
+        QueuedMessage queuedMessage = { messageContext, Platform::GetCurrentTimeInMs() };
+        queue.emplace_back(queuedMessage);
+        ++m_queuedMessages;
+        cache.RecordQueuedMessage(messageContext, 1);
+    }
+
+    void RoutingRetryQueue::RetryQueuedMessages(RoutingCache &cache)
+    {
+        if (m_queuedMessages > 0)
+        {
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+
+            for (auto it = m_destinationQueues.begin(); it != m_destinationQueues.end(); )
+            {
+                std::deque<QueuedMessage> &queue = it->second;
+                while (!queue.empty())
+                {
+                    const QueuedMessage &queuedMessage = queue.front();
+                    if ((currentTimeInMs - queuedMessage.queueTimeInMs) > kRetryTimeoutInMs)
                     {
-                        // If it existed in the cache then we can guarantee that there was - at one point - a valid
-                        // transport associated with it.
-                        m_pCurrentClientContext = &find->second;
+                        ++m_stats.messagesDropped;
+                        cache.RecordDroppedMessage(queuedMessage.context);
                     }
                     else
                     {
-                        // If it doesn't exist in the cache we need to look up both the connection info and the
-                        // transport information from the main router.
-                        CacheClientContext newClientContext = {};
-                        ConnectionInfo& connectionInfo = newClientContext.connectionInfo;
-                        std::shared_ptr<IListenerTransport>& pTransport = newClientContext.pTransport;
+                        ++m_stats.messagesRetried;
+                        cache.RecordRetriedMessage(queuedMessage.context);
 
-                        // First lookup the client ID to see if the router knows about it
-                        if (m_pRouter->ConnectionInfoForClientId(dstClientId, &connectionInfo))
+                        // A destination that is still busy keeps the rest of its queue in order. Any other result
+                        // means the message has been handled, either by delivering it or by the router removing
+                        // the destination client.
+                        if (cache.RetryMessage(queuedMessage.context) == Result::NotReady)
                         {
-                            DD_ASSERT(connectionInfo.handle != 0);
-                            // Then look up the transport associated with its transport handle. This lookup should
-                            // never fail. If it fails, very bad things have happened and we are in an undefined state.
-                            pTransport = m_pRouter->TransportForTransportHandle(connectionInfo.handle);
-                            DD_ASSERT(pTransport != nullptr);
-
-                            // Place the client context inside the routing cache and set the pointer to it.
-                            const auto res = m_routingCache.emplace(dstClientId, newClientContext);
-                            m_pCurrentClientContext = &res.first->second;
+                            break;
                         }
                     }
+                    cache.RecordQueuedMessage(queuedMessage.context, -1);
+                    queue.pop_front();
+                    --m_queuedMessages;
                 }
 
-                // If we have a valid client context then we send the message
-                if (m_pCurrentClientContext != nullptr)
+                if (queue.empty())
                 {
-                    const ConnectionInfo& connectionInfo = m_pCurrentClientContext->connectionInfo;
-                    const std::shared_ptr<IListenerTransport>& pTransport = m_pCurrentClientContext->pTransport;
+                    it = m_destinationQueues.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
 
-                    result = pTransport->TransmitMessage(connectionInfo, messageContext.message);
+    void RoutingRetryQueue::DropQueuedMessages(RoutingCache &cache)
+    {
+        for (const auto &pair : m_destinationQueues)
+        {
+            for (const QueuedMessage &queuedMessage : pair.second)
+            {
+                cache.RecordDroppedMessage(queuedMessage.context);
+                cache.RecordQueuedMessage(queuedMessage.context, -1);
+            }
+            m_stats.messagesDropped += pair.second.size();
+        }
+        m_destinationQueues.clear();
+        m_queuedMessages = 0;
+    }
 
-                    // If the transport failed (not timed out), erase the client from the routing cache, null out
-                    // the current state, and remove the client from the Router.
-                    if (result == Result::Error)
+    RoutingScheduler::RoutingScheduler(RouterCore *pRouter) :
+        m_pRouter(pRouter),
+        m_limits(),
+        m_limitsEnabled(false),
+        m_configGeneration(0),
+        m_sessionGeneration(0),
+        m_pSessionProtocols(std::make_shared<const SessionProtocolMap>()),
+        m_queuedMessages(0),
+        m_lastIdleCheckTimeInMs(0)
+    {
+    }
+
+    bool RoutingScheduler::RefillTokenBucket(TokenBucket *pBucket, const RateLimit &limit, uint64 currentTimeInMs)
+    {
+        const uint64 capacity = (static_cast<uint64>(Platform::Max(limit.burstSize, 1u)) * kTokensPerMessage);
+        const uint64 elapsedTimeInMs = (currentTimeInMs - pBucket->lastRefillTimeInMs);
+
+        // messagesPerSecond tokens per millisecond is exactly the refill rate in thousandths of a message.
+        const uint64 refillTokens = (elapsedTimeInMs * limit.messagesPerSecond);
+        if ((pBucket->tokens >= capacity) || ((capacity - pBucket->tokens) <= refillTokens))
+        {
+            pBucket->tokens = capacity;
+        }
+        else
+        {
+            pBucket->tokens += refillTokens;
+        }
+        pBucket->lastRefillTimeInMs = currentTimeInMs;
+
+        return (pBucket->tokens >= kTokensPerMessage);
+    }
+
+    void RoutingScheduler::UpdateConfiguration()
+    {
+        const uint32 configGeneration = m_pRouter->GetRateLimitGeneration();
+        if (configGeneration != m_configGeneration)
+        {
+            m_limits = m_pRouter->GetRateLimits();
+            m_configGeneration = configGeneration;
+
+            m_limitsEnabled = IsRateLimitEnabled(m_limits.clientLimit);
+            for (uint32 protocol = 0; protocol < kNumProtocolIds; ++protocol)
+            {
+                m_limitsEnabled |= IsRateLimitEnabled(m_limits.protocolLimits[protocol]);
+            }
+
+            // Start every source over with full buckets under the new limits.
+            for (auto &pair : m_sources)
+            {
+                pair.second.clientBucket.tokens = kFullTokenBucket;
+                pair.second.protocolBuckets.clear();
+            }
+        }
+
+        if (m_limitsEnabled)
+        {
+            const uint32 sessionGeneration = m_pRouter->GetSessionGeneration();
+            if (sessionGeneration != m_sessionGeneration)
+            {
+                m_pSessionProtocols = m_pRouter->GetSessionProtocols();
+                m_sessionGeneration = sessionGeneration;
+            }
+        }
+    }
+
+    uint32 RoutingScheduler::ProtocolForMessage(const MessageBuffer &message) const
+    {
+        uint32 protocol = static_cast<uint32>(message.header.protocolId);
+
+        if (message.header.protocolId == Protocol::Session)
+        {
+            const auto find = m_pSessionProtocols->find(SessionKey(message.header.srcClientId,
+                                                                   message.header.dstClientId,
+                                                                   message.header.sessionId));
+            if (find != m_pSessionProtocols->end())
+            {
+                protocol = find->second;
+            }
+        }
+
+        return protocol;
+    }
+
+    RoutingScheduler::SourceState& RoutingScheduler::FindSource(ClientId clientId, uint64 currentTimeInMs)
+    {
+        const auto find = m_sources.find(clientId);
+        if (find != m_sources.end())
+        {
+            return find->second;
+        }
+
+        SourceState &source = m_sources[clientId];
+        source.clientBucket.tokens = kFullTokenBucket;
+        source.clientBucket.lastRefillTimeInMs = currentTimeInMs;
+        source.deficitInBytes = 0;
+        source.lastMessageTimeInMs = currentTimeInMs;
+        source.throttled = false;
+        return source;
+    }
+
+    bool RoutingScheduler::ConsumeTokens(SourceState &source, const MessageBuffer &message, uint64 currentTimeInMs)
+    {
+        bool conforms = true;
+
+        if (m_limitsEnabled)
+        {
+            TokenBucket* pClientBucket = nullptr;
+            if (IsRateLimitEnabled(m_limits.clientLimit))
+            {
+                pClientBucket = &source.clientBucket;
+                conforms = RefillTokenBucket(pClientBucket, m_limits.clientLimit, currentTimeInMs);
+            }
+
+            TokenBucket* pProtocolBucket = nullptr;
+            const uint32 protocol = ProtocolForMessage(message);
+            const RateLimit &protocolLimit = m_limits.protocolLimits[protocol];
+            if (IsRateLimitEnabled(protocolLimit))
+            {
+                auto find = source.protocolBuckets.find(protocol);
+                if (find == source.protocolBuckets.end())
+                {
+                    const TokenBucket fullBucket = { kFullTokenBucket, currentTimeInMs };
+                    find = source.protocolBuckets.emplace(protocol, fullBucket).first;
+                }
+                pProtocolBucket = &find->second;
+                conforms &= RefillTokenBucket(pProtocolBucket, protocolLimit, currentTimeInMs);
+            }
+
+            // Only take tokens once the message passes every limit that applies to it.
+            if (conforms)
+            {
+                if (pClientBucket != nullptr)
+                {
+                    pClientBucket->tokens -= kTokensPerMessage;
+                }
+                if (pProtocolBucket != nullptr)
+                {
+                    pProtocolBucket->tokens -= kTokensPerMessage;
+                }
+            }
+        }
+
+        return conforms;
+    }
+
+    void RoutingScheduler::EnqueueMessage(RoutingCache &cache, SourceState &source, const MessageContext &messageContext)
+    {
+        if (source.queue.empty())
+        {
+            source.deficitInBytes = 0;
+            m_backloggedSources.push_back(messageContext.message.header.srcClientId);
+        }
+        // Drop the oldest message from this source if its queue is full. Only the source that sent too much loses
+        // data, every other source keeps its own queue space.
+        else if (source.queue.size() >= kMaxMessagesPerSource)
+        {
+            cache.RecordDroppedMessage(source.queue.front());
+            cache.RecordQueuedMessage(source.queue.front(), -1);
+            source.queue.pop_front();
+            --m_queuedMessages;
+        }
+
+        if (source.throttled)
+        {
+            cache.RecordThrottledMessage(messageContext);
+        }
+
+        source.queue.emplace_back(messageContext);
+        ++m_queuedMessages;
+        cache.RecordQueuedMessage(messageContext, 1);
+    }
+
+    void RoutingScheduler::RouteMessage(RoutingCache &cache, RoutingRetryQueue &retryQueue, const MessageContext &messageContext)
+    {
+        if (!IsSchedulableMessage(messageContext.message))
+        {
+            retryQueue.RouteMessage(cache, messageContext);
+        }
+        else
+        {
+            UpdateConfiguration();
+
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+            SourceState &source = FindSource(messageContext.message.header.srcClientId, currentTimeInMs);
+            source.lastMessageTimeInMs = currentTimeInMs;
+
+            // Messages from a source without a backlog skip the queue entirely as long as they are within limits.
+            if (source.queue.empty() && !retryQueue.IsSaturated())
+            {
+                source.throttled = !ConsumeTokens(source, messageContext.message, currentTimeInMs);
+                if (!source.throttled)
+                {
+                    retryQueue.RouteMessage(cache, messageContext);
+                    return;
+                }
+            }
+
+            EnqueueMessage(cache, source, messageContext);
+        }
+    }
+
+    void RoutingScheduler::RouteQueuedMessages(RoutingCache &cache, RoutingRetryQueue &retryQueue)
+    {
+        const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+
+        if (m_queuedMessages > 0)
+        {
+            UpdateConfiguration();
+
+            // Keep making passes over the backlogged sources until none of them can send anything else.
+            bool routedMessage = true;
+            while (routedMessage && !m_backloggedSources.empty() && !retryQueue.IsSaturated())
+            {
+                routedMessage = false;
+
+                const size_t numSources = m_backloggedSources.size();
+                for (size_t sourceIndex = 0; (sourceIndex < numSources) && !retryQueue.IsSaturated(); ++sourceIndex)
+                {
+                    const ClientId clientId = m_backloggedSources.front();
+                    m_backloggedSources.pop_front();
+
+                    SourceState &source = m_sources[clientId];
+                    source.deficitInBytes += kQuantumInBytes;
+
+                    while (!source.queue.empty() && !retryQueue.IsSaturated())
                     {
-                        m_routingCache.erase(dstClientId);
-                        m_pCurrentClientContext = nullptr;
-                        m_currentClientId = kBroadcastClientId;
+                        const MessageContext &messageContext = source.queue.front();
+                        const uint32 messageSize = static_cast<uint32>(MessageSizeInBytes(messageContext.message));
+
+                        if (messageSize > source.deficitInBytes)
+                        {
+                            break;
+                        }
+
+                        source.throttled = !ConsumeTokens(source, messageContext.message, currentTimeInMs);
+                        if (source.throttled)
+                        {
+                            // A source that is waiting on its rate limit must not bank credit for later.
+                            if (source.deficitInBytes > kQuantumInBytes)
+                            {
+                                source.deficitInBytes = kQuantumInBytes;
+                            }
+                            break;
+                        }
 
-                        std::lock_guard<std::mutex> clientLock(m_pRouter->m_clientMutex);
-                        std::lock_guard<std::mutex> transportLock(m_pRouter->m_transportMutex);
-                        m_pRouter->RemoveClient(dstClientId);
+                        source.deficitInBytes -= messageSize;
+
+                        cache.RecordQueuedMessage(messageContext, -1);
+                        retryQueue.RouteMessage(cache, messageContext);
+                        source.queue.pop_front();
+                        --m_queuedMessages;
+                        routedMessage = true;
+                    }
+
+                    if (source.queue.empty())
+                    {
+                        source.deficitInBytes = 0;
+                        source.throttled = false;
+                    }
+                    else if (retryQueue.IsSaturated())
+                    {
+                        // This source was cut short, so it goes first once the retry queue drains.
+                        m_backloggedSources.push_front(clientId);
+                    }
+                    else
+                    {
+                        m_backloggedSources.push_back(clientId);
                     }
                 }
             }
         }
-        return result;
+
+        RemoveIdleSources(currentTimeInMs);
+    }
+
+    void RoutingScheduler::RemoveIdleSources(uint64 currentTimeInMs)
+    {
+        if ((currentTimeInMs - m_lastIdleCheckTimeInMs) >= kSourceIdleTimeoutInMs)
+        {
+            m_lastIdleCheckTimeInMs = currentTimeInMs;
+
+            for (auto iter = m_sources.begin(); iter != m_sources.end(); )
+            {
+                const SourceState &source = iter->second;
+                if (source.queue.empty() && ((currentTimeInMs - source.lastMessageTimeInMs) >= kSourceIdleTimeoutInMs))
+                {
+                    iter = m_sources.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
+    }
+
+    void RoutingScheduler::DropQueuedMessages(RoutingCache &cache)
+    {
+        for (auto &pair : m_sources)
+        {
+            for (const MessageContext &messageContext : pair.second.queue)
+            {
+                cache.RecordDroppedMessage(messageContext);
+                cache.RecordQueuedMessage(messageContext, -1);
+            }
+            pair.second.queue.clear();
+        }
+        m_backloggedSources.clear();
+        m_queuedMessages = 0;
+    }
+
+    RetryQueueStats RoutingRetryQueue::GetStats() const
+    {
+        RetryQueueStats stats = m_stats;
+        stats.queuedMessages = m_queuedMessages;
+        stats.stalledDestinations = static_cast<uint32>(m_destinationQueues.size());
+        return stats;
     }
 } // DevDriver
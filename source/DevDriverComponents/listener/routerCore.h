@@ -40,6 +40,7 @@
 #include <atomic>
 #include <unordered_set>
 #include <memory>
+#include <string>
 
 #include "transportThread.h"
 
@@ -62,15 +63,34 @@ namespace DevDriver
     {
         ClientInfo clientInfo;
         ConnectionInfo connectionInfo;
-        uint32 pingRetryCount;
-        bool receivedPong;
+        uint32 pingRetryCount;       // Unanswered pings sent since the client went silent
+        uint64 lastActivityTimeInMs; // Last time any message from the client was seen
         bool registeredClient;
     };
 
+    // Hashes and compares the address bytes of connections on the same transport
+    struct ConnectionInfoHash
+    {
+        size_t operator()(const ConnectionInfo &connectionInfo) const;
+    };
+
+    struct ConnectionInfoEqual
+    {
+        bool operator()(const ConnectionInfo &lhs, const ConnectionInfo &rhs) const;
+    };
+
     struct TransportContext
     {
         std::shared_ptr<IListenerTransport> pTransport;
         std::unordered_map<ClientId, ConnectionInfo> clientMap;
+
+        // Index of clientMap by connection so the client behind the connection a message arrived on can be found
+        // without scanning every client. Several clients may share a connection.
+        std::unordered_multimap<ConnectionInfo, ClientId, ConnectionInfoHash, ConnectionInfoEqual> connectionIndex;
+
+        // Adds or removes a client from both clientMap and connectionIndex. Returns true if the maps changed.
+        bool AddClient(ClientId clientId, const ConnectionInfo &connectionInfo);
+        bool RemoveClient(ClientId clientId);
     };
 
     struct MessageContext
@@ -85,26 +105,146 @@ namespace DevDriver
         std::condition_variable signal;
         std::mutex mutex;
         std::thread thread;
-        volatile bool active = 0;
+        std::atomic<bool> active { false };
+    };
+
+    // Number of distinct protocol ids that can appear in a message header
+    DD_STATIC_CONST uint32 kNumProtocolIds = 256;
+
+    // Token bucket rate limit. A messagesPerSecond of zero disables the limit.
+    struct RateLimit
+    {
+        uint32 messagesPerSecond; // Sustained number of messages allowed per second
+        uint32 burstSize;         // Number of messages that may be sent back to back after being idle
+    };
+
+    // Rate limits applied to the traffic sent by each client
+    struct RouterRateLimits
+    {
+        RateLimit clientLimit;                     // Limit for everything a single client sends
+        RateLimit protocolLimits[kNumProtocolIds]; // Limit for what a single client sends with each protocol. Session
+                                                   // traffic is limited by the protocol that opened the session.
     };
 
     struct RouterStartInfo
     {
         char description[kMaxStringLength];
+        bool enableFederation; // Exchange prefix routes with peer routers and forward traffic addressed to their clients
+        RouterRateLimits rateLimits;
+    };
+
+    // Number of buckets in the routing latency histogram. Bucket 0 counts messages that were routed in less than
+    // one microsecond and bucket N counts messages that took [2^(N-1), 2^N) microseconds. The last bucket also
+    // collects everything slower than that.
+    DD_STATIC_CONST uint32 kNumRoutingLatencyBuckets = 20;
+
+    // Traffic counters kept by the router for a single transport or client
+    struct TrafficStats
+    {
+        uint64 messagesReceived; // Messages read from the transport or sent by the client
+        uint64 bytesReceived;    // Bytes read from the transport or sent by the client
+        uint64 messagesSent;     // Messages written to the transport or delivered to the client
+        uint64 bytesSent;        // Bytes written to the transport or delivered to the client
+        uint64 messagesRetried;  // Delivery attempts that were repeated because the destination was busy
+        uint64 messagesDropped;  // Messages that were discarded without being delivered
+        uint64 messagesThrottled; // Messages that were held back because their sender exceeded a rate limit
+        int64  queuedMessages;   // Messages currently waiting in a retry or scheduling queue
+    };
+
+    struct TransportTrafficStats
+    {
+        TransportHandle handle;
+        std::string     name;
+        TrafficStats    traffic;
+    };
+
+    struct ClientTrafficStats
+    {
+        ClientId     clientId;
+        TrafficStats traffic;
+    };
+
+    // Snapshot of the router's traffic counters
+    // Retries, drops and queue depths are attributed to the transport that received the message and to the client
+    // it was addressed to.
+    struct RouterStats
+    {
+        std::vector<TransportTrafficStats> transports;
+        std::vector<ClientTrafficStats>    clients;
+        uint64                             routingLatencyHistogram[kNumRoutingLatencyBuckets];
+        uint64                             numSessions; // Established sessions whose protocol is being tracked
+    };
+
+    // How a client changed between two versions of the client list
+    enum class ClientListChangeType : uint32
+    {
+        Connected = 0,
+        Updated,        // The client identified itself and its name, description or process id changed
+        Disconnected
+    };
+
+    struct ClientListChange
+    {
+        uint64               version;    // Client list version the change produced
+        ClientListChangeType type;
+        ClientInfo           clientInfo; // Client info after the change, or the last known info when disconnected
+    };
+
+    // An immutable copy of the connected client list. The router publishes a new snapshot for every change, so
+    // readers can hold on to one without locking the router.
+    struct ClientListSnapshot
+    {
+        uint64                        version;
+        std::vector<ClientInfo>       clients;
+        std::vector<ClientListChange> recentChanges; // The most recent changes, oldest first
+    };
+
+    // Protocols of established sessions, keyed by SessionKey
+    typedef std::unordered_map<uint64, uint32> SessionProtocolMap;
+
+    // Traffic counters that have been collected but not yet merged into the router
+    struct PendingTrafficStats
+    {
+        std::unordered_map<TransportHandle, TrafficStats> transports;
+        std::unordered_map<ClientId, TrafficStats>        clients;
+        uint64                                            routingLatencyHistogram[kNumRoutingLatencyBuckets];
     };
 
     class RoutingCache
     {
     public:
-        explicit RoutingCache(RouterCore *pRouter) : m_pRouter(pRouter) {};
-        ~RoutingCache() {};
+        explicit RoutingCache(RouterCore *pRouter);
+        ~RoutingCache();
 
         Result RouteMessage(const MessageContext &messageContext);
+
+        // Does everything RouteMessage does for a newly received message except sending it. Returns true if the
+        // message still has to be sent to its destination with RetryMessage.
+        bool ReceiveMessage(const MessageContext &messageContext);
+
+        // Sends a directed message that previously failed with NotReady. Unlike RouteMessage this skips the
+        // router's internal message handling since that already happened when the message was first routed.
+        Result RetryMessage(const MessageContext &messageContext);
+
+        // Traffic accounting for messages that are waiting in a retry queue
+        void RecordQueuedMessage(const MessageContext &messageContext, int64 delta);
+        void RecordRetriedMessage(const MessageContext &messageContext);
+        void RecordDroppedMessage(const MessageContext &messageContext);
+        void RecordThrottledMessage(const MessageContext &messageContext);
+
+        // Merges the locally collected traffic counters into the router once kStatsFlushIntervalInMs has passed.
+        // Counters are collected per routing cache so that the routing fast path never contends on the router.
+        void FlushStats(bool force);
     private:
+        Result TransmitDirectedMessage(const MessageContext &messageContext);
+
+        DD_STATIC_CONST uint32 kStatsFlushIntervalInMs = 250;
+
         struct CacheClientContext
         {
             ConnectionInfo connectionInfo;
             std::shared_ptr<IListenerTransport> pTransport;
+            bool remoteClient;
         };
 
         RouterCore*                 m_pRouter;
@@ -112,11 +252,134 @@ namespace DevDriver
 
         ClientId            m_currentClientId       = kBroadcastClientId;
         CacheClientContext* m_pCurrentClientContext = nullptr;
+        uint32              m_routeGeneration       = 0;
+
+        PendingTrafficStats m_pendingStats;
+        bool                m_hasPendingStats       = false;
+        uint64              m_lastStatsFlushTimeInMs = 0;
+    };
+
+    // Bounded per-destination retry queues used by the transport threads.
+    // Messages that could not be delivered because the destination was busy are queued by destination client so
+    // that one slow client only delays its own traffic instead of every message arriving on the same transport.
+    // Each destination queue holds at most kMaxMessagesPerDestination messages and drops its oldest message when
+    // full. Queued messages that cannot be delivered within kRetryTimeoutInMs are dropped as well, since the session
+    // layer will have retransmitted them by then. Once kMaxQueuedMessages are queued in total the owner should stop
+    // reading new messages until the queues drain.
+    class RoutingRetryQueue
+    {
+    public:
+        RoutingRetryQueue() : m_queuedMessages(0), m_stats() {};
+        ~RoutingRetryQueue() {};
+
+        // Routes a newly received message and queues it if its destination is busy. Messages for a destination that
+        // already has queued messages are queued behind them so they can't overtake them.
+        void RouteMessage(RoutingCache &cache, const MessageContext &messageContext);
+
+        // Attempts to deliver queued messages, preserving the order of messages for each destination.
+        void RetryQueuedMessages(RoutingCache &cache);
+
+        // Discards every queued message. Used when the owning thread stops so the router's queue depth counters
+        // don't keep reporting messages that no longer exist.
+        void DropQueuedMessages(RoutingCache &cache);
+
+        bool HasQueuedMessages() const { return (m_queuedMessages > 0); }
+        bool IsSaturated() const { return (m_queuedMessages >= kMaxQueuedMessages); }
+
+        RetryQueueStats GetStats() const;
+    private:
+        struct QueuedMessage
+        {
+            MessageContext context;
+            uint64         queueTimeInMs;
+        };
+
+        void EnqueueMessage(RoutingCache &cache, const MessageContext &messageContext);
+
+        DD_STATIC_CONST uint32 kMaxMessagesPerDestination = 64;
+        DD_STATIC_CONST uint32 kMaxQueuedMessages = 512;
+        DD_STATIC_CONST uint32 kRetryTimeoutInMs = 50;
+
+        std::unordered_map<ClientId, std::deque<QueuedMessage>> m_destinationQueues;
+        uint32          m_queuedMessages;
+        RetryQueueStats m_stats;
+    };
+
+    // Rate limits and fairly schedules the messages read by a transport thread.
+    // Every source client has a token bucket for all of its traffic and one for each rate limited protocol. Messages
+    // that conform to the limits are routed right away unless their source already has a backlog or the retry queue
+    // is saturated. Everything else waits in a bounded per-source queue, and backlogged sources are served in deficit
+    // round robin order so that one busy client only ever gets its share of the transport thread. Client management
+    // messages are never limited since clients could not connect or stay connected without them.
+    class RoutingScheduler
+    {
+    public:
+        explicit RoutingScheduler(RouterCore *pRouter);
+        ~RoutingScheduler() {};
+
+        // Routes a newly received message through the retry queue, or queues it behind its source's backlog.
+        void RouteMessage(RoutingCache &cache, RoutingRetryQueue &retryQueue, const MessageContext &messageContext);
+
+        // Routes backlogged messages until every backlogged source is out of tokens or the retry queue saturates.
+        void RouteQueuedMessages(RoutingCache &cache, RoutingRetryQueue &retryQueue);
+
+        // Discards every queued message. Used when the owning thread stops.
+        void DropQueuedMessages(RoutingCache &cache);
+
+        bool HasQueuedMessages() const { return (m_queuedMessages > 0); }
+        bool IsSaturated() const { return (m_queuedMessages >= kMaxQueuedMessages); }
+    private:
+        // Tokens are kept in thousandths of a message so that refills don't need floating point math.
+        struct TokenBucket
+        {
+            uint64 tokens;
+            uint64 lastRefillTimeInMs;
+        };
+
+        struct SourceState
+        {
+            TokenBucket                             clientBucket;
+            std::unordered_map<uint32, TokenBucket> protocolBuckets;
+            std::deque<MessageContext>              queue;
+            uint32                                  deficitInBytes;
+            uint64                                  lastMessageTimeInMs;
+            bool                                    throttled;      // Backlog is waiting on a token bucket
+        };
+
+        // Refills a token bucket for the time that passed since its last refill and returns true if it holds at
+        // least one message worth of tokens.
+        static bool RefillTokenBucket(TokenBucket *pBucket, const RateLimit &limit, uint64 currentTimeInMs);
+
+        void UpdateConfiguration();
+        uint32 ProtocolForMessage(const MessageBuffer &message) const;
+        SourceState& FindSource(ClientId clientId, uint64 currentTimeInMs);
+        bool ConsumeTokens(SourceState &source, const MessageBuffer &message, uint64 currentTimeInMs);
+        void EnqueueMessage(RoutingCache &cache, SourceState &source, const MessageContext &messageContext);
+        void RemoveIdleSources(uint64 currentTimeInMs);
+
+        DD_STATIC_CONST uint64 kTokensPerMessage = 1000;
+        DD_STATIC_CONST uint64 kFullTokenBucket = ~0ull; // The next refill clamps this to the bucket's capacity
+        DD_STATIC_CONST uint32 kQuantumInBytes = static_cast<uint32>(sizeof(MessageBuffer));
+        DD_STATIC_CONST uint32 kMaxMessagesPerSource = 128;
+        DD_STATIC_CONST uint32 kMaxQueuedMessages = 512;
+        DD_STATIC_CONST uint32 kSourceIdleTimeoutInMs = 10000;
+
+        RouterCore*                                m_pRouter;
+        RouterRateLimits                           m_limits;
+        bool                                       m_limitsEnabled;
+        uint32                                     m_configGeneration;
+        uint32                                     m_sessionGeneration;
+        std::shared_ptr<const SessionProtocolMap>  m_pSessionProtocols;
+        std::unordered_map<ClientId, SourceState>  m_sources;
+        std::deque<ClientId>                       m_backloggedSources; // Round robin order
+        uint32                                     m_queuedMessages;
+        uint64                                     m_lastIdleCheckTimeInMs;
     };
 
     class RouterCore
     {
         friend RoutingCache;
+        friend RoutingScheduler;
     public:
         RouterCore();
         ~RouterCore();
@@ -127,13 +390,53 @@ namespace DevDriver
         Result RegisterTransport(const std::shared_ptr<IListenerTransport> &pTransport);
         Result RemoveTransport(const std::shared_ptr<IListenerTransport> &pTransport);
 
+        // Disconnects every client that was connected through a connection that has closed
+        Result RemoveConnection(const ConnectionInfo &connectionInfo);
+
         void Stop();
 
         std::vector<ClientInfo> GetConnectedClientList();
 
+        // Returns the current client list snapshot. This never waits on the router's locks.
+        std::shared_ptr<const ClientListSnapshot> GetClientListSnapshot() const;
+
+        // Returns the changes made to the client list after sinceVersion, oldest first, and the current version.
+        // Returns Unavailable if the changes are no longer retained, in which case a full snapshot must be read.
+        Result GetClientListChanges(uint64 sinceVersion, std::vector<ClientListChange>* pChanges, uint64* pVersion) const;
+
+        // Returns a snapshot of the traffic counters for every registered transport and connected client
+        RouterStats GetRouterStats();
+
+        // Adds a router that prefix routes are exchanged with when federation is enabled. The connection info must
+        // refer to a registered transport. Announcements from routers that were not added
+        // this way are dropped, so both sides of a federation must list each other.
+        Result AddRouterPeer(const ConnectionInfo &connectionInfo);
+
     private:
         DD_STATIC_CONST uint32 kClientDiscoveryIntervalInMs = 3000;
+        // Clients announce themselves when they connect, so the broadcast that finds clients we missed is rare.
+        DD_STATIC_CONST uint32 kClientDiscoveryBroadcastIntervalInMs = 60000;
+        DD_STATIC_CONST uint32 kStatsLogIntervalInMs = 60000;
+        DD_STATIC_CONST uint32 kMaxRouterPrefixes = (1 << kRouterPrefixWidth);
+        DD_STATIC_CONST uint32 kMaxRouterHopCount = (kMaxRouterPrefixes - 1);
+        DD_STATIC_CONST uint32 kRouterTimeoutCount = 3;
+
+        // A router we exchange prefix routes with
+        struct RouterPeer
+        {
+            ConnectionInfo connectionInfo;
+        };
+
+        // The next hop towards the router that owns a prefix
+        struct PrefixRoute
+        {
+            ConnectionInfo nextHop;
+            uint64         lastUpdateTimeInMs;
+            uint32         hopCount;
+            bool           valid;
+        };
         DD_STATIC_CONST uint32 kClientTimeoutCount = 3;
+        DD_STATIC_CONST uint32 kMaxClientListChanges = 256;
         DD_STATIC_CONST uint32 kThreadWaitTimeoutInMs = 250;
 
         std::mutex m_clientMutex;
@@ -141,13 +444,60 @@ namespace DevDriver
         std::mutex m_transportMutex;
         std::unordered_map<TransportHandle, TransportContext> m_transportMap;
 
+        // Published copy of m_clientMap. Only replaced while the client mutex is held and only accessed through the
+        // std::atomic_load/atomic_store overloads for shared_ptr.
+        std::shared_ptr<const ClientListSnapshot> m_pClientListSnapshot;
+
         IClientManager* m_pClientManager;
         TransportHandle m_lastTransportId;
         ClientId m_clientId;
         uint64 m_lastClientPingTimeInMs;
+        uint64 m_lastDiscoveryBroadcastTimeInMs;
         ProcessingQueue m_clientThread;
         MessageBuffer m_clientInfoResponse;
 
+        // Scratch storage for batched broadcasts. Only accessed while both the client and transport mutex are held.
+        std::vector<ClientId> m_broadcastClientIds;
+        std::vector<const ConnectionInfo*> m_broadcastConnections;
+        std::vector<Result> m_broadcastResults;
+
+        // Traffic counters. m_statsMutex is only ever acquired last and nothing else is locked while holding it.
+        std::mutex m_statsMutex;
+        std::unordered_map<TransportHandle, TrafficStats> m_transportStats;
+        std::unordered_map<ClientId, TrafficStats> m_clientStats;
+        std::vector<ClientId> m_activeClients;           // Clients that sent routed traffic since the last liveness check
+        uint64 m_routingLatencyHistogram[kNumRoutingLatencyBuckets];
+        uint64 m_lastStatsLogTimeInMs;
+        uint64 m_lastLoggedMessageCount;
+
+        // Federation state. Only accessed while the client mutex is held, except for the route generation which
+        // routing caches poll to find out when their cached routes need to be discarded.
+        bool m_federationEnabled;
+        ClientId m_routerPrefix;
+        std::vector<RouterPeer> m_routerPeers;
+        PrefixRoute m_prefixRoutes[kMaxRouterPrefixes];
+        std::atomic<uint32> m_routeGeneration;
+
+        // Rate limiting state. Transport threads keep their own copies and poll the generation counters to find out
+        // when those copies are stale. m_sessionMutex is only ever acquired last.
+        std::mutex m_rateLimitMutex;
+        RouterRateLimits m_rateLimits;
+        std::atomic<uint32> m_rateLimitGeneration;
+        std::mutex m_sessionMutex;
+        std::unordered_map<uint64, uint32> m_pendingSessionProtocols;     // Keyed by the session id in the Syn
+        SessionProtocolMap m_sessionProtocols;                            // Keyed by the established session id
+        std::shared_ptr<const SessionProtocolMap> m_pSessionProtocolSnapshot; // Built on demand, shared by readers
+        std::atomic<uint32> m_sessionGeneration;
+
+        // Session keys in the order they were tracked, grouped by the client that opened the session. Each client
+        // can only track a bounded number of sessions so that one leaking client never evicts anyone else's.
+        struct TrackedSessions
+        {
+            std::deque<uint64> pending;
+            std::deque<uint64> established;
+        };
+        std::unordered_map<ClientId, TrackedSessions> m_trackedSessions;
+
         void RouterThreadFunc(ProcessingQueue &pQueueState);
         void UpdateClients();
         void ProcessRouterMessage(const MessageContext &messageContext);
@@ -157,15 +507,42 @@ namespace DevDriver
 
         void AddClient(const ClientId clientId, const ConnectionInfo &connectionInfo, const bool registeredClient);
         void RemoveClient(ClientId clientId);
+        void PublishClientListChange(ClientListChangeType type, const ClientInfo &clientInfo);
 
-        void SendBroadcastMessage(const MessageBuffer &message, const std::shared_ptr<IListenerTransport> &pTransport);
+        void SendBroadcastMessage(const MessageBuffer &message,
+                                  const std::shared_ptr<IListenerTransport> &pSourceTransport,
+                                  const ConnectionInfo *pSourceConnection);
+        void TransmitBroadcastMessage(const MessageBuffer &message,
+                                      const std::shared_ptr<IListenerTransport> &pSourceTransport,
+                                      const ConnectionInfo *pSourceConnection,
+                                      std::vector<ClientId>* pFailedClients);
         void ProcessClientManagementMessage(const MessageContext &messageContext);
+        void LogRouterStats();
+
+        // Federation helpers
+        bool IsRemoteClient(ClientId clientId) const
+        {
+            return (m_federationEnabled && ((clientId & kRouterPrefixMask) != m_routerPrefix));
+        }
+        const PrefixRoute* FindPrefixRoute(ClientId clientId) const;
+        void ProcessRouterAnnounce(const MessageContext &messageContext);
+        void AnnounceRoutes(uint64 currentTimeInMs);
 
         // methods for interfacing with RoutingCache
-        bool ConnectionInfoForClientId(ClientId clientId, ConnectionInfo *pConnectionInfo);
+        bool ConnectionInfoForClientId(ClientId clientId, ConnectionInfo *pConnectionInfo, bool *pRemoteClient);
+        uint32 GetRouteGeneration() const { return m_routeGeneration.load(std::memory_order_acquire); }
         std::shared_ptr<IListenerTransport> TransportForTransportHandle(TransportHandle handle);
         void RouteBroadcastMessage(const MessageContext& msgContext);
         void RouteInternalMessage(const MessageContext& recvMsgContext);
         bool IsRoutableMessage(const MessageContext& recvMsgContext);
+        void MergeTrafficStats(const PendingTrafficStats& stats);
+
+        // methods for interfacing with RoutingScheduler
+        uint32 GetRateLimitGeneration() const { return m_rateLimitGeneration.load(std::memory_order_acquire); }
+        uint32 GetSessionGeneration() const { return m_sessionGeneration.load(std::memory_order_acquire); }
+        RouterRateLimits GetRateLimits();
+        std::shared_ptr<const SessionProtocolMap> GetSessionProtocols();
+        void TrackSessionMessage(const MessageBuffer &message);
+        void RemoveClientSessions(ClientId clientId);
     };
 } // DevDriver
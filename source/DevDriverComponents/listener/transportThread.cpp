@@ -39,40 +39,56 @@ namespace DevDriver
         if ((pRouter != nullptr) & (pTransport != nullptr))
         {
             RoutingCache cache(pRouter);
+            RoutingRetryQueue retryQueue;
+            RoutingScheduler scheduler(pRouter);
             MessageContext recvMsgContext = {};
-            std::deque<MessageContext> recvQueue;
-            std::deque<MessageContext> retryQueue;
 
             while (m_active)
             {
-                size_t firstNewMessageIndex = recvQueue.size();
-                // Check for new local messages.
-                Result readResult = pTransport->ReceiveMessage(recvMsgContext.connectionInfo, recvMsgContext.message, kReceiveDelayInMs);
-                if (readResult == Result::Success)
-                {
-                    do
-                    {
-                        recvQueue.emplace_back(recvMsgContext);
-                        readResult = pTransport->ReceiveMessage(recvMsgContext.connectionInfo, recvMsgContext.message, kNoWait);
-                    } while (readResult == Result::Success);
-                }
+                // Give messages that are waiting on a busy destination another chance before reading new ones, then
+                // let backlogged senders have their share.
+                retryQueue.RetryQueuedMessages(cache);
+                scheduler.RouteQueuedMessages(cache, retryQueue);
 
-                size_t messageNumber = 0;
-                for (const auto &message : recvQueue)
+                // Stop reading from the transport while the scheduling queues are saturated. This pushes back on the
+                // senders through the transport's own buffering instead of growing our queues without bound.
+                if (!scheduler.IsSaturated())
                 {
-                    messageNumber++;
-                    // only requeue messages if it's the first time we've tried to send them
-                    if ((cache.RouteMessage(message) == Result::NotReady) & (messageNumber > firstNewMessageIndex))
+                    const bool hasQueuedMessages = (retryQueue.HasQueuedMessages() || scheduler.HasQueuedMessages());
+                    const uint32 timeoutInMs = hasQueuedMessages ? kRetryDelayInMs : kReceiveDelayInMs;
+
+                    // Check for new local messages.
+                    Result readResult = pTransport->ReceiveMessage(recvMsgContext.connectionInfo, recvMsgContext.message, timeoutInMs);
+                    while (readResult == Result::Success)
                     {
-                        retryQueue.emplace_back(message);
+                        scheduler.RouteMessage(cache, retryQueue, recvMsgContext);
+                        readResult = scheduler.IsSaturated()
+                            ? Result::NotReady
+                            : pTransport->ReceiveMessage(recvMsgContext.connectionInfo, recvMsgContext.message, kNoWait);
                     }
                 }
-                recvQueue.clear();
-                recvQueue.swap(retryQueue);
+                else
+                {
+                    Platform::Sleep(kRetryDelayInMs);
+                }
+
+                cache.FlushStats(false);
+
+                std::lock_guard<std::mutex> statsLock(m_statsMutex);
+                m_retryStats = retryQueue.GetStats();
             }
+
+            scheduler.DropQueuedMessages(cache);
+            retryQueue.DropQueuedMessages(cache);
         }
     }
 
+    RetryQueueStats TransportThread::GetRetryQueueStats() const
+    {
+        std::lock_guard<std::mutex> statsLock(m_statsMutex);
+        return m_retryStats;
+    }
+
     void TransportThread::Start(RouterCore *pRouter, IListenerTransport *pTransport)
     {
         DD_ASSERT(m_active == false);
@@ -92,7 +108,8 @@ namespace DevDriver
     }
 
     TransportThread::TransportThread() :
-        m_active(false)
+        m_active(false),
+        m_retryStats()
     {
     }
 
@@ -34,10 +34,21 @@
 
 #include "transports/abstractListenerTransport.h"
 
+#include <atomic>
 #include <thread>
+#include <mutex>
 
 namespace DevDriver
 {
+    // Counters describing the state of the per-destination retry queues owned by a transport thread
+    struct RetryQueueStats
+    {
+        uint64 messagesRetried;     // Number of queued messages that were sent again
+        uint64 messagesDropped;     // Number of messages discarded because their destination stayed busy
+        uint32 queuedMessages;      // Number of messages currently waiting across all destinations
+        uint32 stalledDestinations; // Number of destinations that currently have messages waiting
+    };
+
     class TransportThread
     {
     public:
@@ -46,10 +57,16 @@ namespace DevDriver
 
         void Start(class RouterCore *pListener, IListenerTransport *pTransport);
         void Stop();
+
+        // Returns the most recent retry queue counters published by the receive thread
+        RetryQueueStats GetRetryQueueStats() const;
     private:
         void ReceiveThreadFunc(RouterCore *pRouter, IListenerTransport *pTransport);
         DD_STATIC_CONST uint32 kReceiveDelayInMs = 25;
+        DD_STATIC_CONST uint32 kRetryDelayInMs = 1;
         std::thread         m_thread;
-        volatile bool       m_active;
+        std::atomic<bool>   m_active;
+        mutable std::mutex  m_statsMutex;
+        RetryQueueStats     m_retryStats;
     };
 } // DevDriver
@@ -55,6 +55,20 @@ namespace DevDriver
         virtual Result ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs) = 0;
         virtual Result TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message) = 0;
         virtual Result TransmitBroadcastMessage(const MessageBuffer &message) = 0;
+
+        // Transmits the same message to several connections on this transport and writes the result of each
+        // transmission into pResults. Transports that can fan out a message more efficiently than one transmit
+        // per connection should override this.
+        virtual void TransmitMessageToConnections(const ConnectionInfo* const* ppConnections,
+                                                  size_t                       numConnections,
+                                                  const MessageBuffer&         message,
+                                                  Result*                      pResults)
+        {
+            for (size_t connectionIndex = 0; connectionIndex < numConnections; ++connectionIndex)
+            {
+                pResults[connectionIndex] = TransmitMessage(*ppConnections[connectionIndex], message);
+            }
+        }
         virtual Result Disable() = 0;
 
         virtual TransportHandle GetHandle() = 0;
@@ -0,0 +1,456 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2016-2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  connectionTransport.cpp
+* @brief Class definition for ConnectionListenerTransport
+***********************************************************************************************************************
+*/
+
+#include "connectionTransport.h"
+#include "ddPlatform.h"
+#include "../routerCore.h"
+#include <cstring>
+
+namespace DevDriver
+{
+    ConnectionListenerTransport::ConnectionListenerTransport(SocketType socketType, const char* pAddress, uint32 port) :
+        m_socketType(socketType),
+        m_port(port),
+        m_transportHandle(0),
+        m_listening(false),
+        m_active(false),
+        m_pRouter(nullptr),
+        m_nextConnectionId(1)
+    {
+        DD_ASSERT((m_socketType == SocketType::Tcp) || (m_socketType == SocketType::LocalSeqPacket));
+
+        if (pAddress != nullptr)
+        {
+            Platform::Strncpy(m_hostAddress, pAddress, sizeof(m_hostAddress));
+        }
+        else
+        {
+            Platform::Strncpy(m_hostAddress, "0.0.0.0", sizeof(m_hostAddress));
+        }
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            Platform::Snprintf(m_hostDescription, sizeof(m_hostDescription), "%s:%u (TCP)", m_hostAddress, m_port);
+        }
+        else
+        {
+            Platform::Snprintf(m_hostDescription, sizeof(m_hostDescription), "%s (Packet)", m_hostAddress);
+        }
+    }
+
+    ConnectionListenerTransport::~ConnectionListenerTransport()
+    {
+        if (m_listening)
+            Disable();
+    }
+
+    void ConnectionListenerTransport::ListeningThreadFunc()
+    {
+        while (m_active)
+        {
+            JoinClosedConnections();
+
+            bool canRead = false;
+            Result result = m_listenSocket.Select(&canRead, nullptr, nullptr, kWaitTimeoutInMs);
+
+            if ((result == Result::Success) && canRead)
+            {
+                std::shared_ptr<ListenerConnection> pConnection = std::make_shared<ListenerConnection>();
+                result = m_listenSocket.Accept(&pConnection->socket);
+
+                if (result == Result::Success)
+                {
+                    result = ConfigureConnection(pConnection.get());
+                }
+
+                if (result == Result::Success)
+                {
+                    DD_PRINT(LogLevel::Debug, "[ConnectionTransport] New client connected, starting new thread");
+
+                    pConnection->active = true;
+
+                    std::lock_guard<std::mutex> lock(m_connections.mutex);
+                    pConnection->connectionId = m_nextConnectionId++;
+                    pConnection->thread = std::thread(&ConnectionListenerTransport::ReceivingThreadFunc,
+                                                      this,
+                                                      m_pRouter,
+                                                      pConnection.get());
+
+                    if (pConnection->thread.joinable())
+                    {
+                        m_connections.connectionMap.emplace(pConnection->connectionId, pConnection);
+                    }
+                    else
+                    {
+                        DD_PRINT(LogLevel::Error, "[ConnectionTransport] Thread creation failed!");
+                    }
+                }
+                else
+                {
+                    DD_PRINT(LogLevel::Error, "[ConnectionTransport] Connection failed!");
+                }
+            }
+        }
+    }
+
+    void ConnectionListenerTransport::ReceivingThreadFunc(RouterCore* pRouter, ListenerConnection* pConnection)
+    {
+        DD_ASSERT(pRouter != nullptr);
+        DD_ASSERT(pConnection != nullptr);
+
+        MessageContext recvContext = {};
+        recvContext.connectionInfo.handle = m_transportHandle;
+        recvContext.connectionInfo.size = sizeof(pConnection->connectionId);
+        memcpy(&recvContext.connectionInfo.data[0], &pConnection->connectionId, sizeof(pConnection->connectionId));
+
+        RoutingCache cache(pRouter);
+        RoutingRetryQueue retryQueue;
+        RoutingScheduler scheduler(pRouter);
+
+        while (pConnection->active)
+        {
+            DD_STATIC_CONST uint32 kReceiveDelayInMs = 10;
+            DD_STATIC_CONST uint32 kRetryDelayInMs = 1;
+
+            // Give messages that are waiting on a busy destination another chance before reading new ones, then
+            // let backlogged senders have their share.
+            retryQueue.RetryQueuedMessages(cache);
+            scheduler.RouteQueuedMessages(cache, retryQueue);
+
+            // Finish writing anything the router could only partly send, so the client isn't left waiting for the
+            // rest until the next message addressed to it.
+            const Result flushResult = FlushConnection(pConnection);
+
+            Result result = Result::NotReady;
+
+            // Stop reading from the connection while the scheduling queues are saturated so that socket flow control
+            // pushes back on the client instead of the listener buffering without bound.
+            if (!scheduler.IsSaturated())
+            {
+                const bool hasQueuedMessages = (retryQueue.HasQueuedMessages() || scheduler.HasQueuedMessages() ||
+                                                (flushResult == Result::NotReady));
+                const uint32 timeoutInMs = hasQueuedMessages ? kRetryDelayInMs : kReceiveDelayInMs;
+
+                bool canRead = false;
+                bool exceptState = false;
+                result = pConnection->socket.Select(&canRead, nullptr, &exceptState, timeoutInMs);
+
+                if (result == Result::Success)
+                {
+                    result = exceptState ? Result::Error : Result::NotReady;
+                }
+
+                if (canRead)
+                {
+                    // Drain every complete message that is already buffered.
+                    result = ReceiveConnectionMessage(pConnection, &recvContext.message);
+                    while (result == Result::Success)
+                    {
+                        scheduler.RouteMessage(cache, retryQueue, recvContext);
+                        result = scheduler.IsSaturated()
+                            ? Result::NotReady
+                            : ReceiveConnectionMessage(pConnection, &recvContext.message);
+                    }
+                }
+            }
+            else
+            {
+                Platform::Sleep(kRetryDelayInMs);
+            }
+
+            if ((result == Result::Error) || (flushResult == Result::Error))
+            {
+                DD_PRINT(LogLevel::Debug, "[ConnectionTransport] Client disconnected");
+                CloseConnection(pConnection);
+            }
+
+            cache.FlushStats(false);
+        }
+
+        // A connection that closed while the transport is still enabled takes its clients with it right away
+        // instead of leaving them to time out. Messages that were already read are delivered first.
+        const bool connectionClosed = m_active;
+        if (connectionClosed)
+        {
+            scheduler.RouteQueuedMessages(cache, retryQueue);
+            retryQueue.RetryQueuedMessages(cache);
+        }
+
+        scheduler.DropQueuedMessages(cache);
+        retryQueue.DropQueuedMessages(cache);
+
+        if (connectionClosed)
+        {
+            pRouter->RemoveConnection(recvContext.connectionInfo);
+        }
+    }
+
+    Result ConnectionListenerTransport::ConfigureConnection(ListenerConnection* pConnection)
+    {
+        Result result = Result::Success;
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            // Protocol messages are small and latency sensitive so they should never wait to be coalesced.
+            // Larger buffers are only a hint, so failing to apply them is not fatal.
+            result = pConnection->socket.SetNoDelay(true);
+            pConnection->socket.SetBufferSizes(kStreamBufferSizeInBytes, kStreamBufferSizeInBytes);
+        }
+
+        return result;
+    }
+
+    Result ConnectionListenerTransport::ReceiveConnectionMessage(ListenerConnection* pConnection, MessageBuffer* pMessage)
+    {
+        Result result = Result::Error;
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            result = pConnection->stream.ReceiveMessage(&pConnection->socket, pMessage);
+        }
+        else
+        {
+            size_t bytesReceived = 0;
+            result = pConnection->socket.Receive(reinterpret_cast<uint8*>(pMessage), sizeof(MessageBuffer), &bytesReceived);
+
+            if (result == Result::Success)
+            {
+                // Each packet carries exactly one message. Anything else means the client is misbehaving.
+                const bool validSize = (bytesReceived >= sizeof(MessageHeader)) &&
+                                       (bytesReceived == (sizeof(MessageHeader) + pMessage->header.payloadSize));
+                result = validSize ? Result::Success : Result::Error;
+            }
+            else if (result == Result::Unavailable)
+            {
+                // An empty read means the client closed the connection.
+                result = Result::Error;
+            }
+        }
+
+        return result;
+    }
+
+    Result ConnectionListenerTransport::SendConnectionMessage(ListenerConnection* pConnection, const MessageBuffer& message)
+    {
+        Result result = Result::Error;
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            result = pConnection->stream.SendMessage(&pConnection->socket, message);
+        }
+        else
+        {
+            const size_t messageSize = (sizeof(MessageHeader) + message.header.payloadSize);
+            size_t bytesSent = 0;
+            result = pConnection->socket.Send(reinterpret_cast<const uint8*>(&message), messageSize, &bytesSent);
+
+            // Packets are sent whole or not at all.
+            if ((result == Result::Success) && (bytesSent != messageSize))
+            {
+                result = Result::Error;
+            }
+        }
+
+        return result;
+    }
+
+    Result ConnectionListenerTransport::FlushConnection(ListenerConnection* pConnection)
+    {
+        Result result = Result::Success;
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            std::lock_guard<std::mutex> sendLock(pConnection->sendMutex);
+            if (pConnection->stream.HasPendingSend())
+            {
+                result = pConnection->stream.FlushSend(&pConnection->socket);
+            }
+        }
+
+        return result;
+    }
+
+    void ConnectionListenerTransport::CloseConnection(ListenerConnection* pConnection)
+    {
+        pConnection->active = false;
+
+        std::lock_guard<std::mutex> lock(m_connections.mutex);
+        auto iter = m_connections.connectionMap.find(pConnection->connectionId);
+        if (iter != m_connections.connectionMap.end())
+        {
+            m_connections.closedConnections.emplace_back(std::move(iter->second));
+            m_connections.connectionMap.erase(iter);
+        }
+    }
+
+    void ConnectionListenerTransport::JoinClosedConnections()
+    {
+        std::vector<std::shared_ptr<ListenerConnection>> closedConnections;
+        {
+            std::lock_guard<std::mutex> lock(m_connections.mutex);
+            closedConnections.swap(m_connections.closedConnections);
+        }
+
+        for (auto& pConnection : closedConnections)
+        {
+            // should already be inactive
+            pConnection->active = false;
+            if (pConnection->thread.joinable())
+                pConnection->thread.join();
+        }
+
+        // The sockets are closed when the last reference to each connection is released since a transmit may
+        // still be using one.
+    }
+
+    Result ConnectionListenerTransport::ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs)
+    {
+        // Messages are read and routed by the per-connection threads.
+        DD_UNUSED(connectionInfo);
+        DD_UNUSED(message);
+        DD_UNUSED(timeoutInMs);
+        return Result::Error;
+    }
+
+    Result ConnectionListenerTransport::TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message)
+    {
+        Result result = Result::Error;
+        DD_ASSERT(connectionInfo.handle == m_transportHandle);
+        DD_ASSERT(connectionInfo.size == sizeof(uint32));
+
+        uint32 connectionId = 0;
+        memcpy(&connectionId, &connectionInfo.data[0], sizeof(connectionId));
+
+        std::shared_ptr<ListenerConnection> pConnection;
+        {
+            std::lock_guard<std::mutex> lock(m_connections.mutex);
+            auto iter = m_connections.connectionMap.find(connectionId);
+            if (iter != m_connections.connectionMap.end())
+            {
+                pConnection = iter->second;
+            }
+        }
+
+        if (pConnection != nullptr)
+        {
+            {
+                std::lock_guard<std::mutex> sendLock(pConnection->sendMutex);
+                result = SendConnectionMessage(pConnection.get(), message);
+            }
+
+            // NotReady means the socket buffer is full and lets the router retry later. Anything else means the
+            // connection is no longer usable. Its receiving thread tells the router once it notices.
+            if ((result != Result::Success) && (result != Result::NotReady))
+            {
+                CloseConnection(pConnection.get());
+            }
+        }
+
+        return result;
+    }
+
+    Result ConnectionListenerTransport::TransmitBroadcastMessage(const MessageBuffer &message)
+    {
+        DD_UNUSED(message);
+        return Result::Error;
+    }
+
+    Result ConnectionListenerTransport::Enable(RouterCore *pRouter, TransportHandle handle)
+    {
+        Result result = m_listenSocket.Init(true, m_socketType);
+
+        if (result == Result::Success)
+        {
+            const char* pAddress = (m_hostAddress[0] != 0) ? m_hostAddress : nullptr;
+            result = m_listenSocket.Bind(pAddress, m_port);
+        }
+
+        if (result == Result::Success)
+        {
+            result = m_listenSocket.Listen(kListenBacklog);
+        }
+
+        if (result == Result::Success)
+        {
+            m_transportHandle = handle;
+            m_pRouter = pRouter;
+            m_active = true;
+            m_listenThread = std::thread(&ConnectionListenerTransport::ListeningThreadFunc, this);
+
+            if (m_listenThread.joinable())
+            {
+                m_listening = true;
+            }
+            else
+            {
+                m_active = false;
+                m_transportHandle = 0;
+                m_pRouter = nullptr;
+                result = Result::Error;
+            }
+        }
+
+        if (result != Result::Success)
+        {
+            m_listenSocket.Close();
+        }
+
+        return result;
+    }
+
+    Result ConnectionListenerTransport::Disable()
+    {
+        Result result = Result::Error;
+        if (m_listening)
+        {
+            m_active = false;
+            if (m_listenThread.joinable())
+                m_listenThread.join();
+
+            {
+                std::lock_guard<std::mutex> lock(m_connections.mutex);
+                for (auto& pair : m_connections.connectionMap)
+                {
+                    pair.second->active = false;
+                    m_connections.closedConnections.emplace_back(std::move(pair.second));
+                }
+                m_connections.connectionMap.clear();
+            }
+            JoinClosedConnections();
+
+            m_listenSocket.Close();
+            m_transportHandle = 0;
+            m_pRouter = nullptr;
+            m_listening = false;
+            result = Result::Success;
+        }
+        return result;
+    }
+} // DevDriver
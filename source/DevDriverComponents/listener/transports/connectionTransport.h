@@ -0,0 +1,124 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2016-2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  connectionTransport.h
+* @brief Class declaration for ConnectionListenerTransport
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "abstractListenerTransport.h"
+#include "../src/ddSocket.h"
+#include "../src/ddMessageStream.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace DevDriver
+{
+    class RouterCore;
+
+    // A single accepted connection and the thread that reads from it
+    struct ListenerConnection
+    {
+        Socket            socket;
+        MessageStream     stream;     // Receives are only done by the receiving thread, sends hold sendMutex
+        std::mutex        sendMutex;  // Serializes writes so that messages are never interleaved on the stream
+        std::thread       thread;
+        std::atomic<bool> active;
+        uint32            connectionId;
+    };
+
+    // Accepts clients over a connection oriented socket and services each connection with its own receiving thread,
+    // mirroring the way the named pipe transport handles local clients. TCP connections are framed with
+    // MessageStream. Local packet connections preserve message boundaries so each packet is one message.
+    // A connection closing disconnects its clients immediately instead of waiting for them to time out.
+    class ConnectionListenerTransport : public IListenerTransport
+    {
+    public:
+        ConnectionListenerTransport(SocketType socketType, const char* pAddress, uint32 port);
+        ~ConnectionListenerTransport() override;
+
+        Result ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs) override;
+        Result TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message) override;
+        Result TransmitBroadcastMessage(const MessageBuffer &message) override;
+
+        Result Enable(RouterCore *pRouter, TransportHandle handle) override;
+        Result Disable() override;
+
+        TransportHandle GetHandle() override { return m_transportHandle; };
+        bool ForwardingConnection() override { return false; };
+        const char* GetTransportName() override { return m_hostDescription; };
+
+    protected:
+        // Kernel buffer sizes requested for accepted connections so that bulk transfers are not window limited.
+        DD_STATIC_CONST uint32 kStreamBufferSizeInBytes = (1024 * 1024);
+        DD_STATIC_CONST uint32 kListenBacklog = 16;
+        DD_STATIC_CONST uint32 kWaitTimeoutInMs = 100;
+
+        SocketType      m_socketType;
+        char            m_hostAddress[kMaxStringLength];
+        char            m_hostDescription[kMaxStringLength];
+        uint32          m_port;
+        TransportHandle m_transportHandle;
+        bool            m_listening;
+        std::atomic<bool> m_active;
+        Socket          m_listenSocket;
+        std::thread     m_listenThread;
+        RouterCore*     m_pRouter;
+        uint32          m_nextConnectionId;
+
+        struct
+        {
+            std::unordered_map<uint32, std::shared_ptr<ListenerConnection>> connectionMap;
+            std::vector<std::shared_ptr<ListenerConnection>> closedConnections; // Waiting for their threads to be joined
+            std::mutex mutex;
+        } m_connections;
+
+        void ListeningThreadFunc();
+        void ReceivingThreadFunc(RouterCore* pRouter, ListenerConnection* pConnection);
+
+        // Applies the socket options for the transport's socket type to a newly accepted connection
+        Result ConfigureConnection(ListenerConnection* pConnection);
+
+        // Reads the next complete message from a connection. Returns NotReady if no complete message is available.
+        Result ReceiveConnectionMessage(ListenerConnection* pConnection, MessageBuffer* pMessage);
+
+        // Writes a message to a connection. Returns NotReady if the socket buffer is full and nothing was written.
+        // A message that only partly fits is finished by the connection's receiving thread. Must hold sendMutex.
+        Result SendConnectionMessage(ListenerConnection* pConnection, const MessageBuffer& message);
+
+        // Writes the rest of a partially sent message. Returns NotReady if some of it is still left.
+        Result FlushConnection(ListenerConnection* pConnection);
+
+        // Stops tracking a connection. The connection is destroyed once its thread has been joined.
+        void CloseConnection(ListenerConnection* pConnection);
+        void JoinClosedConnections();
+    };
+} // DevDriver
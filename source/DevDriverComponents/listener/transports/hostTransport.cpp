@@ -25,6 +25,7 @@
 #include "hostTransport.h"
 #include "ddPlatform.h"
 #include "../routerCore.h"
+#include <cstring>
 
 #define BUFFER_LENGTH 16
 #define RECV_BUFSIZE (sizeof(MessageBuffer) * 8)
@@ -32,6 +33,118 @@
 
 namespace DevDriver
 {
+    HostMessageRing::HostMessageRing() :
+        m_pSlots(new Slot[kCapacity]),
+        m_writePosition(0),
+        m_readPosition(0),
+        m_consumerWaiting(false),
+        m_wakeEvent(false)
+    {
+        for (uint32 index = 0; index < kCapacity; ++index)
+        {
+            m_pSlots[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+
+    Result HostMessageRing::Push(const MessageBuffer &message)
+    {
+        DD_ASSERT(message.header.payloadSize <= kMaxPayloadSizeInBytes);
+
+        Slot* pSlot = nullptr;
+        uint32 position = m_writePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            pSlot = &m_pSlots[position & kIndexMask];
+            const uint32 sequence = pSlot->sequence.load(std::memory_order_acquire);
+            const int32 difference = static_cast<int32>(sequence - position);
+
+            if (difference == 0)
+            {
+                // The slot is free, try to claim it. On failure position is reloaded with the current value.
+                if (m_writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The consumer hasn't freed this slot since the last time around, so the ring is full.
+                return Result::NotReady;
+            }
+            else
+            {
+                // Another producer claimed the slot first.
+                position = m_writePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        memcpy(&pSlot->message, &message, sizeof(MessageHeader) + message.header.payloadSize);
+        pSlot->sequence.store(position + 1, std::memory_order_release);
+
+        // Pairs with the fence in Pop so that either the consumer sees the message or we see it waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerWaiting.load(std::memory_order_relaxed))
+        {
+            m_wakeEvent.Signal();
+        }
+
+        return Result::Success;
+    }
+
+    bool HostMessageRing::TryPop(MessageBuffer *pMessage)
+    {
+        Slot &slot = m_pSlots[m_readPosition & kIndexMask];
+        const bool hasMessage = (slot.sequence.load(std::memory_order_acquire) == (m_readPosition + 1));
+
+        if (hasMessage)
+        {
+            memcpy(pMessage, &slot.message, sizeof(MessageHeader) + slot.message.header.payloadSize);
+
+            // Hand the slot back to the producers for their next pass around the ring.
+            slot.sequence.store(m_readPosition + kCapacity, std::memory_order_release);
+            ++m_readPosition;
+        }
+
+        return hasMessage;
+    }
+
+    Result HostMessageRing::Pop(MessageBuffer *pMessage, uint32 timeoutInMs)
+    {
+        Result result = TryPop(pMessage) ? Result::Success : Result::NotReady;
+
+        if ((result == Result::NotReady) && (timeoutInMs > 0))
+        {
+            const uint64 deadlineInMs = (Platform::GetCurrentTimeInMs() + timeoutInMs);
+            uint64 currentTimeInMs = 0;
+
+            do
+            {
+                m_wakeEvent.Clear();
+                m_consumerWaiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                // Check again now that producers are guaranteed to see us waiting.
+                if (TryPop(pMessage))
+                {
+                    result = Result::Success;
+                }
+                else
+                {
+                    currentTimeInMs = Platform::GetCurrentTimeInMs();
+                    if (currentTimeInMs < deadlineInMs)
+                    {
+                        m_wakeEvent.Wait(static_cast<uint32>(deadlineInMs - currentTimeInMs));
+                        result = TryPop(pMessage) ? Result::Success : Result::NotReady;
+                    }
+                }
+
+                m_consumerWaiting.store(false, std::memory_order_relaxed);
+                currentTimeInMs = Platform::GetCurrentTimeInMs();
+            } while ((result == Result::NotReady) && (currentTimeInMs < deadlineInMs));
+        }
+
+        return result;
+    }
 
     HostListenerTransport::HostListenerTransport(const ListenerCreateInfo &createInfo)
         : m_transportHandle(0)
@@ -46,38 +159,39 @@ namespace DevDriver
 
     Result HostListenerTransport::ReceiveMessage(ConnectionInfo & connectionInfo, MessageBuffer & message, uint32 timeoutInMs)
     {
-        Result result = Result::NotReady;
-        const auto waitTime = std::chrono::milliseconds((int64)timeoutInMs);
-        std::unique_lock<std::mutex> lock(m_inboundMessages.mutex);
-        if (m_inboundMessages.signal.wait_for(lock, waitTime, [&] { return !m_inboundMessages.queue.empty(); }))
+        Result result = m_inboundMessages.Pop(&message, timeoutInMs);
+        if (result == Result::Success)
         {
             DD_ASSERT(m_transportHandle != 0);
-            message = m_inboundMessages.queue.front();
-            m_inboundMessages.queue.pop_front();
-            result = Result::Success;
             connectionInfo.handle = m_transportHandle;
             connectionInfo.size = 0;
         }
-        lock.unlock();
         return result;
     }
+
     Result HostListenerTransport::TransmitMessage(const ConnectionInfo & connectionInfo, const MessageBuffer & message)
     {
         DD_ASSERT(connectionInfo.handle == m_transportHandle);
         DD_UNUSED(connectionInfo);
 
-        std::lock_guard<std::mutex> lock(m_outboundMessages.mutex);
-        m_outboundMessages.queue.emplace_back(message);
-        m_outboundMessages.signal.notify_one();
-        return Result::Success;
+        return m_outboundMessages.Push(message);
     }
 
     Result HostListenerTransport::TransmitBroadcastMessage(const MessageBuffer & message)
     {
-        std::lock_guard<std::mutex> lock(m_outboundMessages.mutex);
-        m_outboundMessages.queue.emplace_back(message);
-        m_outboundMessages.signal.notify_one();
-        return Result::Success;
+        // Broadcasts never go through the router's retry queue, so wait a little for the listener's message channel
+        // to make room instead of dropping the message the moment the ring is full.
+        Result result = m_outboundMessages.Push(message);
+        if (result == Result::NotReady)
+        {
+            const uint64 deadlineInMs = (Platform::GetCurrentTimeInMs() + kBroadcastTimeoutInMs);
+            do
+            {
+                Platform::Sleep(kBroadcastRetryDelayInMs);
+                result = m_outboundMessages.Push(message);
+            } while ((result == Result::NotReady) && (Platform::GetCurrentTimeInMs() < deadlineInMs));
+        }
+        return result;
     }
 
     Result HostListenerTransport::Enable(RouterCore *pRouter, TransportHandle handle)
@@ -106,25 +220,12 @@ namespace DevDriver
 
     Result HostListenerTransport::HostReadMessage(MessageBuffer & messageBuffer, uint32 timeoutInMs)
     {
-        const auto waitTime = std::chrono::milliseconds((int64)timeoutInMs);
-        Result result = Result::NotReady;
-        std::unique_lock<std::mutex> lock(m_outboundMessages.mutex);
-        if (m_outboundMessages.signal.wait_for(lock, waitTime, [&] { return !m_outboundMessages.queue.empty(); }))
-        {
-            messageBuffer = m_outboundMessages.queue.front();
-            m_outboundMessages.queue.pop_front();
-            result = Result::Success;
-        }
-        lock.unlock();
-        return result;
+        return m_outboundMessages.Pop(&messageBuffer, timeoutInMs);
     }
 
     Result HostListenerTransport::HostWriteMessage(const MessageBuffer & messageBuffer)
     {
         DD_ASSERT(m_transportHandle != 0);
-        std::lock_guard<std::mutex> lock(m_inboundMessages.mutex);
-        m_inboundMessages.queue.emplace_back(messageBuffer);
-        m_inboundMessages.signal.notify_one();
-        return Result::Success;
+        return m_inboundMessages.Push(messageBuffer);
     }
 } // DevDriver
@@ -31,14 +31,48 @@
 #pragma once
 
 #include "abstractListenerTransport.h"
-#include <deque>
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include "../listenerCore.h"
 #include "../transportThread.h"
 
 namespace DevDriver
 {
+    // Fixed capacity lock-free message queue with any number of producers and a single consumer.
+    // Producers claim a slot with a compare-and-swap on the write position and publish it by bumping the slot's
+    // sequence number, so neither side takes a lock or allocates per message. Only the header and the used part of
+    // the payload are copied. The consumer is only woken through an event when it is actually waiting, which keeps
+    // the common case free of system calls.
+    class HostMessageRing
+    {
+    public:
+        HostMessageRing();
+        ~HostMessageRing() {};
+
+        // Returns NotReady if the ring is full.
+        Result Push(const MessageBuffer &message);
+
+        // Waits up to timeoutInMs for a message. Must only be called from one thread at a time.
+        Result Pop(MessageBuffer *pMessage, uint32 timeoutInMs);
+    private:
+        DD_STATIC_CONST uint32 kCapacity = 256; // Must be a power of two
+        DD_STATIC_CONST uint32 kIndexMask = (kCapacity - 1);
+
+        struct Slot
+        {
+            std::atomic<uint32> sequence; // Equals the write position when free and the write position + 1 when full
+            MessageBuffer       message;
+        };
+
+        bool TryPop(MessageBuffer *pMessage);
+
+        std::unique_ptr<Slot[]> m_pSlots;
+        std::atomic<uint32>     m_writePosition;
+        uint32                  m_readPosition;       // Only accessed by the consumer
+        std::atomic<bool>       m_consumerWaiting;
+        Platform::Event         m_wakeEvent;
+    };
+
     class HostListenerTransport : public IListenerTransport
     {
     public:
@@ -47,6 +81,8 @@ namespace DevDriver
 
         Result ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs) override;
         Result TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message) override;
+
+        // Waits up to kBroadcastTimeoutInMs for room in the outbound ring. Returns NotReady if it stays full.
         Result TransmitBroadcastMessage(const MessageBuffer &message) override;
 
         Result Enable(RouterCore *pRouter, TransportHandle handle) override;
@@ -59,16 +95,16 @@ namespace DevDriver
         Result HostReadMessage(MessageBuffer &messageBuffer, uint32 timeoutInMs);
         Result HostWriteMessage(const MessageBuffer &messageBuffer);
     protected:
+        // The router holds its client and transport locks while broadcasting, so the wait has to stay short.
+        DD_STATIC_CONST uint32 kBroadcastTimeoutInMs    = 100;
+        DD_STATIC_CONST uint32 kBroadcastRetryDelayInMs = 1;
+
         TransportHandle m_transportHandle;
-        struct MessageQueue
-        {
-            std::deque<MessageBuffer> queue;
-            std::condition_variable signal;
-            std::mutex mutex;
-        };
 
-        MessageQueue m_inboundMessages;
-        MessageQueue m_outboundMessages;
+        // Inbound messages are written by the listener's own message channel and read by the transport thread.
+        // Outbound messages are written by every routing thread and read by the message channel.
+        HostMessageRing m_inboundMessages;
+        HostMessageRing m_outboundMessages;
         TransportThread m_transportThread;
     };
 } // DevDriver
@@ -0,0 +1,169 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  impairedTransport.cpp
+* @brief Class definition for ImpairedListenerTransport
+***********************************************************************************************************************
+*/
+
+#include "impairedTransport.h"
+#include <chrono>
+
+namespace DevDriver
+{
+    ImpairedListenerTransport::ImpairedListenerTransport(const AllocCb&                             allocCb,
+                                                         const std::shared_ptr<IListenerTransport>& pTransport,
+                                                         NetworkImpairment*                         pImpairment) :
+        m_pTransport(pTransport),
+        m_pImpairment(pImpairment),
+        m_queue(allocCb),
+        m_active(false)
+    {
+        DD_ASSERT(m_pTransport != nullptr);
+        DD_ASSERT(m_pImpairment != nullptr);
+    }
+
+    ImpairedListenerTransport::~ImpairedListenerTransport()
+    {
+        if (m_thread.joinable())
+        {
+            Disable();
+        }
+    }
+
+    Result ImpairedListenerTransport::ReceiveMessage(ConnectionInfo& connectionInfo, MessageBuffer& message, uint32 timeoutInMs)
+    {
+        return m_pTransport->ReceiveMessage(connectionInfo, message, timeoutInMs);
+    }
+
+    Result ImpairedListenerTransport::TransmitMessage(const ConnectionInfo& connectionInfo, const MessageBuffer& message)
+    {
+        const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+        uint64 deliveryTimesInMs[NetworkImpairment::kMaxCopies] = {};
+        const uint32 numCopies = m_pImpairment->Schedule(sizeof(MessageHeader) + message.header.payloadSize,
+                                                         currentTimeInMs,
+                                                         &deliveryTimesInMs[0]);
+
+        // Dropped messages report success, just like a datagram lost on the wire.
+        Result result = Result::Success;
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            for (uint32 copyIndex = 0; (copyIndex < numCopies) && (result == Result::Success); ++copyIndex)
+            {
+                // Transmit straight through when nothing is queued ahead of this message.
+                if ((deliveryTimesInMs[copyIndex] <= currentTimeInMs) && m_queue.IsEmpty())
+                {
+                    result = m_pTransport->TransmitMessage(connectionInfo, message);
+                }
+                else
+                {
+                    PendingMessage pending = {};
+                    pending.connectionInfo = connectionInfo;
+                    pending.message = message;
+                    if (m_queue.Push(pending, deliveryTimesInMs[copyIndex]))
+                    {
+                        queued = true;
+                    }
+                    else
+                    {
+                        result = Result::InsufficientMemory;
+                    }
+                }
+            }
+        }
+
+        if (queued)
+        {
+            m_queueCondition.notify_one();
+        }
+
+        return result;
+    }
+
+    Result ImpairedListenerTransport::TransmitBroadcastMessage(const MessageBuffer& message)
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        return m_pTransport->TransmitBroadcastMessage(message);
+    }
+
+    Result ImpairedListenerTransport::Enable(RouterCore* pRouter, TransportHandle handle)
+    {
+        // The wrapped transport reports received messages to the router under the handle registered for this wrapper.
+        Result result = m_pTransport->Enable(pRouter, handle);
+        if (result == Result::Success)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_active = true;
+            }
+            m_thread = std::thread(&ImpairedListenerTransport::TransmitThreadFunc, this);
+        }
+        return result;
+    }
+
+    Result ImpairedListenerTransport::Disable()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_active = false;
+            m_queue.Clear();
+        }
+        m_queueCondition.notify_one();
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+
+        return m_pTransport->Disable();
+    }
+
+    void ImpairedListenerTransport::TransmitThreadFunc()
+    {
+        std::unique_lock<std::mutex> lock(m_queueMutex);
+        while (m_active)
+        {
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+
+            PendingMessage pending;
+            while (m_queue.PopDue(currentTimeInMs, &pending))
+            {
+                // Failures are treated as loss on the simulated link.
+                m_pTransport->TransmitMessage(pending.connectionInfo, pending.message);
+            }
+
+            const uint32 waitTimeInMs = m_queue.GetTimeUntilDue(currentTimeInMs);
+            if (waitTimeInMs == kInfiniteTimeout)
+            {
+                m_queueCondition.wait(lock);
+            }
+            else
+            {
+                m_queueCondition.wait_for(lock, std::chrono::milliseconds(waitTimeInMs));
+            }
+        }
+    }
+} // DevDriver
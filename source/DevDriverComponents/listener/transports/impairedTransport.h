@@ -0,0 +1,84 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  impairedTransport.h
+* @brief Class declaration for ImpairedListenerTransport
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "abstractListenerTransport.h"
+#include "ddNetworkImpairment.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace DevDriver
+{
+    // Wraps another listener transport and runs every message it transmits through a NetworkImpairment.
+    // Surviving messages are held until their delivery time and then transmitted by a dedicated thread.
+    // The wrapped transport still owns its receive path, so only the direction from the listener to its clients is
+    // impaired. Clients can impair the other direction with ImpairedMsgTransport.
+    class ImpairedListenerTransport : public IListenerTransport
+    {
+    public:
+        ImpairedListenerTransport(const AllocCb&                             allocCb,
+                                  const std::shared_ptr<IListenerTransport>& pTransport,
+                                  NetworkImpairment*                         pImpairment);
+        ~ImpairedListenerTransport() override;
+
+        Result ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs) override;
+        Result TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message) override;
+        Result TransmitBroadcastMessage(const MessageBuffer &message) override;
+
+        Result Enable(RouterCore *pRouter, TransportHandle handle) override;
+        Result Disable() override;
+
+        TransportHandle GetHandle() override { return m_pTransport->GetHandle(); };
+        bool ForwardingConnection() override { return m_pTransport->ForwardingConnection(); };
+        const char* GetTransportName() override { return m_pTransport->GetTransportName(); };
+
+    private:
+        struct PendingMessage
+        {
+            ConnectionInfo connectionInfo;
+            MessageBuffer  message;
+        };
+
+        void TransmitThreadFunc();
+
+        std::shared_ptr<IListenerTransport> m_pTransport;
+        NetworkImpairment*                  m_pImpairment;
+
+        // Protects the queue and serializes every transmit on the wrapped transport
+        std::mutex                          m_queueMutex;
+        std::condition_variable             m_queueCondition;
+        ImpairmentQueue<PendingMessage>     m_queue;
+        bool                                m_active;
+        std::thread                         m_thread;
+    };
+} // DevDriver
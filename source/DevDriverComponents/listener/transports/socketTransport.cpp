@@ -55,7 +55,16 @@ namespace DevDriver
     SocketListenerTransport::SocketListenerTransport(TransportType type, const char *pAddress, uint32 port) :
         m_socketType(TransportToSocketType(type)),
         m_port(port),
-        m_listening(false)
+        m_transportHandle(0),
+        m_listening(false),
+        m_sendBufferSize(0),
+        m_receiveBufferSize(0),
+        m_requestReceiveCoalescing(false),
+        m_receiveCoalescing(false),
+        m_coalescedSource(),
+        m_coalescedSize(0),
+        m_coalescedOffset(0),
+        m_coalescedSegmentSize(0)
     {
         if (pAddress != nullptr)
         {
@@ -93,6 +102,13 @@ namespace DevDriver
         bool canRead = false;
         bool exceptState = false;
         connectionInfo.handle = m_transportHandle;
+
+        // Hand out the rest of a coalesced receive before going back to the socket.
+        if (m_coalescedOffset < m_coalescedSize)
+        {
+            return NextCoalescedMessage(connectionInfo, message);
+        }
+
         Result result = m_clientSocket.Select(&canRead, nullptr, &exceptState, timeoutInMs);
         if (result == Result::Success)
         {
@@ -100,6 +116,23 @@ namespace DevDriver
             {
                 result = Result::Error;
             }
+            else if (canRead && m_receiveCoalescing)
+            {
+                m_coalescedSource.handle = m_transportHandle;
+                m_coalescedSource.size = sizeof(m_coalescedSource.data);
+                m_coalescedOffset = 0;
+                m_coalescedSize = 0;
+                result = m_clientSocket.ReceiveSegmentsFrom(reinterpret_cast<void*>(&m_coalescedSource.data[0]),
+                                                            &m_coalescedSource.size,
+                                                            m_coalescedBuffer.data(),
+                                                            m_coalescedBuffer.size(),
+                                                            &m_coalescedSize,
+                                                            &m_coalescedSegmentSize);
+                if (result == Result::Success)
+                {
+                    result = NextCoalescedMessage(connectionInfo, message);
+                }
+            }
             else if (canRead)
             {
                 connectionInfo.size = sizeof(connectionInfo.data);
@@ -116,6 +149,27 @@ namespace DevDriver
         return result;
     }
 
+    Result SocketListenerTransport::NextCoalescedMessage(ConnectionInfo& connectionInfo, MessageBuffer& message)
+    {
+        DD_ASSERT(m_coalescedOffset < m_coalescedSize);
+
+        const size_t messageSize = Platform::Min(m_coalescedSegmentSize, m_coalescedSize - m_coalescedOffset);
+        memcpy(&message, &m_coalescedBuffer[m_coalescedOffset], Platform::Min(messageSize, sizeof(MessageBuffer)));
+        m_coalescedOffset += messageSize;
+
+        memcpy(&connectionInfo, &m_coalescedSource, sizeof(ConnectionInfo));
+
+        return Result::Success;
+    }
+
+    void SocketListenerTransport::SetSocketBufferSizes(uint32 sendBufferSize, uint32 receiveBufferSize)
+    {
+        DD_ASSERT(m_transportHandle == 0);
+
+        m_sendBufferSize = sendBufferSize;
+        m_receiveBufferSize = receiveBufferSize;
+    }
+
     Result SocketListenerTransport::TransmitMessage(const ConnectionInfo& connectionInfo, const MessageBuffer& message)
     {
         DD_ASSERT(connectionInfo.handle == m_transportHandle);
@@ -126,6 +180,28 @@ namespace DevDriver
         return result;
     }
 
+    void SocketListenerTransport::TransmitMessageToConnections(const ConnectionInfo* const* ppConnections,
+                                                               size_t                       numConnections,
+                                                               const MessageBuffer&         message,
+                                                               Result*                      pResults)
+    {
+        m_batchAddresses.resize(numConnections);
+        m_batchAddressSizes.resize(numConnections);
+        for (size_t connectionIndex = 0; connectionIndex < numConnections; ++connectionIndex)
+        {
+            DD_ASSERT(ppConnections[connectionIndex]->handle == m_transportHandle);
+            m_batchAddresses[connectionIndex] = &ppConnections[connectionIndex]->data[0];
+            m_batchAddressSizes[connectionIndex] = ppConnections[connectionIndex]->size;
+        }
+
+        m_clientSocket.SendToMultiple(m_batchAddresses.data(),
+                                      m_batchAddressSizes.data(),
+                                      numConnections,
+                                      reinterpret_cast<const uint8*>(&message),
+                                      sizeof(MessageHeader) + message.header.payloadSize,
+                                      pResults);
+    }
+
     Result SocketListenerTransport::TransmitBroadcastMessage(const MessageBuffer& message)
     {
         DD_UNUSED(message);
@@ -133,6 +209,24 @@ namespace DevDriver
         return Result::Error;
     }
 
+    Result SocketListenerTransport::LookupConnectionInfo(const char *pAddress, uint32 port, ConnectionInfo *pConnectionInfo)
+    {
+        DD_ASSERT(pConnectionInfo != nullptr);
+
+        Result result = Result::Error;
+        if (m_transportHandle != 0)
+        {
+            memset(pConnectionInfo, 0, sizeof(ConnectionInfo));
+            pConnectionInfo->handle = m_transportHandle;
+            result = m_clientSocket.LookupAddressInfo(pAddress,
+                                                      port,
+                                                      sizeof(pConnectionInfo->data),
+                                                      &pConnectionInfo->data[0],
+                                                      &pConnectionInfo->size);
+        }
+        return result;
+    }
+
     Result SocketListenerTransport::Enable(RouterCore *pRouter, TransportHandle handle)
     {
         Result result = Result::Error;
@@ -142,6 +236,23 @@ namespace DevDriver
             char *address = nullptr;
             if (m_hostAddress[0] != 0)
                 address = m_hostAddress;
+            if ((m_sendBufferSize != 0) || (m_receiveBufferSize != 0))
+            {
+                if (m_clientSocket.SetBufferSizes(m_sendBufferSize, m_receiveBufferSize) != Result::Success)
+                {
+                    DD_PRINT(LogLevel::Alert, "[SocketListenerTransport] Failed to set the socket buffer sizes for %s", m_hostDescription);
+                }
+            }
+
+            // Coalesced receives can carry up to a full IP datagram worth of messages.
+            DD_STATIC_CONST size_t kCoalescedBufferSize = 65536;
+            m_receiveCoalescing = (m_requestReceiveCoalescing &&
+                                   (m_socketType == SocketType::Udp) &&
+                                   (m_clientSocket.EnableReceiveCoalescing() == Result::Success));
+            m_coalescedBuffer.resize(m_receiveCoalescing ? kCoalescedBufferSize : 0);
+            m_coalescedOffset = 0;
+            m_coalescedSize = 0;
+
             if (m_clientSocket.Bind(address, m_port) == Result::Success)
             {
                 result = Result::Success;
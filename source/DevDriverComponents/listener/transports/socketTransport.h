@@ -33,6 +33,7 @@
 #include "abstractListenerTransport.h"
 #include "../src/ddSocket.h"
 #include "../transportThread.h"
+#include <vector>
 
 namespace DevDriver
 {
@@ -49,6 +50,22 @@ namespace DevDriver
         Result ReceiveMessage(ConnectionInfo &connectionInfo, MessageBuffer &message, uint32 timeoutInMs) override;
         Result TransmitMessage(const ConnectionInfo &connectionInfo, const MessageBuffer &message) override;
         Result TransmitBroadcastMessage(const MessageBuffer &message) override;
+        void TransmitMessageToConnections(const ConnectionInfo* const* ppConnections,
+                                          size_t                       numConnections,
+                                          const MessageBuffer&         message,
+                                          Result*                      pResults) override;
+
+        // Resolves a network address into connection info that can be used to send messages through this transport.
+        // The transport must be enabled.
+        Result LookupConnectionInfo(const char *pAddress, uint32 port, ConnectionInfo *pConnectionInfo);
+
+        // Overrides the kernel buffer sizes of the transport's socket. A size of zero keeps the default.
+        // Must be called before the transport is enabled.
+        void SetSocketBufferSizes(uint32 sendBufferSize, uint32 receiveBufferSize);
+
+        // Lets the kernel coalesce datagrams from the same sender into a single receive (UDP GRO) if the platform
+        // supports it. Must be called before the transport is enabled.
+        void SetReceiveCoalescing(bool enable) { m_requestReceiveCoalescing = enable; }
 
         Result Enable(RouterCore *pRouter, TransportHandle handle) override;
         Result Disable() override;
@@ -58,6 +75,9 @@ namespace DevDriver
         const char* GetTransportName() override { return m_hostDescription; };
 
     protected:
+        // Returns the next datagram of the last coalesced receive
+        Result NextCoalescedMessage(ConnectionInfo& connectionInfo, MessageBuffer& message);
+
         char        m_hostAddress[kMaxStringLength];
         char        m_hostDescription[kMaxStringLength];
         Socket      m_clientSocket;
@@ -66,5 +86,21 @@ namespace DevDriver
         TransportHandle m_transportHandle;
         bool        m_listening;
         TransportThread m_transportThread;
+        uint32      m_sendBufferSize;
+        uint32      m_receiveBufferSize;
+        bool        m_requestReceiveCoalescing;
+        bool        m_receiveCoalescing;
+
+        // Datagrams from the last coalesced receive that haven't been returned by ReceiveMessage yet.
+        // Only accessed from the transport thread.
+        std::vector<uint8> m_coalescedBuffer;
+        ConnectionInfo     m_coalescedSource;
+        size_t             m_coalescedSize;
+        size_t             m_coalescedOffset;
+        size_t             m_coalescedSegmentSize;
+
+        // Scratch storage for batched transmits. Only used by the router while it holds its transport lock.
+        std::vector<const void*> m_batchAddresses;
+        std::vector<size_t>      m_batchAddressSizes;
     };
 } // DevDriver
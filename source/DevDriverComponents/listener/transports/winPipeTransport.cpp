@@ -284,35 +284,43 @@ namespace DevDriver
         memcpy(&recvContext.connectionInfo.data[0], &pThreadInfo->pipeHandle, sizeof(HANDLE));
 
         RoutingCache cache(pRouter);
-        std::deque<MessageContext> recvQueue;
-        std::deque<MessageContext> retryQueue;
+        RoutingRetryQueue retryQueue;
+        RoutingScheduler scheduler(pRouter);
 
         // Loop until done reading
         while (pThreadInfo->active)
         {
-            size_t firstNewMessageIndex = recvQueue.size();
             DD_STATIC_CONST uint32 kReceiveDelayInMs = 10;
+            DD_STATIC_CONST uint32 kRetryDelayInMs = 1;
 
-            // Check for new local messages.
-            Result result = ReadMessage(*pThreadInfo, oOverlap, recvContext, kReceiveDelayInMs);
-            while (result == Result::Success)
-            {
-                recvQueue.emplace_back(recvContext);
-                result = ReadMessage(*pThreadInfo, oOverlap, recvContext, kNoWait);
-            }
+            // Give messages that are waiting on a busy destination another chance before reading new ones, then
+            // let backlogged senders have their share.
+            retryQueue.RetryQueuedMessages(cache);
+            scheduler.RouteQueuedMessages(cache, retryQueue);
+
+            Result result = Result::NotReady;
 
-            size_t messageNumber = 0;
-            for (const auto &message : recvQueue)
+            // Stop reading from the pipe while the scheduling queues are saturated so that the client blocks instead of
+            // the listener buffering without bound.
+            if (!scheduler.IsSaturated())
             {
-                messageNumber++;
-                // only requeue messages if it's the first time we've tried to send them
-                if ((cache.RouteMessage(message) == Result::NotReady) & (messageNumber > firstNewMessageIndex))
+                const bool hasQueuedMessages = (retryQueue.HasQueuedMessages() || scheduler.HasQueuedMessages());
+                const uint32 timeoutInMs = hasQueuedMessages ? kRetryDelayInMs : kReceiveDelayInMs;
+
+                // Check for new local messages.
+                result = ReadMessage(*pThreadInfo, oOverlap, recvContext, timeoutInMs);
+                while (result == Result::Success)
                 {
-                    retryQueue.emplace_back(message);
+                    scheduler.RouteMessage(cache, retryQueue, recvContext);
+                    result = scheduler.IsSaturated()
+                        ? Result::NotReady
+                        : ReadMessage(*pThreadInfo, oOverlap, recvContext, kNoWait);
                 }
             }
-            recvQueue.clear();
-            recvQueue.swap(retryQueue);
+            else
+            {
+                Platform::Sleep(kRetryDelayInMs);
+            }
 
             if (result == Result::Error)
             {
@@ -323,7 +331,12 @@ namespace DevDriver
                     m_threadPool.deleteSet.emplace(pThreadInfo);
                 }
             }
+
+            cache.FlushStats(false);
         }
+
+        scheduler.DropQueuedMessages(cache);
+        retryQueue.DropQueuedMessages(cache);
     }
 
     PipeListenerTransport::PipeListenerTransport(const char* pPipeName) :
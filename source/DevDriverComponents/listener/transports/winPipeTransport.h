@@ -31,6 +31,7 @@
 #pragma once
 
 #include "abstractListenerTransport.h"
+#include <atomic>
 #include <deque>
 #include <unordered_set>
 #include <condition_variable>
@@ -48,7 +49,7 @@ namespace DevDriver
     {
         std::mutex      lock;
         std::thread     thread;
-        volatile bool   active;
+        std::atomic<bool> active;
         Handle          pipeHandle;
         Handle          writeEvent;
         Handle          readEvent;
@@ -0,0 +1,243 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddClientConnectionManager.cpp
+* @brief Class definition for ClientConnectionManager
+***********************************************************************************************************************
+*/
+
+#include "ddClientConnectionManager.h"
+
+namespace DevDriver
+{
+    // =================================================================================================================
+    ClientConnectionManager::ClientConnectionManager(const AllocCb&                           allocCb,
+                                                     DevDriverClient*                         pClient,
+                                                     const ClientConnectionManagerCreateInfo& createInfo)
+        : m_allocCb(allocCb)
+        , m_pClient(pClient)
+        , m_createInfo(createInfo)
+        , m_mutex()
+        , m_targets(allocCb)
+        , m_leases(allocCb)
+    {
+        DD_ASSERT(m_pClient != nullptr);
+    }
+
+    // =================================================================================================================
+    ClientConnectionManager::~ClientConnectionManager()
+    {
+        DisconnectAll();
+    }
+
+    // =================================================================================================================
+    void ClientConnectionManager::DisconnectProtocolClient(IProtocolClient* pProtocolClient)
+    {
+        bool found = false;
+
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+            for (size_t index = 0; index < m_leases.Size(); ++index)
+            {
+                if (m_leases[index].pProtocolClient == pProtocolClient)
+                {
+                    auto iter = m_targets.Find(m_leases[index].targetClientId);
+                    if (iter != m_targets.End())
+                    {
+                        DD_ASSERT(iter->value.numClients > 0);
+                        iter->value.numClients -= 1;
+                    }
+
+                    m_leases.Remove(index);
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        // The DevDriverClient disconnects the protocol client before putting it back in its pool.
+        if (found)
+        {
+            m_pClient->ReleaseProtocolClient(pProtocolClient);
+        }
+    }
+
+    // =================================================================================================================
+    void ClientConnectionManager::DisconnectTarget(ClientId targetClientId)
+    {
+        Vector<IProtocolClient*, 16> targetClients(m_allocCb);
+
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+            size_t index = 0;
+            while (index < m_leases.Size())
+            {
+                if (m_leases[index].targetClientId == targetClientId)
+                {
+                    targetClients.PushBack(m_leases[index].pProtocolClient);
+                    m_leases.Remove(index);
+                }
+                else
+                {
+                    ++index;
+                }
+            }
+
+            auto iter = m_targets.Find(targetClientId);
+            if (iter != m_targets.End())
+            {
+                DD_ASSERT(iter->value.numClients >= targetClients.Size());
+                iter->value.numClients -= static_cast<uint32>(targetClients.Size());
+            }
+        }
+
+        for (size_t index = 0; index < targetClients.Size(); ++index)
+        {
+            m_pClient->ReleaseProtocolClient(targetClients[index]);
+        }
+    }
+
+    // =================================================================================================================
+    void ClientConnectionManager::DisconnectAll()
+    {
+        Vector<ClientLease, 16> leases(m_allocCb);
+
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+            leases.Swap(m_leases);
+
+            // Only the released leases are subtracted. Connects that are still in flight keep their reservation and
+            // give it back themselves.
+            for (size_t index = 0; index < leases.Size(); ++index)
+            {
+                auto iter = m_targets.Find(leases[index].targetClientId);
+                if (iter != m_targets.End())
+                {
+                    DD_ASSERT(iter->value.numClients > 0);
+                    iter->value.numClients -= 1;
+                }
+            }
+        }
+
+        for (size_t index = 0; index < leases.Size(); ++index)
+        {
+            m_pClient->ReleaseProtocolClient(leases[index].pProtocolClient);
+        }
+    }
+
+    // =================================================================================================================
+    void ClientConnectionManager::SetTargetQuota(ClientId targetClientId, uint32 maxClients)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        bool existed = false;
+        TargetState* pState = m_targets.FindAllocate(targetClientId, &existed);
+        if (pState != nullptr)
+        {
+            if (!existed)
+            {
+                pState->numClients = 0;
+            }
+            pState->maxClients = maxClients;
+        }
+    }
+
+    // =================================================================================================================
+    uint32 ClientConnectionManager::GetNumConnectedClients(ClientId targetClientId)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        uint32 numClients = 0;
+        for (size_t index = 0; index < m_leases.Size(); ++index)
+        {
+            if (m_leases[index].targetClientId == targetClientId)
+            {
+                ++numClients;
+            }
+        }
+
+        return numClients;
+    }
+
+    // =================================================================================================================
+    // Counts a client against the target's quota before it connects so that concurrent connects can't overshoot it
+    Result ClientConnectionManager::ReserveClient(ClientId targetClientId)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        Result result = Result::InsufficientMemory;
+
+        bool existed = false;
+        TargetState* pState = m_targets.FindAllocate(targetClientId, &existed);
+        if (pState != nullptr)
+        {
+            if (!existed)
+            {
+                pState->maxClients = m_createInfo.maxClientsPerTarget;
+                pState->numClients = 0;
+            }
+
+            TargetState& state = *pState;
+            if ((state.maxClients == 0) || (state.numClients < state.maxClients))
+            {
+                state.numClients += 1;
+                result = Result::Success;
+            }
+            else
+            {
+                result = Result::Rejected;
+            }
+        }
+
+        return result;
+    }
+
+    // =================================================================================================================
+    void ClientConnectionManager::CancelReservation(ClientId targetClientId)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        auto iter = m_targets.Find(targetClientId);
+        if (iter != m_targets.End())
+        {
+            DD_ASSERT(iter->value.numClients > 0);
+            iter->value.numClients -= 1;
+        }
+    }
+
+    // =================================================================================================================
+    Result ClientConnectionManager::TrackClient(ClientId targetClientId, IProtocolClient* pProtocolClient)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        ClientLease lease = {};
+        lease.pProtocolClient = pProtocolClient;
+        lease.targetClientId = targetClientId;
+        return m_leases.PushBack(lease) ? Result::Success : Result::InsufficientMemory;
+    }
+} // DevDriver
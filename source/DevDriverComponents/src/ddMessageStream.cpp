@@ -0,0 +1,163 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2016-2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddMessageStream.cpp
+* @brief Class definition for MessageStream
+***********************************************************************************************************************
+*/
+
+#include "ddMessageStream.h"
+
+#include <cstring>
+
+namespace DevDriver
+{
+    MessageStream::MessageStream() :
+        m_receiveBuffer(),
+        m_bytesReceived(0),
+        m_sendBuffer(),
+        m_sendSize(0),
+        m_bytesSent(0)
+    {
+    }
+
+    Result MessageStream::ReceiveMessage(Socket* pSocket, MessageBuffer* pMessageBuffer)
+    {
+        DD_ASSERT(pSocket != nullptr);
+        DD_ASSERT(pMessageBuffer != nullptr);
+
+        Result result = Result::Success;
+
+        uint8* pBuffer = reinterpret_cast<uint8*>(&m_receiveBuffer);
+
+        // Read the header first, then the payload size it describes.
+        size_t messageSize = sizeof(MessageHeader);
+        while (result == Result::Success)
+        {
+            if (m_bytesReceived >= sizeof(MessageHeader))
+            {
+                if (m_receiveBuffer.header.payloadSize > kMaxPayloadSizeInBytes)
+                {
+                    // A bad length means we can no longer find message boundaries in this stream.
+                    result = Result::Error;
+                    break;
+                }
+
+                messageSize = (sizeof(MessageHeader) + m_receiveBuffer.header.payloadSize);
+            }
+
+            if (m_bytesReceived == messageSize)
+            {
+                break;
+            }
+
+            size_t bytesReceived = 0;
+            result = pSocket->Receive(pBuffer + m_bytesReceived, (messageSize - m_bytesReceived), &bytesReceived);
+
+            if (result == Result::Success)
+            {
+                m_bytesReceived += bytesReceived;
+            }
+        }
+
+        if (result == Result::Success)
+        {
+            memcpy(pMessageBuffer, &m_receiveBuffer, messageSize);
+            m_bytesReceived = 0;
+        }
+        else if (result == Result::Unavailable)
+        {
+            // The remote side closed the stream.
+            result = Result::Error;
+        }
+
+        return result;
+    }
+
+    Result MessageStream::SendMessage(Socket* pSocket, const MessageBuffer& messageBuffer)
+    {
+        DD_ASSERT(pSocket != nullptr);
+        DD_ASSERT(messageBuffer.header.payloadSize <= kMaxPayloadSizeInBytes);
+
+        // Messages can't overtake the rest of an earlier one.
+        Result result = FlushSend(pSocket);
+
+        if (result == Result::Success)
+        {
+            const uint8* pData = reinterpret_cast<const uint8*>(&messageBuffer);
+            const size_t messageSize = (sizeof(MessageHeader) + messageBuffer.header.payloadSize);
+
+            size_t bytesSent = 0;
+            result = pSocket->Send(pData, messageSize, &bytesSent);
+
+            if ((result == Result::Success) && (bytesSent < messageSize))
+            {
+                // Part of the message is already on the wire, so the rest has to follow before anything else or the
+                // stream is corrupted. Keep it instead of waiting for the socket to drain.
+                memcpy(&m_sendBuffer, &messageBuffer, messageSize);
+                m_sendSize = messageSize;
+                m_bytesSent = bytesSent;
+                FlushSend(pSocket);
+            }
+        }
+
+        return result;
+    }
+
+    Result MessageStream::FlushSend(Socket* pSocket)
+    {
+        DD_ASSERT(pSocket != nullptr);
+
+        Result result = Result::Success;
+
+        const uint8* pData = reinterpret_cast<const uint8*>(&m_sendBuffer);
+        while ((result == Result::Success) && (m_bytesSent < m_sendSize))
+        {
+            size_t bytesSent = 0;
+            result = pSocket->Send(pData + m_bytesSent, (m_sendSize - m_bytesSent), &bytesSent);
+
+            if (result == Result::Success)
+            {
+                m_bytesSent += bytesSent;
+            }
+        }
+
+        if (m_bytesSent == m_sendSize)
+        {
+            m_sendSize = 0;
+            m_bytesSent = 0;
+        }
+
+        return result;
+    }
+
+    void MessageStream::Reset()
+    {
+        m_bytesReceived = 0;
+        m_sendSize = 0;
+        m_bytesSent = 0;
+    }
+
+} // DevDriver
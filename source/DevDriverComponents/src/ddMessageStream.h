@@ -0,0 +1,81 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2016-2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddMessageStream.h
+* @brief Class declaration for MessageStream
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "gpuopen.h"
+#include "ddSocket.h"
+
+namespace DevDriver
+{
+    // Frames messages over a reliable byte stream such as a TCP socket.
+    //
+    // Every message already begins with a MessageHeader whose payloadSize field describes how many bytes follow it,
+    // so the header itself serves as the length prefix and no extra framing is placed on the wire. Receives are
+    // accumulated across calls so that a non-blocking socket can deliver a message in arbitrarily small pieces.
+    // Sends work the same way in the other direction. The send and receive sides may be used from different
+    // threads, as long as each side is only used by one thread at a time.
+    class MessageStream
+    {
+    public:
+        MessageStream();
+        ~MessageStream() {}
+
+        // Attempts to read the next complete message from the socket.
+        // Returns NotReady if only part of a message is currently available, Error if the stream was closed or
+        // contained an invalid message.
+        Result ReceiveMessage(Socket* pSocket, MessageBuffer* pMessageBuffer);
+
+        // Writes a message to the socket without blocking. If the socket only takes part of it, the rest is kept and
+        // written by later calls, and the message still counts as sent.
+        // Returns NotReady without writing anything if the socket takes no data, or if the rest of an earlier message
+        // is still waiting and can't be written yet. Returns Error if the stream was closed.
+        Result SendMessage(Socket* pSocket, const MessageBuffer& messageBuffer);
+
+        // Writes whatever is left of a partially sent message.
+        // Returns Success once nothing is left, NotReady if the socket can't take all of it yet.
+        Result FlushSend(Socket* pSocket);
+
+        // Returns true if part of a message is still waiting to be written.
+        bool HasPendingSend() const { return (m_bytesSent < m_sendSize); }
+
+        // Discards any partially received or partially sent message.
+        void Reset();
+
+    private:
+        MessageBuffer m_receiveBuffer;
+        size_t        m_bytesReceived;
+
+        MessageBuffer m_sendBuffer; // Holds a partially sent message until all of it is written
+        size_t        m_sendSize;
+        size_t        m_bytesSent;
+    };
+
+} // DevDriver
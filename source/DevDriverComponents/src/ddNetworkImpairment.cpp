@@ -0,0 +1,195 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  ddNetworkImpairment.cpp
+* @brief Class definition for NetworkImpairment
+***********************************************************************************************************************
+*/
+
+#include "ddNetworkImpairment.h"
+
+namespace DevDriver
+{
+    // =================================================================================================================
+    NetworkImpairment::NetworkImpairment()
+        : m_config()
+        , m_stats()
+        , m_randomState(1)
+        , m_burstRemaining(0)
+        , m_messageCount(0)
+        , m_linkFreeTimeInUs(0)
+    {
+    }
+
+    // =================================================================================================================
+    NetworkImpairment::NetworkImpairment(const NetworkImpairmentConfig& config)
+        : NetworkImpairment()
+    {
+        SetConfig(config);
+    }
+
+    // =================================================================================================================
+    NetworkImpairment::~NetworkImpairment()
+    {
+    }
+
+    // =================================================================================================================
+    void NetworkImpairment::SetConfig(const NetworkImpairmentConfig& config)
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        m_config = config;
+
+        // Xorshift can't leave the all zero state, so remap a zero seed.
+        m_randomState = (config.seed != 0) ? config.seed : 1;
+        m_burstRemaining = 0;
+        m_messageCount = 0;
+        m_linkFreeTimeInUs = 0;
+    }
+
+    // =================================================================================================================
+    NetworkImpairmentConfig NetworkImpairment::GetConfig() const
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+        return m_config;
+    }
+
+    // =================================================================================================================
+    bool NetworkImpairment::IsEnabled() const
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+        return ((m_config.lossRatio > 0.0f) ||
+                (m_config.dropInterval != 0) ||
+                (m_config.delayInMs != 0) ||
+                (m_config.jitterInMs != 0) ||
+                ((m_config.reorderRatio > 0.0f) && (m_config.reorderDelayInMs != 0)) ||
+                (m_config.duplicateRatio > 0.0f) ||
+                (m_config.bandwidthInBytesPerSecond != 0));
+    }
+
+    // =================================================================================================================
+    uint32 NetworkImpairment::Schedule(size_t messageSize, uint64 currentTimeInMs, uint64* pDeliveryTimesInMs)
+    {
+        DD_ASSERT(pDeliveryTimesInMs != nullptr);
+
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+        ++m_stats.messagesSubmitted;
+        ++m_messageCount;
+
+        // Losses are decided first so a dropped message doesn't occupy the simulated link.
+        bool drop = false;
+        if (m_burstRemaining > 0)
+        {
+            --m_burstRemaining;
+            drop = true;
+        }
+        else if ((m_config.lossRatio > 0.0f) && (NextRandomFloat() < m_config.lossRatio))
+        {
+            m_burstRemaining = (m_config.lossBurstLength > 1) ? (m_config.lossBurstLength - 1) : 0;
+            drop = true;
+        }
+
+        if ((m_config.dropInterval != 0) && ((m_messageCount % m_config.dropInterval) == 0))
+        {
+            drop = true;
+        }
+
+        uint32 numCopies = 0;
+        if (drop)
+        {
+            ++m_stats.messagesDropped;
+        }
+        else
+        {
+            numCopies = 1;
+            if ((m_config.duplicateRatio > 0.0f) && (NextRandomFloat() < m_config.duplicateRatio))
+            {
+                numCopies = 2;
+                ++m_stats.messagesDuplicated;
+            }
+
+            const uint64 currentTimeInUs = (currentTimeInMs * 1000);
+            for (uint32 copyIndex = 0; copyIndex < numCopies; ++copyIndex)
+            {
+                // Serialize the copy onto the link. The link is idle again once its last bit has been sent.
+                uint64 sentTimeInUs = currentTimeInUs;
+                if (m_config.bandwidthInBytesPerSecond != 0)
+                {
+                    const uint64 startTimeInUs = Platform::Max(currentTimeInUs, m_linkFreeTimeInUs);
+                    const uint64 transmitTimeInUs = ((static_cast<uint64>(messageSize) * 1000000) /
+                                                     m_config.bandwidthInBytesPerSecond);
+                    sentTimeInUs = (startTimeInUs + transmitTimeInUs);
+                    m_linkFreeTimeInUs = sentTimeInUs;
+                }
+
+                uint64 delayInMs = m_config.delayInMs;
+                if (m_config.jitterInMs != 0)
+                {
+                    delayInMs += (NextRandom() % (m_config.jitterInMs + 1));
+                }
+
+                if ((m_config.reorderRatio > 0.0f) &&
+                    (m_config.reorderDelayInMs != 0) &&
+                    (NextRandomFloat() < m_config.reorderRatio))
+                {
+                    delayInMs += m_config.reorderDelayInMs;
+                    ++m_stats.messagesReordered;
+                }
+
+                // Round the link time up so a message is never delivered before it has been fully sent.
+                pDeliveryTimesInMs[copyIndex] = (((sentTimeInUs + 999) / 1000) + delayInMs);
+            }
+        }
+
+        return numCopies;
+    }
+
+    // =================================================================================================================
+    NetworkImpairmentStats NetworkImpairment::GetStats() const
+    {
+        Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    // =================================================================================================================
+    uint32 NetworkImpairment::NextRandom()
+    {
+        // Xorshift32. Cheap, and deterministic for a given seed on every platform.
+        uint32 state = m_randomState;
+        state ^= (state << 13);
+        state ^= (state >> 17);
+        state ^= (state << 5);
+        m_randomState = state;
+        return state;
+    }
+
+    // =================================================================================================================
+    float NetworkImpairment::NextRandomFloat()
+    {
+        // Use the top 24 bits so the result is exactly representable and always below 1.
+        return (static_cast<float>(NextRandom() >> 8) / static_cast<float>(1u << 24));
+    }
+} // DevDriver
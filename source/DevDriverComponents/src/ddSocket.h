@@ -58,7 +58,8 @@ namespace DevDriver
         Unknown = 0,
         Tcp,
         Udp,
-        Local
+        Local,
+        LocalSeqPacket  // Connection oriented local socket that preserves message boundaries (Linux only)
     };
 
     /**
@@ -95,14 +96,48 @@ namespace DevDriver
 
         Result SendTo(const void* pSockAddr, size_t addrSize, const uint8* pData, size_t dataSize);
 
+        /// Sends the same datagram to every address in ppSockAddrs, batching the sends into as few system calls as
+        /// the platform allows. The result of each individual send is written into the matching entry of pResults.
+        ///
+        /// @returns Success if every send succeeded, or the first failure otherwise.
+        Result SendToMultiple(const void* const* ppSockAddrs,
+                              const size_t*      pAddrSizes,
+                              size_t             numAddrs,
+                              const uint8*       pData,
+                              size_t             dataSize,
+                              Result*            pResults);
+
         Result Receive(uint8* pBuffer, size_t bufferSize, size_t* pBytesReceived);
 
         Result ReceiveFrom(void *pSockAddr, size_t *addrSize, uint8* pBuffer, size_t bufferSize);
 
+        /// Allows the kernel to coalesce datagrams from the same sender into a single receive (UDP GRO).
+        ///
+        /// @returns Success if coalescing was enabled, or Unavailable if the platform does not support it.
+        Result EnableReceiveCoalescing();
+
+        /// Receives one or more datagrams from a single sender. pSegmentSize is set to the size of every datagram in
+        /// the buffer except the last, which may be shorter. Unless receive coalescing is enabled, this always
+        /// returns a single datagram.
+        Result ReceiveSegmentsFrom(void*   pSockAddr,
+                                   size_t* pAddrSize,
+                                   uint8*  pBuffer,
+                                   size_t  bufferSize,
+                                   size_t* pBytesReceived,
+                                   size_t* pSegmentSize);
+
         Result Close();
 
         Result GetSocketName(char *pAddress, size_t addrLen, uint32 *pPort);
 
+        /// Enables or disables Nagle's algorithm on a TCP socket. Disabling it sends small messages immediately
+        /// instead of coalescing them.
+        Result SetNoDelay(bool noDelay);
+
+        /// Requests kernel send and receive buffer sizes for the socket. A size of zero keeps the system default.
+        /// Datagram sockets are created with buffers large enough for two full session windows.
+        Result SetBufferSizes(uint32 sendBufferSize, uint32 receiveBufferSize);
+
         Result LookupAddressInfo(const char* pAddress, uint32 port, size_t addressInfoSize, char* pAddressInfo, size_t *pAddressSize);
 
     private:
@@ -119,6 +154,7 @@ namespace DevDriver
 #if !defined(DD_WINDOWS)
         char         m_address[kMaxStringLength];
         size_t       m_addressSize;
+        bool         m_receiveCoalescing;
 #endif
         Result InitAsClient(OsSocketType socket, const char* pAddress, uint32 port, bool isNonBlocking);
     };
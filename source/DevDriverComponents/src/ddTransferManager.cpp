@@ -25,11 +25,1281 @@
 #include "ddTransferManager.h"
 #include "protocols/ddTransferServer.h"
 #include "messageChannel.h"
+#include "util/ddLz4.h"
+#include "util/ddMetroHash.h"
 
 namespace DevDriver
 {
     namespace TransferProtocol
     {
+        // Blocks smaller than this are always pulled over a single stream.
+        static const size_t kMinParallelPullSizeInBytes = (256 * kTransferChunkSizeInBytes);
+
+        // Pulls a block over several transfer sessions at once. The block is split into ranges that are handed out to
+        // the streams in turn, so stream s pulls ranges s, s + numStreams and so on. Each stream receives its current
+        // range on its own thread into a buffer of its own and only moves on to its next range once Read has consumed
+        // the current one. This keeps numStreams ranges in flight while memory use stays bounded by the range size.
+        class ParallelPull
+        {
+        public:
+            ParallelPull(const AllocCb& allocCb, IMsgChannel* pMsgChannel)
+                : m_allocCb(allocCb)
+                , m_pMsgChannel(pMsgChannel)
+                , m_clientId(kBroadcastClientId)
+                , m_blockId(kInvalidBlockId)
+                , m_blockSize(0)
+                , m_rangeSize(0)
+                , m_readOffset(0)
+                , m_numStreams(0)
+                , m_abort(false)
+                , m_dataEvent(false)
+            {
+            }
+
+            ~ParallelPull();
+
+            // Requests the first range of every stream and starts receiving them. pFirstClient must already be
+            // connected to the server and is used for the first stream.
+            Result Start(ClientId        clientId,
+                         BlockId         blockId,
+                         TransferClient* pFirstClient,
+                         size_t          blockSize,
+                         uint32          numStreams);
+
+            // Copies the next bytes of the block into pDstBuffer, waiting for them to arrive if necessary.
+            Result Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead);
+
+            // Restarts every stream that failed, continuing each one from the last byte it received.
+            Result Resume();
+
+            DD_STATIC_CONST uint32 kMaxStreams = 8;
+
+            // Ranges are at most this large, which bounds the memory of a pull to kMaxStreams ranges.
+            DD_STATIC_CONST size_t kMaxRangeSizeInBytes = (1024 * kTransferChunkSizeInBytes);
+
+        private:
+            // State for a single stream and the range it's currently pulling
+            struct Stream
+            {
+                Stream()
+                    : pOwner(nullptr)
+                    , pClient(nullptr)
+                    , ownsClient(false)
+                    , pData(nullptr)
+                    , offset(0)
+                    , size(0)
+                    , bytesReceived(0)
+                    , isRequested(false)
+                    , isDone(false)
+                    , result(Result::Success)
+                    , rangeConsumedEvent(false)
+                {
+                }
+
+                ParallelPull*    pOwner;
+                TransferClient*  pClient;            // Client used to pull the stream's ranges
+                bool             ownsClient;         // True if the client was created for this stream
+                uint8*           pData;              // Buffer that receives the current range
+                size_t           offset;             // Offset of the current range within the block, guarded by m_mutex
+                size_t           size;               // Size of the current range in bytes, guarded by m_mutex
+                size_t           bytesReceived;      // Bytes of the current range that have arrived, guarded by m_mutex
+                bool             isRequested;        // Set once the current range has been requested from the server
+                bool             isDone;             // Set once the stream has finished, guarded by m_mutex
+                Result           result;             // Final result of the stream, guarded by m_mutex
+                Platform::Event  rangeConsumedEvent; // Signaled when Read has consumed the current range
+                Platform::Thread thread;
+            };
+
+            // Receives every remaining range of a single stream. Runs on the stream's thread.
+            void ReceiveStream(Stream* pStream);
+
+            // Requests the stream's current range from the server.
+            Result RequestRange(Stream* pStream);
+
+            // Receives the rest of the stream's current range. Returns Aborted if the pull is being destroyed.
+            Result ReceiveRange(Stream* pStream);
+
+            // Waits until Read has consumed the stream's current range. Returns Aborted if the pull is being destroyed.
+            Result WaitForRangeConsumed(Stream* pStream);
+
+            static void StreamThreadFunc(void* pThreadParam);
+
+            // Streams publish their progress after each read of this size so Read can consume data early.
+            DD_STATIC_CONST size_t kStreamReadSizeInBytes = (16 * kTransferChunkSizeInBytes);
+
+            // How long Read and waiting streams sleep between checks for progress.
+            DD_STATIC_CONST uint32 kDataWaitTimeoutInMs = 100;
+
+            AllocCb         m_allocCb;
+            IMsgChannel*    m_pMsgChannel;
+            ClientId        m_clientId;   // Client that exposes the block
+            BlockId         m_blockId;
+            size_t          m_blockSize;
+            size_t          m_rangeSize;  // Size of every range except possibly the last one
+            size_t          m_readOffset; // Offset of the next byte returned by Read, guarded by m_mutex
+            uint32          m_numStreams;
+            bool            m_abort;      // Tells the streams to stop receiving, guarded by m_mutex
+            Platform::Mutex m_mutex;
+            Platform::Event m_dataEvent;  // Signaled whenever a stream makes progress
+            Stream          m_streams[kMaxStreams];
+        };
+
+        // ============================================================================================================
+        ParallelPull::~ParallelPull()
+        {
+            m_mutex.Lock();
+            m_abort = true;
+            m_mutex.Unlock();
+
+            for (uint32 streamIndex = 0; streamIndex < m_numStreams; ++streamIndex)
+            {
+                m_streams[streamIndex].rangeConsumedEvent.Signal();
+            }
+
+            for (uint32 streamIndex = 0; streamIndex < m_numStreams; ++streamIndex)
+            {
+                Stream& stream = m_streams[streamIndex];
+                if (stream.thread.IsJoinable())
+                {
+                    stream.thread.Join();
+                }
+
+                if (stream.pClient->IsTransferInProgress())
+                {
+                    // Attempt to abort the transfer if the stream was stopped before it finished.
+                    const Result result = stream.pClient->AbortPullTransfer();
+                    DD_UNUSED(result);
+                }
+
+                if (stream.ownsClient)
+                {
+                    stream.pClient->Disconnect();
+                    DD_DELETE(stream.pClient, m_allocCb);
+                }
+
+                if (stream.pData != nullptr)
+                {
+                    DD_FREE(stream.pData, m_allocCb);
+                }
+            }
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::Start(
+            ClientId        clientId,
+            BlockId         blockId,
+            TransferClient* pFirstClient,
+            size_t          blockSize,
+            uint32          numStreams)
+        {
+            DD_ASSERT(m_numStreams == 0);
+            DD_ASSERT(blockSize > 0);
+
+            const uint32 maxStreams = kMaxStreams;
+            numStreams = Platform::Min(numStreams, maxStreams);
+
+            // Split the block into ranges of whole chunks. Large blocks get more ranges than streams.
+            m_clientId = clientId;
+            m_blockId = blockId;
+            m_blockSize = blockSize;
+            m_rangeSize = Platform::Pow2Align(((blockSize + numStreams - 1) / numStreams), kTransferChunkSizeInBytes);
+            m_rangeSize = Platform::Min(m_rangeSize, kMaxRangeSizeInBytes);
+            numStreams = static_cast<uint32>(Platform::Min(static_cast<size_t>(numStreams),
+                                                           ((blockSize + m_rangeSize - 1) / m_rangeSize)));
+
+            Result result = Result::Success;
+
+            // Request the first range of every stream before starting any threads so a failure leaves nothing running.
+            for (uint32 streamIndex = 0; (streamIndex < numStreams) && (result == Result::Success); ++streamIndex)
+            {
+                Stream& stream = m_streams[streamIndex];
+                stream.pOwner = this;
+                stream.ownsClient = (streamIndex != 0);
+                stream.pClient = stream.ownsClient ? DD_NEW(TransferClient, m_allocCb)(m_pMsgChannel) : pFirstClient;
+                stream.offset = (streamIndex * m_rangeSize);
+                stream.size = Platform::Min(m_rangeSize, (blockSize - stream.offset));
+
+                if (stream.pClient == nullptr)
+                {
+                    result = Result::InsufficientMemory;
+                    break;
+                }
+
+                ++m_numStreams;
+
+                stream.pData = reinterpret_cast<uint8*>(DD_MALLOC(m_rangeSize, alignof(TransferChunk), m_allocCb));
+                if (stream.pData == nullptr)
+                {
+                    result = Result::InsufficientMemory;
+                }
+
+                if ((result == Result::Success) && stream.ownsClient)
+                {
+                    result = stream.pClient->Connect(clientId);
+                }
+
+                if (result == Result::Success)
+                {
+                    result = RequestRange(&stream);
+                }
+            }
+
+            for (uint32 streamIndex = 0; (streamIndex < m_numStreams) && (result == Result::Success); ++streamIndex)
+            {
+                result = m_streams[streamIndex].thread.Start(StreamThreadFunc, &m_streams[streamIndex]);
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead)
+        {
+            Result result = Result::Error;
+
+            if (pBytesRead != nullptr)
+            {
+                result = Result::Success;
+                size_t bytesRead = 0;
+
+                while ((bytesRead < bufferSize) && (m_readOffset < m_blockSize) && (result == Result::Success))
+                {
+                    const size_t rangeOffset = ((m_readOffset / m_rangeSize) * m_rangeSize);
+                    Stream& stream = m_streams[(m_readOffset / m_rangeSize) % m_numStreams];
+
+                    // The stream may still be waiting to move on to this range.
+                    m_mutex.Lock();
+                    const bool isCurrentRange = (stream.offset == rangeOffset);
+                    const size_t bytesAvailable =
+                        isCurrentRange ? ((stream.offset + stream.bytesReceived) - m_readOffset) : 0;
+                    const bool failed = (stream.isDone && (stream.result != Result::Success));
+                    if ((bytesAvailable == 0) && (failed == false))
+                    {
+                        // Clear the event while holding the lock so we can't miss progress made after the check.
+                        m_dataEvent.Clear();
+                    }
+                    m_mutex.Unlock();
+
+                    if (failed)
+                    {
+                        result = Result::Error;
+                    }
+                    else if (bytesAvailable > 0)
+                    {
+                        // The stream doesn't touch received data until the whole range has been consumed.
+                        const size_t bytesToCopy = Platform::Min(bytesAvailable, (bufferSize - bytesRead));
+                        memcpy(pDstBuffer + bytesRead, stream.pData + (m_readOffset - rangeOffset), bytesToCopy);
+                        bytesRead += bytesToCopy;
+
+                        m_mutex.Lock();
+                        m_readOffset += bytesToCopy;
+                        const bool isRangeConsumed = (m_readOffset == (stream.offset + stream.size));
+                        m_mutex.Unlock();
+
+                        if (isRangeConsumed)
+                        {
+                            stream.rangeConsumedEvent.Signal();
+                        }
+                    }
+                    else
+                    {
+                        // Streams time out on their own if the server stops responding, so just keep waiting.
+                        m_dataEvent.Wait(kDataWaitTimeoutInMs);
+                    }
+                }
+
+                *pBytesRead = bytesRead;
+
+                if ((result == Result::Success) && (m_readOffset == m_blockSize))
+                {
+                    result = Result::EndOfStream;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::Resume()
+        {
+            Result result = Result::Success;
+
+            for (uint32 streamIndex = 0; (streamIndex < m_numStreams) && (result == Result::Success); ++streamIndex)
+            {
+                Stream& stream = m_streams[streamIndex];
+
+                m_mutex.Lock();
+                const bool failed = (stream.isDone && (stream.result != Result::Success));
+                m_mutex.Unlock();
+
+                if (failed)
+                {
+                    stream.thread.Join();
+
+                    if (stream.isRequested)
+                    {
+                        result = stream.pClient->ResumePullTransfer(m_clientId);
+                    }
+                    else
+                    {
+                        // The stream failed while requesting its next range. Reconnect and let it request again.
+                        stream.pClient->Disconnect();
+                        result = stream.pClient->Connect(m_clientId);
+                    }
+
+                    if (result == Result::Success)
+                    {
+                        m_mutex.Lock();
+                        stream.isDone = false;
+                        stream.result = Result::Success;
+                        m_mutex.Unlock();
+
+                        result = stream.thread.Start(StreamThreadFunc, &stream);
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::RequestRange(Stream* pStream)
+        {
+            size_t transferSize = 0;
+            size_t remoteBlockSize = 0;
+            Result result = pStream->pClient->RequestRangedPullTransfer(m_blockId,
+                                                                        pStream->offset,
+                                                                        pStream->size,
+                                                                        &transferSize,
+                                                                        &remoteBlockSize);
+
+            if ((result == Result::Success) && ((transferSize != pStream->size) || (remoteBlockSize != m_blockSize)))
+            {
+                result = Result::Error;
+            }
+
+            pStream->isRequested = (result == Result::Success);
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::ReceiveRange(Stream* pStream)
+        {
+            Result result = Result::Success;
+            bool abort = false;
+
+            // Resumed streams continue from the data they already received.
+            m_mutex.Lock();
+            size_t bytesReceived = pStream->bytesReceived;
+            m_mutex.Unlock();
+
+            while ((result == Result::Success) && (bytesReceived < pStream->size) && (abort == false))
+            {
+                const size_t bytesRemaining = (pStream->size - bytesReceived);
+                const size_t bytesToRead = (bytesRemaining < kStreamReadSizeInBytes) ? bytesRemaining
+                                                                                      : kStreamReadSizeInBytes;
+                size_t bytesRead = 0;
+                result = pStream->pClient->ReadPullTransferData(pStream->pData + bytesReceived,
+                                                                bytesToRead,
+                                                                &bytesRead);
+                bytesReceived += bytesRead;
+
+                m_mutex.Lock();
+                pStream->bytesReceived = bytesReceived;
+                abort = m_abort;
+                m_mutex.Unlock();
+                m_dataEvent.Signal();
+            }
+
+            // The client verifies the range CRC when it consumes the sentinel. If that didn't happen during the last
+            // read, an empty read reports whether the range arrived intact.
+            if ((result == Result::Success) && (bytesReceived == pStream->size))
+            {
+                size_t bytesRead = 0;
+                result = pStream->pClient->ReadPullTransferData(nullptr, 0, &bytesRead);
+            }
+
+            return (result == Result::EndOfStream) ? Result::Success : (abort ? Result::Aborted : Result::Error);
+        }
+
+        // ============================================================================================================
+        Result ParallelPull::WaitForRangeConsumed(Stream* pStream)
+        {
+            Result result = Result::NotReady;
+
+            while (result == Result::NotReady)
+            {
+                m_mutex.Lock();
+                if (m_abort)
+                {
+                    result = Result::Aborted;
+                }
+                else if (m_readOffset >= (pStream->offset + pStream->size))
+                {
+                    result = Result::Success;
+                }
+                else
+                {
+                    // Clear the event while holding the lock so we can't miss Read finishing the range.
+                    pStream->rangeConsumedEvent.Clear();
+                }
+                m_mutex.Unlock();
+
+                if (result == Result::NotReady)
+                {
+                    pStream->rangeConsumedEvent.Wait(kDataWaitTimeoutInMs);
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        void ParallelPull::ReceiveStream(Stream* pStream)
+        {
+            Result result = Result::Success;
+            bool hasMoreRanges = true;
+
+            while ((result == Result::Success) && hasMoreRanges)
+            {
+                if (pStream->isRequested == false)
+                {
+                    result = RequestRange(pStream);
+                }
+
+                if (result == Result::Success)
+                {
+                    result = ReceiveRange(pStream);
+                }
+
+                if (result == Result::Success)
+                {
+                    const size_t nextOffset = (pStream->offset + (m_numStreams * m_rangeSize));
+                    hasMoreRanges = (nextOffset < m_blockSize);
+
+                    // The range buffer is reused for the next range, so Read has to be done with it first.
+                    if (hasMoreRanges)
+                    {
+                        result = WaitForRangeConsumed(pStream);
+                    }
+
+                    if ((result == Result::Success) && hasMoreRanges)
+                    {
+                        m_mutex.Lock();
+                        pStream->offset = nextOffset;
+                        pStream->size = Platform::Min(m_rangeSize, (m_blockSize - nextOffset));
+                        pStream->bytesReceived = 0;
+                        m_mutex.Unlock();
+
+                        pStream->isRequested = false;
+                    }
+                }
+            }
+
+            m_mutex.Lock();
+            pStream->result = result;
+            pStream->isDone = true;
+            m_mutex.Unlock();
+            m_dataEvent.Signal();
+        }
+
+        // ============================================================================================================
+        void ParallelPull::StreamThreadFunc(void* pThreadParam)
+        {
+            Stream* pStream = reinterpret_cast<Stream*>(pThreadParam);
+            pStream->pOwner->ReceiveStream(pStream);
+        }
+
+        // Decodes the frames of a compressed pull as they arrive so Read returns the original block data.
+        class CompressedPull
+        {
+        public:
+            CompressedPull(const AllocCb& allocCb, TransferClient* pClient, size_t blockSize)
+                : m_allocCb(allocCb)
+                , m_pClient(pClient)
+                , m_pFrameData(nullptr)
+                , m_pDecodedData(nullptr)
+                , m_blockSize(blockSize)
+                , m_bytesDecoded(0)
+                , m_decodedSize(0)
+                , m_decodedOffset(0)
+                , m_isTransferDone(false)
+            {
+            }
+
+            ~CompressedPull();
+
+            // Allocates the frame buffers.
+            Result Init();
+
+            // Copies the next bytes of the decoded block into pDstBuffer, receiving and decoding frames as necessary.
+            Result Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead);
+
+        private:
+            // Receives the next frame and decodes it into m_pDecodedData.
+            Result ReceiveFrame();
+
+            // Receives exactly numBytes bytes of the transfer into pDstBuffer.
+            Result ReceiveBytes(void* pDstBuffer, size_t numBytes);
+
+            AllocCb         m_allocCb;
+            TransferClient* m_pClient;
+            uint8*          m_pFrameData;     // Compressed data of the current frame
+            uint8*          m_pDecodedData;   // Decoded data of the current frame
+            size_t          m_blockSize;      // Size of the decoded block
+            size_t          m_bytesDecoded;   // Decoded bytes of all frames received so far
+            size_t          m_decodedSize;    // Decoded size of the current frame
+            size_t          m_decodedOffset;  // Offset of the next byte of the current frame returned by Read
+            bool            m_isTransferDone; // Set once the client has verified the end of the transfer
+        };
+
+        // ============================================================================================================
+        CompressedPull::~CompressedPull()
+        {
+            if (m_pDecodedData != nullptr)
+            {
+                DD_FREE(m_pDecodedData, m_allocCb);
+            }
+        }
+
+        // ============================================================================================================
+        Result CompressedPull::Init()
+        {
+            // Both buffers share one allocation.
+            const size_t frameCapacity = Lz4::CompressBound(kCompressedFrameSizeInBytes);
+            m_pDecodedData = reinterpret_cast<uint8*>(DD_MALLOC((kCompressedFrameSizeInBytes + frameCapacity),
+                                                                alignof(TransferChunk),
+                                                                m_allocCb));
+            m_pFrameData = (m_pDecodedData != nullptr) ? (m_pDecodedData + kCompressedFrameSizeInBytes) : nullptr;
+
+            return (m_pDecodedData != nullptr) ? Result::Success : Result::InsufficientMemory;
+        }
+
+        // ============================================================================================================
+        Result CompressedPull::Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead)
+        {
+            Result result = Result::Error;
+
+            if (pBytesRead != nullptr)
+            {
+                result = Result::Success;
+                size_t bytesRead = 0;
+
+                while ((bytesRead < bufferSize) && (result == Result::Success))
+                {
+                    if (m_decodedOffset < m_decodedSize)
+                    {
+                        const size_t bytesAvailable = (m_decodedSize - m_decodedOffset);
+                        const size_t bytesToCopy = Platform::Min(bytesAvailable, (bufferSize - bytesRead));
+                        memcpy(pDstBuffer + bytesRead, m_pDecodedData + m_decodedOffset, bytesToCopy);
+                        bytesRead += bytesToCopy;
+                        m_decodedOffset += bytesToCopy;
+                    }
+                    else if (m_bytesDecoded < m_blockSize)
+                    {
+                        result = ReceiveFrame();
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+
+                *pBytesRead = bytesRead;
+
+                if ((result == Result::Success) &&
+                    (m_bytesDecoded == m_blockSize) &&
+                    (m_decodedOffset == m_decodedSize))
+                {
+                    // The client verifies the CRC of the compressed data when it consumes the sentinel. If that
+                    // didn't happen while receiving the last frame, an empty read reports whether it arrived intact.
+                    if (m_isTransferDone == false)
+                    {
+                        size_t emptyBytesRead = 0;
+                        result = m_pClient->ReadPullTransferData(nullptr, 0, &emptyBytesRead);
+                        m_isTransferDone = (result == Result::EndOfStream);
+                    }
+
+                    result = m_isTransferDone ? Result::EndOfStream : Result::Error;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result CompressedPull::ReceiveFrame()
+        {
+            TransferCompressedFrameHeader frameHeader = {};
+            Result result = m_isTransferDone ? Result::Error : ReceiveBytes(&frameHeader, sizeof(frameHeader));
+
+            const size_t compressedSize = frameHeader.compressedSizeInBytes;
+            const size_t decompressedSize = frameHeader.decompressedSizeInBytes;
+
+            // Reject frames that don't fit the buffers or would decode past the end of the block.
+            if ((result == Result::Success) &&
+                ((decompressedSize == 0) ||
+                 (decompressedSize > kCompressedFrameSizeInBytes) ||
+                 (decompressedSize > (m_blockSize - m_bytesDecoded)) ||
+                 (compressedSize == 0) ||
+                 (compressedSize > Lz4::CompressBound(decompressedSize))))
+            {
+                result = Result::Error;
+            }
+
+            if (result == Result::Success)
+            {
+                if (compressedSize == decompressedSize)
+                {
+                    // Stored frame
+                    result = ReceiveBytes(m_pDecodedData, decompressedSize);
+                }
+                else
+                {
+                    result = ReceiveBytes(m_pFrameData, compressedSize);
+
+                    size_t decodedSize = 0;
+                    if (result == Result::Success)
+                    {
+                        result = Lz4::DecompressBlock(m_pFrameData,
+                                                      compressedSize,
+                                                      m_pDecodedData,
+                                                      decompressedSize,
+                                                      &decodedSize);
+                    }
+
+                    if ((result == Result::Success) && (decodedSize != decompressedSize))
+                    {
+                        result = Result::Error;
+                    }
+                }
+            }
+
+            if (result == Result::Success)
+            {
+                m_decodedSize = decompressedSize;
+                m_decodedOffset = 0;
+                m_bytesDecoded += decompressedSize;
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result CompressedPull::ReceiveBytes(void* pDstBuffer, size_t numBytes)
+        {
+            uint8* pDstData = reinterpret_cast<uint8*>(pDstBuffer);
+            Result result = Result::Success;
+            size_t bytesReceived = 0;
+
+            while ((bytesReceived < numBytes) && (result == Result::Success))
+            {
+                size_t bytesRead = 0;
+                result = m_pClient->ReadPullTransferData(pDstData + bytesReceived,
+                                                         (numBytes - bytesReceived),
+                                                         &bytesRead);
+                bytesReceived += bytesRead;
+
+                if (result == Result::EndOfStream)
+                {
+                    // The transfer ended and its CRC checked out, but it has to hold all the bytes we asked for.
+                    m_isTransferDone = true;
+                    result = (bytesReceived == numBytes) ? Result::Success : Result::Error;
+                    break;
+                }
+            }
+
+            return result;
+        }
+
+        // Sends the data of a push transfer from a queue on a background thread so writes don't wait for the network.
+        // The queue is a ring buffer. Write appends to it on the caller's thread and the send thread consumes it.
+        class PipelinedPush
+        {
+        public:
+            PipelinedPush(const AllocCb& allocCb, TransferClient* pClient)
+                : m_allocCb(allocCb)
+                , m_pClient(pClient)
+                , m_pQueue(nullptr)
+                , m_queueSize(0)
+                , m_readOffset(0)
+                , m_bytesQueued(0)
+                , m_finalizeRequested(false)
+                , m_discardRequested(false)
+                , m_abort(false)
+                , m_isDone(false)
+                , m_result(Result::Success)
+                , m_dataEvent(false)
+                , m_spaceEvent(false)
+                , m_doneEvent(false)
+            {
+            }
+
+            ~PipelinedPush();
+
+            // Allocates a queue of queueSizeInBytes bytes and starts the send thread.
+            Result Start(size_t queueSizeInBytes);
+
+            // Copies bufferSize bytes into the queue, waiting for space if it's full. Returns the error that stopped
+            // the send thread if it has failed.
+            Result Write(const uint8* pSrcBuffer, size_t bufferSize);
+
+            // Tells the send thread to close the transfer once the queue is empty, or right away when discarding.
+            Result BeginFinalize(bool discard);
+
+            // Waits for the send thread to finish the transfer and returns its result.
+            Result WaitForFinalize(uint32 timeoutInMs);
+
+            // Resumes the transfer after the send thread failed and restarts it with an empty queue.
+            Result Resume(ClientId clientId, size_t* pOffsetInBytes);
+
+        private:
+            // Sends queued data until the transfer is closed, fails or is aborted. Runs on the send thread.
+            void SendQueue();
+
+            // Marks the transfer as finished. Must be called with m_mutex held.
+            void Finish(Result result);
+
+            static void SendThreadFunc(void* pThreadParam);
+
+            // The send thread hands the transfer client at most this much data at a time so space is freed steadily.
+            DD_STATIC_CONST size_t kMaxSendSizeInBytes = (16 * kTransferChunkSizeInBytes);
+
+            // How long each side sleeps between checks of the queue.
+            DD_STATIC_CONST uint32 kQueueWaitTimeoutInMs = 100;
+
+            AllocCb          m_allocCb;
+            TransferClient*  m_pClient;
+            uint8*           m_pQueue;            // Ring buffer of data waiting to be sent
+            size_t           m_queueSize;
+            size_t           m_readOffset;        // Offset of the next byte to send, guarded by m_mutex
+            size_t           m_bytesQueued;       // Bytes waiting to be sent, guarded by m_mutex
+            bool             m_finalizeRequested; // Guarded by m_mutex
+            bool             m_discardRequested;  // Guarded by m_mutex
+            bool             m_abort;             // Tells the send thread to stop, guarded by m_mutex
+            bool             m_isDone;            // Set once the send thread has finished, guarded by m_mutex
+            Result           m_result;            // Result of the transfer, guarded by m_mutex
+            Platform::Mutex  m_mutex;
+            Platform::Event  m_dataEvent;         // Signaled when data is queued or a finalize is requested
+            Platform::Event  m_spaceEvent;        // Signaled when the send thread frees queue space
+            Platform::Event  m_doneEvent;         // Signaled when the send thread finishes
+            Platform::Thread m_thread;
+        };
+
+        // ============================================================================================================
+        PipelinedPush::~PipelinedPush()
+        {
+            m_mutex.Lock();
+            m_abort = true;
+            m_mutex.Unlock();
+            m_dataEvent.Signal();
+
+            if (m_thread.IsJoinable())
+            {
+                m_thread.Join();
+            }
+
+            if (m_pQueue != nullptr)
+            {
+                DD_FREE(m_pQueue, m_allocCb);
+            }
+        }
+
+        // ============================================================================================================
+        Result PipelinedPush::Start(size_t queueSizeInBytes)
+        {
+            DD_ASSERT(m_pQueue == nullptr);
+
+            m_queueSize = Platform::Pow2Align(queueSizeInBytes, kTransferChunkSizeInBytes);
+            m_pQueue = reinterpret_cast<uint8*>(DD_MALLOC(m_queueSize, alignof(TransferChunk), m_allocCb));
+
+            return (m_pQueue != nullptr) ? m_thread.Start(SendThreadFunc, this) : Result::InsufficientMemory;
+        }
+
+        // ============================================================================================================
+        Result PipelinedPush::Write(const uint8* pSrcBuffer, size_t bufferSize)
+        {
+            Result result = Result::Success;
+
+            while ((bufferSize > 0) && (result == Result::Success))
+            {
+                m_mutex.Lock();
+                const size_t space = (m_queueSize - m_bytesQueued);
+                const size_t writeOffset = ((m_readOffset + m_bytesQueued) % m_queueSize);
+                if (m_isDone || m_finalizeRequested)
+                {
+                    result = (m_result != Result::Success) ? m_result : Result::Error;
+                }
+                else if (space == 0)
+                {
+                    // Clear the event while holding the lock so we can't miss space freed after the check.
+                    m_spaceEvent.Clear();
+                }
+                m_mutex.Unlock();
+
+                if ((result == Result::Success) && (space > 0))
+                {
+                    // The free space isn't touched by the send thread, so it can be filled without the lock.
+                    const size_t contiguousSpace = (m_queueSize - writeOffset);
+                    const size_t bytesToCopy = Platform::Min(Platform::Min(space, contiguousSpace), bufferSize);
+                    memcpy(m_pQueue + writeOffset, pSrcBuffer, bytesToCopy);
+                    pSrcBuffer += bytesToCopy;
+                    bufferSize -= bytesToCopy;
+
+                    m_mutex.Lock();
+                    m_bytesQueued += bytesToCopy;
+                    m_mutex.Unlock();
+                    m_dataEvent.Signal();
+                }
+                else if (result == Result::Success)
+                {
+                    m_spaceEvent.Wait(kQueueWaitTimeoutInMs);
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PipelinedPush::BeginFinalize(bool discard)
+        {
+            Result result = Result::Success;
+
+            m_mutex.Lock();
+            if (m_isDone || m_finalizeRequested)
+            {
+                result = Result::Error;
+            }
+            else
+            {
+                m_finalizeRequested = true;
+                m_discardRequested = discard;
+            }
+            m_mutex.Unlock();
+            m_dataEvent.Signal();
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PipelinedPush::WaitForFinalize(uint32 timeoutInMs)
+        {
+            Result result = Result::Error;
+
+            m_mutex.Lock();
+            const bool isFinalizing = m_finalizeRequested;
+            m_mutex.Unlock();
+
+            if (isFinalizing)
+            {
+                result = m_doneEvent.Wait(timeoutInMs);
+                if (result == Result::Success)
+                {
+                    // The thread is already joined if the transfer was waited on before.
+                    if (m_thread.IsJoinable())
+                    {
+                        m_thread.Join();
+                    }
+
+                    m_mutex.Lock();
+                    result = m_result;
+                    m_mutex.Unlock();
+                }
+                else
+                {
+                    result = Result::NotReady;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PipelinedPush::Resume(ClientId clientId, size_t* pOffsetInBytes)
+        {
+            Result result = Result::Error;
+
+            m_mutex.Lock();
+            const bool failed = (m_isDone && (m_result != Result::Success) && (m_result != Result::Aborted));
+            m_mutex.Unlock();
+
+            // Only a transfer that failed on its own can be resumed. The send thread has already exited in that case.
+            if (failed)
+            {
+                // WaitForFinalize may have joined the thread already.
+                if (m_thread.IsJoinable())
+                {
+                    m_thread.Join();
+                }
+
+                result = m_pClient->ResumePushTransfer(clientId, pOffsetInBytes);
+                if (result == Result::Success)
+                {
+                    m_mutex.Lock();
+                    m_readOffset = 0;
+                    m_bytesQueued = 0;
+                    m_finalizeRequested = false;
+                    m_discardRequested = false;
+                    m_isDone = false;
+                    m_result = Result::Success;
+                    m_mutex.Unlock();
+                    m_doneEvent.Clear();
+
+                    result = m_thread.Start(SendThreadFunc, this);
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        void PipelinedPush::SendQueue()
+        {
+            bool isDone = false;
+
+            while (isDone == false)
+            {
+                m_mutex.Lock();
+                const size_t readOffset = m_readOffset;
+                const size_t contiguousBytes = (m_queueSize - readOffset);
+                size_t bytesToSend = (m_bytesQueued < contiguousBytes) ? m_bytesQueued : contiguousBytes;
+                bytesToSend = (bytesToSend < kMaxSendSizeInBytes) ? bytesToSend : kMaxSendSizeInBytes;
+                const bool abort = m_abort;
+                const bool discard = m_discardRequested;
+                const bool finalize = (m_finalizeRequested && (m_bytesQueued == 0));
+                if ((abort == false) && (discard == false) && (finalize == false) && (bytesToSend == 0))
+                {
+                    // Clear the event while holding the lock so we can't miss data queued after the check.
+                    m_dataEvent.Clear();
+                }
+                m_mutex.Unlock();
+
+                if (abort)
+                {
+                    // The owner closes the transfer itself.
+                    m_mutex.Lock();
+                    Finish(Result::Aborted);
+                    m_mutex.Unlock();
+                    isDone = true;
+                }
+                else if (discard || finalize)
+                {
+                    // Queued data is dropped when discarding.
+                    const Result result = m_pClient->ClosePushTransfer(discard);
+
+                    m_mutex.Lock();
+                    m_bytesQueued = 0;
+                    Finish(result);
+                    m_mutex.Unlock();
+                    isDone = true;
+                }
+                else if (bytesToSend > 0)
+                {
+                    // Writers only add data behind the queued bytes, so this range is stable without the lock.
+                    const Result result = m_pClient->WritePushTransferData(m_pQueue + readOffset, bytesToSend);
+
+                    m_mutex.Lock();
+                    if (result == Result::Success)
+                    {
+                        m_readOffset = ((readOffset + bytesToSend) % m_queueSize);
+                        m_bytesQueued -= bytesToSend;
+                    }
+                    else
+                    {
+                        Finish(result);
+                        isDone = true;
+                    }
+                    m_mutex.Unlock();
+                    m_spaceEvent.Signal();
+                }
+                else
+                {
+                    m_dataEvent.Wait(kQueueWaitTimeoutInMs);
+                }
+            }
+        }
+
+        // ============================================================================================================
+        void PipelinedPush::Finish(Result result)
+        {
+            m_result = result;
+            m_isDone = true;
+            m_doneEvent.Signal();
+            m_spaceEvent.Signal();
+        }
+
+        // ============================================================================================================
+        void PipelinedPush::SendThreadFunc(void* pThreadParam)
+        {
+            reinterpret_cast<PipelinedPush*>(pThreadParam)->SendQueue();
+        }
+
+        // Pulled block data kept by the pull content cache, identified by the hash of its content
+        class PullContent
+        {
+        public:
+            PullContent(const AllocCb& allocCb, const TransferContentHash& hash, size_t size)
+                : m_allocCb(allocCb)
+                , m_hash(hash)
+                , m_pData(nullptr)
+                , m_size(size)
+            {
+            }
+
+            ~PullContent()
+            {
+                if (m_pData != nullptr)
+                {
+                    DD_FREE(m_pData, m_allocCb);
+                }
+            }
+
+            // Allocates storage for the data.
+            Result Init()
+            {
+                m_pData = (m_size > 0) ? reinterpret_cast<uint8*>(DD_MALLOC(m_size, DD_DEFAULT_ALIGNMENT, m_allocCb))
+                                       : nullptr;
+                return ((m_size == 0) || (m_pData != nullptr)) ? Result::Success : Result::InsufficientMemory;
+            }
+
+            // Returns true if the data matches the hash and size reported for a block.
+            bool Matches(const TransferContentHash& hash, size_t size) const
+            {
+                return (m_size == size) && (memcmp(&m_hash, &hash, sizeof(hash)) == 0);
+            }
+
+            // Returns true if the hash of the data that has been written matches the hash it was created with.
+            bool IsValid() const
+            {
+                MetroHash::Hash hash = {};
+                Util::MetroHash128::Hash(m_pData, m_size, hash.bytes);
+                return (memcmp(hash.dwords, m_hash.dwords, sizeof(m_hash.dwords)) == 0);
+            }
+
+            uint8* GetData() const { return m_pData; }
+            size_t GetSize() const { return m_size; }
+
+        private:
+            AllocCb             m_allocCb;
+            TransferContentHash m_hash;
+            uint8*              m_pData;
+            size_t              m_size;
+        };
+
+        // Keeps the data of recently pulled blocks so pulling the same data again can skip the transfer.
+        // Entries are evicted least recently used first to stay within a byte budget.
+        class PullContentCache
+        {
+        public:
+            PullContentCache()
+                : m_mutex()
+                , m_entries()
+                , m_numEntries(0)
+                , m_sizeInBytes(0)
+                , m_budgetInBytes(kDefaultBudgetInBytes)
+                , m_useCount(0)
+            {
+            }
+
+            // Returns the cached data matching the hash and size reported for a block, or an empty pointer.
+            SharedPointer<PullContent> Find(const TransferContentHash& hash, size_t size);
+
+            // Returns true if data of the specified size can be cached.
+            bool CanHold(size_t size);
+
+            // Adds data to the cache, evicting the least recently used entries to make room.
+            void Insert(const SharedPointer<PullContent>& pContent);
+
+            // Sets the byte budget of the cache, evicting entries to fit in it.
+            void SetBudget(size_t budgetInBytes);
+
+        private:
+            // Evicts entries until they use at most budgetInBytes bytes and there's room for numFreeSlots more.
+            // Must be called with m_mutex held.
+            void Trim(size_t budgetInBytes, size_t numFreeSlots);
+
+            struct Entry
+            {
+                SharedPointer<PullContent> pContent;
+                uint64                     lastUse;  // Value of m_useCount when the entry was last used
+            };
+
+            DD_STATIC_CONST size_t kMaxEntries = 32;
+            DD_STATIC_CONST size_t kDefaultBudgetInBytes = (16 * 1024 * 1024);
+
+            Platform::Mutex m_mutex;
+            Entry           m_entries[kMaxEntries];
+            size_t          m_numEntries;
+            size_t          m_sizeInBytes;   // Combined size of the cached data
+            size_t          m_budgetInBytes;
+            uint64          m_useCount;
+        };
+
+        // ============================================================================================================
+        SharedPointer<PullContent> PullContentCache::Find(const TransferContentHash& hash, size_t size)
+        {
+            SharedPointer<PullContent> pContent;
+
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            for (size_t entryIndex = 0; entryIndex < m_numEntries; ++entryIndex)
+            {
+                if (m_entries[entryIndex].pContent->Matches(hash, size))
+                {
+                    pContent = m_entries[entryIndex].pContent;
+                    m_entries[entryIndex].lastUse = ++m_useCount;
+                    break;
+                }
+            }
+
+            return pContent;
+        }
+
+        // ============================================================================================================
+        bool PullContentCache::CanHold(size_t size)
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            return (size <= m_budgetInBytes);
+        }
+
+        // ============================================================================================================
+        void PullContentCache::Insert(const SharedPointer<PullContent>& pContent)
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+            const size_t size = pContent->GetSize();
+            if (size <= m_budgetInBytes)
+            {
+                Trim((m_budgetInBytes - size), 1);
+
+                Entry& entry = m_entries[m_numEntries];
+                entry.pContent = pContent;
+                entry.lastUse = ++m_useCount;
+                ++m_numEntries;
+                m_sizeInBytes += size;
+            }
+        }
+
+        // ============================================================================================================
+        void PullContentCache::SetBudget(size_t budgetInBytes)
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            m_budgetInBytes = budgetInBytes;
+            Trim(budgetInBytes, 0);
+        }
+
+        // ============================================================================================================
+        void PullContentCache::Trim(size_t budgetInBytes, size_t numFreeSlots)
+        {
+            while ((m_numEntries > 0) && ((m_sizeInBytes > budgetInBytes) || ((m_numEntries + numFreeSlots) > kMaxEntries)))
+            {
+                size_t oldestIndex = 0;
+                for (size_t entryIndex = 1; entryIndex < m_numEntries; ++entryIndex)
+                {
+                    if (m_entries[entryIndex].lastUse < m_entries[oldestIndex].lastUse)
+                    {
+                        oldestIndex = entryIndex;
+                    }
+                }
+
+                m_sizeInBytes -= m_entries[oldestIndex].pContent->GetSize();
+                --m_numEntries;
+                m_entries[oldestIndex].pContent = m_entries[m_numEntries].pContent;
+                m_entries[oldestIndex].lastUse = m_entries[m_numEntries].lastUse;
+                m_entries[m_numEntries].pContent.Clear();
+            }
+        }
+
+        // Reads a hashed pull. Data found in the pull content cache is returned from there. Otherwise it's read
+        // from the transfer client and added to the cache once the transfer has been verified.
+        class CachedPull
+        {
+        public:
+            CachedPull(PullContentCache*                 pCache,
+                       TransferClient*                   pClient,
+                       const SharedPointer<PullContent>& pContent,
+                       bool                              isCached)
+                : m_pCache(pCache)
+                , m_pClient(pClient)
+                , m_pContent(pContent)
+                , m_readOffset(0)
+                , m_isCached(isCached)
+                , m_isDone(false)
+            {
+            }
+
+            // Copies the next bytes of the block into pDstBuffer.
+            Result Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead);
+
+        private:
+            PullContentCache*          m_pCache;
+            TransferClient*            m_pClient;
+            SharedPointer<PullContent> m_pContent;   // Cached data, or storage for the data being pulled. May be
+                                                     // empty if the data isn't going to be cached.
+            size_t                     m_readOffset; // Offset of the next byte returned by Read
+            bool                       m_isCached;   // Set if m_pContent already holds the block data or the block
+                                                     // is empty
+            bool                       m_isDone;     // Set once Read has reported the end of the block
+        };
+
+        // ============================================================================================================
+        Result CachedPull::Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead)
+        {
+            Result result = Result::Error;
+
+            if ((pBytesRead != nullptr) && (m_isDone == false))
+            {
+                if (m_isCached)
+                {
+                    const size_t contentSize = m_pContent.IsNull() ? 0 : m_pContent->GetSize();
+                    const size_t bytesAvailable = (contentSize - m_readOffset);
+                    const size_t bytesToCopy = Platform::Min(bytesAvailable, bufferSize);
+                    if (bytesToCopy > 0)
+                    {
+                        memcpy(pDstBuffer, m_pContent->GetData() + m_readOffset, bytesToCopy);
+                    }
+                    m_readOffset += bytesToCopy;
+                    *pBytesRead = bytesToCopy;
+
+                    m_isDone = (m_readOffset == contentSize);
+                    result = m_isDone ? Result::EndOfStream : Result::Success;
+                }
+                else
+                {
+                    result = m_pClient->ReadPullTransferData(pDstBuffer, bufferSize, pBytesRead);
+
+                    if ((result == Result::Success) || (result == Result::EndOfStream))
+                    {
+                        // Keep a copy of everything read so the block can be cached once it has been verified.
+                        if (m_pContent.IsNull() == false)
+                        {
+                            const size_t bytesToCopy = Platform::Min(*pBytesRead, (m_pContent->GetSize() - m_readOffset));
+                            if (bytesToCopy > 0)
+                            {
+                                memcpy(m_pContent->GetData() + m_readOffset, pDstBuffer, bytesToCopy);
+                            }
+                        }
+                        m_readOffset += *pBytesRead;
+                    }
+
+                    if (result == Result::EndOfStream)
+                    {
+                        // The transfer CRC has been checked. Checking the hash as well makes sure the data is
+                        // cached under the right key.
+                        if ((m_pContent.IsNull() == false) &&
+                            (m_readOffset == m_pContent->GetSize()) &&
+                            m_pContent->IsValid())
+                        {
+                            m_pCache->Insert(m_pContent);
+                        }
+                        m_isDone = true;
+                    }
+                }
+            }
+
+            return result;
+        }
+
         // ============================================================================================================
         TransferManager::TransferManager(const AllocCb& allocCb)
             : m_pMessageChannel(nullptr)
@@ -38,14 +1308,34 @@ namespace DevDriver
             , m_allocCb(allocCb)
             , m_rng()
             , m_mutex()
-            , m_registeredServerBlocks(allocCb)
-            , m_idleBlocks(allocCb)
+            , m_pRegistryShards(nullptr)
+            , m_pPullContentCache(nullptr)
+            , m_idleBlocks()
+            , m_numIdleBlocks(0)
+            , m_idleBlockSizeInBytes(0)
+            , m_idleBlockBudgetInBytes(kDefaultIdleBlockBudgetInBytes)
+            , m_retainedServerBlocks(allocCb)
+            , m_serverBlockRetentionTimeInMs(kDefaultServerBlockRetentionTimeInMs)
         {}
 
         // ============================================================================================================
         TransferManager::~TransferManager()
         {
             Destroy();
+
+            if (m_pRegistryShards != nullptr)
+            {
+                for (size_t shardIndex = 0; shardIndex < kNumRegistryShards; ++shardIndex)
+                {
+                    Platform::Destructor(&m_pRegistryShards[shardIndex]);
+                }
+                DD_FREE(m_pRegistryShards, m_allocCb);
+            }
+
+            if (m_pPullContentCache != nullptr)
+            {
+                DD_DELETE(m_pPullContentCache, m_allocCb);
+            }
         }
 
         // ============================================================================================================
@@ -57,10 +1347,32 @@ namespace DevDriver
             m_pMessageChannel = pMsgChannel;
             m_pSessionManager = pSessionManager;
 
-            m_pTransferServer = DD_NEW(TransferServer, m_allocCb)(m_pMessageChannel, this);
-            if (m_pTransferServer != nullptr)
+            if (m_pRegistryShards == nullptr)
+            {
+                m_pRegistryShards = reinterpret_cast<RegistryShard*>(DD_MALLOC((sizeof(RegistryShard) * kNumRegistryShards),
+                                                                               alignof(RegistryShard),
+                                                                               m_allocCb));
+                if (m_pRegistryShards != nullptr)
+                {
+                    for (size_t shardIndex = 0; shardIndex < kNumRegistryShards; ++shardIndex)
+                    {
+                        new(&m_pRegistryShards[shardIndex]) RegistryShard(m_allocCb);
+                    }
+                }
+            }
+
+            if (m_pPullContentCache == nullptr)
+            {
+                m_pPullContentCache = DD_NEW(PullContentCache, m_allocCb)();
+            }
+
+            if ((m_pRegistryShards != nullptr) && (m_pPullContentCache != nullptr))
             {
-                m_pSessionManager->RegisterProtocolServer(m_pTransferServer);
+                m_pTransferServer = DD_NEW(TransferServer, m_allocCb)(m_pMessageChannel, this);
+                if (m_pTransferServer != nullptr)
+                {
+                    m_pSessionManager->RegisterProtocolServer(m_pTransferServer);
+                }
             }
 
             return (m_pTransferServer != nullptr) ? Result::Success : Result::Error;
@@ -78,64 +1390,482 @@ namespace DevDriver
         }
 
         // ============================================================================================================
-        SharedPointer<ServerBlock> TransferManager::OpenServerBlock()
+        SharedPointer<ServerBlock> TransferManager::OpenServerBlock(ServerBlockStorage storage, size_t sizeHintInBytes)
+        {
+            SharedPointer<ServerBlock> pBlock;
+
+            if (m_pRegistryShards != nullptr)
+            {
+                Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+                ReleaseExpiredServerBlocks();
+
+                // Reuse the smallest idle block that can hold the hinted size without growing.
+                uint32 minSizeClass = 0;
+                while ((minSizeClass < 63) && ((static_cast<uint64>(1) << minSizeClass) < sizeHintInBytes))
+                {
+                    ++minSizeClass;
+                }
+
+                size_t bestIndex = m_numIdleBlocks;
+                for (size_t blockIndex = 0; blockIndex < m_numIdleBlocks; ++blockIndex)
+                {
+                    const IdleServerBlock& idleBlock = m_idleBlocks[blockIndex];
+                    if ((idleBlock.pBlock->GetStorage() == storage) &&
+                        (idleBlock.sizeClass >= minSizeClass) &&
+                        ((bestIndex == m_numIdleBlocks) || (idleBlock.sizeClass < m_idleBlocks[bestIndex].sizeClass)))
+                    {
+                        bestIndex = blockIndex;
+                    }
+                }
+
+                if (bestIndex < m_numIdleBlocks)
+                {
+                    pBlock = m_idleBlocks[bestIndex].pBlock;
+                    m_idleBlockSizeInBytes -= pBlock->m_capacity;
+                    --m_numIdleBlocks;
+                    m_idleBlocks[bestIndex].Replace(m_idleBlocks[m_numIdleBlocks]);
+                }
+                else
+                {
+                    pBlock = SharedPointer<ServerBlock>::Create(m_allocCb, m_allocCb, kInvalidBlockId, storage);
+                    if ((pBlock.IsNull() == false) && (sizeHintInBytes > 0))
+                    {
+                        pBlock->Reserve(sizeHintInBytes);
+                    }
+                }
+
+                // Register the block under a new random id. Creating the registry entry fails if the id is taken.
+                Result result = pBlock.IsNull() ? Result::InsufficientMemory : Result::Error;
+                while (result == Result::Error)
+                {
+                    const BlockId newBlockId = m_rng.Generate();
+                    if (newBlockId != kInvalidBlockId)
+                    {
+                        RegistryShard& shard = GetRegistryShard(newBlockId);
+                        Platform::LockGuard<Platform::Mutex> shardLock(shard.mutex);
+                        result = shard.blocks.Create(newBlockId, pBlock);
+                        if (result == Result::Success)
+                        {
+                            pBlock->m_blockId = newBlockId;
+                        }
+                    }
+                }
+
+                if (result != Result::Success)
+                {
+                    pBlock.Clear();
+                }
+            }
+
+            return pBlock;
+        }
+
+        // ============================================================================================================
+        SharedPointer<ServerBlock> TransferManager::GetServerBlock(BlockId serverBlockId)
+        {
+            SharedPointer<ServerBlock> pBlock = SharedPointer<ServerBlock>();
+            if (m_pRegistryShards != nullptr)
+            {
+                bool isExpired = false;
+                {
+                    RegistryShard& shard = GetRegistryShard(serverBlockId);
+                    Platform::LockGuard<Platform::Mutex> lock(shard.mutex);
+
+                    const RegisteredServerBlock* pRegisteredBlock = shard.blocks.FindValue(serverBlockId);
+                    if (pRegisteredBlock != nullptr)
+                    {
+                        isExpired = ((pRegisteredBlock->expirationTimeInMs != 0) &&
+                                     (pRegisteredBlock->expirationTimeInMs <= Platform::GetCurrentTimeInMs()));
+                        if (isExpired == false)
+                        {
+                            pBlock = pRegisteredBlock->pBlock;
+                        }
+                    }
+                }
+
+                // Release the expired block right away instead of waiting for the next update. The manager lock is
+                // taken after the shard lock has been dropped since CloseServerBlock takes them in that order.
+                if (isExpired)
+                {
+                    Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+                    ReleaseExpiredServerBlocks();
+                }
+            }
+            return pBlock;
+        }
+
+        // ============================================================================================================
+        void TransferManager::CloseServerBlock(SharedPointer<ServerBlock>& pBlock)
+        {
+            if (!pBlock.IsNull())
+            {
+                Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+
+                ReleaseExpiredServerBlocks();
+
+                // Keep the block registered for a while if retention is enabled so remote clients can resume
+                // interrupted transfers. The block is released immediately if retention is disabled or can't be tracked.
+                const BlockId blockId = pBlock->GetBlockId();
+                bool retained = false;
+                if (m_serverBlockRetentionTimeInMs > 0)
+                {
+                    RetainedServerBlock retainedBlock = {};
+                    retainedBlock.blockId = blockId;
+                    retainedBlock.expirationTimeInMs = (Platform::GetCurrentTimeInMs() + m_serverBlockRetentionTimeInMs);
+                    retained = m_retainedServerBlocks.PushBack(retainedBlock);
+
+                    if (retained)
+                    {
+                        RegistryShard& shard = GetRegistryShard(blockId);
+                        Platform::LockGuard<Platform::Mutex> shardLock(shard.mutex);
+                        RegisteredServerBlock* pRegisteredBlock = shard.blocks.FindValue(blockId);
+                        if (pRegisteredBlock != nullptr)
+                        {
+                            pRegisteredBlock->expirationTimeInMs = retainedBlock.expirationTimeInMs;
+                        }
+                    }
+                }
+
+                // Clear the external shared pointer to the block.
+                pBlock.Clear();
+
+                if (retained == false)
+                {
+                    SharedPointer<ServerBlock> pReleasedBlock = UnregisterServerBlock(blockId);
+                    RecycleServerBlock(pReleasedBlock);
+                }
+            }
+        }
+
+        // ============================================================================================================
+        void TransferManager::Update()
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            ReleaseExpiredServerBlocks();
+        }
+
+        // ============================================================================================================
+        void TransferManager::SetServerBlockRetentionTime(uint32 retentionTimeInMs)
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            m_serverBlockRetentionTimeInMs = retentionTimeInMs;
+        }
+
+        // ============================================================================================================
+        void TransferManager::SetIdleServerBlockBudget(size_t budgetInBytes)
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+            m_idleBlockBudgetInBytes = budgetInBytes;
+            TrimIdleServerBlocks(budgetInBytes, 0);
+        }
+
+        // ============================================================================================================
+        SharedPointer<ServerBlock> TransferManager::UnregisterServerBlock(BlockId blockId)
+        {
+            SharedPointer<ServerBlock> pBlock;
+
+            RegistryShard& shard = GetRegistryShard(blockId);
+            Platform::LockGuard<Platform::Mutex> lock(shard.mutex);
+            const RegisteredServerBlock* pRegisteredBlock = shard.blocks.FindValue(blockId);
+            if (pRegisteredBlock != nullptr)
+            {
+                pBlock = pRegisteredBlock->pBlock;
+                shard.blocks.Erase(blockId);
+            }
+
+            return pBlock;
+        }
+
+        // ============================================================================================================
+        void TransferManager::ReleaseExpiredServerBlocks()
+        {
+            // Blocks are retained in the order they're closed, so the ones that expire first are at the front.
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+            const RetainedServerBlock* pRetainedBlock = m_retainedServerBlocks.PeekFront();
+            while ((pRetainedBlock != nullptr) && (pRetainedBlock->expirationTimeInMs <= currentTimeInMs))
+            {
+                SharedPointer<ServerBlock> pBlock = UnregisterServerBlock(pRetainedBlock->blockId);
+                RecycleServerBlock(pBlock);
+                m_retainedServerBlocks.PopFront();
+                pRetainedBlock = m_retainedServerBlocks.PeekFront();
+            }
+        }
+
+        // ============================================================================================================
+        void TransferManager::RecycleServerBlock(SharedPointer<ServerBlock>& pBlock)
+        {
+            // A block that's still referenced elsewhere, e.g. by a transfer that's still running, is freed by its
+            // last reference instead. Nothing else can pick up a reference since the block is no longer registered.
+            if ((pBlock.IsNull() == false) && (pBlock.GetRefCount() == 1))
+            {
+                const size_t capacity = pBlock->m_capacity;
+                if ((capacity > 0) && (capacity <= m_idleBlockBudgetInBytes))
+                {
+                    TrimIdleServerBlocks((m_idleBlockBudgetInBytes - capacity), 1);
+
+                    uint32 sizeClass = 0;
+                    while ((static_cast<uint64>(2) << sizeClass) <= capacity)
+                    {
+                        ++sizeClass;
+                    }
+
+                    pBlock->Reset();
+                    pBlock->m_blockId = kInvalidBlockId;
+
+                    IdleServerBlock& idleBlock = m_idleBlocks[m_numIdleBlocks];
+                    idleBlock.pBlock = pBlock;
+                    idleBlock.sizeClass = sizeClass;
+                    ++m_numIdleBlocks;
+                    m_idleBlockSizeInBytes += capacity;
+                }
+            }
+
+            pBlock.Clear();
+        }
+
+        // ============================================================================================================
+        void TransferManager::TrimIdleServerBlocks(size_t budgetInBytes, size_t numFreeSlots)
+        {
+            while ((m_numIdleBlocks > 0) &&
+                   ((m_idleBlockSizeInBytes > budgetInBytes) || ((m_numIdleBlocks + numFreeSlots) > kMaxCachedIdleBlocks)))
+            {
+                size_t largestIndex = 0;
+                for (size_t blockIndex = 1; blockIndex < m_numIdleBlocks; ++blockIndex)
+                {
+                    if (m_idleBlocks[blockIndex].pBlock->m_capacity > m_idleBlocks[largestIndex].pBlock->m_capacity)
+                    {
+                        largestIndex = blockIndex;
+                    }
+                }
+
+                m_idleBlockSizeInBytes -= m_idleBlocks[largestIndex].pBlock->m_capacity;
+                --m_numIdleBlocks;
+                m_idleBlocks[largestIndex].Replace(m_idleBlocks[m_numIdleBlocks]);
+            }
+        }
+
+        // ============================================================================================================
+        PullBlock* TransferManager::OpenPullBlock(ClientId clientId, BlockId blockId)
+        {
+            PullBlock* pBlock = DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, clientId, blockId);
+            if (pBlock != nullptr)
+            {
+                // Connect to the remote client and request a transfer.
+                Result result = pBlock->m_transferClient.Connect(clientId);
+                if (result == Result::Success)
+                {
+                    result = pBlock->m_transferClient.RequestPullTransfer(blockId, &pBlock->m_blockDataSize);
+                }
+
+                // If we fail the transfer or connection, destroy the block.
+                if (result != Result::Success)
+                {
+                    pBlock->m_transferClient.Disconnect();
+                    DD_DELETE(pBlock, m_allocCb);
+                    pBlock = nullptr;
+                }
+            }
+            return pBlock;
+        }
+
+        // ============================================================================================================
+        PullBlock* TransferManager::OpenPullBlock(ClientId clientId, BlockId blockId, uint32 numStreams)
         {
-            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
-
-            BlockId newBlockId = kInvalidBlockId;
-            do
+            if (numStreams <= 1)
             {
-                newBlockId = m_rng.Generate();
-            } while ((newBlockId == kInvalidBlockId) && m_registeredServerBlocks.Contains(newBlockId));
+                return OpenPullBlock(clientId, blockId);
+            }
 
-            // Attempt to allocate a new server block
-            SharedPointer<ServerBlock> pBlock = SharedPointer<ServerBlock>::Create(m_allocCb,
-                                                                                   m_allocCb,
-                                                                                   newBlockId);
-            if (!pBlock.IsNull())
+            PullBlock* pBlock = DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, clientId, blockId);
+            if (pBlock != nullptr)
             {
-                m_registeredServerBlocks.Create(newBlockId, pBlock);
-            }
+                Result result = pBlock->m_transferClient.Connect(clientId);
+
+                // Query the block size with an empty range to decide whether splitting the transfer is worthwhile.
+                size_t blockSize = 0;
+                if ((result == Result::Success) && pBlock->m_transferClient.SupportsRangedPull())
+                {
+                    size_t transferSize = 0;
+                    result = pBlock->m_transferClient.RequestRangedPullTransfer(blockId, 0, 0, &transferSize, &blockSize);
+                }
+
+                bool isParallel = false;
+                if ((result == Result::Success) && (blockSize >= kMinParallelPullSizeInBytes))
+                {
+                    pBlock->m_pParallelPull = DD_NEW(ParallelPull, m_allocCb)(m_allocCb, m_pMessageChannel);
+                    if (pBlock->m_pParallelPull != nullptr)
+                    {
+                        isParallel = (pBlock->m_pParallelPull->Start(clientId,
+                                                                     blockId,
+                                                                     &pBlock->m_transferClient,
+                                                                     blockSize,
+                                                                     numStreams) == Result::Success);
+                        if (isParallel)
+                        {
+                            pBlock->m_blockDataSize = blockSize;
+                        }
+                        else
+                        {
+                            // Fall back to a single stream if the extra sessions couldn't be set up.
+                            DD_DELETE(pBlock->m_pParallelPull, m_allocCb);
+                            pBlock->m_pParallelPull = nullptr;
+                        }
+                    }
+                }
+
+                if ((result == Result::Success) && (isParallel == false))
+                {
+                    result = pBlock->m_transferClient.RequestPullTransfer(blockId, &pBlock->m_blockDataSize);
+                }
 
+                // If we fail the transfer or connection, destroy the block.
+                if (result != Result::Success)
+                {
+                    pBlock->m_transferClient.Disconnect();
+                    DD_DELETE(pBlock, m_allocCb);
+                    pBlock = nullptr;
+                }
+            }
             return pBlock;
         }
 
         // ============================================================================================================
-        SharedPointer<ServerBlock> TransferManager::GetServerBlock(BlockId serverBlockId)
+        PullBlock* TransferManager::OpenPullBlockAtOffset(ClientId clientId, BlockId blockId, size_t offsetInBytes)
         {
-            SharedPointer<ServerBlock> pBlock = SharedPointer<ServerBlock>();
-            Platform::LockGuard<Platform::Mutex> lock(m_mutex);
-            const auto blockIter = m_registeredServerBlocks.Find(serverBlockId);
-            if (blockIter != m_registeredServerBlocks.End())
+            // Ranged requests can't address data beyond 4 GB.
+            PullBlock* pBlock = FitsInRangedRequest(offsetInBytes)
+                                    ? DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, clientId, blockId)
+                                    : nullptr;
+            if (pBlock != nullptr)
             {
-                pBlock = blockIter->value;
+                // Connect to the remote client and request everything from the offset to the end of the block.
+                Result result = pBlock->m_transferClient.Connect(clientId);
+                if (result == Result::Success)
+                {
+                    size_t blockSize = 0;
+                    result = pBlock->m_transferClient.RequestRangedPullTransfer(blockId,
+                                                                                offsetInBytes,
+                                                                                UINT32_MAX,
+                                                                                &pBlock->m_blockDataSize,
+                                                                                &blockSize);
+
+                    // The server clamps the offset to the end of the block, so offsets past it are caught here. An
+                    // empty range leaves no transfer in progress, so Read reports the end of the block by itself.
+                    if ((result == Result::Success) && (offsetInBytes > blockSize))
+                    {
+                        result = Result::Error;
+                    }
+                    pBlock->m_isEmptyRange = (pBlock->m_blockDataSize == 0);
+                }
+
+                // If we fail the transfer or connection, destroy the block.
+                if (result != Result::Success)
+                {
+                    pBlock->m_transferClient.Disconnect();
+                    DD_DELETE(pBlock, m_allocCb);
+                    pBlock = nullptr;
+                }
             }
             return pBlock;
         }
 
         // ============================================================================================================
-        void TransferManager::CloseServerBlock(SharedPointer<ServerBlock>& pBlock)
+        PullBlock* TransferManager::OpenCompressedPullBlock(ClientId clientId, BlockId blockId)
         {
-            if (!pBlock.IsNull())
+            PullBlock* pBlock = DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, clientId, blockId);
+            if (pBlock != nullptr)
             {
-                Platform::LockGuard<Platform::Mutex> lock(m_mutex);
+                Result result = pBlock->m_transferClient.Connect(clientId);
+                if ((result == Result::Success) && pBlock->m_transferClient.SupportsCompressedPull())
+                {
+                    size_t transferSize = 0;
+                    TransferCompression compression = TransferCompression::None;
+                    result = pBlock->m_transferClient.RequestCompressedPullTransfer(blockId,
+                                                                                    TransferCompression::Lz4,
+                                                                                    &transferSize,
+                                                                                    &pBlock->m_blockDataSize,
+                                                                                    &compression);
 
-                m_registeredServerBlocks.Erase(pBlock->GetBlockId());
+                    // Uncompressed data is read straight from the transfer client.
+                    if ((result == Result::Success) && (compression != TransferCompression::None))
+                    {
+                        pBlock->m_pCompressedPull = DD_NEW(CompressedPull, m_allocCb)(m_allocCb,
+                                                                                      &pBlock->m_transferClient,
+                                                                                      pBlock->m_blockDataSize);
+                        result = (pBlock->m_pCompressedPull != nullptr) ? pBlock->m_pCompressedPull->Init()
+                                                                        : Result::InsufficientMemory;
+                    }
+                }
+                else if (result == Result::Success)
+                {
+                    result = pBlock->m_transferClient.RequestPullTransfer(blockId, &pBlock->m_blockDataSize);
+                }
 
-                // Clear the external shared pointer to the block.
-                pBlock.Clear();
+                // If we fail the transfer or connection, destroy the block.
+                if (result != Result::Success)
+                {
+                    if (pBlock->m_pCompressedPull != nullptr)
+                    {
+                        DD_DELETE(pBlock->m_pCompressedPull, m_allocCb);
+                    }
+                    pBlock->m_transferClient.Disconnect();
+                    DD_DELETE(pBlock, m_allocCb);
+                    pBlock = nullptr;
+                }
             }
+            return pBlock;
         }
 
         // ============================================================================================================
-        PullBlock* TransferManager::OpenPullBlock(ClientId clientId, BlockId blockId)
+        PullBlock* TransferManager::OpenCachedPullBlock(ClientId clientId, BlockId blockId)
         {
-            PullBlock* pBlock = DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, blockId);
+            PullBlock* pBlock = DD_NEW(PullBlock, m_allocCb)(m_pMessageChannel, clientId, blockId);
             if (pBlock != nullptr)
             {
-                // Connect to the remote client and request a transfer.
                 Result result = pBlock->m_transferClient.Connect(clientId);
-                if (result == Result::Success)
+                if ((result == Result::Success) && pBlock->m_transferClient.SupportsHashedPull())
+                {
+                    TransferContentHash contentHash = {};
+                    result = pBlock->m_transferClient.RequestHashedPullTransfer(blockId,
+                                                                                &pBlock->m_blockDataSize,
+                                                                                &contentHash);
+
+                    SharedPointer<PullContent> pContent;
+                    bool isCached = false;
+                    if (result == Result::Success)
+                    {
+                        pContent = m_pPullContentCache->Find(contentHash, pBlock->m_blockDataSize);
+                        isCached = (pContent.IsNull() == false);
+
+                        // Data that isn't cached yet is copied aside as it's read so it can be cached afterwards.
+                        if ((isCached == false) && m_pPullContentCache->CanHold(pBlock->m_blockDataSize))
+                        {
+                            pContent = SharedPointer<PullContent>::Create(m_allocCb,
+                                                                          m_allocCb,
+                                                                          contentHash,
+                                                                          pBlock->m_blockDataSize);
+                            if ((pContent.IsNull() == false) && (pContent->Init() != Result::Success))
+                            {
+                                pContent.Clear();
+                            }
+                        }
+
+                        // An empty block has no data to send either, so it's read like a cached one.
+                        isCached = (isCached || (pBlock->m_blockDataSize == 0));
+                        result = pBlock->m_transferClient.ContinueHashedPullTransfer(isCached);
+                    }
+
+                    if (result == Result::Success)
+                    {
+                        pBlock->m_pCachedPull = DD_NEW(CachedPull, m_allocCb)(m_pPullContentCache,
+                                                                              &pBlock->m_transferClient,
+                                                                              pContent,
+                                                                              isCached);
+                        result = (pBlock->m_pCachedPull != nullptr) ? Result::Success : Result::InsufficientMemory;
+                    }
+                }
+                else if (result == Result::Success)
                 {
                     result = pBlock->m_transferClient.RequestPullTransfer(blockId, &pBlock->m_blockDataSize);
                 }
@@ -151,11 +1881,39 @@ namespace DevDriver
             return pBlock;
         }
 
+        // ============================================================================================================
+        void TransferManager::SetPullContentCacheBudget(size_t budgetInBytes)
+        {
+            if (m_pPullContentCache != nullptr)
+            {
+                m_pPullContentCache->SetBudget(budgetInBytes);
+            }
+        }
+
         // ============================================================================================================
         void TransferManager::ClosePullBlock(PullBlock** ppBlock)
         {
             DD_ASSERT(ppBlock != nullptr);
 
+            if ((*ppBlock)->m_pCachedPull != nullptr)
+            {
+                DD_DELETE((*ppBlock)->m_pCachedPull, m_allocCb);
+                (*ppBlock)->m_pCachedPull = nullptr;
+            }
+
+            if ((*ppBlock)->m_pCompressedPull != nullptr)
+            {
+                DD_DELETE((*ppBlock)->m_pCompressedPull, m_allocCb);
+                (*ppBlock)->m_pCompressedPull = nullptr;
+            }
+
+            if ((*ppBlock)->m_pParallelPull != nullptr)
+            {
+                // Stops the streams and aborts any of their transfers that are still in progress.
+                DD_DELETE((*ppBlock)->m_pParallelPull, m_allocCb);
+                (*ppBlock)->m_pParallelPull = nullptr;
+            }
+
             TransferProtocol::TransferClient& transferClient = (*ppBlock)->m_transferClient;
             if (transferClient.IsTransferInProgress())
             {
@@ -172,7 +1930,7 @@ namespace DevDriver
         // ============================================================================================================
         PushBlock* TransferManager::OpenPushBlock(ClientId clientId, BlockId blockId, size_t blockSize)
         {
-            PushBlock* pBlock = DD_NEW(PushBlock, m_allocCb)(m_pMessageChannel, blockId);
+            PushBlock* pBlock = DD_NEW(PushBlock, m_allocCb)(m_pMessageChannel, clientId, blockId);
             if (pBlock != nullptr)
             {
                 // Connect to the remote client and request a transfer.
@@ -193,11 +1951,41 @@ namespace DevDriver
             return pBlock;
         }
 
+        // ============================================================================================================
+        PushBlock* TransferManager::OpenPushBlock(
+            ClientId clientId,
+            BlockId  blockId,
+            size_t   blockSize,
+            size_t   sendQueueSizeInBytes)
+        {
+            PushBlock* pBlock = OpenPushBlock(clientId, blockId, blockSize);
+            if ((pBlock != nullptr) && (sendQueueSizeInBytes > 0))
+            {
+                pBlock->m_pPipelinedPush = DD_NEW(PipelinedPush, m_allocCb)(m_allocCb, &pBlock->m_transferClient);
+
+                const Result result = (pBlock->m_pPipelinedPush != nullptr)
+                                      ? pBlock->m_pPipelinedPush->Start(sendQueueSizeInBytes)
+                                      : Result::InsufficientMemory;
+                if (result != Result::Success)
+                {
+                    ClosePushBlock(&pBlock);
+                }
+            }
+            return pBlock;
+        }
+
         // ============================================================================================================
         void TransferManager::ClosePushBlock(PushBlock** ppBlock)
         {
             DD_ASSERT(ppBlock != nullptr);
 
+            if ((*ppBlock)->m_pPipelinedPush != nullptr)
+            {
+                // Stops the send thread. Any transfer it left open is discarded below.
+                DD_DELETE((*ppBlock)->m_pPipelinedPush, m_allocCb);
+                (*ppBlock)->m_pPipelinedPush = nullptr;
+            }
+
             TransferProtocol::TransferClient& transferClient = (*ppBlock)->m_transferClient;
             if (transferClient.IsTransferInProgress())
             {
@@ -212,33 +2000,118 @@ namespace DevDriver
             *ppBlock = nullptr;
         }
 
+        // ============================================================================================================
+        ServerBlock::~ServerBlock()
+        {
+            ReleaseSegments();
+        }
+
         // ============================================================================================================
         void ServerBlock::Write(const void* pSrcBuffer, size_t numBytes)
         {
             // Writes can only be performed on blocks that are not closed.
             DD_ASSERT(m_isClosed == false);
 
-            if (numBytes > 0)
+            const uint8* pSrcData = reinterpret_cast<const uint8*>(pSrcBuffer);
+            while (numBytes > 0)
             {
-                // Calculate how many bytes we have available.
-                const size_t blockCapacityInBytes = (m_chunks.Size() * kTransferChunkSizeInBytes);
-                const size_t bytesAvailable = (blockCapacityInBytes - m_blockDataSize);
+                // Allocate another segment if the existing ones are full. Data that's already written never moves.
+                if ((m_capacity == m_blockDataSize) && (AddSegment(numBytes) == false))
+                {
+                    DD_ALERT_REASON("Failed to allocate server block storage");
+                    break;
+                }
 
-                // Allocate more chunks if necessary.
-                if (bytesAvailable < numBytes)
+                // Advance to the segment that holds the end of the block.
+                while ((m_segments[m_writeSegmentIndex].offset + m_segments[m_writeSegmentIndex].size) <= m_blockDataSize)
                 {
-                    const size_t additionalBytesRequired = (numBytes - bytesAvailable);
-                    const size_t numChunksRequired =
-                        (Platform::Pow2Align(additionalBytesRequired, kTransferChunkSizeInBytes) / kTransferChunkSizeInBytes);
-                    m_chunks.Resize(m_chunks.Size() + numChunksRequired);
+                    ++m_writeSegmentIndex;
                 }
 
+                const Segment& segment = m_segments[m_writeSegmentIndex];
+                const size_t segmentOffset = (m_blockDataSize - segment.offset);
+                const size_t bytesToCopy = Platform::Min(numBytes, (segment.size - segmentOffset));
+
                 // Copy the new data into the block
-                uint8* pData = (reinterpret_cast<uint8*>(m_chunks.Data()) + m_blockDataSize);
-                memcpy(pData, pSrcBuffer, numBytes);
-                m_crc32 = CRC32(pData, numBytes, m_crc32);
-                m_blockDataSize += numBytes;
+                uint8* pData = (segment.pData + segmentOffset);
+                memcpy(pData, pSrcData, bytesToCopy);
+                m_crc32 = CRC32(pData, bytesToCopy, m_crc32);
+                m_blockDataSize += bytesToCopy;
+
+                pSrcData += bytesToCopy;
+                numBytes -= bytesToCopy;
+            }
+        }
+
+        // ============================================================================================================
+        size_t ServerBlock::Read(size_t offset, void* pDstBuffer, size_t numBytes) const
+        {
+            uint8* pDstData = reinterpret_cast<uint8*>(pDstBuffer);
+            size_t bytesRead = 0;
+
+            if (offset < m_blockDataSize)
+            {
+                numBytes = Platform::Min(numBytes, (m_blockDataSize - offset));
+                size_t segmentIndex = FindSegment(offset);
+
+                // Gather the data from consecutive segments.
+                while (bytesRead < numBytes)
+                {
+                    const Segment& segment = m_segments[segmentIndex];
+                    const size_t segmentOffset = ((offset + bytesRead) - segment.offset);
+                    const size_t bytesToCopy = Platform::Min((numBytes - bytesRead), (segment.size - segmentOffset));
+                    memcpy(pDstData + bytesRead, segment.pData + segmentOffset, bytesToCopy);
+                    bytesRead += bytesToCopy;
+                    ++segmentIndex;
+                }
+            }
+
+            return bytesRead;
+        }
+
+        // ============================================================================================================
+        uint32 ServerBlock::CalculateCrc32(size_t offset, size_t numBytes, uint32 crc32) const
+        {
+            if (offset < m_blockDataSize)
+            {
+                numBytes = Platform::Min(numBytes, (m_blockDataSize - offset));
+                size_t segmentIndex = FindSegment(offset);
+
+                size_t bytesProcessed = 0;
+                while (bytesProcessed < numBytes)
+                {
+                    const Segment& segment = m_segments[segmentIndex];
+                    const size_t segmentOffset = ((offset + bytesProcessed) - segment.offset);
+                    const size_t bytesToProcess = Platform::Min((numBytes - bytesProcessed), (segment.size - segmentOffset));
+                    crc32 = CRC32(segment.pData + segmentOffset, bytesToProcess, crc32);
+                    bytesProcessed += bytesToProcess;
+                    ++segmentIndex;
+                }
             }
+
+            return crc32;
+        }
+
+        // ============================================================================================================
+        size_t ServerBlock::FindSegment(size_t offset) const
+        {
+            // Binary search for the last segment that starts at or before the offset.
+            size_t segmentIndex = 0;
+            size_t endIndex = m_segments.Size();
+            while ((endIndex - segmentIndex) > 1)
+            {
+                const size_t middleIndex = (segmentIndex + ((endIndex - segmentIndex) / 2));
+                if (m_segments[middleIndex].offset <= offset)
+                {
+                    segmentIndex = middleIndex;
+                }
+                else
+                {
+                    endIndex = middleIndex;
+                }
+            }
+
+            return segmentIndex;
         }
 
         // ============================================================================================================
@@ -254,7 +2127,38 @@ namespace DevDriver
         {
             m_isClosed = false;
             m_blockDataSize = 0;
+            m_writeSegmentIndex = 0;
             m_crc32 = 0;
+            m_hasContentHash = false;
+        }
+
+        // ============================================================================================================
+        TransferContentHash ServerBlock::GetContentHash()
+        {
+            DD_ASSERT(m_isClosed);
+
+            Platform::LockGuard<Platform::Mutex> lock(m_contentHashMutex);
+
+            if (m_hasContentHash == false)
+            {
+                // Hash the segments in place so blocks don't need contiguous storage.
+                Util::MetroHash128 hasher;
+                for (size_t segmentIndex = 0; segmentIndex < m_segments.Size(); ++segmentIndex)
+                {
+                    const Segment& segment = m_segments[segmentIndex];
+                    if (segment.offset < m_blockDataSize)
+                    {
+                        hasher.Update(segment.pData, Platform::Min((m_blockDataSize - segment.offset), segment.size));
+                    }
+                }
+
+                MetroHash::Hash hash = {};
+                hasher.Finalize(hash.bytes);
+                memcpy(m_contentHash.dwords, hash.dwords, sizeof(m_contentHash.dwords));
+                m_hasContentHash = true;
+            }
+
+            return m_contentHash;
         }
 
         // ============================================================================================================
@@ -262,8 +2166,89 @@ namespace DevDriver
         {
             if (!m_isClosed)
             {
-                m_chunks.Reserve(Platform::Pow2Align(bytes, kTransferChunkSizeInBytes) / kTransferChunkSizeInBytes);
+                if (m_blockDataSize == 0)
+                {
+                    // Nothing has been written yet, so replace the storage with a single segment if it doesn't
+                    // already start with one that's big enough. This keeps reserved blocks contiguous.
+                    if ((m_segments.IsEmpty() == false) && (m_segments[0].size < bytes))
+                    {
+                        ReleaseSegments();
+                    }
+                }
+
+                if (m_capacity < bytes)
+                {
+                    AddSegment(bytes - m_capacity);
+                }
+            }
+        }
+
+        // ============================================================================================================
+        bool ServerBlock::AddSegment(size_t minBytes)
+        {
+            Segment segment = {};
+            segment.offset = m_capacity;
+
+            if (m_storage == ServerBlockStorage::File)
+            {
+                size_t growthInBytes = (m_capacity < kMaxFileSegmentGrowthInBytes) ? m_capacity
+                                                                                    : kMaxFileSegmentGrowthInBytes;
+                growthInBytes = (growthInBytes < kMinFileSegmentSizeInBytes) ? kMinFileSegmentSizeInBytes
+                                                                              : growthInBytes;
+                segment.size = Platform::Pow2Align(Platform::Max(minBytes, growthInBytes), kTransferChunkSizeInBytes);
+                segment.pData = reinterpret_cast<uint8*>(Platform::AllocateFileBackedMemory(segment.size));
+                segment.isFileBacked = (segment.pData != nullptr);
+            }
+
+            if (segment.pData == nullptr)
+            {
+                // Grow geometrically so small blocks stay small and large blocks need few segments.
+                const size_t growthInBytes = (m_capacity < kMaxSegmentGrowthInBytes) ? m_capacity : kMaxSegmentGrowthInBytes;
+                segment.size = Platform::Pow2Align(Platform::Max(minBytes, growthInBytes), kTransferChunkSizeInBytes);
+                segment.pData = reinterpret_cast<uint8*>(DD_MALLOC(segment.size, alignof(TransferChunk), m_allocCb));
+            }
+
+            bool added = false;
+            if (segment.pData != nullptr)
+            {
+                if (m_segments.PushBack(segment))
+                {
+                    m_capacity += segment.size;
+                    added = true;
+                }
+                else
+                {
+                    FreeSegment(segment);
+                }
+            }
+
+            return added;
+        }
+
+        // ============================================================================================================
+        void ServerBlock::FreeSegment(const Segment& segment)
+        {
+            if (segment.isFileBacked)
+            {
+                Platform::FreeFileBackedMemory(segment.pData, segment.size);
+            }
+            else
+            {
+                DD_FREE(segment.pData, m_allocCb);
+            }
+        }
+
+        // ============================================================================================================
+        void ServerBlock::ReleaseSegments()
+        {
+            for (size_t segmentIndex = 0; segmentIndex < m_segments.Size(); ++segmentIndex)
+            {
+                FreeSegment(m_segments[segmentIndex]);
             }
+
+            m_segments.Clear();
+            m_capacity = 0;
+            m_writeSegmentIndex = 0;
         }
 
         // ============================================================================================================
@@ -315,25 +2300,150 @@ namespace DevDriver
         // ============================================================================================================
         Result PullBlock::Read(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead)
         {
-            return m_transferClient.ReadPullTransferData(pDstBuffer, bufferSize, pBytesRead);
+            Result result = Result::Error;
+            if (m_pParallelPull != nullptr)
+            {
+                result = m_pParallelPull->Read(pDstBuffer, bufferSize, pBytesRead);
+            }
+            else if (m_pCompressedPull != nullptr)
+            {
+                result = m_pCompressedPull->Read(pDstBuffer, bufferSize, pBytesRead);
+            }
+            else if (m_pCachedPull != nullptr)
+            {
+                result = m_pCachedPull->Read(pDstBuffer, bufferSize, pBytesRead);
+            }
+            else if (m_isEmptyRange)
+            {
+                if (pBytesRead != nullptr)
+                {
+                    *pBytesRead = 0;
+                    m_isEmptyRange = false;
+                    result = Result::EndOfStream;
+                }
+            }
+            else
+            {
+                result = m_transferClient.ReadPullTransferData(pDstBuffer, bufferSize, pBytesRead);
+            }
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PullBlock::Resume()
+        {
+            Result result = Result::Error;
+            if (m_pParallelPull != nullptr)
+            {
+                result = m_pParallelPull->Resume();
+            }
+            else
+            {
+                // The transfer client reports compressed pulls as unavailable.
+                result = m_transferClient.ResumePullTransfer(m_clientId);
+            }
+            return result;
         }
 
         // ============================================================================================================
         Result PushBlock::Write(const uint8* pDstBuffer, size_t bufferSize)
         {
-            return m_transferClient.WritePushTransferData(pDstBuffer, bufferSize);
+            return (m_pPipelinedPush != nullptr) ? m_pPipelinedPush->Write(pDstBuffer, bufferSize)
+                                                 : m_transferClient.WritePushTransferData(pDstBuffer, bufferSize);
         }
 
         // ============================================================================================================
         Result PushBlock::Finalize()
         {
-            return m_transferClient.ClosePushTransfer(false);
+            Result result = BeginFinalize();
+            if (result == Result::Success)
+            {
+                result = WaitForFinalize(kInfiniteTimeout);
+            }
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PushBlock::BeginFinalize()
+        {
+            Result result = Result::Success;
+
+            if (m_pPipelinedPush != nullptr)
+            {
+                result = m_pPipelinedPush->BeginFinalize(false);
+            }
+            else if (m_isFinalizing)
+            {
+                result = Result::Error;
+            }
+            else
+            {
+                // Without a send queue there's nothing to overlap, so the transfer is closed here.
+                m_finalizeResult = m_transferClient.ClosePushTransfer(false);
+                m_isFinalizing = true;
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PushBlock::WaitForFinalize(uint32 timeoutInMs)
+        {
+            Result result = Result::Error;
+
+            if (m_pPipelinedPush != nullptr)
+            {
+                result = m_pPipelinedPush->WaitForFinalize(timeoutInMs);
+            }
+            else if (m_isFinalizing)
+            {
+                result = m_finalizeResult;
+            }
+
+            return result;
         }
 
         // ============================================================================================================
         Result PushBlock::Discard()
         {
-            return m_transferClient.ClosePushTransfer(true);
+            Result result = Result::Success;
+
+            if (m_pPipelinedPush != nullptr)
+            {
+                result = m_pPipelinedPush->BeginFinalize(true);
+                if (result == Result::Success)
+                {
+                    result = m_pPipelinedPush->WaitForFinalize(kInfiniteTimeout);
+                }
+            }
+            else
+            {
+                result = m_transferClient.ClosePushTransfer(true);
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result PushBlock::Resume(size_t* pOffsetInBytes)
+        {
+            Result result = Result::Error;
+
+            if (m_pPipelinedPush != nullptr)
+            {
+                result = m_pPipelinedPush->Resume(m_clientId, pOffsetInBytes);
+            }
+            else
+            {
+                // A finalize that failed can be started again once the transfer continues.
+                result = m_transferClient.ResumePushTransfer(m_clientId, pOffsetInBytes);
+                if (result == Result::Success)
+                {
+                    m_isFinalizing = false;
+                }
+            }
+
+            return result;
         }
     } // TransferProtocol
 } // DevDriver
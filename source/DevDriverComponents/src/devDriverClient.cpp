@@ -32,6 +32,7 @@
 #include "messageChannel.h"
 #include "protocolClient.h"
 #include "socketMsgTransport.h"
+#include "impairedMsgTransport.h"
 #include "protocols/loggingClient.h"
 #include "protocols/settingsClient.h"
 #include "protocols/driverControlClient.h"
@@ -76,6 +77,7 @@ namespace DevDriver
             break;
         }
         case TransportType::Remote:
+        case TransportType::RemoteStream:
         {
             m_createInfo.connectionInfo = createInfo.transportCreateInfo.hostInfo;
             // Explicitly overwrite connectionInfo.type since it didn't exist originally.
@@ -105,21 +107,48 @@ namespace DevDriver
                                                               m_createInfo,
                                                               m_createInfo.connectionInfo);
         }
-        else if (m_createInfo.connectionInfo.type == TransportType::Remote)
+        else if ((m_createInfo.connectionInfo.type == TransportType::Remote) |
+                 (m_createInfo.connectionInfo.type == TransportType::RemoteStream))
         {
-            using MsgChannelSocket = MessageChannel<SocketMsgTransport>;
-            m_pMsgChannel = DD_NEW(MsgChannelSocket, m_allocCb)(m_allocCb,
-                                                                m_createInfo,
-                                                                m_createInfo.connectionInfo);
+            if (m_createInfo.pNetworkImpairment != nullptr)
+            {
+                using MsgChannelImpairedSocket = MessageChannel<ImpairedMsgTransport<SocketMsgTransport>>;
+                m_pMsgChannel = DD_NEW(MsgChannelImpairedSocket, m_allocCb)(m_allocCb,
+                                                                            m_createInfo,
+                                                                            m_createInfo.pNetworkImpairment,
+                                                                            m_allocCb,
+                                                                            m_createInfo.connectionInfo);
+            }
+            else
+            {
+                using MsgChannelSocket = MessageChannel<SocketMsgTransport>;
+                m_pMsgChannel = DD_NEW(MsgChannelSocket, m_allocCb)(m_allocCb,
+                                                                    m_createInfo,
+                                                                    m_createInfo.connectionInfo);
+            }
         }
 #else
         if ((m_createInfo.connectionInfo.type == TransportType::Remote) |
-            (m_createInfo.connectionInfo.type == TransportType::Local))
+            (m_createInfo.connectionInfo.type == TransportType::RemoteStream) |
+            (m_createInfo.connectionInfo.type == TransportType::Local) |
+            (m_createInfo.connectionInfo.type == TransportType::LocalPacket))
         {
-            using MsgChannelSocket = MessageChannel<SocketMsgTransport>;
-            m_pMsgChannel = DD_NEW(MsgChannelSocket, m_allocCb)(m_allocCb,
-                                                                m_createInfo,
-                                                                m_createInfo.connectionInfo);
+            if (m_createInfo.pNetworkImpairment != nullptr)
+            {
+                using MsgChannelImpairedSocket = MessageChannel<ImpairedMsgTransport<SocketMsgTransport>>;
+                m_pMsgChannel = DD_NEW(MsgChannelImpairedSocket, m_allocCb)(m_allocCb,
+                                                                            m_createInfo,
+                                                                            m_createInfo.pNetworkImpairment,
+                                                                            m_allocCb,
+                                                                            m_createInfo.connectionInfo);
+            }
+            else
+            {
+                using MsgChannelSocket = MessageChannel<SocketMsgTransport>;
+                m_pMsgChannel = DD_NEW(MsgChannelSocket, m_allocCb)(m_allocCb,
+                                                                    m_createInfo,
+                                                                    m_createInfo.connectionInfo);
+            }
         }
 #endif
         else
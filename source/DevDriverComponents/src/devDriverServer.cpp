@@ -75,7 +75,8 @@ namespace DevDriver
                                                               m_createInfo.connectionInfo);
         }
 #else
-        if (m_createInfo.connectionInfo.type == TransportType::Local)
+        if ((m_createInfo.connectionInfo.type == TransportType::Local) |
+            (m_createInfo.connectionInfo.type == TransportType::LocalPacket))
         {
             using MsgChannelSocket = MessageChannel<SocketMsgTransport>;
             m_pMsgChannel = DD_NEW(MsgChannelSocket, m_allocCb)(m_allocCb,
@@ -359,6 +360,11 @@ namespace DevDriver
                 result = WinPipeMsgTransport::TestConnection(hostInfo, timeout);
 #endif
                 break;
+#if !defined(_WIN32)
+            case TransportType::LocalPacket:
+                result = SocketMsgTransport::TestConnection(hostInfo, timeout);
+                break;
+#endif
             default:
                 // Invalid value passed to the function
                 DD_ALERT_REASON("Invalid transport type specified");
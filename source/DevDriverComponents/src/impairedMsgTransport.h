@@ -0,0 +1,160 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  impairedMsgTransport.h
+* @brief Class declaration for ImpairedMsgTransport
+***********************************************************************************************************************
+*/
+
+#pragma once
+
+#include "msgTransport.h"
+#include "ddNetworkImpairment.h"
+
+namespace DevDriver
+{
+    // Wraps another message transport and runs every outgoing message through a NetworkImpairment. Messages that
+    // survive are held until their delivery time and written out from ReadMessage, which the message channel calls
+    // continuously. Only the outgoing direction is impaired. Impair the other end of the link for the other direction.
+    template <class MsgTransport>
+    class ImpairedMsgTransport : public IMsgTransport
+    {
+    public:
+        template <class ...Args>
+        ImpairedMsgTransport(NetworkImpairment* pImpairment, const AllocCb& allocCb, Args&&... args)
+            : m_transport(Platform::Forward<Args>(args)...)
+            , m_pImpairment(pImpairment)
+            , m_sendQueue(allocCb)
+        {
+            DD_ASSERT(m_pImpairment != nullptr);
+        }
+
+        ~ImpairedMsgTransport()
+        {
+        }
+
+        Result Connect(ClientId* pClientId, uint32 timeoutInMs) override
+        {
+            return m_transport.Connect(pClientId, timeoutInMs);
+        }
+
+        Result Disconnect() override
+        {
+            {
+                Platform::LockGuard<Platform::Mutex> lock(m_sendMutex);
+                m_sendQueue.Clear();
+            }
+
+            return m_transport.Disconnect();
+        }
+
+        Result WriteMessage(const MessageBuffer& messageBuffer) override
+        {
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+            uint64 deliveryTimesInMs[NetworkImpairment::kMaxCopies] = {};
+            const uint32 numCopies = m_pImpairment->Schedule(sizeof(MessageHeader) + messageBuffer.header.payloadSize,
+                                                             currentTimeInMs,
+                                                             &deliveryTimesInMs[0]);
+
+            // A dropped message looks like a successful write to the caller, just like a datagram lost on the wire.
+            Result result = Result::Success;
+
+            Platform::LockGuard<Platform::Mutex> lock(m_sendMutex);
+            for (uint32 copyIndex = 0; (copyIndex < numCopies) && (result == Result::Success); ++copyIndex)
+            {
+                // Write straight through when nothing is queued ahead of this message.
+                if ((deliveryTimesInMs[copyIndex] <= currentTimeInMs) && m_sendQueue.IsEmpty())
+                {
+                    result = m_transport.WriteMessage(messageBuffer);
+                }
+                else if (m_sendQueue.Push(messageBuffer, deliveryTimesInMs[copyIndex]) == false)
+                {
+                    result = Result::InsufficientMemory;
+                }
+            }
+
+            return result;
+        }
+
+        Result ReadMessage(MessageBuffer& messageBuffer, uint32 timeoutInMs) override
+        {
+            // Wake up in time to deliver the next queued message.
+            const uint32 waitTimeInMs = Platform::Min(timeoutInMs, FlushDueMessages());
+
+            Result result = m_transport.ReadMessage(messageBuffer, waitTimeInMs);
+
+            if (result == Result::NotReady)
+            {
+                FlushDueMessages();
+            }
+
+            return result;
+        }
+
+        const char* GetTransportName() const override
+        {
+            return m_transport.GetTransportName();
+        }
+
+#if !DD_VERSION_SUPPORTS(GPUOPEN_DISTRIBUTED_STATUS_FLAGS_VERSION)
+        Result UpdateClientStatus(ClientId clientId, StatusFlags flags) override
+        {
+            return m_transport.UpdateClientStatus(clientId, flags);
+        }
+#endif
+
+        DD_STATIC_CONST bool RequiresKeepAlive()
+        {
+            return MsgTransport::RequiresKeepAlive();
+        }
+
+        DD_STATIC_CONST bool RequiresClientRegistration()
+        {
+            return MsgTransport::RequiresClientRegistration();
+        }
+
+    private:
+        // Writes every queued message that is due and returns the time until the next one is
+        uint32 FlushDueMessages()
+        {
+            Platform::LockGuard<Platform::Mutex> lock(m_sendMutex);
+
+            const uint64 currentTimeInMs = Platform::GetCurrentTimeInMs();
+            MessageBuffer messageBuffer;
+            while (m_sendQueue.PopDue(currentTimeInMs, &messageBuffer))
+            {
+                // Failures are treated as loss on the simulated link.
+                m_transport.WriteMessage(messageBuffer);
+            }
+
+            return m_sendQueue.GetTimeUntilDue(currentTimeInMs);
+        }
+
+        MsgTransport                   m_transport;
+        NetworkImpairment*             m_pImpairment;
+        Platform::Mutex                m_sendMutex;
+        ImpairmentQueue<MessageBuffer> m_sendQueue;
+    };
+} // DevDriver
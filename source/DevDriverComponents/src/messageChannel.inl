@@ -140,6 +140,9 @@ namespace DevDriver
             // Give the session manager a chance to update its sessions.
             m_sessionManager.UpdateSessions();
 
+            // Release server blocks whose retention time has passed.
+            m_transferManager.Update();
+
             m_updateSemaphore.Signal();
 
 #if defined(DD_LINUX)
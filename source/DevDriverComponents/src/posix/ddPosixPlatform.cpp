@@ -31,6 +31,10 @@
 #include "ddPlatform.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -183,6 +187,65 @@ namespace DevDriver
             free(pMemory);
         }
 
+        void* AllocateFileBackedMemory(size_t size)
+        {
+            const char* pTempDir = getenv("TMPDIR");
+            if ((pTempDir == nullptr) || (pTempDir[0] == '\0'))
+            {
+                pTempDir = "/tmp";
+            }
+
+            // The file is never linked into the directory, or unlinked right away, so it only lives as long as the
+            // mapping does.
+            int fd = -1;
+#if defined(O_TMPFILE)
+            fd = open(pTempDir, O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+#endif
+            if (fd == -1)
+            {
+                char path[PATH_MAX];
+                Snprintf(path, sizeof(path), "%s/ddblock-XXXXXX", pTempDir);
+                fd = mkstemp(path);
+                if (fd != -1)
+                {
+                    unlink(path);
+                }
+            }
+
+            void* pMemory = nullptr;
+            if (fd != -1)
+            {
+                // Writing to a mapping whose file can't grow raises SIGBUS, so reserve the disk space now where
+                // the platform allows it.
+#if defined(DD_LINUX)
+                const bool sized = (posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0);
+#else
+                const bool sized = (ftruncate(fd, static_cast<off_t>(size)) == 0);
+#endif
+                if (sized)
+                {
+                    void* pMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (pMapping != MAP_FAILED)
+                    {
+                        pMemory = pMapping;
+                    }
+                }
+
+                // The mapping keeps the file alive.
+                close(fd);
+            }
+
+            return pMemory;
+        }
+
+        void FreeFileBackedMemory(void* pMemory, size_t size)
+        {
+            if (pMemory != nullptr)
+            {
+                munmap(pMemory, size);
+            }
+        }
+
         /////////////////////////////////////////////////////
         // Synchronization primatives
         //
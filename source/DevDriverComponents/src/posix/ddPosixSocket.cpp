@@ -37,6 +37,7 @@
 #include <sys/fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 
@@ -46,6 +47,8 @@
 #include <errno.h>
 #include "ddPlatform.h"
 
+#include "../session.h"
+
 namespace DevDriver
 {
     Result GetDataError(bool nonBlocking)
@@ -55,6 +58,7 @@ namespace DevDriver
         switch (err)
         {
         case EAGAIN:
+        case EINPROGRESS:
             if (nonBlocking)
                 result = Result::NotReady;
             break;
@@ -90,6 +94,7 @@ namespace DevDriver
         , m_hints()
         , m_address()
         , m_addressSize(0)
+        , m_receiveCoalescing(false)
     {
     }
 
@@ -134,6 +139,14 @@ namespace DevDriver
                     m_hints.ai_socktype = SOCK_DGRAM;
                     m_hints.ai_protocol = 0;
                     break;
+#if defined(DD_LINUX)
+                case SocketType::LocalSeqPacket:
+                    m_osSocket = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+                    m_hints.ai_family = AF_UNIX;
+                    m_hints.ai_socktype = SOCK_SEQPACKET;
+                    m_hints.ai_protocol = 0;
+                    break;
+#endif
                 default:
                     break;
             }
@@ -141,6 +154,17 @@ namespace DevDriver
             result = (m_osSocket != -1) ? Result::Success : Result::Error;
         }
 
+        if ((result == Result::Success) &&
+            ((socketType == SocketType::Udp) || (socketType == SocketType::Local)))
+        {
+            // The default kernel buffers only hold a fraction of a session window, so several clients sending at
+            // once overflow the receive queue and force retransmits. Match the 2x window sizing used on Windows.
+            // The kernel clamps the request to its configured maximum, so a failure here is not fatal.
+            DD_STATIC_CONST uint32 kBufferMultiple = 2;
+            const uint32 bufferSize = static_cast<uint32>(kBufferMultiple * kDefaultWindowSize * kMaxMessageSizeInBytes);
+            SetBufferSizes(bufferSize, bufferSize);
+        }
+
         if ((result == Result::Success) & m_isNonBlocking)
         {
             // Enable non blocking mode for the socket.
@@ -242,7 +266,7 @@ namespace DevDriver
     {
         Result result = Result::Error;
 
-        if (m_socketType == SocketType::Local)
+        if ((m_socketType == SocketType::Local) || (m_socketType == SocketType::LocalSeqPacket))
         {
             DD_ASSERT(sizeof(m_address) >= sizeof(sockaddr_un));
 
@@ -331,7 +355,7 @@ namespace DevDriver
 
     Result Socket::Listen(uint32 backlog)
     {
-        DD_ASSERT(m_socketType == SocketType::Tcp);
+        DD_ASSERT((m_socketType == SocketType::Tcp) || (m_socketType == SocketType::LocalSeqPacket));
 
         Result result = Result::Error;
 
@@ -345,27 +369,33 @@ namespace DevDriver
 
     Result Socket::Accept(Socket* pClientSocket)
     {
-        DD_ASSERT(m_socketType == SocketType::Tcp);
+        DD_ASSERT((m_socketType == SocketType::Tcp) || (m_socketType == SocketType::LocalSeqPacket));
 
         Result result = Result::Error;
 
-        sockaddr addr = {};
+        sockaddr_storage addr = {};
         socklen_t addrSize = sizeof(addr);
 
         const int clientSocket = Platform::RetryTemporaryFailure(accept,
                                                                  m_osSocket,
-                                                                 &addr,
+                                                                 reinterpret_cast<sockaddr*>(&addr),
                                                                  &addrSize);
         if (clientSocket != -1)
         {
-            sockaddr_in* pSocket = reinterpret_cast<sockaddr_in*>(&addr);
-
             const unsigned int addressBufSize = 256;
             char addressBuf[addressBufSize];
-            const char* pAddress = inet_ntop(AF_INET, reinterpret_cast<void*>(&pSocket->sin_addr), addressBuf, addressBufSize);
+            const char* pAddress = nullptr;
+            unsigned int port = 0;
 
-            unsigned int port = ntohs(pSocket->sin_port);
+            // Local peers are usually unnamed so there is no address to report for them.
+            if (addr.ss_family == AF_INET)
+            {
+                sockaddr_in* pSocket = reinterpret_cast<sockaddr_in*>(&addr);
+                pAddress = inet_ntop(AF_INET, reinterpret_cast<void*>(&pSocket->sin_addr), addressBuf, addressBufSize);
+                port = ntohs(pSocket->sin_port);
+            }
 
+            pClientSocket->m_socketType = m_socketType;
             result = pClientSocket->InitAsClient(clientSocket, pAddress, port, m_isNonBlocking);
         }
 
@@ -404,6 +434,7 @@ namespace DevDriver
                 break;
             }
             case SocketType::Local:
+            case SocketType::LocalSeqPacket:
             {
                 DD_ASSERT(addressInfoSize >= sizeof(sockaddr_un));
 
@@ -429,11 +460,18 @@ namespace DevDriver
     {
         Result result = Result::Error;
 
+#if defined(DD_LINUX)
+        // Report a closed stream through the return value instead of raising SIGPIPE.
+        const int sendFlags = MSG_NOSIGNAL;
+#else
+        const int sendFlags = 0;
+#endif
+
         const int retVal = Platform::RetryTemporaryFailure(send,
                                                            m_osSocket,
                                                            reinterpret_cast<const char*>(pData),
                                                            static_cast<int>(dataSize),
-                                                           0);
+                                                           sendFlags);
         if (retVal != -1)
         {
             *pBytesSent = retVal;
@@ -485,6 +523,79 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::SendToMultiple(const void* const* ppSockAddrs,
+                                  const size_t*      pAddrSizes,
+                                  size_t             numAddrs,
+                                  const uint8*       pData,
+                                  size_t             dataSize,
+                                  Result*            pResults)
+    {
+        DD_ASSERT((m_socketType == SocketType::Udp) || (m_socketType == SocketType::Local));
+
+        Result result = Result::Success;
+
+#if defined(DD_LINUX)
+        // The payload is identical for every destination so all of the message headers share a single iovec.
+        DD_STATIC_CONST size_t kMaxMessagesPerCall = 64;
+        mmsghdr messages[kMaxMessagesPerCall];
+        iovec   dataVector = {};
+        dataVector.iov_base = const_cast<uint8*>(pData);
+        dataVector.iov_len  = dataSize;
+
+        size_t addrIndex = 0;
+        while (addrIndex < numAddrs)
+        {
+            const size_t numMessages = Platform::Min(numAddrs - addrIndex, kMaxMessagesPerCall);
+            for (size_t messageIndex = 0; messageIndex < numMessages; ++messageIndex)
+            {
+                msghdr& header = messages[messageIndex].msg_hdr;
+                memset(&messages[messageIndex], 0, sizeof(mmsghdr));
+                header.msg_name    = const_cast<void*>(ppSockAddrs[addrIndex + messageIndex]);
+                header.msg_namelen = static_cast<socklen_t>(pAddrSizes[addrIndex + messageIndex]);
+                header.msg_iov     = &dataVector;
+                header.msg_iovlen  = 1;
+            }
+
+            const int retVal = Platform::RetryTemporaryFailure(sendmmsg,
+                                                               m_osSocket,
+                                                               &messages[0],
+                                                               static_cast<unsigned int>(numMessages),
+                                                               0);
+            if (retVal > 0)
+            {
+                for (int messageIndex = 0; messageIndex < retVal; ++messageIndex)
+                {
+                    pResults[addrIndex + messageIndex] =
+                        (messages[messageIndex].msg_len == dataSize) ? Result::Success : Result::Error;
+                }
+                addrIndex += static_cast<size_t>(retVal);
+            }
+            else
+            {
+                // The first message of the batch failed. Record the error and continue with the next destination.
+                pResults[addrIndex] = (retVal == 0) ? Result::Unavailable : GetDataError(m_isNonBlocking);
+                ++addrIndex;
+            }
+        }
+#else
+        for (size_t addrIndex = 0; addrIndex < numAddrs; ++addrIndex)
+        {
+            pResults[addrIndex] = SendTo(ppSockAddrs[addrIndex], pAddrSizes[addrIndex], pData, dataSize);
+        }
+#endif
+
+        for (size_t addrIndex = 0; addrIndex < numAddrs; ++addrIndex)
+        {
+            if (pResults[addrIndex] != Result::Success)
+            {
+                result = pResults[addrIndex];
+                break;
+            }
+        }
+
+        return result;
+    }
+
     Result Socket::Receive(uint8* pBuffer, size_t bufferSize, size_t* pBytesReceived)
     {
         Result result = Result::Error;
@@ -545,6 +656,92 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::EnableReceiveCoalescing()
+    {
+        DD_ASSERT(m_socketType == SocketType::Udp);
+
+        Result result = Result::Unavailable;
+
+#if defined(DD_LINUX) && defined(UDP_GRO)
+        const int value = 1;
+        if (setsockopt(m_osSocket, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0)
+        {
+            m_receiveCoalescing = true;
+            result = Result::Success;
+        }
+#endif
+
+        return result;
+    }
+
+    Result Socket::ReceiveSegmentsFrom(void*   pSockAddr,
+                                       size_t* pAddrSize,
+                                       uint8*  pBuffer,
+                                       size_t  bufferSize,
+                                       size_t* pBytesReceived,
+                                       size_t* pSegmentSize)
+    {
+        DD_ASSERT((m_socketType == SocketType::Udp) || (m_socketType == SocketType::Local));
+        DD_ASSERT(*pAddrSize >= sizeof(sockaddr));
+
+        Result result = Result::Error;
+
+        iovec dataVector = {};
+        dataVector.iov_base = pBuffer;
+        dataVector.iov_len  = bufferSize;
+
+        char control[CMSG_SPACE(sizeof(int))] = {};
+
+        msghdr header = {};
+        header.msg_name    = pSockAddr;
+        header.msg_namelen = static_cast<socklen_t>(*pAddrSize);
+        header.msg_iov     = &dataVector;
+        header.msg_iovlen  = 1;
+        if (m_receiveCoalescing)
+        {
+            header.msg_control    = &control[0];
+            header.msg_controllen = sizeof(control);
+        }
+
+        const int retVal = Platform::RetryTemporaryFailure(recvmsg, m_osSocket, &header, 0);
+        if (retVal > 0)
+        {
+            *pAddrSize      = header.msg_namelen;
+            *pBytesReceived = static_cast<size_t>(retVal);
+            *pSegmentSize   = static_cast<size_t>(retVal);
+
+#if defined(DD_LINUX) && defined(UDP_GRO)
+            // The kernel only attaches the segment size when it actually coalesced several datagrams.
+            for (cmsghdr* pControlHeader = CMSG_FIRSTHDR(&header);
+                 pControlHeader != nullptr;
+                 pControlHeader = CMSG_NXTHDR(&header, pControlHeader))
+            {
+                if ((pControlHeader->cmsg_level == SOL_UDP) && (pControlHeader->cmsg_type == UDP_GRO))
+                {
+                    int segmentSize = 0;
+                    memcpy(&segmentSize, CMSG_DATA(pControlHeader), sizeof(segmentSize));
+                    if (segmentSize > 0)
+                    {
+                        *pSegmentSize = static_cast<size_t>(segmentSize);
+                    }
+                }
+            }
+#endif
+
+            result = Result::Success;
+        }
+        else if (retVal == 0)
+        {
+            result = Result::Unavailable;
+        }
+        else
+        {
+            result = GetDataError(m_isNonBlocking);
+        }
+
+        return result;
+    }
+
     Result Socket::Close()
     {
         Result result = Result::Error;
@@ -571,6 +768,41 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::SetNoDelay(bool noDelay)
+    {
+        DD_ASSERT(m_socketType == SocketType::Tcp);
+
+        const int value = noDelay ? 1 : 0;
+        const int retVal = setsockopt(m_osSocket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+
+        return (retVal == 0) ? Result::Success : Result::Error;
+    }
+
+    Result Socket::SetBufferSizes(uint32 sendBufferSize, uint32 receiveBufferSize)
+    {
+        Result result = Result::Success;
+
+        if (sendBufferSize > 0)
+        {
+            const int value = static_cast<int>(sendBufferSize);
+            if (setsockopt(m_osSocket, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)) != 0)
+            {
+                result = Result::Error;
+            }
+        }
+
+        if (receiveBufferSize > 0)
+        {
+            const int value = static_cast<int>(receiveBufferSize);
+            if (setsockopt(m_osSocket, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) != 0)
+            {
+                result = Result::Error;
+            }
+        }
+
+        return result;
+    }
+
     Result Socket::GetSocketName(char *pAddress, size_t addrLen, uint32 *pPort)
     {
         Result result = Result::Error;
@@ -594,7 +826,7 @@ namespace DevDriver
     Result Socket::InitAsClient(OsSocketType socket, const char* pAddress, uint32 port, bool isNonBlocking)
     {
 
-        DD_ASSERT(m_socketType == SocketType::Tcp);
+        DD_ASSERT((m_socketType == SocketType::Tcp) || (m_socketType == SocketType::LocalSeqPacket));
         DD_UNUSED(pAddress);
         DD_UNUSED(port);
 
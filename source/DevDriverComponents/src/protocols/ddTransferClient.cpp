@@ -26,7 +26,7 @@
 #include <cstring>
 
 #define TRANSFER_CLIENT_MIN_MAJOR_VERSION 1
-#define TRANSFER_CLIENT_MAX_MAJOR_VERSION 2
+#define TRANSFER_CLIENT_MAX_MAJOR_VERSION 6
 
 namespace DevDriver
 {
@@ -67,11 +67,7 @@ namespace DevDriver
                     if (m_pSession->GetVersion() >= TRANSFER_REFACTOR_VERSION)
                     {
                         const TransferDataHeaderV2& receivedHeader = container.GetPayload<TransferDataHeaderV2>();
-                        m_transferContext.state = TransferState::TransferInProgress;
-                        m_transferContext.totalBytes = receivedHeader.sizeInBytes;
-                        m_transferContext.crc32 = 0;
-                        m_transferContext.dataChunkSizeInBytes = 0;
-                        m_transferContext.dataChunkBytesTransfered = 0;
+                        BeginPullTransfer(blockId, 0, receivedHeader.sizeInBytes);
 
                         *pTransferSizeInBytes = receivedHeader.sizeInBytes;
                     }
@@ -81,12 +77,7 @@ namespace DevDriver
                         result = receivedHeader.result;
                         if (result == Result::Success)
                         {
-                            m_transferContext.state = TransferState::TransferInProgress;
-                            m_transferContext.totalBytes = receivedHeader.sizeInBytes;
-                            m_transferContext.crc32 = 0;
-                            m_transferContext.dataChunkSizeInBytes = 0;
-                            m_transferContext.dataChunkBytesTransfered = 0;
-                            m_transferContext.type = TransferType::Pull;
+                            BeginPullTransfer(blockId, 0, receivedHeader.sizeInBytes);
 
                             *pTransferSizeInBytes = receivedHeader.sizeInBytes;
                         }
@@ -109,6 +100,193 @@ namespace DevDriver
             return result;
         }
 
+        // ============================================================================================================
+        Result TransferClient::RequestRangedPullTransfer(
+            BlockId blockId,
+            size_t  offsetInBytes,
+            size_t  sizeInBytes,
+            size_t* pTransferSizeInBytes,
+            size_t* pBlockSizeInBytes)
+        {
+            Result result = Result::Error;
+
+            // Offsets and sizes that don't fit into the request would be silently truncated, so they're rejected.
+            if ((m_transferContext.state == TransferState::Idle) &&
+                (pTransferSizeInBytes != nullptr) &&
+                (pBlockSizeInBytes != nullptr) &&
+                FitsInRangedRequest(offsetInBytes) &&
+                FitsInRangedRequest(sizeInBytes))
+            {
+                if (SupportsRangedPull())
+                {
+                    const uint32 offset = static_cast<uint32>(offsetInBytes);
+                    TransferRangedDataHeader receivedHeader(0, 0);
+                    result = SendRangedPullRequest(blockId, offset, static_cast<uint32>(sizeInBytes), offset, &receivedHeader);
+
+                    if (result == Result::Success)
+                    {
+                        *pTransferSizeInBytes = receivedHeader.sizeInBytes;
+                        *pBlockSizeInBytes = receivedHeader.blockSizeInBytes;
+
+                        BeginPullTransfer(blockId, offset, receivedHeader.sizeInBytes);
+
+                        if (receivedHeader.sizeInBytes == 0)
+                        {
+                            // Nothing to transfer, consume the sentinel so the session is ready for the next request.
+                            result = ReceivePullSentinel();
+                            if ((result == Result::Success) && (m_transferContext.state != TransferState::Error))
+                            {
+                                m_transferContext.state = TransferState::Idle;
+                            }
+                            else
+                            {
+                                m_transferContext.state = TransferState::Error;
+                                result = Result::Error;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    result = Result::Unavailable;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::RequestCompressedPullTransfer(
+            BlockId              blockId,
+            TransferCompression  compression,
+            size_t*              pTransferSizeInBytes,
+            size_t*              pBlockSizeInBytes,
+            TransferCompression* pCompression)
+        {
+            Result result = Result::Error;
+
+            if ((m_transferContext.state == TransferState::Idle) &&
+                (pTransferSizeInBytes != nullptr) &&
+                (pBlockSizeInBytes != nullptr) &&
+                (pCompression != nullptr))
+            {
+                if (SupportsCompressedPull())
+                {
+                    SizedPayloadContainer container = {};
+                    container.CreatePayload<TransferCompressedRequest>(blockId, compression);
+
+                    result = TransactTransferPayload(&container);
+
+                    if ((result == Result::Success) &&
+                        (container.GetPayload<TransferHeader>().command == TransferMessage::TransferDataHeader))
+                    {
+                        const TransferCompressedDataHeader& receivedHeader =
+                            container.GetPayload<TransferCompressedDataHeader>();
+
+                        *pTransferSizeInBytes = receivedHeader.sizeInBytes;
+                        *pBlockSizeInBytes = receivedHeader.blockSizeInBytes;
+                        *pCompression = receivedHeader.compression;
+
+                        BeginPullTransfer(blockId, 0, receivedHeader.sizeInBytes);
+
+                        // Compressed data is streamed until the sentinel arrives. It doesn't map to ranges of the
+                        // block, so only raw transfers can be resumed.
+                        if (receivedHeader.compression != TransferCompression::None)
+                        {
+                            m_transferContext.type = TransferType::CompressedPull;
+                        }
+                    }
+                    else
+                    {
+                        // We either didn't receive a response, or the server rejected the request.
+                        m_transferContext.state = TransferState::Error;
+                        result = Result::Error;
+                    }
+                }
+                else
+                {
+                    result = Result::Unavailable;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::RequestHashedPullTransfer(
+            BlockId              blockId,
+            size_t*              pTransferSizeInBytes,
+            TransferContentHash* pContentHash)
+        {
+            Result result = Result::Error;
+
+            if ((m_transferContext.state == TransferState::Idle) &&
+                (pTransferSizeInBytes != nullptr) &&
+                (pContentHash != nullptr))
+            {
+                if (SupportsHashedPull())
+                {
+                    SizedPayloadContainer container = {};
+                    container.CreatePayload<TransferRequest>(blockId, TransferType::HashedPull, 0);
+
+                    result = TransactTransferPayload(&container);
+
+                    if ((result == Result::Success) &&
+                        (container.GetPayload<TransferHeader>().command == TransferMessage::TransferDataHeader))
+                    {
+                        const TransferHashedDataHeader& receivedHeader =
+                            container.GetPayload<TransferHashedDataHeader>();
+
+                        *pTransferSizeInBytes = receivedHeader.sizeInBytes;
+                        *pContentHash = receivedHeader.contentHash;
+
+                        BeginPullTransfer(blockId, 0, receivedHeader.sizeInBytes);
+                        m_transferContext.state = TransferState::WaitingForContinue;
+                    }
+                    else
+                    {
+                        // We either didn't receive a response, or the server rejected the request.
+                        m_transferContext.state = TransferState::Error;
+                        result = Result::Error;
+                    }
+                }
+                else
+                {
+                    result = Result::Unavailable;
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::ContinueHashedPullTransfer(bool skipData)
+        {
+            Result result = Result::Error;
+
+            if (m_transferContext.state == TransferState::WaitingForContinue)
+            {
+                // An empty block has nothing to send, so it's skipped too.
+                const bool skip = (skipData || (m_transferContext.totalBytes == 0));
+
+                SizedPayloadContainer container = {};
+                container.CreatePayload<TransferStatus>(skip ? Result::EndOfStream : Result::Success);
+                result = SendTransferPayload(container);
+
+                if (result == Result::Success)
+                {
+                    m_transferContext.state = skip ? TransferState::Idle : TransferState::TransferInProgress;
+                }
+                else
+                {
+                    m_transferContext.state = TransferState::Error;
+                    result = Result::Error;
+                }
+            }
+
+            return result;
+        }
+
         // ============================================================================================================
         Result TransferClient::ReadPullTransferData(uint8* pDstBuffer, size_t bufferSize, size_t* pBytesRead)
         {
@@ -118,9 +296,13 @@ namespace DevDriver
             {
                 result = Result::Success;
 
+                // Streamed transfers don't know their size, so they only end when the sentinel arrives.
+                const bool isStreamed = (m_transferContext.type == TransferType::CompressedPull);
+                const bool isChunkConsumed =
+                    (m_transferContext.dataChunkSizeInBytes == m_transferContext.dataChunkBytesTransfered);
+
                 // There is no remaining data to read
-                if ((m_transferContext.totalBytes == 0) &&
-                    (m_transferContext.dataChunkSizeInBytes == m_transferContext.dataChunkBytesTransfered))
+                if ((isStreamed == false) && (m_transferContext.totalBytes == 0) && isChunkConsumed)
                 {
                     result = Result::EndOfStream;
                     m_transferContext.state = TransferState::Idle;
@@ -152,79 +334,18 @@ namespace DevDriver
                             remainingBufferSize -= bytesToRead;
 
                             // If this is the last of the data for the transfer, return end of stream and return to the idle state.
-                            if ((m_transferContext.dataChunkBytesTransfered == m_transferContext.dataChunkSizeInBytes) &&
+                            if ((isStreamed == false) &&
+                                (m_transferContext.dataChunkBytesTransfered == m_transferContext.dataChunkSizeInBytes) &&
                                 (m_transferContext.totalBytes == 0))
                             {
                                 result = Result::EndOfStream;
                                 m_transferContext.state = TransferState::Idle;
                             }
                         }
-                        else if (m_transferContext.totalBytes > 0)
+                        else if (isStreamed || (m_transferContext.totalBytes > 0))
                         {
                             // Attempt to fetch a new chunk if we're out of data.
-                            result = ReceiveTransferPayload(&m_transferContext.scratchPayload, kTransferChunkTimeoutInMs);
-
-                            const TransferDataChunk& chunk =
-                                scratchPayload.GetPayload<TransferDataChunk>();
-
-                            if ((result == Result::Success) &&
-                                (chunk.command == TransferMessage::TransferDataChunk))
-                            {
-                                // Calculate the remaining payload size. We clamp this to the minimum of the payload
-                                // size specified and how many bytes are remaining. This works on the V1 protocol
-                                // as all packets are guaranteed to be a full payload size, except for the last
-                                // packet. That packet should be equal to the number of total bytes remaining.
-                                // On V2 sessions, a server is free to send arbitrary sized chunks in situations
-                                // that require it
-                                const size_t receivedSize = scratchPayload.payloadSize - sizeof(TransferHeader);
-                                const size_t payloadSize = Platform::Min(receivedSize, kMaxTransferDataChunkSize);
-                                const uint32 adjustedPayloadSize = Platform::Min(static_cast<uint32>(payloadSize),
-                                                                                 m_transferContext.totalBytes);
-
-                                // Adjust global state
-                                m_transferContext.dataChunkSizeInBytes = adjustedPayloadSize;
-                                m_transferContext.dataChunkBytesTransfered = 0;
-                                m_transferContext.totalBytes -= adjustedPayloadSize;
-
-                                // Update the calculated CRC using the chunk we just received. The existing CRC value
-                                // is used as an input, ensuring that we calculate the same value as the server.
-                                m_transferContext.crc32 = CRC32(&chunk.data[0],
-                                                                adjustedPayloadSize,
-                                                                m_transferContext.crc32);
-
-                                // If that was the last chunk we consume and verify the sentinel
-                                if (m_transferContext.totalBytes == 0)
-                                {
-                                    SizedPayloadContainer sentinelPayload = {};
-                                    result = ReceiveTransferPayload(&sentinelPayload, kTransferChunkTimeoutInMs);
-
-                                    TransferDataSentinel& sentinel = sentinelPayload.GetPayload<TransferDataSentinel>();
-
-                                    // If we didn't receive a sentinel or the read failed we return an error, otherwise
-                                    if ((result != Result::Success) ||
-                                        (sentinel.command != TransferMessage::TransferDataSentinel) ||
-                                        (sentinel.result != Result::Success))
-                                    {
-                                        // Failed to receive the sentinel. Fail the transfer.
-                                        m_transferContext.state = TransferState::Error;
-                                    }
-                                    else
-                                    {
-                                        // Check CRC
-                                        if ((m_pSession->GetVersion() >= TRANSFER_REFACTOR_VERSION) &&
-                                            (sentinel.crc32 != m_transferContext.crc32))
-                                        {
-                                            m_transferContext.state = TransferState::Error;
-                                        }
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                // Failed to receive a transfer data chunk. Fail the transfer.
-                                DD_ALERT_REASON("Pull transfer session received invalid data");
-                                m_transferContext.state = TransferState::Error;
-                            }
+                            result = ReceivePullChunk();
                         }
                     }
 
@@ -232,7 +353,12 @@ namespace DevDriver
                 }
                 else
                 {
-                    // No space available for writing in the caller's buffer.
+                    // No space available for writing in the caller's buffer. Once a streamed transfer has handed out
+                    // all of its data, this checks whether the sentinel is next.
+                    if (isStreamed && isChunkConsumed)
+                    {
+                        result = ReceivePullChunk();
+                    }
                     *pBytesRead = 0;
                 }
             }
@@ -260,6 +386,9 @@ namespace DevDriver
                 {
                     m_transferContext.type = TransferType::Push;
                     m_transferContext.state = TransferState::TransferInProgress;
+                    m_transferContext.blockId = blockId;
+                    m_transferContext.crcOffset = 0;
+                    m_transferContext.endOffset = static_cast<uint32>(transferSizeInBytes);
                     m_transferContext.totalBytes = static_cast<uint32>(transferSizeInBytes);
                     m_transferContext.crc32 = 0;
                     m_transferContext.dataChunkSizeInBytes = 0;
@@ -336,13 +465,127 @@ namespace DevDriver
             return result;
         }
 
+        // ============================================================================================================
+        Result TransferClient::ResumePushTransfer(ClientId clientId, size_t* pOffsetInBytes)
+        {
+            Result result = Result::Error;
+
+            if ((pOffsetInBytes != nullptr) &&
+                (m_transferContext.type == TransferType::Push) &&
+                (m_transferContext.state != TransferState::Idle) &&
+                (m_transferContext.blockId != kInvalidBlockId))
+            {
+                // Reconnecting resets the transfer context, so keep a copy to continue from.
+                const ClientTransferContext context = m_transferContext;
+
+                Disconnect();
+                result = Connect(clientId);
+                if ((result == Result::Success) && (m_pSession->GetVersion() < TRANSFER_RESUME_VERSION))
+                {
+                    result = Result::Unavailable;
+                }
+
+                m_transferContext = context;
+                m_transferContext.state = TransferState::Error;
+
+                if (result == Result::Success)
+                {
+                    SizedPayloadContainer container = {};
+                    container.CreatePayload<TransferRequest>(context.blockId, TransferType::ResumePush, context.endOffset);
+                    result = TransactTransferPayload(&container);
+
+                    const TransferResumeStatus& status = container.GetPayload<TransferResumeStatus>();
+                    if ((result == Result::Success) &&
+                        (status.command == TransferMessage::TransferStatus) &&
+                        (container.payloadSize >= sizeof(TransferResumeStatus)) &&
+                        (status.result == Result::Success))
+                    {
+                        // Continue the CRC from the data the server actually holds, which may be less than we sent.
+                        m_transferContext.state = TransferState::TransferInProgress;
+                        m_transferContext.crc32 = status.crc32;
+                        *pOffsetInBytes = status.sizeInBytes;
+                    }
+                    else
+                    {
+                        result = Result::Error;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::ResumePullTransfer(ClientId clientId)
+        {
+            Result result = Result::Error;
+
+            if (m_transferContext.type == TransferType::CompressedPull)
+            {
+                result = Result::Unavailable;
+            }
+            else if ((m_transferContext.type == TransferType::Pull) &&
+                     (m_transferContext.state != TransferState::Idle) &&
+                     (m_transferContext.blockId != kInvalidBlockId))
+            {
+                // Reconnecting resets the transfer context, so keep a copy to continue from.
+                const ClientTransferContext context = m_transferContext;
+
+                Disconnect();
+                result = Connect(clientId);
+                if ((result == Result::Success) && (m_pSession->GetVersion() < TRANSFER_RESUME_VERSION))
+                {
+                    result = Result::Unavailable;
+                }
+
+                m_transferContext = context;
+                m_transferContext.state = TransferState::Error;
+
+                if (result == Result::Success)
+                {
+                    // Request everything after the last chunk we received. The CRC of the new range starts at the
+                    // beginning of the original transfer so it also verifies the data we already have.
+                    const uint32 offset = (context.endOffset - context.totalBytes);
+                    TransferRangedDataHeader receivedHeader(0, 0);
+                    result = SendRangedPullRequest(context.blockId,
+                                                   offset,
+                                                   context.totalBytes,
+                                                   context.crcOffset,
+                                                   &receivedHeader);
+
+                    if ((result == Result::Success) && (receivedHeader.sizeInBytes == context.totalBytes))
+                    {
+                        m_transferContext.state = TransferState::TransferInProgress;
+
+                        // If the transfer was interrupted while waiting for the sentinel, receive it now.
+                        if (context.totalBytes == 0)
+                        {
+                            result = ReceivePullSentinel();
+                            if (m_transferContext.state == TransferState::Error)
+                            {
+                                result = Result::Error;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        m_transferContext.state = TransferState::Error;
+                        result = Result::Error;
+                    }
+                }
+            }
+
+            return result;
+        }
+
         // ============================================================================================================
         Result TransferClient::AbortPullTransfer()
         {
             Result result = Result::Error;
 
             if ((m_transferContext.state == TransferState::TransferInProgress) &&
-                (m_transferContext.type == TransferType::Pull))
+                ((m_transferContext.type == TransferType::Pull) ||
+                 (m_transferContext.type == TransferType::CompressedPull)))
             {
                 SizedPayloadContainer container = {};
 
@@ -388,6 +631,160 @@ namespace DevDriver
             memset(&m_transferContext, 0, sizeof(m_transferContext));
         }
 
+        // ============================================================================================================
+        void TransferClient::BeginPullTransfer(BlockId blockId, uint32 offset, uint32 totalBytes)
+        {
+            m_transferContext.state = TransferState::TransferInProgress;
+            m_transferContext.type = TransferType::Pull;
+            m_transferContext.blockId = blockId;
+            m_transferContext.crcOffset = offset;
+            m_transferContext.endOffset = (offset + totalBytes);
+            m_transferContext.totalBytes = totalBytes;
+            m_transferContext.crc32 = 0;
+            m_transferContext.dataChunkSizeInBytes = 0;
+            m_transferContext.dataChunkBytesTransfered = 0;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::ReceivePullChunk()
+        {
+            SizedPayloadContainer& scratchPayload = m_transferContext.scratchPayload;
+            Result result = ReceiveTransferPayload(&scratchPayload, kTransferChunkTimeoutInMs);
+
+            const TransferDataChunk& chunk = scratchPayload.GetPayload<TransferDataChunk>();
+            const bool isStreamed = (m_transferContext.type == TransferType::CompressedPull);
+
+            if ((result == Result::Success) &&
+                (chunk.command == TransferMessage::TransferDataChunk))
+            {
+                // Calculate the remaining payload size. We clamp this to the minimum of the payload
+                // size specified and how many bytes are remaining. This works on the V1 protocol
+                // as all packets are guaranteed to be a full payload size, except for the last
+                // packet. That packet should be equal to the number of total bytes remaining.
+                // On V2 sessions, a server is free to send arbitrary sized chunks in situations
+                // that require it
+                const size_t receivedSize = scratchPayload.payloadSize - sizeof(TransferHeader);
+                const size_t payloadSize = Platform::Min(receivedSize, kMaxTransferDataChunkSize);
+                const uint32 adjustedPayloadSize =
+                    isStreamed ? static_cast<uint32>(payloadSize)
+                               : Platform::Min(static_cast<uint32>(payloadSize), m_transferContext.totalBytes);
+
+                // Adjust global state
+                m_transferContext.dataChunkSizeInBytes = adjustedPayloadSize;
+                m_transferContext.dataChunkBytesTransfered = 0;
+                if (isStreamed == false)
+                {
+                    m_transferContext.totalBytes -= adjustedPayloadSize;
+                }
+
+                // Update the calculated CRC using the chunk we just received. The existing CRC value
+                // is used as an input, ensuring that we calculate the same value as the server.
+                m_transferContext.crc32 = CRC32(&chunk.data[0],
+                                                adjustedPayloadSize,
+                                                m_transferContext.crc32);
+
+                // If that was the last chunk we consume and verify the sentinel
+                if ((isStreamed == false) && (m_transferContext.totalBytes == 0))
+                {
+                    result = ReceivePullSentinel();
+                }
+            }
+            else if ((result == Result::Success) &&
+                     isStreamed &&
+                     (chunk.command == TransferMessage::TransferDataSentinel))
+            {
+                // The end of a streamed transfer.
+                CheckPullSentinel(scratchPayload.GetPayload<TransferDataSentinel>());
+                m_transferContext.dataChunkSizeInBytes = 0;
+                m_transferContext.dataChunkBytesTransfered = 0;
+
+                if (m_transferContext.state == TransferState::TransferInProgress)
+                {
+                    m_transferContext.state = TransferState::Idle;
+                    result = Result::EndOfStream;
+                }
+                else
+                {
+                    result = Result::Error;
+                }
+            }
+            else
+            {
+                // Failed to receive a transfer data chunk. Fail the transfer.
+                DD_ALERT_REASON("Pull transfer session received invalid data");
+                m_transferContext.state = TransferState::Error;
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        Result TransferClient::ReceivePullSentinel()
+        {
+            SizedPayloadContainer sentinelPayload = {};
+            const Result result = ReceiveTransferPayload(&sentinelPayload, kTransferChunkTimeoutInMs);
+
+            // If the read failed we fail the transfer.
+            if (result == Result::Success)
+            {
+                CheckPullSentinel(sentinelPayload.GetPayload<TransferDataSentinel>());
+            }
+            else
+            {
+                m_transferContext.state = TransferState::Error;
+            }
+
+            return result;
+        }
+
+        // ============================================================================================================
+        void TransferClient::CheckPullSentinel(const TransferDataSentinel& sentinel)
+        {
+            // If we didn't receive a sentinel or the server failed the transfer we fail it too.
+            if ((sentinel.command != TransferMessage::TransferDataSentinel) ||
+                (sentinel.result != Result::Success))
+            {
+                m_transferContext.state = TransferState::Error;
+            }
+            else
+            {
+                // Check CRC
+                if ((m_pSession->GetVersion() >= TRANSFER_REFACTOR_VERSION) &&
+                    (sentinel.crc32 != m_transferContext.crc32))
+                {
+                    m_transferContext.state = TransferState::Error;
+                }
+            }
+        }
+
+        // ============================================================================================================
+        Result TransferClient::SendRangedPullRequest(
+            BlockId                   blockId,
+            uint32                    offset,
+            uint32                    size,
+            uint32                    crcOffset,
+            TransferRangedDataHeader* pHeader)
+        {
+            SizedPayloadContainer container = {};
+            container.CreatePayload<TransferRangedRequest>(blockId, offset, size, crcOffset);
+
+            Result result = TransactTransferPayload(&container);
+
+            if ((result == Result::Success) &&
+                (container.GetPayload<TransferHeader>().command == TransferMessage::TransferDataHeader))
+            {
+                *pHeader = container.GetPayload<TransferRangedDataHeader>();
+            }
+            else
+            {
+                // We either didn't receive a response, or the server rejected the request.
+                m_transferContext.state = TransferState::Error;
+                result = Result::Error;
+            }
+
+            return result;
+        }
+
         // ============================================================================================================
         // Helper method to send a payload, handling backwards compatibility and retrying.
         Result TransferClient::SendTransferPayload(
@@ -25,9 +25,10 @@
 #include "protocols/ddTransferServer.h"
 #include "ddTransferManager.h"
 #include "msgChannel.h"
+#include "util/ddLz4.h"
 
 #define TRANSFER_SERVER_MIN_MAJOR_VERSION 1
-#define TRANSFER_SERVER_MAX_MAJOR_VERSION 2
+#define TRANSFER_SERVER_MAX_MAJOR_VERSION 6
 
 namespace DevDriver
 {
@@ -38,6 +39,7 @@ namespace DevDriver
             Idle = 0,
             SendPayload,
             StartPullTransfer,
+            WaitForPullContinue,
             ProcessPullTransfer,
             StartPushTransfer,
             ReceivePushTransferData,
@@ -47,14 +49,25 @@ namespace DevDriver
         {
         public:
             // ========================================================================================================
-            TransferSession(TransferManager* pTransferManager, const SharedPointer<ISession>& pSession)
+            TransferSession(const AllocCb&                 allocCb,
+                            TransferManager*               pTransferManager,
+                            const SharedPointer<ISession>& pSession)
                 : m_scratchPayload()
+                , m_allocCb(allocCb)
                 , m_pTransferManager(pTransferManager)
                 , m_pSession(pSession)
                 , m_pBlock()
+                , m_compression(TransferCompression::None)
+                , m_pFrameBuffer(nullptr)
+                , m_frameSize(0)
+                , m_frameOffset(0)
+                , m_startOffset(0)
                 , m_totalBytes(0)
                 , m_bytesTransferred(0)
                 , m_crc32(0)
+                , m_accumulateCrc(false)
+                , m_waitForContinue(false)
+                , m_pushGeneration(0)
                 , m_state(SessionState::Idle)
             {
             }
@@ -68,6 +81,11 @@ namespace DevDriver
                 {
                     m_pBlock->EndTransfer();
                 }
+
+                if (m_pFrameBuffer != nullptr)
+                {
+                    DD_FREE(m_pFrameBuffer, m_allocCb);
+                }
             }
 
             // Helper functions for working with SizedPayloadContainers and managing back-compat.
@@ -121,9 +139,12 @@ namespace DevDriver
 
                             // Use the block information to populate our transfer context.
                             m_pBlock = pBlock;
+                            m_compression = TransferCompression::None;
+                            m_startOffset = 0;
                             m_totalBytes = pBlock->GetBlockDataSize();
                             m_bytesTransferred = 0;
                             m_crc32 = pBlock->GetCrc32();
+                            m_accumulateCrc = false;
                             m_state = SessionState::StartPullTransfer;
 
                             const uint32 blockSizeInBytes = static_cast<uint32>(m_pBlock->GetBlockDataSize());
@@ -146,6 +167,180 @@ namespace DevDriver
                         }
                         break;
                     }
+                    case TransferType::RangedPull:
+                    {
+                        // Ranged requests carry an extra offset field, so make sure we actually received it.
+                        SharedPointer<ServerBlock> pBlock = m_pTransferManager->GetServerBlock(request.blockId);
+                        const bool blockIsAvailable = (!pBlock.IsNull() && pBlock->IsClosed());
+                        if (blockIsAvailable &&
+                            (m_state == SessionState::Idle) &&
+                            (m_pSession->GetVersion() >= TRANSFER_RANGED_PULL_VERSION) &&
+                            (m_scratchPayload.payloadSize >= kRangedRequestV3Size))
+                        {
+                            const TransferRangedRequest rangedRequest = m_scratchPayload.GetPayload<TransferRangedRequest>();
+                            const size_t blockSize = pBlock->GetBlockDataSize();
+                            const size_t offset = Platform::Min(static_cast<size_t>(rangedRequest.offsetInBytes), blockSize);
+                            const size_t size = Platform::Min(static_cast<size_t>(rangedRequest.sizeInBytes), blockSize - offset);
+
+                            // Resumed ranges ask for a CRC that also covers the data sent before the interruption.
+                            const bool hasCrcOffset = ((m_pSession->GetVersion() >= TRANSFER_RESUME_VERSION) &&
+                                                       (m_scratchPayload.payloadSize >= sizeof(TransferRangedRequest)));
+                            const size_t crcOffset =
+                                hasCrcOffset ? Platform::Min(static_cast<size_t>(rangedRequest.crcOffsetInBytes), offset)
+                                             : offset;
+
+                            pBlock->BeginTransfer();
+
+                            m_pBlock = pBlock;
+                            m_compression = TransferCompression::None;
+                            m_startOffset = offset;
+                            m_totalBytes = size;
+                            m_bytesTransferred = 0;
+                            m_state = SessionState::StartPullTransfer;
+
+                            if ((crcOffset == 0) && ((offset + size) == blockSize))
+                            {
+                                // The CRC covers the whole block, which the block already knows.
+                                m_crc32 = pBlock->GetCrc32();
+                                m_accumulateCrc = false;
+                            }
+                            else
+                            {
+                                // Otherwise it's accumulated as the data is sent, starting with any data in front
+                                // of the range that the CRC needs to cover.
+                                m_crc32 = pBlock->CalculateCrc32(crcOffset, (offset - crcOffset), 0);
+                                m_accumulateCrc = true;
+                            }
+
+                            m_scratchPayload.CreatePayload<TransferRangedDataHeader>(static_cast<uint32>(size),
+                                                                                     static_cast<uint32>(blockSize));
+
+                            SendPullTransferHeader();
+                        }
+                        else
+                        {
+                            m_scratchPayload.CreatePayload<TransferStatus>(Result::Error);
+                            m_state = SessionState::SendPayload;
+                            SendScratchPayloadAndMoveToIdle();
+                        }
+                        break;
+                    }
+                    case TransferType::CompressedPull:
+                    {
+                        SharedPointer<ServerBlock> pBlock = m_pTransferManager->GetServerBlock(request.blockId);
+                        const bool blockIsAvailable = (!pBlock.IsNull() && pBlock->IsClosed());
+                        if (blockIsAvailable &&
+                            (m_state == SessionState::Idle) &&
+                            (m_pSession->GetVersion() >= TRANSFER_COMPRESSION_VERSION))
+                        {
+                            const TransferCompressedRequest compressedRequest =
+                                m_scratchPayload.GetPayload<TransferCompressedRequest>();
+
+                            // Frames are encoded one at a time as the data is sent, so the size of the encoded data
+                            // isn't known up front and the sentinel marks its end. Small blocks, unsupported
+                            // compressions and sessions without a frame buffer get the raw data with its size.
+                            const size_t blockSize = pBlock->GetBlockDataSize();
+                            const bool compress = ((compressedRequest.compression == TransferCompression::Lz4) &&
+                                                   (blockSize >= kMinCompressedBlockSizeInBytes) &&
+                                                   AllocateFrameBuffer());
+
+                            pBlock->BeginTransfer();
+
+                            m_pBlock = pBlock;
+                            m_compression = compress ? compressedRequest.compression : TransferCompression::None;
+                            m_frameSize = 0;
+                            m_frameOffset = 0;
+                            m_startOffset = 0;
+                            m_totalBytes = blockSize;
+                            m_bytesTransferred = 0;
+                            m_crc32 = compress ? 0 : pBlock->GetCrc32();
+                            m_accumulateCrc = compress;
+                            m_state = SessionState::StartPullTransfer;
+
+                            m_scratchPayload.CreatePayload<TransferCompressedDataHeader>(
+                                compress ? 0 : static_cast<uint32>(blockSize),
+                                static_cast<uint32>(blockSize),
+                                m_compression);
+
+                            SendPullTransferHeader();
+                        }
+                        else
+                        {
+                            m_scratchPayload.CreatePayload<TransferStatus>(Result::Error);
+                            m_state = SessionState::SendPayload;
+                            SendScratchPayloadAndMoveToIdle();
+                        }
+                        break;
+                    }
+                    case TransferType::HashedPull:
+                    {
+                        SharedPointer<ServerBlock> pBlock = m_pTransferManager->GetServerBlock(request.blockId);
+                        const bool blockIsAvailable = (!pBlock.IsNull() && pBlock->IsClosed());
+                        if (blockIsAvailable &&
+                            (m_state == SessionState::Idle) &&
+                            (m_pSession->GetVersion() >= TRANSFER_CONTENT_HASH_VERSION))
+                        {
+                            pBlock->BeginTransfer();
+
+                            m_pBlock = pBlock;
+                            m_compression = TransferCompression::None;
+                            m_startOffset = 0;
+                            m_totalBytes = pBlock->GetBlockDataSize();
+                            m_bytesTransferred = 0;
+                            m_crc32 = pBlock->GetCrc32();
+                            m_accumulateCrc = false;
+                            m_waitForContinue = true;
+                            m_state = SessionState::StartPullTransfer;
+
+                            // The data is only sent once the client asks for it after seeing the hash.
+                            m_scratchPayload.CreatePayload<TransferHashedDataHeader>(static_cast<uint32>(m_totalBytes),
+                                                                                     pBlock->GetContentHash());
+
+                            SendPullTransferHeader();
+                        }
+                        else
+                        {
+                            m_scratchPayload.CreatePayload<TransferStatus>(Result::Error);
+                            m_state = SessionState::SendPayload;
+                            SendScratchPayloadAndMoveToIdle();
+                        }
+                        break;
+                    }
+                    case TransferType::ResumePush:
+                    {
+                        // Picks up a push transfer whose session was lost. The block keeps the data it received
+                        // before the interruption, so the client continues writing from the end of that data.
+                        // The interrupted session may not have been torn down yet, so this session takes the
+                        // block over and the old one stops writing to it.
+                        SharedPointer<ServerBlock> pBlock = m_pTransferManager->GetServerBlock(request.blockId);
+                        const bool blockIsAvailable = (!pBlock.IsNull() && !pBlock->IsClosed());
+                        if (blockIsAvailable &&
+                            (m_state == SessionState::Idle) &&
+                            (m_pSession->GetVersion() >= TRANSFER_RESUME_VERSION) &&
+                            (request.sizeInBytes >= pBlock->GetBlockDataSize()))
+                        {
+                            pBlock->BeginTransfer();
+
+                            m_pBlock = pBlock;
+                            m_pushGeneration = ++pBlock->m_pushGeneration;
+                            m_bytesTransferred = pBlock->GetBlockDataSize();
+                            m_crc32 = 0;
+                            m_totalBytes = request.sizeInBytes;
+                            m_pBlock->Reserve(m_totalBytes);
+                            m_state = SessionState::StartPushTransfer;
+                            m_scratchPayload.CreatePayload<TransferResumeStatus>(Result::Success,
+                                                                                 static_cast<uint32>(m_bytesTransferred),
+                                                                                 pBlock->GetCrc32());
+                            StartPushTransferSession();
+                        }
+                        else
+                        {
+                            m_scratchPayload.CreatePayload<TransferResumeStatus>(Result::Error, 0, 0);
+                            m_state = SessionState::SendPayload;
+                            SendScratchPayloadAndMoveToIdle();
+                        }
+                        break;
+                    }
                     case TransferType::Push:
                     {
                         DD_ASSERT(m_pSession->GetVersion() >= TRANSFER_REFACTOR_VERSION);
@@ -164,6 +359,7 @@ namespace DevDriver
                             // Increments the number of pending transfers to prevent the block from being destroyed
                             // in the middle of a transfer.
                             m_pBlock = pBlock;
+                            m_pushGeneration = ++pBlock->m_pushGeneration;
                             m_bytesTransferred = 0;
                             m_crc32 = 0;
 
@@ -250,27 +446,44 @@ namespace DevDriver
                 // If we haven't received any messages from the client, then continue transferring data to them.
                 if (result == Result::NotReady)
                 {
-                    while (m_bytesTransferred < m_totalBytes)
+                    bool isTransferDone = false;
+
+                    if (m_compression != TransferCompression::None)
+                    {
+                        SendCompressedFrames();
+                        isTransferDone = ((m_bytesTransferred == m_totalBytes) && (m_frameOffset == m_frameSize));
+                    }
+                    else
                     {
-                        const uint8* pData = (m_pBlock->GetBlockData() + m_bytesTransferred);
-                        const size_t bytesRemaining = (m_totalBytes - m_bytesTransferred);
-                        const size_t bytesToSend = Platform::Min(kMaxTransferDataChunkSize, bytesRemaining);
+                        while (m_bytesTransferred < m_totalBytes)
+                        {
+                            const size_t bytesRemaining = (m_totalBytes - m_bytesTransferred);
+                            const size_t bytesToSend = Platform::Min(kMaxTransferDataChunkSize, bytesRemaining);
 
-                        TransferDataChunk::WritePayload(pData, bytesToSend, &m_scratchPayload);
+                            // Gather the chunk straight from the block's segments into the payload.
+                            uint8* pChunkData = TransferDataChunk::PreparePayload(bytesToSend, &m_scratchPayload);
+                            m_pBlock->Read(m_startOffset + m_bytesTransferred, pChunkData, bytesToSend);
 
-                        const Result sendResult = SendPayload(m_scratchPayload, kNoWait);
-                        if (sendResult == Result::Success)
-                        {
-                            m_bytesTransferred += bytesToSend;
-                        }
-                        else
-                        {
-                            break;
+                            const Result sendResult = SendPayload(m_scratchPayload, kNoWait);
+                            if (sendResult == Result::Success)
+                            {
+                                if (m_accumulateCrc)
+                                {
+                                    m_crc32 = CRC32(pChunkData, bytesToSend, m_crc32);
+                                }
+                                m_bytesTransferred += bytesToSend;
+                            }
+                            else
+                            {
+                                break;
+                            }
                         }
+
+                        isTransferDone = (m_bytesTransferred == m_totalBytes);
                     }
 
                     // If we've finished transferring all block data, send the sentinel and free the block.
-                    if (m_bytesTransferred == m_totalBytes)
+                    if (isTransferDone)
                     {
                         // Notify the block that a transfer is completing.
                         m_pBlock->EndTransfer();
@@ -299,14 +512,125 @@ namespace DevDriver
                 }
             }
 
+            // ========================================================================================================
+            // Sends the frames of a compressed pull until the session can't take more data, encoding each frame
+            // once all of the previous one has been sent.
+            void SendCompressedFrames()
+            {
+                bool canSend = true;
+                while (canSend && ((m_frameOffset < m_frameSize) || (m_bytesTransferred < m_totalBytes)))
+                {
+                    if (m_frameOffset == m_frameSize)
+                    {
+                        EncodeFrame();
+                    }
+
+                    // Chunks don't span frames so a chunk that couldn't be sent can be built again from the frame.
+                    const uint8* pFrameData = (m_pFrameBuffer + kCompressedFrameSizeInBytes + m_frameOffset);
+                    const size_t bytesToSend = Platform::Min(kMaxTransferDataChunkSize, (m_frameSize - m_frameOffset));
+                    TransferDataChunk::WritePayload(pFrameData, bytesToSend, &m_scratchPayload);
+
+                    canSend = (SendPayload(m_scratchPayload, kNoWait) == Result::Success);
+                    if (canSend)
+                    {
+                        m_crc32 = CRC32(pFrameData, bytesToSend, m_crc32);
+                        m_frameOffset += bytesToSend;
+                    }
+                }
+            }
+
+            // ========================================================================================================
+            // Encodes the next kCompressedFrameSizeInBytes bytes of the block into the frame buffer. The raw data is
+            // read into the front of the buffer and the frame, header first, is written behind it. Frames that don't
+            // shrink are stored as they are.
+            void EncodeFrame()
+            {
+                DD_ASSERT(m_pFrameBuffer != nullptr);
+
+                uint8* pRawData = m_pFrameBuffer;
+                uint8* pFrame = (m_pFrameBuffer + kCompressedFrameSizeInBytes);
+                uint8* pFrameData = (pFrame + sizeof(TransferCompressedFrameHeader));
+
+                const size_t rawSize = m_pBlock->Read(m_bytesTransferred,
+                                                      pRawData,
+                                                      Platform::Min(static_cast<size_t>(kCompressedFrameSizeInBytes),
+                                                                    (m_totalBytes - m_bytesTransferred)));
+
+                // Limiting the output to less than the input makes LZ4 give up early on data that doesn't shrink.
+                size_t compressedSize = Lz4::CompressBlock(pRawData, rawSize, pFrameData, (rawSize - 1));
+                if (compressedSize == 0)
+                {
+                    memcpy(pFrameData, pRawData, rawSize);
+                    compressedSize = rawSize;
+                }
+
+                TransferCompressedFrameHeader frameHeader = {};
+                frameHeader.compressedSizeInBytes = static_cast<uint32>(compressedSize);
+                frameHeader.decompressedSizeInBytes = static_cast<uint32>(rawSize);
+                memcpy(pFrame, &frameHeader, sizeof(frameHeader));
+
+                m_bytesTransferred += rawSize;
+                m_frameOffset = 0;
+                m_frameSize = (sizeof(frameHeader) + compressedSize);
+            }
+
+            // ========================================================================================================
+            // Allocates the frame buffer used by compressed pulls. It's kept for the rest of the session.
+            bool AllocateFrameBuffer()
+            {
+                if (m_pFrameBuffer == nullptr)
+                {
+                    m_pFrameBuffer = reinterpret_cast<uint8*>(DD_MALLOC(kFrameBufferSizeInBytes,
+                                                                        alignof(TransferChunk),
+                                                                        m_allocCb));
+                }
+
+                return (m_pFrameBuffer != nullptr);
+            }
+
             // ========================================================================================================
             void SendPullTransferHeader()
             {
                 DD_ASSERT(m_state == SessionState::StartPullTransfer);
                 if (SendPayload(m_scratchPayload, kNoWait) == Result::Success)
                 {
-                    m_state = SessionState::ProcessPullTransfer;
-                    ProcessPullSession();
+                    if (m_waitForContinue)
+                    {
+                        m_waitForContinue = false;
+                        m_state = SessionState::WaitForPullContinue;
+                        WaitForPullContinue();
+                    }
+                    else
+                    {
+                        m_state = SessionState::ProcessPullTransfer;
+                        ProcessPullSession();
+                    }
+                }
+            }
+
+            // ========================================================================================================
+            void WaitForPullContinue()
+            {
+                DD_ASSERT(m_state == SessionState::WaitForPullContinue);
+
+                const Result result = ReceivePayload(&m_scratchPayload, kNoWait);
+                if (result == Result::Success)
+                {
+                    const TransferStatus& status = m_scratchPayload.GetPayload<TransferStatus>();
+                    if ((status.command == TransferMessage::TransferStatus) && (status.result == Result::Success))
+                    {
+                        m_state = SessionState::ProcessPullTransfer;
+                        ProcessPullSession();
+                    }
+                    else
+                    {
+                        // The client already has the data or gave up on the transfer. Either way nothing more is sent.
+                        DD_ALERT((status.command == TransferMessage::TransferStatus) &&
+                                 ((status.result == Result::EndOfStream) || (status.result == Result::Aborted)));
+                        m_pBlock->EndTransfer();
+                        m_pBlock.Clear();
+                        m_state = SessionState::Idle;
+                    }
                 }
             }
 
@@ -330,7 +654,16 @@ namespace DevDriver
                 do
                 {
                     result = ReceivePayload(&m_scratchPayload, kNoWait);
-                    if (result == Result::Success)
+                    if ((result == Result::Success) && (m_pBlock->m_pushGeneration != m_pushGeneration))
+                    {
+                        // A resumed push took the block over. Leave its data alone and stop the transfer.
+                        m_pBlock->EndTransfer();
+                        m_pBlock.Clear();
+                        m_state = SessionState::SendPayload;
+                        m_scratchPayload.CreatePayload<TransferStatus>(Result::Aborted);
+                        SendScratchPayloadAndMoveToIdle();
+                    }
+                    else if (result == Result::Success)
                     {
                         switch (m_scratchPayload.GetPayload<TransferHeader>().command)
                         {
@@ -422,6 +755,11 @@ namespace DevDriver
                     SendPullTransferHeader();
                     break;
                 }
+                case SessionState::WaitForPullContinue:
+                {
+                    WaitForPullContinue();
+                    break;
+                }
 
                 case SessionState::StartPushTransfer:
                 {
@@ -450,13 +788,29 @@ namespace DevDriver
             }
 
         private:
+            // Blocks smaller than this are sent uncompressed.
+            DD_STATIC_CONST size_t kMinCompressedBlockSizeInBytes = (4 * kTransferChunkSizeInBytes);
+
+            // Raw data of a frame followed by the encoded frame, which is never larger than its header and the raw data.
+            DD_STATIC_CONST size_t kFrameBufferSizeInBytes =
+                ((2 * kCompressedFrameSizeInBytes) + sizeof(TransferCompressedFrameHeader));
+
             SizedPayloadContainer      m_scratchPayload;
+            AllocCb                    m_allocCb;
             TransferManager*           m_pTransferManager;
             SharedPointer<ISession>    m_pSession;
             SharedPointer<ServerBlock> m_pBlock;
-            size_t                     m_totalBytes;
-            size_t                     m_bytesTransferred;
+            TransferCompression        m_compression;      // Compression applied to the current pull
+            uint8*                     m_pFrameBuffer;     // Scratch buffer for compressed pulls, allocated on first use
+            size_t                     m_frameSize;        // Size of the current encoded frame including its header
+            size_t                     m_frameOffset;      // Bytes of the current frame that have been sent
+            size_t                     m_startOffset;
+            size_t                     m_totalBytes;       // Bytes to send, or block bytes to encode for compressed pulls
+            size_t                     m_bytesTransferred; // Bytes sent, or block bytes encoded for compressed pulls
             uint32                     m_crc32;
+            bool                       m_accumulateCrc;
+            bool                       m_waitForContinue; // Set while a hashed pull header waits to be sent
+            uint32                     m_pushGeneration;
             SessionState               m_state;
         };
 
@@ -489,7 +843,9 @@ namespace DevDriver
         void TransferServer::SessionEstablished(const SharedPointer<ISession>& pSession)
         {
             // Allocate session data for the newly established session
-            TransferSession* pSessionData = DD_NEW(TransferSession, m_pMsgChannel->GetAllocCb())(m_pTransferManager, pSession);
+            TransferSession* pSessionData = DD_NEW(TransferSession, m_pMsgChannel->GetAllocCb())(m_pMsgChannel->GetAllocCb(),
+                                                                                             m_pTransferManager,
+                                                                                             pSession);
             pSession->SetUserData(pSessionData);
         }
 
@@ -100,6 +100,7 @@ namespace DevDriver
                 , m_hasQueuedPayload(false)
                 , m_context()
                 , m_pendingPostRequest()
+                , m_postData(pServer->m_pMsgChannel->GetAllocCb())
             {
             }
 
@@ -264,12 +265,19 @@ namespace DevDriver
                                     // stored in m_pendingPostRequest
                                     if ((m_pendingPostRequest.pPostDataBlock.IsNull() == false) &&
                                         (m_pendingPostRequest.pPostDataBlock->GetBlockId() == payload.blockId) &&
-                                        (m_pendingPostRequest.pPostDataBlock->GetBlockData() != nullptr) &&
+                                        (payload.dataSize > 0) &&
                                         (payload.dataSize == m_pendingPostRequest.pPostDataBlock->GetBlockDataSize()))
                                     {
-                                        // The request data was sent via the provided blockId, setup the context to point at the block.
-                                        postInfo.pData  = m_pendingPostRequest.pPostDataBlock->GetBlockData();
-                                        postInfo.size   = static_cast<uint32>(m_pendingPostRequest.pPostDataBlock->GetBlockDataSize());
+                                        // The request data was sent via the provided blockId. The block may keep it in
+                                        // several segments, so gather it into the session's buffer for the service.
+                                        m_postData.Resize(payload.dataSize);
+                                        const size_t bytesRead =
+                                            m_pendingPostRequest.pPostDataBlock->Read(0, m_postData.Data(), payload.dataSize);
+                                        DD_ASSERT(bytesRead == payload.dataSize);
+                                        DD_UNUSED(bytesRead);
+
+                                        postInfo.pData  = m_postData.Data();
+                                        postInfo.size   = payload.dataSize;
                                         postInfo.format = TransferFmtToURIDataFmt(payload.dataFormat);
                                     }
                                     else
@@ -385,6 +393,7 @@ namespace DevDriver
             bool                                         m_hasQueuedPayload;
             URIRequestContext                            m_context;
             PostDataRequest m_pendingPostRequest;
+            Vector<uint8>   m_postData;            // Contiguous copy of the post data handed to services
         };
 
         // =====================================================================================================================
@@ -417,13 +417,14 @@ namespace DevDriver
         }
 
         // If the sessionRef pointer is non-null, we pass the message on to it. Otherwise we send a reset packet
-        // to inform the other side that the connection is invalid.
+        // to inform the other side that the connection is invalid. A reset is never answered with another one, or
+        // two clients that have both dropped a session would keep resetting it at each other.
         if (!pSession.IsNull())
         {
             DD_ASSERT(pSession->GetDestinationClientId() == sourceClientId);
             pSession->HandleMessage(pSession, messageBuffer);
         }
-        else
+        else if (static_cast<SessionMessage>(messageBuffer.header.messageId) != SessionMessage::Rst)
         {
             SendReset(sourceClientId, remoteSessionId, reason, version);
         }
@@ -45,6 +45,14 @@ namespace DevDriver
         case TransportType::Remote:
             result = SocketType::Udp;
             break;
+        case TransportType::RemoteStream:
+            result = SocketType::Tcp;
+            break;
+#if defined(DD_LINUX)
+        case TransportType::LocalPacket:
+            result = SocketType::LocalSeqPacket;
+            break;
+#endif
         default:
             DD_ALERT_REASON("Invalid transport type specified");
             break;
@@ -57,7 +65,10 @@ namespace DevDriver
         m_hostInfo(hostInfo),
         m_socketType(TransportToSocketType(hostInfo.type))
     {
-        if ((m_socketType != SocketType::Udp) && (m_socketType != SocketType::Local))
+        if ((m_socketType != SocketType::Udp) &&
+            (m_socketType != SocketType::Local) &&
+            (m_socketType != SocketType::Tcp) &&
+            (m_socketType != SocketType::LocalSeqPacket))
         {
             DD_ASSERT_REASON("Unsupported socket type provided");
         }
@@ -68,9 +79,29 @@ namespace DevDriver
         Disconnect();
     }
 
+    // Connects a socket to the remote host, waiting up to the timeout for a connection to be established
+    static Result ConnectSocket(Socket* pSocket, SocketType socketType, const HostInfo& hostInfo, uint32 timeoutInMs)
+    {
+        Result result = pSocket->Connect(hostInfo.hostname, hostInfo.port);
+
+        // Non-blocking connection oriented sockets finish connecting in the background.
+        if ((result == Result::NotReady) &&
+            ((socketType == SocketType::Tcp) || (socketType == SocketType::LocalSeqPacket)))
+        {
+            bool canWrite = false;
+            bool exceptState = false;
+            result = pSocket->Select(nullptr, &canWrite, &exceptState, timeoutInMs);
+            if ((result == Result::Success) && (!canWrite || exceptState))
+            {
+                result = Result::Error;
+            }
+        }
+
+        return result;
+    }
+
     Result SocketMsgTransport::Connect(ClientId* pClientId, uint32 timeoutInMs)
     {
-        DD_UNUSED(timeoutInMs);
         DD_UNUSED(pClientId);
 
         // Attempt to connect to the remote host.
@@ -87,8 +118,22 @@ namespace DevDriver
 
             if (result == Result::Success)
             {
-                result = m_clientSocket.Connect(m_hostInfo.hostname, m_hostInfo.port);
+                result = ConnectSocket(&m_clientSocket, m_socketType, m_hostInfo, timeoutInMs);
             }
+
+            if ((result == Result::Success) && (m_socketType == SocketType::Tcp))
+            {
+                // Protocol messages are small and latency sensitive so they should never wait to be coalesced.
+                result = m_clientSocket.SetNoDelay(true);
+
+                if (result == Result::Success)
+                {
+                    // Larger buffers are only a hint, so failing to apply them is not fatal.
+                    m_clientSocket.SetBufferSizes(kStreamBufferSizeInBytes, kStreamBufferSizeInBytes);
+                }
+            }
+
+            m_messageStream.Reset();
             m_connected = (result == Result::Success);
         }
         return result;
@@ -130,8 +175,21 @@ namespace DevDriver
         {
             if (canRead)
             {
-                size_t bytesReceived;
-                result = m_clientSocket.Receive(reinterpret_cast<uint8*>(&messageBuffer), sizeof(MessageBuffer), &bytesReceived);
+                if (m_socketType == SocketType::Tcp)
+                {
+                    result = m_messageStream.ReceiveMessage(&m_clientSocket, &messageBuffer);
+                }
+                else
+                {
+                    size_t bytesReceived;
+                    result = m_clientSocket.Receive(reinterpret_cast<uint8*>(&messageBuffer), sizeof(MessageBuffer), &bytesReceived);
+
+                    // An empty read on a packet connection means the listener closed it.
+                    if ((result == Result::Unavailable) && (m_socketType == SocketType::LocalSeqPacket))
+                    {
+                        result = Result::Error;
+                    }
+                }
             }
             else if (exceptState)
             {
@@ -148,9 +206,36 @@ namespace DevDriver
     Result SocketMsgTransport::WriteMessage(const MessageBuffer &messageBuffer)
     {
         DD_ASSERT(m_connected);
-        const size_t totalMsgSize = (sizeof(MessageHeader) + messageBuffer.header.payloadSize);
-        size_t bytesSent = 0;
-        return m_clientSocket.Send(reinterpret_cast<const uint8*>(&messageBuffer), totalMsgSize, &bytesSent);
+        Result result = Result::Error;
+
+        if (m_socketType == SocketType::Tcp)
+        {
+            result = m_messageStream.SendMessage(&m_clientSocket, messageBuffer);
+
+            // Nothing else flushes the stream on this side, so a partially sent message is finished here. A stream
+            // that stays stalled can't be used any more.
+            while ((result == Result::Success) && m_messageStream.HasPendingSend())
+            {
+                bool canWrite = false;
+                result = m_clientSocket.Select(nullptr, &canWrite, nullptr, kSendStallTimeoutInMs);
+                if ((result != Result::Success) || !canWrite)
+                {
+                    result = Result::Error;
+                }
+                else if (m_messageStream.FlushSend(&m_clientSocket) == Result::Error)
+                {
+                    result = Result::Error;
+                }
+            }
+        }
+        else
+        {
+            const size_t totalMsgSize = (sizeof(MessageHeader) + messageBuffer.header.payloadSize);
+            size_t bytesSent = 0;
+            result = m_clientSocket.Send(reinterpret_cast<const uint8*>(&messageBuffer), totalMsgSize, &bytesSent);
+        }
+
+        return result;
     }
 
 #if !DD_VERSION_SUPPORTS(GPUOPEN_DISTRIBUTED_STATUS_FLAGS_VERSION)
@@ -172,7 +257,7 @@ namespace DevDriver
 
                 if (result == Result::Success)
                 {
-                    result = clientSocket.Connect(hostInfo.hostname, hostInfo.port);
+                    result = ConnectSocket(&clientSocket, sType, hostInfo, timeoutInMs);
                 }
 
                 if (result == Result::Success)
@@ -240,7 +325,7 @@ namespace DevDriver
                 // If we were able to bind to a socket we the connect to the remote host/port specified
                 if (result == Result::Success)
                 {
-                    result = clientSocket.Connect(hostInfo.hostname, hostInfo.port);
+                    result = ConnectSocket(&clientSocket, sType, hostInfo, timeoutInMs);
                 }
 
                 // If we made it this far we need to actually make sure we can actually communicate with the remote host
@@ -32,6 +32,7 @@
 
 #include "msgTransport.h"
 #include "ddSocket.h"
+#include "ddMessageStream.h"
 
 namespace DevDriver
 {
@@ -88,7 +89,14 @@ namespace DevDriver
         }
 
     private:
+        // Kernel buffer sizes requested for stream connections so that bulk transfers are not window limited.
+        DD_STATIC_CONST uint32 kStreamBufferSizeInBytes = (1024 * 1024);
+
+        // How long a write waits for the rest of a partially sent message to go out before giving up on the stream.
+        DD_STATIC_CONST uint32 kSendStallTimeoutInMs = 1000;
+
         Socket              m_clientSocket;
+        MessageStream       m_messageStream;
         bool                m_connected;
         const HostInfo      m_hostInfo;
         const SocketType    m_socketType;
@@ -0,0 +1,285 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "ddPlatform.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DD_CRC32_PCLMUL 1
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DD_CRC32_PCLMUL_TARGET
+#else
+#include <cpuid.h>
+#define DD_CRC32_PCLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#endif
+#else
+#define DD_CRC32_PCLMUL 0
+#endif
+
+namespace DevDriver
+{
+
+// All implementations work on the inverted CRC state and leave the final inversion to CRC32.
+typedef uint32 (*Crc32Func)(const uint8* pData, size_t length, uint32 crc);
+
+// Lookup tables for the slice-by-8 method. See http://create.stephan-brumme.com/crc32/#slicing-by-8-overview
+// Table 0 is the Sarwate table and table N advances a byte's contribution by N further bytes.
+struct Crc32Tables
+{
+    Crc32Tables()
+    {
+        for (uint32 i = 0; i < 256; ++i)
+        {
+            uint32 crc = i;
+            for (uint32 bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0u);
+            }
+            table[0][i] = crc;
+        }
+
+        for (uint32 i = 0; i < 256; ++i)
+        {
+            for (uint32 slice = 1; slice < 8; ++slice)
+            {
+                const uint32 crc = table[slice - 1][i];
+                table[slice][i] = (crc >> 8) ^ table[0][crc & 0xFF];
+            }
+        }
+    }
+
+    uint32 table[8][256];
+};
+
+//=====================================================================================================================
+static const Crc32Tables& GetCrc32Tables()
+{
+    static const Crc32Tables tables;
+    return tables;
+}
+
+//=====================================================================================================================
+static uint32 Load32(const uint8* pData)
+{
+    return (static_cast<uint32>(pData[0])         |
+            (static_cast<uint32>(pData[1]) << 8)  |
+            (static_cast<uint32>(pData[2]) << 16) |
+            (static_cast<uint32>(pData[3]) << 24));
+}
+
+//=====================================================================================================================
+static uint32 Crc32SliceBy8(const uint8* pData, size_t length, uint32 crc)
+{
+    const uint32 (&table)[8][256] = GetCrc32Tables().table;
+
+    while (length >= 8)
+    {
+        const uint32 one = Load32(pData) ^ crc;
+        const uint32 two = Load32(pData + 4);
+        crc = table[7][one & 0xFF]         ^
+              table[6][(one >> 8) & 0xFF]  ^
+              table[5][(one >> 16) & 0xFF] ^
+              table[4][one >> 24]          ^
+              table[3][two & 0xFF]         ^
+              table[2][(two >> 8) & 0xFF]  ^
+              table[1][(two >> 16) & 0xFF] ^
+              table[0][two >> 24];
+        pData += 8;
+        length -= 8;
+    }
+
+    while (length-- > 0)
+    {
+        crc = (crc >> 8) ^ table[0][(crc ^ *pData++) & 0xFF];
+    }
+
+    return crc;
+}
+
+#if DD_CRC32_PCLMUL
+//=====================================================================================================================
+// Folds a multiple of 16 bytes, at least 64, with carry-less multiplies and reduces the result with Barrett reduction.
+// This is the method from Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" using
+// the bit-reflected constants for the CRC32 polynomial, as also used by zlib.
+DD_CRC32_PCLMUL_TARGET
+static uint32 Crc32FoldPclmul(const uint8* pData, size_t length, uint32 crc)
+{
+    alignas(16) static const uint64 kK1K2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64 kK3K4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64 kK5K0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64 kPoly[] = { 0x01db710641, 0x01f7011641 };
+
+    DD_ASSERT((length >= 64) && ((length % 16) == 0));
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+
+    __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(kK1K2));
+
+    pData += 64;
+    length -= 64;
+
+    // Fold four lanes of 16 bytes in parallel.
+    while (length >= 64)
+    {
+        const __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        const __m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+        const __m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+        const __m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + 0x30)));
+
+        pData += 64;
+        length -= 64;
+    }
+
+    // Fold the four lanes into one.
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(kK3K4));
+
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold any remaining 16 byte blocks.
+    while (length >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData))), x5);
+
+        pData += 16;
+        length -= 16;
+    }
+
+    // Fold 128 bits down to 64 bits.
+    const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kK5K0));
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction down to 32 bits.
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(kPoly));
+
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+//=====================================================================================================================
+static uint32 Crc32Pclmul(const uint8* pData, size_t length, uint32 crc)
+{
+    // Folding only pays off for longer buffers and works on whole 16 byte blocks.
+    if (length >= 64)
+    {
+        const size_t foldLength = (length & ~static_cast<size_t>(15));
+        crc = Crc32FoldPclmul(pData, foldLength, crc);
+        pData += foldLength;
+        length -= foldLength;
+    }
+
+    return Crc32SliceBy8(pData, length, crc);
+}
+
+//=====================================================================================================================
+static bool CpuSupportsPclmul()
+{
+    // CPUID leaf 1 reports PCLMULQDQ in bit 1 of ECX and SSE2 in bit 26 of EDX.
+#if defined(_MSC_VER)
+    int cpuInfo[4] = {};
+    __cpuid(cpuInfo, 1);
+    const uint32 ecx = static_cast<uint32>(cpuInfo[2]);
+    const uint32 edx = static_cast<uint32>(cpuInfo[3]);
+#else
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+    {
+        ecx = 0;
+        edx = 0;
+    }
+#endif
+    return (((ecx & (1u << 1)) != 0) && ((edx & (1u << 26)) != 0));
+}
+#endif
+
+//=====================================================================================================================
+static Crc32Func SelectCrc32Func()
+{
+    // Build the tables up front so the first call on each path doesn't race to do it.
+    GetCrc32Tables();
+
+    Crc32Func pfnCrc32 = &Crc32SliceBy8;
+#if DD_CRC32_PCLMUL
+    if (CpuSupportsPclmul())
+    {
+        pfnCrc32 = &Crc32Pclmul;
+    }
+#endif
+    return pfnCrc32;
+}
+
+//=====================================================================================================================
+uint32 CRC32(const void* pData, size_t length, uint32 lastCRC)
+{
+    static const Crc32Func pfnCrc32 = SelectCrc32Func();
+
+    return ~pfnCrc32(static_cast<const uint8*>(pData), length, ~lastCRC);
+}
+
+} // DevDriver
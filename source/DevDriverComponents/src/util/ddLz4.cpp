@@ -0,0 +1,299 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "util/ddLz4.h"
+
+namespace DevDriver
+{
+    namespace Lz4
+    {
+        // Block format constraints. The last match must start at least kMatchFindLimit bytes before the end of the
+        // input and the last kLastLiterals bytes are always encoded as literals.
+        DD_STATIC_CONST size_t kMinMatch       = 4;
+        DD_STATIC_CONST size_t kLastLiterals   = 5;
+        DD_STATIC_CONST size_t kMatchFindLimit = 12;
+        DD_STATIC_CONST size_t kMaxOffset      = 65535;
+        DD_STATIC_CONST uint32 kHashLog        = 12;
+        DD_STATIC_CONST uint32 kRunMask        = 15;
+
+        // ================================================================================================================
+        static uint32 Read32(const uint8* pData)
+        {
+            uint32 value;
+            memcpy(&value, pData, sizeof(value));
+            return value;
+        }
+
+        // ================================================================================================================
+        static uint32 Hash(uint32 sequence)
+        {
+            return ((sequence * 2654435761u) >> (32 - kHashLog));
+        }
+
+        // ================================================================================================================
+        // Writes the extra length bytes that follow a token field that was saturated at kRunMask.
+        static uint8* WriteLength(uint8* pDst, size_t length)
+        {
+            while (length >= 255)
+            {
+                *pDst++ = 255;
+                length -= 255;
+            }
+            *pDst++ = static_cast<uint8>(length);
+            return pDst;
+        }
+
+        // ================================================================================================================
+        // Reads the extra length bytes that follow a saturated token field. Returns false if the input ends first.
+        static bool ReadLength(const uint8** ppSrc, const uint8* pSrcEnd, size_t* pLength)
+        {
+            const uint8* pSrc = *ppSrc;
+            uint8 value = 255;
+            while (value == 255)
+            {
+                if (pSrc >= pSrcEnd)
+                {
+                    return false;
+                }
+                value = *pSrc++;
+                *pLength += value;
+            }
+            *ppSrc = pSrc;
+            return true;
+        }
+
+        // ================================================================================================================
+        // Emits one sequence. A match length of zero marks the final, literal only, sequence.
+        static uint8* WriteSequence(uint8*       pDst,
+                                    const uint8* pDstEnd,
+                                    const uint8* pLiterals,
+                                    size_t       literalLength,
+                                    size_t       offset,
+                                    size_t       matchLength)
+        {
+            const size_t worstCase = 1 + (literalLength / 255) + 1 + literalLength + 2 + (matchLength / 255) + 1;
+            if (worstCase > static_cast<size_t>(pDstEnd - pDst))
+            {
+                return nullptr;
+            }
+
+            uint8* pToken = pDst++;
+            uint8 token = 0;
+
+            if (literalLength >= kRunMask)
+            {
+                token = static_cast<uint8>(kRunMask << 4);
+                pDst = WriteLength(pDst, literalLength - kRunMask);
+            }
+            else
+            {
+                token = static_cast<uint8>(literalLength << 4);
+            }
+            memcpy(pDst, pLiterals, literalLength);
+            pDst += literalLength;
+
+            if (matchLength != 0)
+            {
+                *pDst++ = static_cast<uint8>(offset & 0xFF);
+                *pDst++ = static_cast<uint8>(offset >> 8);
+
+                const size_t matchCode = matchLength - kMinMatch;
+                if (matchCode >= kRunMask)
+                {
+                    token |= static_cast<uint8>(kRunMask);
+                    pDst = WriteLength(pDst, matchCode - kRunMask);
+                }
+                else
+                {
+                    token |= static_cast<uint8>(matchCode);
+                }
+            }
+
+            *pToken = token;
+            return pDst;
+        }
+
+        // ================================================================================================================
+        size_t CompressBlock(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity)
+        {
+            DD_ASSERT((pSrc != nullptr) || (srcSize == 0));
+            DD_ASSERT(pDst != nullptr);
+
+            const uint8* pInput = static_cast<const uint8*>(pSrc);
+            uint8* pOutput = static_cast<uint8*>(pDst);
+            const uint8* pOutputEnd = pOutput + dstCapacity;
+
+            size_t anchor = 0;
+
+            if (srcSize > kMatchFindLimit)
+            {
+                // Positions are stored relative to the start of the input. Stale or colliding entries are rejected by
+                // comparing the actual bytes below.
+                uint32 hashTable[1 << kHashLog] = {};
+
+                const size_t matchLimit = (srcSize - kLastLiterals);
+                const size_t searchLimit = (srcSize - kMatchFindLimit);
+                size_t pos = 0;
+
+                while (pos <= searchLimit)
+                {
+                    const uint32 sequence = Read32(pInput + pos);
+                    const uint32 hash = Hash(sequence);
+                    size_t candidate = hashTable[hash];
+                    hashTable[hash] = static_cast<uint32>(pos);
+
+                    if ((candidate < pos) &&
+                        ((pos - candidate) <= kMaxOffset) &&
+                        (Read32(pInput + candidate) == sequence))
+                    {
+                        size_t matchLength = kMinMatch;
+                        while (((pos + matchLength) < matchLimit) &&
+                               (pInput[candidate + matchLength] == pInput[pos + matchLength]))
+                        {
+                            ++matchLength;
+                        }
+
+                        // Pull any matching bytes back out of the pending literals.
+                        while ((pos > anchor) && (candidate > 0) && (pInput[pos - 1] == pInput[candidate - 1]))
+                        {
+                            --pos;
+                            --candidate;
+                            ++matchLength;
+                        }
+
+                        pOutput = WriteSequence(pOutput,
+                                                pOutputEnd,
+                                                pInput + anchor,
+                                                pos - anchor,
+                                                pos - candidate,
+                                                matchLength);
+                        if (pOutput == nullptr)
+                        {
+                            return 0;
+                        }
+
+                        pos += matchLength;
+                        anchor = pos;
+                    }
+                    else
+                    {
+                        // Step faster through data that is not matching to bound the cost of incompressible input.
+                        pos += 1 + ((pos - anchor) >> 6);
+                    }
+                }
+            }
+
+            pOutput = WriteSequence(pOutput, pOutputEnd, pInput + anchor, srcSize - anchor, 0, 0);
+
+            return (pOutput != nullptr) ? static_cast<size_t>(pOutput - static_cast<uint8*>(pDst)) : 0;
+        }
+
+        // ================================================================================================================
+        Result DecompressBlock(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity, size_t* pDstSize)
+        {
+            DD_ASSERT(pSrc != nullptr);
+            DD_ASSERT(pDst != nullptr);
+            DD_ASSERT(pDstSize != nullptr);
+
+            const uint8* pInput = static_cast<const uint8*>(pSrc);
+            const uint8* pInputEnd = pInput + srcSize;
+            uint8* pOutputStart = static_cast<uint8*>(pDst);
+            uint8* pOutput = pOutputStart;
+            const uint8* pOutputEnd = pOutputStart + dstCapacity;
+
+            Result result = (srcSize > 0) ? Result::Success : Result::Error;
+
+            while ((result == Result::Success) && (pInput < pInputEnd))
+            {
+                const uint8 token = *pInput++;
+
+                size_t literalLength = (token >> 4);
+                if ((literalLength == kRunMask) && (ReadLength(&pInput, pInputEnd, &literalLength) == false))
+                {
+                    result = Result::Error;
+                    break;
+                }
+
+                if ((literalLength > static_cast<size_t>(pInputEnd - pInput)) ||
+                    (literalLength > static_cast<size_t>(pOutputEnd - pOutput)))
+                {
+                    result = Result::Error;
+                    break;
+                }
+                memcpy(pOutput, pInput, literalLength);
+                pInput += literalLength;
+                pOutput += literalLength;
+
+                // The final sequence carries only literals.
+                if (pInput == pInputEnd)
+                {
+                    break;
+                }
+
+                if ((pInputEnd - pInput) < 2)
+                {
+                    result = Result::Error;
+                    break;
+                }
+                const size_t offset = (static_cast<size_t>(pInput[0]) | (static_cast<size_t>(pInput[1]) << 8));
+                pInput += 2;
+
+                size_t matchLength = (token & kRunMask);
+                if ((matchLength == kRunMask) && (ReadLength(&pInput, pInputEnd, &matchLength) == false))
+                {
+                    result = Result::Error;
+                    break;
+                }
+                matchLength += kMinMatch;
+
+                if ((offset == 0) ||
+                    (offset > static_cast<size_t>(pOutput - pOutputStart)) ||
+                    (matchLength > static_cast<size_t>(pOutputEnd - pOutput)))
+                {
+                    result = Result::Error;
+                    break;
+                }
+
+                // Matches may overlap the bytes they produce, so copy forwards one byte at a time in that case.
+                const uint8* pMatch = pOutput - offset;
+                if (offset >= matchLength)
+                {
+                    memcpy(pOutput, pMatch, matchLength);
+                    pOutput += matchLength;
+                }
+                else
+                {
+                    for (size_t i = 0; i < matchLength; ++i)
+                    {
+                        *pOutput++ = *pMatch++;
+                    }
+                }
+            }
+
+            *pDstSize = static_cast<size_t>(pOutput - pOutputStart);
+
+            return result;
+        }
+    } // Lz4
+} // DevDriver
@@ -211,6 +211,62 @@ namespace DevDriver
             _aligned_free(pMemory);
         }
 
+        void* AllocateFileBackedMemory(size_t size)
+        {
+            void* pMemory = nullptr;
+
+            char tempDir[MAX_PATH];
+            char tempPath[MAX_PATH];
+            const DWORD tempDirLength = GetTempPathA(sizeof(tempDir), tempDir);
+            if ((tempDirLength != 0) && (tempDirLength < sizeof(tempDir)) &&
+                (GetTempFileNameA(tempDir, "dd", 0, tempPath) != 0))
+            {
+                // The file is deleted once the last handle and view of it are gone.
+                HANDLE hFile = CreateFileA(tempPath,
+                                           GENERIC_READ | GENERIC_WRITE,
+                                           0,
+                                           nullptr,
+                                           CREATE_ALWAYS,
+                                           FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                                           nullptr);
+                if (hFile != INVALID_HANDLE_VALUE)
+                {
+                    // Creating the mapping extends the file to its full size, which fails if the disk is full.
+                    const uint64 mappingSize = size;
+                    HANDLE hMapping = CreateFileMappingA(hFile,
+                                                         nullptr,
+                                                         PAGE_READWRITE,
+                                                         static_cast<DWORD>(mappingSize >> 32),
+                                                         static_cast<DWORD>(mappingSize & 0xFFFFFFFF),
+                                                         nullptr);
+                    if (hMapping != nullptr)
+                    {
+                        pMemory = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+                        // The view keeps the mapping and the file alive.
+                        CloseHandle(hMapping);
+                    }
+                    CloseHandle(hFile);
+                }
+                else
+                {
+                    DeleteFileA(tempPath);
+                }
+            }
+
+            return pMemory;
+        }
+
+        void FreeFileBackedMemory(void* pMemory, size_t size)
+        {
+            DD_UNUSED(size);
+
+            if (pMemory != nullptr)
+            {
+                UnmapViewOfFile(pMemory);
+            }
+        }
+
         /////////////////////////////////////////////////////
         // Synchronization primatives...
         //
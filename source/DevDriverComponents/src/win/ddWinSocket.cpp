@@ -305,6 +305,7 @@ namespace DevDriver
 
             UINT port = ntohs(pSocket->sin_port);
 
+            pClientSocket->m_socketType = m_socketType;
             result = pClientSocket->InitAsClient(clientSocket, pAddress, port, m_isNonBlocking);
         }
 
@@ -399,6 +400,28 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::SendToMultiple(const void* const* ppSockAddrs,
+                                  const size_t*      pAddrSizes,
+                                  size_t             numAddrs,
+                                  const uint8*       pData,
+                                  size_t             dataSize,
+                                  Result*            pResults)
+    {
+        Result result = Result::Success;
+
+        // Winsock has no batched datagram send, so fall back to one sendto per destination.
+        for (size_t addrIndex = 0; addrIndex < numAddrs; ++addrIndex)
+        {
+            pResults[addrIndex] = SendTo(ppSockAddrs[addrIndex], pAddrSizes[addrIndex], pData, dataSize);
+            if ((result == Result::Success) && (pResults[addrIndex] != Result::Success))
+            {
+                result = pResults[addrIndex];
+            }
+        }
+
+        return result;
+    }
+
     Result Socket::Receive(uint8* pBuffer, size_t bufferSize, size_t* pBytesReceived)
     {
         //DD_ASSERT(m_socketType == SocketType::Tcp);
@@ -459,6 +482,52 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::EnableReceiveCoalescing()
+    {
+        DD_ASSERT(m_socketType == SocketType::Udp);
+
+        return Result::Unavailable;
+    }
+
+    Result Socket::ReceiveSegmentsFrom(void*   pSockAddr,
+                                       size_t* pAddrSize,
+                                       uint8*  pBuffer,
+                                       size_t  bufferSize,
+                                       size_t* pBytesReceived,
+                                       size_t* pSegmentSize)
+    {
+        DD_ASSERT(m_socketType == SocketType::Udp);
+        DD_ASSERT(*pAddrSize >= sizeof(sockaddr));
+
+        Result result = Result::Error;
+
+        int addrSize = static_cast<int>(*pAddrSize);
+        const int retVal = recvfrom(m_osSocket,
+                                    reinterpret_cast<char*>(pBuffer),
+                                    static_cast<int>(bufferSize),
+                                    0,
+                                    reinterpret_cast<sockaddr*>(pSockAddr),
+                                    &addrSize);
+
+        if (retVal > 0)
+        {
+            *pAddrSize      = static_cast<size_t>(addrSize);
+            *pBytesReceived = static_cast<size_t>(retVal);
+            *pSegmentSize   = static_cast<size_t>(retVal);
+            result = Result::Success;
+        }
+        else if (retVal == 0)
+        {
+            result = Result::Unavailable;
+        }
+        else
+        {
+            result = GetDataError(m_isNonBlocking);
+        }
+
+        return result;
+    }
+
     Result Socket::Close()
     {
         Result result = Result::Error;
@@ -482,6 +551,45 @@ namespace DevDriver
         return result;
     }
 
+    Result Socket::SetNoDelay(bool noDelay)
+    {
+        DD_ASSERT(m_socketType == SocketType::Tcp);
+
+        const BOOL value = noDelay ? TRUE : FALSE;
+        const int retVal = setsockopt(m_osSocket,
+                                      IPPROTO_TCP,
+                                      TCP_NODELAY,
+                                      reinterpret_cast<const char*>(&value),
+                                      sizeof(value));
+
+        return (retVal == 0) ? Result::Success : Result::Error;
+    }
+
+    Result Socket::SetBufferSizes(uint32 sendBufferSize, uint32 receiveBufferSize)
+    {
+        Result result = Result::Success;
+
+        if (sendBufferSize > 0)
+        {
+            const int value = static_cast<int>(sendBufferSize);
+            if (setsockopt(m_osSocket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&value), sizeof(value)) != 0)
+            {
+                result = Result::Error;
+            }
+        }
+
+        if (receiveBufferSize > 0)
+        {
+            const int value = static_cast<int>(receiveBufferSize);
+            if (setsockopt(m_osSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&value), sizeof(value)) != 0)
+            {
+                result = Result::Error;
+            }
+        }
+
+        return result;
+    }
+
     Result Socket::GetSocketName(char *pAddress, size_t addrLen, uint32 *pPort)
     {
         Result result = Result::Error;